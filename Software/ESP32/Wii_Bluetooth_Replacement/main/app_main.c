@@ -11,21 +11,26 @@
 #include "rom/ets_sys.h"
 #include "esp_system.h"
 #include "driver/timer.h"
+#include "cal_cache.h"
 #include "connect.h"
+#include "console.h"
 #include "gamepad.h"
 #include "hid_controller.h"
+#include "link_policy.h"
 #include "pair.h"
+#include "pipeline.h"
+#include "reconnect.h"
+#include "registry.h"
 #include "spi.h"
 #include "uart_controller.h"
 #include "timer.h"
+#include "trace.h"
 #include "wiimote.h"
 
 #define PAIR_PIN GPIO_NUM_14
 
 static btstack_timer_source_t app_loop;
 uint64_t app_timer;	// App time running in ms
-uint32_t prev_time = 0;
-uint8_t spi_en = 0;
 
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 static btstack_packet_callback_registration_t l2cap_event_callback_registration;
@@ -48,6 +53,7 @@ static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *pa
 					host_mac_string[6] = 0;
 					l2cap_register_service(l2cap_event_handler, HID_CONTROL_PSM, 64, LEVEL_2);
 					l2cap_register_service(l2cap_event_handler, HID_INTERRUPT_PSM, 64, LEVEL_2);
+					reconnect_start();	// Previously connected controllers page on boot
 				}
 				break;
 			default:
@@ -56,13 +62,23 @@ static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *pa
     }
 }
 
+// Refresh app_timer outside of the loop timer so event handlers see the current time
+void app_timer_update() {
+	uint64_t counter;
+	timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &counter);
+	app_timer = counter / 1000;	// Convert us to ms
+}
+
+// Controllers are handled as their packets arrive and gamepads by the pipeline, so this loop only covers pairing, wired Joy-Con and timeouts
 void app_loop_handler(btstack_timer_source_t *ts) {
     UNUSED(ts);
-	timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &app_timer);
-	app_timer = app_timer / 1000;	// Convert us to ms
+	app_timer_update();
 
 	if (!gpio_get_level(PAIR_PIN) && app_timer >= 1000) start_scan();
 	pair_timeout_check();
+	registry_write_handle();
+	cal_cache_write_handle();
+	reconnect_handle();
 
 	// Check device inquiry results
 	if (ready_to_pair()) {
@@ -80,33 +96,17 @@ void app_loop_handler(btstack_timer_source_t *ts) {
 	uart_joycon_handle(&joycon_right);
 	uart_joycon_handle(&joycon_left);
 
-	controller_handle(1);
-	controller_handle(2);
-	controller_handle(3);
-	controller_handle(4);
-	controller_handle(5);
-	controller_handle(6);
-	controller_handle(7);
-	controller_handle(8);
-
-	gamepad_handle(1);
-	gamepad_handle(2);
-	gamepad_handle(3);
-	gamepad_handle(4);
-
-	if ((app_timer >= 1500) && !spi_en) {
-		spi_en = 1;
-		gpio_set_level(SPI_EN, 1);	// Accept SPI transfers
-	}
-	
-	if (app_timer - prev_time >= 15) {
-		wiimote_spi_receive();
-		wiimote_spi_send(1);
-		wiimote_spi_send(2);
-		wiimote_spi_send(3);
-		wiimote_spi_send(4);
-		prev_time = app_timer;
-	}
+	controller_timer_handle(1);
+	controller_timer_handle(2);
+	controller_timer_handle(3);
+	controller_timer_handle(4);
+	controller_timer_handle(5);
+	controller_timer_handle(6);
+	controller_timer_handle(7);
+	controller_timer_handle(8);
+	pipeline_sync_states();	// Setup callbacks change controller state without a report
+
+	pipeline_handle_requests();	// In case a request was pushed while the previous one was running
 
 	// Re-register timer
 	btstack_run_loop_set_timer(&app_loop, APP_LOOP_PERIOD_MS);
@@ -121,9 +121,13 @@ int btstack_main(int argc, const char * argv[]) {
 	spi_slave_init(GPIO_NUM_19, GPIO_NUM_21, GPIO_NUM_17, GPIO_NUM_18);
 	uart_init();
 
+	init_registry();	// Known controllers are read from flash here only
 	init_controllers();
 	init_gamepads();
 	init_wiimotes();
+	trace_init();
+	console_init();	// "lat" prints pipeline latency and "link" radio slot usage per controller
+	pipeline_init();	// Gamepads, Wiimotes and SPI are handled on the other core from here on
 	
 	gpio_set_direction(PAIR_PIN, GPIO_MODE_INPUT);
 	gpio_set_pull_mode(PAIR_PIN, GPIO_PULLUP_ONLY);
@@ -131,6 +135,8 @@ int btstack_main(int argc, const char * argv[]) {
 	gpio_set_level(SPI_EN, 0);
 
     l2cap_init();
+	init_reconnect();
+	init_link_policy();	// Allow idle controllers to be put into sniff
 	
 	// Name must contain "Nintendo" to keep Switch controllers connected? But "Nintendo Switch" causes button latency
 	gap_set_local_name("Nintendo");
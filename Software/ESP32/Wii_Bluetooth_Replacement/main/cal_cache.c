@@ -0,0 +1,104 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "nvs.h"
+#include "cal_cache.h"
+#include "gamepad.h"
+#include "hid_controller.h"
+#include "pair.h"
+#include "pipeline.h"
+#include "timer.h"
+#include "trace.h"
+
+static cal_cache_pending_t cal_cache_pending[CAL_CACHE_PENDING];
+static uint8_t cal_cache_dirty = 0;
+static uint64_t cal_cache_change_time;
+
+static void cal_cache_key(uint8_t * addr, char * key) {
+    key[0] = 'c';
+    get_mac_address_string(addr, key + 1);
+}
+
+static cal_cache_pending_t * cal_cache_find_pending(uint8_t * addr) {
+    uint8_t i;
+
+    for (i = 0; i < CAL_CACHE_PENDING; i++) {
+        if (cal_cache_pending[i].dirty && !memcmp(cal_cache_pending[i].address, addr, 6)) return &cal_cache_pending[i];
+    }
+    return NULL;
+}
+
+// Returns 1 if a record for this controller (same type and firmware tag) was found
+uint8_t cal_cache_load(hid_controller_t * controller, cal_cache_record_t * record) {
+    cal_cache_pending_t * pending = cal_cache_find_pending(controller->address);
+    nvs_handle_t handle;
+    size_t len = sizeof(cal_cache_record_t);
+    char key[14];
+    esp_err_t err;
+
+    if (pending) memcpy(record, &pending->record, sizeof(cal_cache_record_t));  // Not written yet
+    else {
+        if (nvs_open(CAL_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return 0;
+        cal_cache_key(controller->address, key);
+        err = nvs_get_blob(handle, key, record, &len);
+        nvs_close(handle);
+        if ((err != ESP_OK) || (len != sizeof(cal_cache_record_t))) return 0;
+    }
+
+    if ((record->version != CAL_CACHE_VERSION) || (record->controller_type != controller->type)) return 0;
+    return 1;
+}
+
+// Only updates RAM, cal_cache_write_handle() writes it out later
+void cal_cache_store(hid_controller_t * controller) {
+    cal_cache_pending_t * pending;
+    uint8_t i;
+
+    if (!controller->gamepad_num || (controller->type == CNT_WIIU_PRO)) return;  // Wii U Pro Controller has no calibration to cache
+    pending = cal_cache_find_pending(controller->address);
+    for (i = 0; !pending && (i < CAL_CACHE_PENDING); i++) {
+        if (!cal_cache_pending[i].dirty) pending = &cal_cache_pending[i];
+    }
+    if (!pending) return;   // Only if more controllers than slots finish setup within the write delay, the next connection reads it again
+
+    memset(pending, 0, sizeof(cal_cache_pending_t));
+    memcpy(pending->address, controller->address, 6);
+    pending->record.version = CAL_CACHE_VERSION;
+    pending->record.controller_type = controller->type;
+    pending->record.wmp_type = controller->wmp_type;
+    pending->record.extension_type = controller->extension_type;
+    memcpy(&pending->record.cal, pipeline_staged_calibration(controller->gamepad_num), sizeof(calibration_t));
+    pending->dirty = 1;
+    cal_cache_dirty = 1;
+    cal_cache_change_time = app_timer;
+}
+
+// Called from the app loop, writes all changed records with a single commit once they have settled
+void cal_cache_write_handle() {
+    cal_cache_record_t stored;
+    nvs_handle_t handle;
+    size_t len;
+    char key[14];
+    uint8_t changed = 0;
+    uint8_t i;
+
+    if (!cal_cache_dirty || (app_timer - cal_cache_change_time < CAL_CACHE_WRITE_DELAY)) return;
+    cal_cache_dirty = 0;
+    if (nvs_open(CAL_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    for (i = 0; i < CAL_CACHE_PENDING; i++) {
+        if (!cal_cache_pending[i].dirty) continue;
+        cal_cache_pending[i].dirty = 0;
+        cal_cache_key(cal_cache_pending[i].address, key);
+        len = sizeof(cal_cache_record_t);
+
+        // Flash is only written when the record changed
+        if ((nvs_get_blob(handle, key, &stored, &len) == ESP_OK) && (len == sizeof(cal_cache_record_t)) &&
+            !memcmp(&cal_cache_pending[i].record, &stored, sizeof(cal_cache_record_t))) continue;
+        if (nvs_set_blob(handle, key, &cal_cache_pending[i].record, sizeof(cal_cache_record_t)) != ESP_OK) continue;
+        trace_event_data(0, EVT_CAL_CACHED, cal_cache_pending[i].address, 6);
+        changed = 1;
+    }
+    if (changed) nvs_commit(handle);
+    nvs_close(handle);
+}
\ No newline at end of file
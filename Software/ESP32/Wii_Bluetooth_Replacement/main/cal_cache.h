@@ -0,0 +1,31 @@
+#ifndef _CAL_CACHE_H_
+#define	_CAL_CACHE_H_
+
+#include "gamepad.h"
+#include "hid_controller.h"
+
+// Calibration and Wiimote capabilities are kept in NVS per controller MAC, so a reconnect doesn't wait for them to be read again
+#define CAL_CACHE_NAMESPACE "calcache"
+#define CAL_CACHE_VERSION   1   // Firmware tag, bump whenever the record layout or calibration parsing changes
+#define CAL_CACHE_PENDING   8   // Records held in RAM until written, one per connected controller
+#define CAL_CACHE_WRITE_DELAY   2000    // Time (ms) records are held in RAM before being written together
+
+typedef struct {
+    uint8_t version;
+    uint8_t controller_type;    // enum HID_DEVICE
+    uint8_t wmp_type;           // enum WMP_TYPE
+    uint8_t extension_type;     // enum EXTENSION_TYPE
+    calibration_t cal;
+} cal_cache_record_t;
+
+typedef struct {
+    uint8_t address[6];
+    cal_cache_record_t record;
+    uint8_t dirty;              // Record not yet written to NVS
+} cal_cache_pending_t;
+
+uint8_t cal_cache_load(hid_controller_t * controller, cal_cache_record_t * record);
+void cal_cache_store(hid_controller_t * controller);
+void cal_cache_write_handle();
+
+#endif
\ No newline at end of file
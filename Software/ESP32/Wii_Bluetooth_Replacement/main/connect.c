@@ -3,9 +3,13 @@
 #include "btstack.h"
 #include "connect.h"
 #include "hid_controller.h"
+#include "link_policy.h"
 #include "gamepad.h"
+#include "pipeline.h"
 #include "wiimote.h"
 #include "pair.h"
+#include "reconnect.h"
+#include "trace.h"
 #include "uart_controller.h"
 
 void l2cap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
@@ -13,17 +17,28 @@ void l2cap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet,
 	uint8_t event_addr[6] = {0};
     uint16_t l2cap_cid;
 	uint16_t psm;
+	uint8_t gamepad_num;
 	hid_controller_t * controller = NULL;
 
 	switch (packet_type) {
 		case HCI_EVENT_PACKET:
 			event = hci_event_packet_get_type(packet);
 			switch (event) {
+				case HCI_EVENT_CONNECTION_REQUEST:
+					hci_event_connection_request_get_bd_addr(packet, event_addr);
+					reconnect_connection_request(event_addr);
+					break;
 				case HCI_EVENT_CONNECTION_COMPLETE:
+					hci_event_connection_complete_get_bd_addr(packet, event_addr);
+					reconnect_connection_complete(event_addr, hci_event_connection_complete_get_status(packet));
 					//printf("Time 4 connection\n");
 					//hci_event_connection_complete_get_bd_addr(packet, event_addr);
 					//l2cap_create_channel(l2cap_event_handler, event_addr, HID_CONTROL_PSM, 64, &general_cid);
 					break;
+				case HCI_EVENT_MODE_CHANGE:
+					link_policy_mode_change(hci_event_mode_change_get_handle(packet), hci_event_mode_change_get_status(packet), 
+											hci_event_mode_change_get_mode(packet), hci_event_mode_change_get_interval(packet));
+					break;
 				case HCI_EVENT_PIN_CODE_REQUEST:
 					printf("Pin code request\n");
 					hci_event_pin_code_request_get_bd_addr(packet, event_addr);
@@ -80,7 +95,9 @@ void l2cap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet,
 							//if(hci_can_send_command_packet_now()) hci_send_cmd(&hci_write_automatic_flush_timeout, connection_handle, 0x0400);
 							//else write_flush_timeout_queued = 1;
 							controller->connected = 1;
-							printf("HID Interrupt established on channel %d\n", controller->l2cap_interrupt_cid);
+							reconnect_hid_opened(controller);
+							link_policy_reset(controller);
+							trace_event((controller - get_controller(1)) + 1, EVT_CONNECTED, controller->gamepad_num);
 							controller_setup(controller);
 						}
 					}
@@ -93,12 +110,11 @@ void l2cap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet,
 						if (l2cap_cid == controller->l2cap_interrupt_cid) controller->l2cap_interrupt_cid = 0;
 						if (controller->l2cap_control_cid == 0 && controller->l2cap_interrupt_cid == 0) {
 							if (controller->pairing) end_pair(controller);
-							gamepad_reset(&gamepads[controller->gamepad_num - 1]);
-							gamepad_set_type(controller->gamepad_num);
-							gamepad_set_extension(controller->gamepad_num);
-							wiimote_reset(&wiimotes[controller->gamepad_num - 1]);
+							gamepad_num = controller->gamepad_num;
 							controller_reset(controller);
-							printf("Device disconnected\n");
+							pipeline_reset_gamepad(gamepad_num, 1);	// After the reset so the pipeline sees the controller gone
+							trace_event((controller - get_controller(1)) + 1, EVT_DISCONNECTED, 0);
+							reconnect_start();	// Controller will likely try to reconnect
 						}
 					}
 					break;
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "console.h"
+#include "latency.h"
+#include "link_policy.h"
+
+typedef struct {
+    const char * name;
+    void (*handler)();
+    const char * help;
+} console_command_t;
+
+static void console_help();
+
+static const console_command_t console_commands[] = {
+    { "lat",        latency_print,            "Print per controller latency of each pipeline stage" },
+    { "lat reset",  latency_reset,            "Clear latency stats" },
+    { "link",       link_policy_print,        "Print radio slot usage and sniff time per connected controller" },
+    { "link reset", link_policy_reset_stats,  "Clear link stats" },
+    { "help",       console_help,             "List commands" }
+};
+
+static void console_help() {
+    uint8_t i;
+    for (i = 0; i < sizeof(console_commands) / sizeof(console_command_t); i++) printf("%-10s %s\n", console_commands[i].name, console_commands[i].help);
+}
+
+static void console_run(char * line) {
+    uint8_t i;
+    if (!line[0]) return;
+
+    for (i = 0; i < sizeof(console_commands) / sizeof(console_command_t); i++) {
+        if (!strcmp(line, console_commands[i].name)) {
+            console_commands[i].handler();
+            return;
+        }
+    }
+    printf("Unknown command \"%s\", type help for a list\n", line);
+}
+
+static void console_task(void * arg) {
+    char line[CONSOLE_LINE_LEN];
+    uint8_t line_len = 0;
+    uint8_t c;
+
+    while (1) {
+        if (uart_read_bytes(CONSOLE_UART, &c, 1, portMAX_DELAY) != 1) continue;
+
+        if ((c == '\r') || (c == '\n')) {
+            line[line_len] = 0;
+            console_run(line);
+            line_len = 0;
+        } else if (line_len < CONSOLE_LINE_LEN - 1) line[line_len++] = c;
+    }
+}
+
+// Only receiving goes through the driver, printf keeps writing to UART0 directly
+void console_init() {
+    uart_driver_install(CONSOLE_UART, CONSOLE_RX_BUF_LEN, 0, 0, NULL, 0);
+    xTaskCreatePinnedToCore(&console_task, "console", CONSOLE_TASK_STACK_SIZE, NULL, CONSOLE_TASK_PRIORITY, NULL, tskNO_AFFINITY);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef _CONSOLE_H_
+#define	_CONSOLE_H_
+
+// Line based commands typed into the serial monitor (UART0), handled by a low priority task
+#define CONSOLE_UART            UART_NUM_0
+#define CONSOLE_RX_BUF_LEN      256
+#define CONSOLE_LINE_LEN        32
+#define CONSOLE_TASK_PRIORITY   1
+#define CONSOLE_TASK_STACK_SIZE 3072
+
+void console_init();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef _FIXED_H_
+#define	_FIXED_H_
+
+#include <stdint.h>
+
+// Q16.16 fixed point used for angles, rates and IR coordinates (the ESP32 has no double precision FPU)
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT         16
+#define FIXED_ONE           ((fixed_t)1 << FIXED_SHIFT)
+#define FIXED_CONST(x)      ((fixed_t)((x) * 65536.0 + (((x) >= 0) ? 0.5 : -0.5)))     // Constant expressions only, folded at compile time
+#define FIXED_FROM_INT(x)   ((fixed_t)(x) * FIXED_ONE)
+#define FIXED_TO_INT(x)     ((int32_t)(x) >> FIXED_SHIFT)                                 // Rounds down
+
+static inline fixed_t fixed_mul(fixed_t a, fixed_t b) {
+    return (fixed_t)(((int64_t)a * b) >> FIXED_SHIFT);
+}
+
+static inline fixed_t fixed_div(fixed_t a, fixed_t b) {
+    return (fixed_t)(((int64_t)a << FIXED_SHIFT) / b);
+}
+
+// Scale an integer by num / den without losing precision to the intermediate product
+static inline fixed_t fixed_from_ratio(int32_t x, int32_t num, int32_t den) {
+    return (fixed_t)(((int64_t)x * num << FIXED_SHIFT) / den);
+}
+
+static inline fixed_t fixed_map(fixed_t x, fixed_t in_min, fixed_t in_max, fixed_t out_min, fixed_t out_max) {
+    return (fixed_t)(((int64_t)(x - in_min) * (out_max - out_min)) / (in_max - in_min)) + out_min;
+}
+
+static inline fixed_t fixed_clamp(fixed_t x, fixed_t min, fixed_t max) {
+    if (x < min) return min;
+    if (x > max) return max;
+    return x;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "flash_cal.h"
+#include "gamepad.h"
+#include "hid_command.h"
+#include "hid_controller.h"
+
+#define FLASH_CAL_MAGIC_0 0xB2  // User calibration is only valid if it starts with these bytes
+#define FLASH_CAL_MAGIC_1 0xA1
+
+typedef struct {
+    uint16_t address;
+    uint8_t len;        // Only the bytes the calibration parsers use
+    uint8_t offset;     // Offset in the image
+} flash_cal_block_t;
+
+static const flash_cal_block_t flash_cal_blocks[CAL_BLOCK_COUNT] = {
+    { 0x6020, 0x12, 0 },    // Factory IMU (accel offsets, accel sensitivity, gyro offsets)
+    { 0x603D, 0x09, 18 },   // Factory left stick
+    { 0x6046, 0x09, 27 },   // Factory right stick
+    { 0x8010, 0x0B, 36 },   // User left stick (magic, then same layout as factory)
+    { 0x801B, 0x0B, 47 },   // User right stick
+    { 0x8026, 0x14, 58 }    // User IMU
+};
+
+// Copies a block to where the calibration parsers expect a single flash read response. Returns 0 for user, 1 for factory, 2 if neither was read.
+static uint8_t flash_cal_select(hid_controller_t * controller, uint8_t user_block, uint8_t factory_block) {
+    flash_cal_t * cal = &controller->flash_cal;
+    const flash_cal_block_t * user = &flash_cal_blocks[user_block];
+    const flash_cal_block_t * factory = &flash_cal_blocks[factory_block];
+
+    if ((cal->blocks_read & (1 << user_block)) && (cal->image[user->offset] == FLASH_CAL_MAGIC_0) && (cal->image[user->offset + 1] == FLASH_CAL_MAGIC_1)) {
+        memcpy(controller->command_response + 21, cal->image + user->offset, user->len);
+        return 0;
+    }
+    if (cal->blocks_read & (1 << factory_block)) {
+        memcpy(controller->command_response + 21, cal->image + factory->offset, factory->len);
+        return 1;
+    }
+    return 2;
+}
+
+// Applies whatever was read. A missing user block falls back to factory, and with neither the current
+// calibration is kept (defaults after a reset, or the cached values when refreshing).
+static void flash_cal_apply(hid_controller_t * controller) {
+    flash_cal_t * cal = &controller->flash_cal;
+    uint8_t type;
+
+    cal->blocks_missing = cal->blocks & ~cal->blocks_read;
+    if (cal->blocks_missing) {
+        printf("Calibration blocks 0x%02X not read\n", cal->blocks_missing);
+        controller->cal_cache_dirty = 0;    // Don't cache an incomplete calibration, the next connection reads it again
+    }
+
+    if (cal->blocks & (1 << CAL_BLOCK_IMU_FACTORY)) {
+        type = flash_cal_select(controller, CAL_BLOCK_IMU_USER, CAL_BLOCK_IMU_FACTORY);
+        if (type < 2) {
+            controller->cal_accel_r_type = type;
+            controller->cal_accel_l_type = type;
+            controller->cal_gyro_r_type = type;
+            controller->cal_gyro_l_type = type;
+            gamepad_set_cal_imu(controller);
+        }
+    }
+    if (cal->blocks & (1 << CAL_BLOCK_JOY_R_FACTORY)) {
+        type = flash_cal_select(controller, CAL_BLOCK_JOY_R_USER, CAL_BLOCK_JOY_R_FACTORY);
+        if (type < 2) {
+            controller->cal_joy_r_type = type;
+            gamepad_set_cal_joy_r(controller);
+        }
+    }
+    if (cal->blocks & (1 << CAL_BLOCK_JOY_L_FACTORY)) {
+        type = flash_cal_select(controller, CAL_BLOCK_JOY_L_USER, CAL_BLOCK_JOY_L_FACTORY);
+        if (type < 2) {
+            controller->cal_joy_l_type = type;
+            gamepad_set_cal_joy_l(controller);
+        }
+    }
+}
+
+// Scatters a flash read response into every requested block it covers
+static void flash_cal_read_done(hid_controller_t * controller) {
+    flash_cal_t * cal = &controller->flash_cal;
+    uint8_t * response = controller->command_response;
+    uint16_t address = response[16] | (response[17] << 8);
+    uint8_t len = response[20];
+    const flash_cal_block_t * block;
+    uint8_t i;
+
+    if (controller->command_failed) len = 0;   // Timed out, its blocks stay unread and are reported as missing
+    if (len > FLASH_READ_MAX) len = FLASH_READ_MAX;
+    for (i = 0; i < CAL_BLOCK_COUNT; i++) {
+        block = &flash_cal_blocks[i];
+        if (!(cal->blocks & (1 << i)) || (block->address < address) || (block->address + block->len > address + len)) continue;
+        memcpy(cal->image + block->offset, response + 21 + (block->address - address), block->len);
+        cal->blocks_read |= (1 << i);
+    }
+
+    if (cal->reads_pending) cal->reads_pending--;
+    if (!cal->reads_pending) flash_cal_apply(controller);
+}
+
+static void flash_cal_queue_read(hid_controller_t * controller, uint16_t address, uint8_t len) {
+    uint8_t arg[5] = { address & 0xFF, address >> 8, 0x00, 0x00, len };
+    hid_queue_command(controller, &cmd_joycon_read_flash, arg, &flash_cal_read_done, 1);
+    controller->flash_cal.reads_pending++;
+}
+
+void flash_cal_load(hid_controller_t * controller) {
+    flash_cal_t * cal = &controller->flash_cal;
+    const flash_cal_block_t * block;
+    uint16_t start = 0, end = 0;
+    uint8_t i;
+
+    cal->blocks = (1 << CAL_BLOCK_IMU_FACTORY) | (1 << CAL_BLOCK_IMU_USER);
+    if (controller->type != CNT_JOYCON_L) cal->blocks |= (1 << CAL_BLOCK_JOY_R_FACTORY) | (1 << CAL_BLOCK_JOY_R_USER);
+    if (controller->type != CNT_JOYCON_R) cal->blocks |= (1 << CAL_BLOCK_JOY_L_FACTORY) | (1 << CAL_BLOCK_JOY_L_USER);
+    cal->blocks_read = 0;
+    cal->blocks_missing = 0;
+    cal->reads_pending = 0;
+
+    // Blocks are sorted by address, so greedily extending each read as far as FLASH_READ_MAX allows gives the fewest reads
+    for (i = 0; i < CAL_BLOCK_COUNT; i++) {
+        if (!(cal->blocks & (1 << i))) continue;
+        block = &flash_cal_blocks[i];
+        if (end && (block->address + block->len - start <= FLASH_READ_MAX)) {
+            end = block->address + block->len;
+            continue;
+        }
+        if (end) flash_cal_queue_read(controller, start, end - start);
+        start = block->address;
+        end = block->address + block->len;
+    }
+    if (end) flash_cal_queue_read(controller, start, end - start);
+}
\ No newline at end of file
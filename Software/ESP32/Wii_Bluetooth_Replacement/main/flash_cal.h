@@ -0,0 +1,25 @@
+#ifndef _FLASH_CAL_H_
+#define	_FLASH_CAL_H_
+
+#include <stdint.h>
+
+// Loads Joy-Con/Pro Controller calibration (factory and user) with the fewest SPI flash reads
+#define FLASH_READ_MAX      0x1D    // Largest flash read a controller answers
+#define FLASH_CAL_IMAGE_LEN 78      // Sum of all block lengths
+
+enum FLASH_CAL_BLOCK { CAL_BLOCK_IMU_FACTORY, CAL_BLOCK_JOY_L_FACTORY, CAL_BLOCK_JOY_R_FACTORY,  // Sorted by address
+                       CAL_BLOCK_JOY_L_USER, CAL_BLOCK_JOY_R_USER, CAL_BLOCK_IMU_USER, CAL_BLOCK_COUNT };
+
+typedef struct {
+    uint8_t blocks;         // Blocks requested (bitmask of FLASH_CAL_BLOCK)
+    uint8_t blocks_read;
+    uint8_t blocks_missing;     // Requested but lost to a timed out read, known once all reads are done
+    uint8_t reads_pending;
+    uint8_t image[FLASH_CAL_IMAGE_LEN];     // Block contents, each at its offset in the image
+} flash_cal_t;
+
+struct hid_controller_t;
+
+void flash_cal_load(struct hid_controller_t * controller);
+
+#endif
\ No newline at end of file
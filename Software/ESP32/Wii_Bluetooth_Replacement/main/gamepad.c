@@ -1,29 +1,41 @@
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include "btstack.h"
 #include "gamepad.h"
 #include "hid_controller.h"
+#include "hd_rumble.h"
 #include "hid_command.h"
+#include "input_desc.h"
+#include "joystick.h"
+#include "latency.h"
+#include "orientation.h"
+#include "pipeline.h"
 #include "uart_controller.h"
 #include "wiimote.h"
 #include "driver/timer.h"
 #include "timer.h"
+#include "trace.h"
 
 gamepad_t gamepads[4];
 
-static int32_t map(int32_t x, int32_t in_min, int32_t in_max, int32_t out_min, int32_t out_max) {
-    int32_t result = (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-    if (result < out_min) return out_min;
-    if (result > out_max) return out_max;
-    return result;
-}
+static joy_axis_map_t wiiu_pro_joy_map;   // Wii U Pro sticks have no calibration data
 
 static void gamepad_reset_angles(gamepad_t * gamepad) {
+    orientation_center(&gamepad->orientation);
     gamepad->yaw = 0;
     gamepad->pitch = 0;
     gamepad->roll = 0;
 }
 
+// Pointer angles relative to the last centered orientation
+static void gamepad_update_pointer(gamepad_t * gamepad) {
+    float yaw, pitch;
+    orientation_get_pointer(&gamepad->orientation, &yaw, &pitch);
+    gamepad->yaw = (fixed_t)(yaw * 65536.0f);
+    gamepad->pitch = (fixed_t)(pitch * 65536.0f);
+}
+
 static void gamepad_input_defaults(gamepad_t * gamepad) {
     memset(&gamepad->buttons, 0, sizeof(buttons_t));
     memset(&gamepad->buttons, 0, sizeof(axes_t));
@@ -33,49 +45,101 @@ static void gamepad_input_defaults(gamepad_t * gamepad) {
     gamepad->axes.joy_ly = 0x7FF;
 }
 
-static void gamepad_cal_defaults(gamepad_t * gamepad) {
-    gamepad->cal.joy_rx_max = 0xFFF;
-    gamepad->cal.joy_rx_center = 0x7FF;
-    gamepad->cal.joy_rx_min = 0;
-    gamepad->cal.joy_ry_max = 0xFFF;
-    gamepad->cal.joy_ry_center = 0x7FF;
-    gamepad->cal.joy_ry_min = 0;
-    gamepad->cal.accel_rx_offset = 0;
-    gamepad->cal.accel_ry_offset = 0;
-    gamepad->cal.accel_rz_offset = 0;
-    gamepad->cal.gyro_rx_offset = 0;
-    gamepad->cal.gyro_ry_offset = 0;
-    gamepad->cal.gyro_rz_offset = 0;
-    gamepad->cal.joy_lx_max = 0xFFF;
-    gamepad->cal.joy_lx_center = 0x7FF;
-    gamepad->cal.joy_lx_min = 0;
-    gamepad->cal.joy_ly_max = 0xFFF;
-    gamepad->cal.joy_ly_center = 0x7FF;
-    gamepad->cal.joy_ly_min = 0;
-    gamepad->cal.accel_lx_offset = 0;
-    gamepad->cal.accel_ly_offset = 0;
-    gamepad->cal.accel_lz_offset = 0;
-    gamepad->cal.gyro_lx_offset = 0;
-    gamepad->cal.gyro_ly_offset = 0;
-    gamepad->cal.gyro_lz_offset = 0;
+static void gamepad_build_joy_maps_r(gamepad_t * gamepad) {
+    joystick_build_map(&gamepad->joy_rx_map, gamepad->cal.joy_rx_min, gamepad->cal.joy_rx_center, gamepad->cal.joy_rx_max);
+    joystick_build_map(&gamepad->joy_ry_map, gamepad->cal.joy_ry_min, gamepad->cal.joy_ry_center, gamepad->cal.joy_ry_max);
+}
+
+static void gamepad_build_joy_maps_l(gamepad_t * gamepad) {
+    joystick_build_map(&gamepad->joy_lx_map, gamepad->cal.joy_lx_min, gamepad->cal.joy_lx_center, gamepad->cal.joy_lx_max);
+    joystick_build_map(&gamepad->joy_ly_map, gamepad->cal.joy_ly_min, gamepad->cal.joy_ly_center, gamepad->cal.joy_ly_max);
+}
+
+void gamepad_cal_defaults(calibration_t * cal) {
+    cal->joy_rx_max = 0xFFF;
+    cal->joy_rx_center = 0x7FF;
+    cal->joy_rx_min = 0;
+    cal->joy_ry_max = 0xFFF;
+    cal->joy_ry_center = 0x7FF;
+    cal->joy_ry_min = 0;
+    cal->accel_rx_offset = 0;
+    cal->accel_ry_offset = 0;
+    cal->accel_rz_offset = 0;
+    cal->gyro_rx_offset = 0;
+    cal->gyro_ry_offset = 0;
+    cal->gyro_rz_offset = 0;
+    cal->joy_lx_max = 0xFFF;
+    cal->joy_lx_center = 0x7FF;
+    cal->joy_lx_min = 0;
+    cal->joy_ly_max = 0xFFF;
+    cal->joy_ly_center = 0x7FF;
+    cal->joy_ly_min = 0;
+    cal->accel_lx_offset = 0;
+    cal->accel_ly_offset = 0;
+    cal->accel_lz_offset = 0;
+    cal->gyro_lx_offset = 0;
+    cal->gyro_ly_offset = 0;
+    cal->gyro_lz_offset = 0;
+}
+
+// Copy calibration groups set on the BTstack core (pipeline only)
+void gamepad_apply_cal(gamepad_t * gamepad, const calibration_t * cal, uint8_t groups) {
+    if (groups & CAL_GROUP_BIT(CAL_ACCEL_R)) {
+        gamepad->cal.accel_rx_offset = cal->accel_rx_offset;
+        gamepad->cal.accel_ry_offset = cal->accel_ry_offset;
+        gamepad->cal.accel_rz_offset = cal->accel_rz_offset;
+    }
+    if (groups & CAL_GROUP_BIT(CAL_GYRO_R)) {
+        gamepad->cal.gyro_rx_offset = cal->gyro_rx_offset;
+        gamepad->cal.gyro_ry_offset = cal->gyro_ry_offset;
+        gamepad->cal.gyro_rz_offset = cal->gyro_rz_offset;
+    }
+    if (groups & CAL_GROUP_BIT(CAL_JOY_R)) {
+        gamepad->cal.joy_rx_max = cal->joy_rx_max;
+        gamepad->cal.joy_rx_center = cal->joy_rx_center;
+        gamepad->cal.joy_rx_min = cal->joy_rx_min;
+        gamepad->cal.joy_ry_max = cal->joy_ry_max;
+        gamepad->cal.joy_ry_center = cal->joy_ry_center;
+        gamepad->cal.joy_ry_min = cal->joy_ry_min;
+        gamepad_build_joy_maps_r(gamepad);
+    }
+    if (groups & CAL_GROUP_BIT(CAL_ACCEL_L)) {
+        gamepad->cal.accel_lx_offset = cal->accel_lx_offset;
+        gamepad->cal.accel_ly_offset = cal->accel_ly_offset;
+        gamepad->cal.accel_lz_offset = cal->accel_lz_offset;
+    }
+    if (groups & CAL_GROUP_BIT(CAL_GYRO_L)) {
+        gamepad->cal.gyro_lx_offset = cal->gyro_lx_offset;
+        gamepad->cal.gyro_ly_offset = cal->gyro_ly_offset;
+        gamepad->cal.gyro_lz_offset = cal->gyro_lz_offset;
+    }
+    if (groups & CAL_GROUP_BIT(CAL_JOY_L)) {
+        gamepad->cal.joy_lx_max = cal->joy_lx_max;
+        gamepad->cal.joy_lx_center = cal->joy_lx_center;
+        gamepad->cal.joy_lx_min = cal->joy_lx_min;
+        gamepad->cal.joy_ly_max = cal->joy_ly_max;
+        gamepad->cal.joy_ly_center = cal->joy_ly_center;
+        gamepad->cal.joy_ly_min = cal->joy_ly_min;
+        gamepad_build_joy_maps_l(gamepad);
+    }
 }
 
 static uint8_t gamepad_handle_button_event(button_event_t * event, uint8_t button_state) {
     switch (event->state) {
         case 0: 
             if (button_state) {
-                event->press_timer = app_timer;
+                event->press_timer = pipeline_timer;
                 event->state = 1;
             }
             return 0;
         case 1:
-            if ((app_timer - event->press_timer) >= LONG_PRESS_THRESH) {
+            if ((pipeline_timer - event->press_timer) >= LONG_PRESS_THRESH) {
                 event->triggered = 1;
                 event->state = 2; // Button must be released before retriggering
                 //event->state = 0;   // Retrigger if button is held down
             } else if (!button_state) {
-                event->press_timer = app_timer - event->press_timer;
-                event->release_timer = app_timer;
+                event->press_timer = pipeline_timer - event->press_timer;
+                event->release_timer = pipeline_timer;
                 event->state = 3;
             }
             return 0;
@@ -83,8 +147,8 @@ static uint8_t gamepad_handle_button_event(button_event_t * event, uint8_t butto
             if (!button_state) event->state = 0;    // Wait for button to be released
             return 0;
         case 3:
-            event->press_timer -= (app_timer - event->release_timer);   // Decrement by amount of time since last loop
-            event->release_timer = app_timer;
+            event->press_timer -= (pipeline_timer - event->release_timer);   // Decrement by amount of time since last loop
+            event->release_timer = pipeline_timer;
             if (event->press_timer <= 0) event->state = 0;
             return 1;
         default:
@@ -92,37 +156,43 @@ static uint8_t gamepad_handle_button_event(button_event_t * event, uint8_t butto
     }
 }
 
+// Expand an input descriptor table (input_desc.h) into assignments from the report in data
+#define DESC_SET(group, field, byte, bit, width, shift, flags)  gamepad->group.field = DESC_READ(data, byte, bit, width, shift, flags);
+#define DESC_OR(group, field, byte, bit, width, shift, flags)   gamepad->group.field |= DESC_READ(data, byte, bit, width, shift, flags);
+#define DESC_DECODE(table) table(DESC_SET, DESC_OR)
+
+static void gamepad_map_joy_r(gamepad_t * gamepad) {
+    gamepad->axes.joy_rx = joystick_map(&gamepad->joy_rx_map, gamepad->axes.joy_rx);
+    gamepad->axes.joy_ry = joystick_map(&gamepad->joy_ry_map, gamepad->axes.joy_ry);
+}
+
+static void gamepad_map_joy_l(gamepad_t * gamepad) {
+    gamepad->axes.joy_lx = joystick_map(&gamepad->joy_lx_map, gamepad->axes.joy_lx);
+    gamepad->axes.joy_ly = joystick_map(&gamepad->joy_ly_map, gamepad->axes.joy_ly);
+}
+
+// Raw gyro values are provided while calibrating
+static void gamepad_apply_gyro_r_cal(gamepad_t * gamepad) {
+    if (gamepad->calibrating) return;
+    gamepad->axes.gyro_rx -= gamepad->cal.gyro_rx_offset;
+    gamepad->axes.gyro_ry -= gamepad->cal.gyro_ry_offset;
+    gamepad->axes.gyro_rz -= gamepad->cal.gyro_rz_offset;
+}
+
 static void gamepad_parse_joycon_input(gamepad_t * gamepad, hid_controller_t * hid_joycon_right, hid_controller_t * hid_joycon_left) {
+    uint8_t * data;
+
     if (hid_joycon_right) {
-        switch (hid_joycon_right->status_response[1]) {
+        data = hid_joycon_right->status_response;
+        switch (data[1]) {
             case 0x30:
-                gamepad->buttons.a = (hid_joycon_right->status_response[4] & 0x08) >> 3;
-                gamepad->buttons.b = (hid_joycon_right->status_response[4] & 0x04) >> 2;
-                gamepad->buttons.x = (hid_joycon_right->status_response[4] & 0x02) >> 1;
-                gamepad->buttons.y = hid_joycon_right->status_response[4] & 0x01;
-                gamepad->buttons.r = (hid_joycon_right->status_response[4] & 0x40) >> 6;
-                gamepad->buttons.zr = (hid_joycon_right->status_response[4] & 0x80) >> 7;
-                gamepad->buttons.plus = (hid_joycon_right->status_response[5] & 0x02) >> 1;
-                gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, (hid_joycon_right->status_response[5] & 0x10) >> 4);
-                gamepad->buttons.rs = (hid_joycon_right->status_response[5] & 0x04) >> 2;
-                gamepad->buttons.srr = (hid_joycon_right->status_response[4] & 0x10) >> 4;
-                gamepad->buttons.slr = (hid_joycon_right->status_response[4] & 0x20) >> 5;
-                gamepad->axes.joy_rx = hid_joycon_right->status_response[10] | ((hid_joycon_right->status_response[11] & 0x0F) << 8);
-                gamepad->axes.joy_ry = (hid_joycon_right->status_response[11] >> 4) | (hid_joycon_right->status_response[12] << 4);
-                gamepad->axes.accel_rx = ((hid_joycon_right->status_response[15] << 8) | hid_joycon_right->status_response[14]) - gamepad->cal.accel_rx_offset;
-                gamepad->axes.accel_ry = ((hid_joycon_right->status_response[17] << 8) | hid_joycon_right->status_response[16]) - gamepad->cal.accel_ry_offset;
-                gamepad->axes.accel_rz = -(((hid_joycon_right->status_response[19] << 8) | hid_joycon_right->status_response[18]) - gamepad->cal.accel_rz_offset);
-                gamepad->axes.gyro_rx = ((hid_joycon_right->status_response[21] << 8) | hid_joycon_right->status_response[20]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);   // Provide raw values for calibration
-                gamepad->axes.gyro_ry = ((hid_joycon_right->status_response[23] << 8) | hid_joycon_right->status_response[22]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
-                gamepad->axes.gyro_rz = ((hid_joycon_right->status_response[25] << 8) | hid_joycon_right->status_response[24]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
-
-                if (gamepad->axes.joy_rx <= gamepad->cal.joy_rx_center)
-                    gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_min, gamepad->cal.joy_rx_center, 0, 2047);
-                else gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_center + 1, gamepad->cal.joy_rx_max, 2048, 4095);
-                
-                if (gamepad->axes.joy_ry <= gamepad->cal.joy_ry_center)
-                    gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_min, gamepad->cal.joy_ry_center, 0, 2047);
-                else gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_center + 1, gamepad->cal.joy_ry_max, 2048, 4095);
+                DESC_DECODE(DESC_JOYCON_R_30)
+                gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, gamepad->buttons.home);
+                gamepad->axes.accel_rx -= gamepad->cal.accel_rx_offset;
+                gamepad->axes.accel_ry -= gamepad->cal.accel_ry_offset;
+                gamepad->axes.accel_rz = -(gamepad->axes.accel_rz - gamepad->cal.accel_rz_offset);
+                gamepad_apply_gyro_r_cal(gamepad);
+                gamepad_map_joy_r(gamepad);
                 break;
             case 0x3F:
                 break;
@@ -131,35 +201,17 @@ static void gamepad_parse_joycon_input(gamepad_t * gamepad, hid_controller_t * h
         }
     }
     if (hid_joycon_left) {
-        switch (hid_joycon_left->status_response[1]) {
+        data = hid_joycon_left->status_response;
+        switch (data[1]) {
             case 0x30:
-                gamepad->buttons.du = (hid_joycon_left->status_response[6] & 0x02) >> 1;
-                gamepad->buttons.dd = hid_joycon_left->status_response[6] & 0x01;
-                gamepad->buttons.dr = (hid_joycon_left->status_response[6] & 0x04) >> 2;
-                gamepad->buttons.dl = (hid_joycon_left->status_response[6] & 0x08) >> 3;
-                gamepad->buttons.l = (hid_joycon_left->status_response[6] & 0x40) >> 6;
-                gamepad->buttons.zl = (hid_joycon_left->status_response[6] & 0x80) >> 7;
-                gamepad->buttons.minus = hid_joycon_left->status_response[5] & 0x01;
-                gamepad->buttons.capture = (hid_joycon_left->status_response[5] & 0x20) >> 5;
-                gamepad->buttons.ls = (hid_joycon_left->status_response[5] & 0x08) >> 3;
-                gamepad->buttons.srl = (hid_joycon_left->status_response[6] & 0x10) >> 4;
-                gamepad->buttons.sll = (hid_joycon_left->status_response[6] & 0x20) >> 5;
-                gamepad->axes.joy_lx = hid_joycon_left->status_response[7] | ((hid_joycon_left->status_response[8] & 0x0F) << 8);
-                gamepad->axes.joy_ly = (hid_joycon_left->status_response[8] >> 4) | (hid_joycon_left->status_response[9] << 4);
-                gamepad->axes.accel_lx = ((hid_joycon_left->status_response[15] << 8) | hid_joycon_left->status_response[14]) - gamepad->cal.accel_lx_offset;
-                gamepad->axes.accel_ly = ((hid_joycon_left->status_response[17] << 8) | hid_joycon_left->status_response[16]) - gamepad->cal.accel_ly_offset;
-                gamepad->axes.accel_lz = ((hid_joycon_left->status_response[19] << 8) | hid_joycon_left->status_response[18]) - gamepad->cal.accel_lz_offset;
-                gamepad->axes.gyro_lx = ((hid_joycon_left->status_response[21] << 8) | hid_joycon_left->status_response[20]) - gamepad->cal.gyro_lx_offset;
-                gamepad->axes.gyro_ly = ((hid_joycon_left->status_response[23] << 8) | hid_joycon_left->status_response[22]) - gamepad->cal.gyro_ly_offset;
-                gamepad->axes.gyro_lz = ((hid_joycon_left->status_response[25] << 8) | hid_joycon_left->status_response[24]) - gamepad->cal.gyro_lz_offset;
-
-                if (gamepad->axes.joy_lx <= gamepad->cal.joy_lx_center)
-                    gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_min, gamepad->cal.joy_lx_center, 0, 2047);
-                else gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_center + 1, gamepad->cal.joy_lx_max, 2048, 4095);
-                
-                if (gamepad->axes.joy_ly <= gamepad->cal.joy_ly_center)
-                    gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_min, gamepad->cal.joy_ly_center, 0, 2047);
-                else gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_center + 1, gamepad->cal.joy_ly_max, 2048, 4095);
+                DESC_DECODE(DESC_JOYCON_L_30)
+                gamepad->axes.accel_lx -= gamepad->cal.accel_lx_offset;
+                gamepad->axes.accel_ly -= gamepad->cal.accel_ly_offset;
+                gamepad->axes.accel_lz -= gamepad->cal.accel_lz_offset;
+                gamepad->axes.gyro_lx -= gamepad->cal.gyro_lx_offset;
+                gamepad->axes.gyro_ly -= gamepad->cal.gyro_ly_offset;
+                gamepad->axes.gyro_lz -= gamepad->cal.gyro_lz_offset;
+                gamepad_map_joy_l(gamepad);
                 break;
             case 0x3F:
                 break;
@@ -170,52 +222,18 @@ static void gamepad_parse_joycon_input(gamepad_t * gamepad, hid_controller_t * h
 }
 
 static void gamepad_parse_procon_input(gamepad_t * gamepad, hid_controller_t * controller) {
-    switch (controller->status_response[1]) {
+    uint8_t * data = controller->status_response;
+
+    switch (data[1]) {
         case 0x30:
-            gamepad->buttons.a = (controller->status_response[4] & 0x08) >> 3;
-            gamepad->buttons.b = (controller->status_response[4] & 0x04) >> 2;
-            gamepad->buttons.x = (controller->status_response[4] & 0x02) >> 1;
-            gamepad->buttons.y = controller->status_response[4] & 0x01;
-            gamepad->buttons.du = (controller->status_response[6] & 0x02) >> 1;
-            gamepad->buttons.dd = controller->status_response[6] & 0x01;
-            gamepad->buttons.dr = (controller->status_response[6] & 0x04) >> 2;
-            gamepad->buttons.dl = (controller->status_response[6] & 0x08) >> 3;
-            gamepad->buttons.r = (controller->status_response[4] & 0x40) >> 6;
-            gamepad->buttons.l = (controller->status_response[6] & 0x40) >> 6;
-            gamepad->buttons.zr = (controller->status_response[4] & 0x80) >> 7;
-            gamepad->buttons.zl = (controller->status_response[6] & 0x80) >> 7;
-            gamepad->buttons.plus = (controller->status_response[5] & 0x02) >> 1;
-            gamepad->buttons.minus = controller->status_response[5] & 0x01;
-            gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, (controller->status_response[5] & 0x10) >> 4);
-            gamepad->buttons.capture = (controller->status_response[5] & 0x20) >> 5;
-            gamepad->buttons.rs = (controller->status_response[5] & 0x04) >> 2;
-            gamepad->buttons.ls = (controller->status_response[5] & 0x08) >> 3;
-            gamepad->axes.joy_rx = controller->status_response[10] | ((controller->status_response[11] & 0x0F) << 8);
-            gamepad->axes.joy_ry = (controller->status_response[11] >> 4) | (controller->status_response[12] << 4);
-            gamepad->axes.joy_lx = controller->status_response[7] | ((controller->status_response[8] & 0x0F) << 8);
-            gamepad->axes.joy_ly = (controller->status_response[8] >> 4) | (controller->status_response[9] << 4);
-            gamepad->axes.accel_ry = -(((controller->status_response[15] << 8) | controller->status_response[14]) - gamepad->cal.accel_rx_offset);
-            gamepad->axes.accel_rx = -(((controller->status_response[17] << 8) | controller->status_response[16]) - gamepad->cal.accel_ry_offset);
-            gamepad->axes.accel_rz = ((controller->status_response[19] << 8) | controller->status_response[18]) - gamepad->cal.accel_rz_offset;
-            gamepad->axes.gyro_rx = ((controller->status_response[21] << 8) | controller->status_response[20]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);   // Provide raw values for calibration
-            gamepad->axes.gyro_ry = ((controller->status_response[23] << 8) | controller->status_response[22]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
-            gamepad->axes.gyro_rz = ((controller->status_response[25] << 8) | controller->status_response[24]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
-
-            if (gamepad->axes.joy_rx <= gamepad->cal.joy_rx_center)
-                gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_min, gamepad->cal.joy_rx_center, 0, 2047);
-            else gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_center + 1, gamepad->cal.joy_rx_max, 2048, 4095);
-            
-            if (gamepad->axes.joy_ry <= gamepad->cal.joy_ry_center)
-                gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_min, gamepad->cal.joy_ry_center, 0, 2047);
-            else gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_center + 1, gamepad->cal.joy_ry_max, 2048, 4095);
-
-            if (gamepad->axes.joy_lx <= gamepad->cal.joy_lx_center)
-                gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_min, gamepad->cal.joy_lx_center, 0, 2047);
-            else gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_center + 1, gamepad->cal.joy_lx_max, 2048, 4095);
-            
-            if (gamepad->axes.joy_ly <= gamepad->cal.joy_ly_center)
-                gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_min, gamepad->cal.joy_ly_center, 0, 2047);
-            else gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_center + 1, gamepad->cal.joy_ly_max, 2048, 4095);
+            DESC_DECODE(DESC_PROCON_30)
+            gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, gamepad->buttons.home);
+            gamepad->axes.accel_ry = -(gamepad->axes.accel_ry - gamepad->cal.accel_rx_offset);
+            gamepad->axes.accel_rx = -(gamepad->axes.accel_rx - gamepad->cal.accel_ry_offset);
+            gamepad->axes.accel_rz -= gamepad->cal.accel_rz_offset;
+            gamepad_apply_gyro_r_cal(gamepad);
+            gamepad_map_joy_r(gamepad);
+            gamepad_map_joy_l(gamepad);
             break;
         case 0x3F:
             break;
@@ -225,73 +243,36 @@ static void gamepad_parse_procon_input(gamepad_t * gamepad, hid_controller_t * c
 }
 
 static void gamepad_parse_extension_input(gamepad_t * gamepad, hid_controller_t * controller) {
-    if (controller->wmp_active) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    uint8_t * data = controller->status_response;
+
+    if (state->wmp_active) {
         // Get WMP gyro data
-        if ((controller->status_response[22] & 0x03) == 0x02) {
-            gamepad->axes.gyro_rx = ((((controller->status_response[21] & 0xFC) << 6) | controller->status_response[18]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);
-            gamepad->axes.gyro_ry = ((((controller->status_response[22] & 0xFC) << 6) | controller->status_response[19]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
-            gamepad->axes.gyro_rz = ((((controller->status_response[20] & 0xFC) << 6) | controller->status_response[17]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
+        if ((data[22] & 0x03) == 0x02) {
+            DESC_DECODE(DESC_WMP_GYRO)
+            gamepad->axes.gyro_rx -= 0x8000;
+            gamepad->axes.gyro_ry -= 0x8000;
+            gamepad->axes.gyro_rz -= 0x8000;
+            gamepad_apply_gyro_r_cal(gamepad);
         }
         // Get WMP passthrough data
-        else if ((controller->status_response[22] & 0x03) == 0x00) {
+        else if ((data[22] & 0x03) == 0x00) {
             // TODO: Parse passthrough data
         }
     }
-    else if (controller->wmp_type == WMP_NOT_SUPPORTED) {
-        switch (controller->extension_type) {
+    else if (state->wmp_type == WMP_NOT_SUPPORTED) {
+        switch (state->extension_type) {
             case EXT_NUNCHUK:
-                gamepad->buttons.c = (~controller->status_response[22] & 0x02) >> 1;
-                gamepad->buttons.z = ~controller->status_response[22] & 0x01;
-                gamepad->axes.joy_lx = controller->status_response[17];
-                gamepad->axes.joy_ly = controller->status_response[18];
-                gamepad->axes.accel_lx = (int16_t)(((controller->status_response[19] << 2) | ((controller->status_response[22] & 0x0C) >> 2)) * 64) - 0x8000 - gamepad->cal.accel_lx_offset;
-                gamepad->axes.accel_ly = (int16_t)(((controller->status_response[20] << 2) | ((controller->status_response[22] & 0x30) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ly_offset;
-                gamepad->axes.accel_lz = (int16_t)(((controller->status_response[21] << 2) | ((controller->status_response[22] & 0xC0) >> 6)) * 64) - 0x8000 - gamepad->cal.accel_lz_offset;
-                
-                if (gamepad->axes.joy_lx <= gamepad->cal.joy_lx_center)
-                    gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_min, gamepad->cal.joy_lx_center, 0, 2047);
-                else gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_center + 1, gamepad->cal.joy_lx_max, 2048, 4095);
-                
-                if (gamepad->axes.joy_ly <= gamepad->cal.joy_ly_center)
-                    gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_min, gamepad->cal.joy_ly_center, 0, 2047);
-                else gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_center + 1, gamepad->cal.joy_ly_max, 2048, 4095);
+                DESC_DECODE(DESC_NUNCHUK)
+                gamepad->axes.accel_lx = (int16_t)(gamepad->axes.accel_lx * 64) - 0x8000 - gamepad->cal.accel_lx_offset;
+                gamepad->axes.accel_ly = (int16_t)(gamepad->axes.accel_ly * 64) - 0x8000 - gamepad->cal.accel_ly_offset;
+                gamepad->axes.accel_lz = (int16_t)(gamepad->axes.accel_lz * 64) - 0x8000 - gamepad->cal.accel_lz_offset;
+                gamepad_map_joy_l(gamepad);
                 break;
             case EXT_CLASSIC:
-                gamepad->buttons.a = (~controller->status_response[22] & 0x10) >> 4;
-                gamepad->buttons.b = (~controller->status_response[22] & 0x40) >> 6;
-                gamepad->buttons.x = (~controller->status_response[22] & 0x08) >> 3;
-                gamepad->buttons.y = (~controller->status_response[22] & 0x20) >> 5;
-                gamepad->buttons.du = ~controller->status_response[22] & 0x01;
-                gamepad->buttons.dd = (~controller->status_response[21] & 0x40) >> 6;
-                gamepad->buttons.dr = (~controller->status_response[21] & 0x80) >> 7;
-                gamepad->buttons.dl = (~controller->status_response[22] & 0x02) >> 1;
-                gamepad->buttons.r = (~controller->status_response[21] & 0x02) >> 1;
-                gamepad->buttons.l = (~controller->status_response[21] & 0x20) >> 5;
-                gamepad->buttons.zr = (~controller->status_response[22] & 0x04) >> 2;
-                gamepad->buttons.zl = (~controller->status_response[22] & 0x80) >> 7;
-                gamepad->buttons.plus = (~controller->status_response[21] & 0x04) >> 2;
-                gamepad->buttons.minus = (~controller->status_response[21] & 0x10) >> 4;
-                gamepad->buttons.home = (~controller->status_response[21] & 0x08) >> 3;
-                gamepad->axes.joy_rx = (((controller->status_response[17] & 0xC0) >> 3) | ((controller->status_response[18] & 0xC0) >> 5) | ((controller->status_response[19] & 0x80) >> 7)) << 3;
-                gamepad->axes.joy_ry = (controller->status_response[19] & 0x1F) << 3;
-                gamepad->axes.joy_lx = (controller->status_response[17] & 0x3F) << 2;
-                gamepad->axes.joy_ly = (controller->status_response[18] & 0x3F) << 2;
-
-                if (gamepad->axes.joy_rx <= gamepad->cal.joy_rx_center)
-                    gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_min, gamepad->cal.joy_rx_center, 0, 2047);
-                else gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, gamepad->cal.joy_rx_center + 1, gamepad->cal.joy_rx_max, 2048, 4095);
-                
-                if (gamepad->axes.joy_ry <= gamepad->cal.joy_ry_center)
-                    gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_min, gamepad->cal.joy_ry_center, 0, 2047);
-                else gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, gamepad->cal.joy_ry_center + 1, gamepad->cal.joy_ry_max, 2048, 4095);
-
-                if (gamepad->axes.joy_lx <= gamepad->cal.joy_lx_center)
-                    gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_min, gamepad->cal.joy_lx_center, 0, 2047);
-                else gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, gamepad->cal.joy_lx_center + 1, gamepad->cal.joy_lx_max, 2048, 4095);
-                
-                if (gamepad->axes.joy_ly <= gamepad->cal.joy_ly_center)
-                    gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_min, gamepad->cal.joy_ly_center, 0, 2047);
-                else gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, gamepad->cal.joy_ly_center + 1, gamepad->cal.joy_ly_max, 2048, 4095);
+                DESC_DECODE(DESC_CLASSIC)
+                gamepad_map_joy_r(gamepad);
+                gamepad_map_joy_l(gamepad);
                 break;
             default:
                 break;
@@ -300,148 +281,110 @@ static void gamepad_parse_extension_input(gamepad_t * gamepad, hid_controller_t
 }
 
 static void gamepad_parse_wiimote_input(gamepad_t * gamepad, hid_controller_t * controller) {
-    gamepad->buttons.a = (controller->status_response[3] & 0x08) >> 3;
-    gamepad->buttons.b = (controller->status_response[3] & 0x04) >> 2;
-    gamepad->buttons.one = (controller->status_response[3] & 0x02) >> 1;
-    gamepad->buttons.two = controller->status_response[3] & 0x01;
-    gamepad->buttons.du = (controller->status_response[2] & 0x08) >> 3;
-    gamepad->buttons.dd = (controller->status_response[2] & 0x04) >> 2;
-    gamepad->buttons.dr = (controller->status_response[2] & 0x02) >> 1;
-    gamepad->buttons.dl = controller->status_response[2] & 0x01;
-    gamepad->buttons.home = (controller->status_response[3] & 0x80) >> 7;
-
-    switch (controller->status_response[1]) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    uint8_t * data = controller->status_response;
+
+    DESC_DECODE(DESC_WIIMOTE_BUTTONS)
+
+    switch (data[1]) {
         case 0x37:  // Buttons, accel, IR10, EXT6
-            // TODO: Read IR data
-            
-            gamepad->axes.accel_rx = (int16_t)(((controller->status_response[4] << 2) | ((controller->status_response[2] & 0x60) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
-            gamepad->axes.accel_ry = (int16_t)(((controller->status_response[5] << 2) | ((controller->status_response[3] & 0x20) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
-            gamepad->axes.accel_rz = (int16_t)(((controller->status_response[6] << 2) | ((controller->status_response[3] & 0x40) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
-            
-            gamepad_parse_extension_input(gamepad, controller);
-            break;
         case 0x33:  // Buttons, accel, IR12
             // TODO: Read IR data
-            
-            gamepad->axes.accel_rx = (int16_t)(((controller->status_response[4] << 2) | ((controller->status_response[2] & 0x60) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
-            gamepad->axes.accel_ry = (int16_t)(((controller->status_response[5] << 2) | ((controller->status_response[3] & 0x20) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
-            gamepad->axes.accel_rz = (int16_t)(((controller->status_response[6] << 2) | ((controller->status_response[3] & 0x40) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
+            DESC_DECODE(DESC_WIIMOTE_ACCEL)
+            gamepad->axes.accel_rx = (int16_t)(gamepad->axes.accel_rx * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
+            gamepad->axes.accel_ry = (int16_t)(gamepad->axes.accel_ry * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
+            gamepad->axes.accel_rz = (int16_t)(gamepad->axes.accel_rz * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
+            if (data[1] == 0x37) gamepad_parse_extension_input(gamepad, controller);
             break;
         default:
             break;
     }
 
-    if (controller->extension_type != EXT_CLASSIC) {
-        gamepad->buttons.plus = gamepad_handle_button_event(&gamepad->gyro_center, (controller->status_response[2] & 0x10) >> 4);
-        gamepad->buttons.minus = gamepad_handle_button_event(&gamepad->gyro_enable, (controller->status_response[3] & 0x10) >> 4);
-        gamepad->buttons.home = gamepad_handle_button_event(&gamepad->gyro_calibrate, (controller->status_response[3] & 0x80) >> 7);
+    if (state->extension_type != EXT_CLASSIC) {
+        gamepad->buttons.plus = gamepad_handle_button_event(&gamepad->gyro_center, DESC_READ(data, 2, 4, 1, 0, 0));
+        gamepad->buttons.minus = gamepad_handle_button_event(&gamepad->gyro_enable, DESC_READ(data, 3, 4, 1, 0, 0));
+        gamepad->buttons.home = gamepad_handle_button_event(&gamepad->gyro_calibrate, DESC_READ(data, 3, 7, 1, 0, 0));
     }
 }
 
 static void gamepad_parse_wiiu_pro_input(gamepad_t * gamepad, hid_controller_t * controller) {
-    gamepad->buttons.a = (~controller->status_response[11] & 0x10) >> 4;
-    gamepad->buttons.b = (~controller->status_response[11] & 0x40) >> 6;
-    gamepad->buttons.x = (~controller->status_response[11] & 0x08) >> 3;
-    gamepad->buttons.y = (~controller->status_response[11] & 0x20) >> 5;
-    gamepad->buttons.du = ~controller->status_response[11] & 0x01;
-    gamepad->buttons.dd = (~controller->status_response[10] & 0x40) >> 6;
-    gamepad->buttons.dr = (~controller->status_response[10] & 0x80) >> 7;
-    gamepad->buttons.dl = (~controller->status_response[11] & 0x02) >> 1;
-    gamepad->buttons.r = (~controller->status_response[10] & 0x02) >> 1;
-    gamepad->buttons.l = (~controller->status_response[10] & 0x20) >> 5;
-    gamepad->buttons.zr = (~controller->status_response[11] & 0x04) >> 2;
-    gamepad->buttons.zl = (~controller->status_response[11] & 0x80) >> 7;
-    gamepad->buttons.plus = (~controller->status_response[10] & 0x04) >> 2;
-    gamepad->buttons.minus = (~controller->status_response[10] & 0x10) >> 4;
-    gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, (~controller->status_response[10] & 0x08) >> 3);
-    gamepad->buttons.rs = ~controller->status_response[12] & 0x01;
-    gamepad->buttons.ls = (~controller->status_response[12] & 0x02) >> 1;
-    gamepad->axes.joy_rx = controller->status_response[4] | ((controller->status_response[5] & 0x0F) << 8);
-    gamepad->axes.joy_ry = controller->status_response[8] | ((controller->status_response[9] & 0x0F) << 8);
-    gamepad->axes.joy_lx = controller->status_response[2] | ((controller->status_response[3] & 0x0F) << 8);
-    gamepad->axes.joy_ly = controller->status_response[6] | ((controller->status_response[7] & 0x0F) << 8);
-    
-    gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, 800, 3295, 0, 4095);
-    gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, 800, 3295, 0, 4095);
-    gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, 800, 3295, 0, 4095);
-    gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, 800, 3295, 0, 4095);
+    uint8_t * data = controller->status_response;
+
+    DESC_DECODE(DESC_WIIU_PRO)
+    gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, gamepad->buttons.home);
+    gamepad->axes.joy_rx = joystick_map(&wiiu_pro_joy_map, gamepad->axes.joy_rx);
+    gamepad->axes.joy_ry = joystick_map(&wiiu_pro_joy_map, gamepad->axes.joy_ry);
+    gamepad->axes.joy_lx = joystick_map(&wiiu_pro_joy_map, gamepad->axes.joy_lx);
+    gamepad->axes.joy_ly = joystick_map(&wiiu_pro_joy_map, gamepad->axes.joy_ly);
 }
 
 static void gamepad_parse_uart_input(gamepad_t * gamepad) {
+    uint8_t frame[UART_JOYCON_FRAME_LEN];
+    uint8_t * data = frame;
+
     if (joycon_right.data_ready) {
-        gamepad->buttons.a = (joycon_right.rx_buf[15] & 0x08) >> 3;
-        gamepad->buttons.b = (joycon_right.rx_buf[15] & 0x04) >> 2;
-        gamepad->buttons.x = (joycon_right.rx_buf[15] & 0x02) >> 1;
-        gamepad->buttons.y = joycon_right.rx_buf[15] & 0x01;
-        gamepad->buttons.r = (joycon_right.rx_buf[15] & 0x40) >> 6;
-        gamepad->buttons.zr = (joycon_right.rx_buf[15] & 0x80) >> 7;
-        gamepad->buttons.plus = (joycon_right.rx_buf[16] & 0x02) >> 1;
-        gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, (joycon_right.rx_buf[16] & 0x10) >> 4);
-        gamepad->buttons.rs = (joycon_right.rx_buf[16] & 0x04) >> 2;
-        gamepad->buttons.srr = (joycon_right.rx_buf[15] & 0x10) >> 4;
-        gamepad->buttons.slr = (joycon_right.rx_buf[15] & 0x20) >> 5;
-        gamepad->axes.joy_rx = ((joycon_right.rx_buf[22] & 0x0F << 4) | (joycon_right.rx_buf[22] & 0xF0 >> 4)) << 4;
-        gamepad->axes.joy_ry = joycon_right.rx_buf[21] << 4;
-        gamepad->axes.gyro_rx = ((joycon_right.rx_buf[32] << 8) | joycon_right.rx_buf[31]) - joycon_right.gyro_x_offset;
-        gamepad->axes.gyro_ry = ((joycon_right.rx_buf[34] << 8) | joycon_right.rx_buf[33]) - joycon_right.gyro_y_offset;
-        gamepad->axes.gyro_rz = ((joycon_right.rx_buf[36] << 8) | joycon_right.rx_buf[35]) - joycon_right.gyro_z_offset;
-        gamepad->axes.accel_rx = ((joycon_right.rx_buf[38] << 8) | joycon_right.rx_buf[37]) - joycon_right.accel_x_offset;
-        gamepad->axes.accel_ry = ((joycon_right.rx_buf[40] << 8) | joycon_right.rx_buf[39]) - joycon_right.accel_y_offset;
-        gamepad->axes.accel_rz = ((joycon_right.rx_buf[42] << 8) | joycon_right.rx_buf[41]) - joycon_right.accel_z_offset;
-
-        if (gamepad->axes.joy_rx <= joycon_right.joy_x_center)
-            gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, joycon_right.joy_x_min, joycon_right.joy_x_center, 0, 2047);
-        else gamepad->axes.joy_rx = map(gamepad->axes.joy_rx, joycon_right.joy_x_center + 1, joycon_right.joy_x_max, 2048, 4095);
-        
-        if (gamepad->axes.joy_ry <= joycon_right.joy_y_center)
-            gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, joycon_right.joy_y_min, joycon_right.joy_y_center, 0, 2047);
-        else gamepad->axes.joy_ry = map(gamepad->axes.joy_ry, joycon_right.joy_y_center + 1, joycon_right.joy_y_max, 2048, 4095);
+        uart_joycon_read_input(&joycon_right, frame);
+        DESC_DECODE(DESC_UART_JOYCON_R)
+        gamepad->buttons.home = gamepad_handle_button_event(&gamepad->mode_switch, gamepad->buttons.home);
+        gamepad->axes.gyro_rx -= joycon_right.gyro_x_offset;
+        gamepad->axes.gyro_ry -= joycon_right.gyro_y_offset;
+        gamepad->axes.gyro_rz -= joycon_right.gyro_z_offset;
+        gamepad->axes.accel_rx -= joycon_right.accel_x_offset;
+        gamepad->axes.accel_ry -= joycon_right.accel_y_offset;
+        gamepad->axes.accel_rz -= joycon_right.accel_z_offset;
+        gamepad->axes.joy_rx = joystick_map(&joycon_right.joy_x_map, gamepad->axes.joy_rx);
+        gamepad->axes.joy_ry = joystick_map(&joycon_right.joy_y_map, gamepad->axes.joy_ry);
     }
     if (joycon_left.data_ready) {
-        gamepad->buttons.du = (joycon_left.rx_buf[17] & 0x02) >> 1;
-        gamepad->buttons.dd = joycon_left.rx_buf[17] & 0x01;
-        gamepad->buttons.dr = (joycon_left.rx_buf[17] & 0x04) >> 2;
-        gamepad->buttons.dl = (joycon_left.rx_buf[17] & 0x08) >> 3;
-        gamepad->buttons.l = (joycon_left.rx_buf[17] & 0x40) >> 6;
-        gamepad->buttons.zl = (joycon_left.rx_buf[17] & 0x80) >> 7;
-        gamepad->buttons.minus = joycon_left.rx_buf[16] & 0x01;
-        gamepad->buttons.capture = (joycon_left.rx_buf[16] & 0x20) >> 5;
-        gamepad->buttons.ls = (joycon_left.rx_buf[16] & 0x08) >> 3;
-        gamepad->buttons.srl = (joycon_left.rx_buf[17] & 0x10) >> 4;
-        gamepad->buttons.sll = (joycon_left.rx_buf[17] & 0x20) >> 5;
-        gamepad->axes.joy_lx = ((joycon_left.rx_buf[19] & 0x0F << 4) | (joycon_left.rx_buf[19] & 0xF0 >> 4)) << 4;
-        gamepad->axes.joy_ly = joycon_left.rx_buf[20] << 4;
-        gamepad->axes.gyro_lx = ((joycon_left.rx_buf[32] << 8) | joycon_left.rx_buf[31]) - joycon_left.gyro_x_offset;
-        gamepad->axes.gyro_ly = ((joycon_left.rx_buf[34] << 8) | joycon_left.rx_buf[33]) - joycon_left.gyro_y_offset;
-        gamepad->axes.gyro_lz = ((joycon_left.rx_buf[36] << 8) | joycon_left.rx_buf[35]) - joycon_left.gyro_z_offset;
-        gamepad->axes.accel_lx = ((joycon_left.rx_buf[38] << 8) | joycon_left.rx_buf[37]) - joycon_left.accel_x_offset;
-        gamepad->axes.accel_ly = ((joycon_left.rx_buf[40] << 8) | joycon_left.rx_buf[39]) - joycon_left.accel_y_offset;
-        gamepad->axes.accel_lz = ((joycon_left.rx_buf[42] << 8) | joycon_left.rx_buf[41]) - joycon_left.accel_z_offset;
-
-        if (gamepad->axes.joy_lx <= joycon_left.joy_x_center)
-            gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, joycon_left.joy_x_min, joycon_left.joy_x_center, 0, 2047);
-        else gamepad->axes.joy_lx = map(gamepad->axes.joy_lx, joycon_left.joy_x_center + 1, joycon_left.joy_x_max, 2048, 4095);
-        
-        if (gamepad->axes.joy_ly <= joycon_left.joy_y_center)
-            gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, joycon_left.joy_y_min, joycon_left.joy_y_center, 0, 2047);
-        else gamepad->axes.joy_ly = map(gamepad->axes.joy_ly, joycon_left.joy_y_center + 1, joycon_left.joy_y_max, 2048, 4095);
+        uart_joycon_read_input(&joycon_left, frame);
+        DESC_DECODE(DESC_UART_JOYCON_L)
+        gamepad->axes.gyro_lx -= joycon_left.gyro_x_offset;
+        gamepad->axes.gyro_ly -= joycon_left.gyro_y_offset;
+        gamepad->axes.gyro_lz -= joycon_left.gyro_z_offset;
+        gamepad->axes.accel_lx -= joycon_left.accel_x_offset;
+        gamepad->axes.accel_ly -= joycon_left.accel_y_offset;
+        gamepad->axes.accel_lz -= joycon_left.accel_z_offset;
+        gamepad->axes.joy_lx = joystick_map(&joycon_left.joy_x_map, gamepad->axes.joy_lx);
+        gamepad->axes.joy_ly = joystick_map(&joycon_left.joy_y_map, gamepad->axes.joy_ly);
     }
 }
 
+// Wired Joy-Con send the same IMU axes as wireless ones (right Joy-Con only)
+static void gamepad_get_angles_from_uart(gamepad_t * gamepad) {
+    int16_t gyro[3];
+    int16_t accel[3];
+    uint64_t cur_time;
+
+    if (!joycon_right.data_ready) return;
+    if (gamepad->buttons.r) gamepad_reset_angles(gamepad);
+
+    timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &cur_time);
+    gyro[0] = gamepad->axes.gyro_rx;
+    gyro[1] = gamepad->axes.gyro_ry;
+    gyro[2] = gamepad->axes.gyro_rz;
+    accel[0] = gamepad->axes.accel_rx;
+    accel[1] = gamepad->axes.accel_ry;
+    accel[2] = gamepad->axes.accel_rz;
+    orientation_update(&gamepad->orientation, gyro, accel, GYRO_SCALE_SWITCH, cur_time);
+    gamepad_update_pointer(gamepad);
+}
+
 // TODO: Calibrate accel as well so user calibration can be properly updated (for Switch controllers)
 static uint8_t gamepad_gyro_calibrate(gamepad_t * gamepad) {
+    uint8_t data[1 + (3 * sizeof(int16_t))];    // Gamepad number and gyro offsets for the trace
+
     if (gamepad->calibrating) {
-        if ((app_timer - gamepad->calibration_timer >= 6500) || (gamepad->calibrate_num_samples == 255)) {
+        if ((pipeline_timer - gamepad->calibration_timer >= 6500) || (gamepad->calibrate_num_samples == 255)) {
             gamepad->cal.gyro_rx_offset = gamepad->calibrate_gyro_x_sum / gamepad->calibrate_num_samples;
             gamepad->cal.gyro_ry_offset = gamepad->calibrate_gyro_y_sum / gamepad->calibrate_num_samples;
             gamepad->cal.gyro_rz_offset = gamepad->calibrate_gyro_z_sum / gamepad->calibrate_num_samples;
             gamepad->calibrating = 0;
-            printf("Gyro X offset: %d\n", gamepad->cal.gyro_rx_offset);
-            printf("Gyro Y offset: %d\n", gamepad->cal.gyro_ry_offset);
-            printf("Gyro Z offset: %d\n", gamepad->cal.gyro_rz_offset);
+            data[0] = (gamepad - gamepads) + 1;
+            memcpy(&data[1], &gamepad->cal.gyro_rx_offset, 3 * sizeof(int16_t));
+            trace_event_data(0, EVT_GYRO_CALIBRATED, data, sizeof(data));
             return 1;
         } else {
-            if (app_timer - gamepad->calibration_timer >= 3000) { // Start calibration after 3s
+            if (pipeline_timer - gamepad->calibration_timer >= 3000) { // Start calibration after 3s
                 gamepad->calibrate_gyro_x_sum += gamepad->axes.gyro_rx;
                 gamepad->calibrate_gyro_y_sum += gamepad->axes.gyro_ry;
                 gamepad->calibrate_gyro_z_sum += gamepad->axes.gyro_rz;
@@ -450,13 +393,13 @@ static uint8_t gamepad_gyro_calibrate(gamepad_t * gamepad) {
         }
     } else {
         gamepad->calibrating = 1; 
-        gamepad->calibration_timer = app_timer;
+        gamepad->calibration_timer = pipeline_timer;
         gamepad->calibrate_gyro_x_sum = 0;
         gamepad->calibrate_gyro_y_sum = 0;
         gamepad->calibrate_gyro_z_sum = 0;
         gamepad->calibrate_num_samples = 0;
         gamepad_reset_angles(gamepad);
-        printf("Calibrating\n");
+        trace_event(0, EVT_GYRO_CALIBRATING, (gamepad - gamepads) + 1);
     }
     return 0;
 }
@@ -468,7 +411,7 @@ static void gamepad_gyro_handle(gamepad_t * gamepad, hid_controller_t * controll
             // Store calibration data in memory
             uint8_t accel_data[6];
             uint8_t gyro_data[6];
-            switch (controller->type) {
+            switch (pipeline_controller_state(controller)->type) {
                 case CNT_JOYCON_R:
                 case CNT_PROCON:
                     accel_data[0] = gamepad->cal.accel_rx_offset & 0xFF; 
@@ -483,9 +426,9 @@ static void gamepad_gyro_handle(gamepad_t * gamepad, hid_controller_t * controll
                     gyro_data[3] = (gamepad->cal.gyro_ry_offset & 0xFF00) >> 8;
                     gyro_data[4] = gamepad->cal.gyro_rz_offset & 0xFF; 
                     gyro_data[5] = (gamepad->cal.gyro_rz_offset & 0xFF00) >> 8;
-                    hid_queue_command(controller, &cmd_joycon_write_cal_accel_user, accel_data, NULL, 1);
-                    hid_queue_command(controller, &cmd_joycon_write_cal_gyro_user, gyro_data, NULL, 1);
-                    hid_queue_command(controller, &cmd_joycon_write_magic_imu_user, NULL, NULL, 1);
+                    pipeline_queue_command(controller, &cmd_joycon_write_cal_accel_user, accel_data);
+                    pipeline_queue_command(controller, &cmd_joycon_write_cal_gyro_user, gyro_data);
+                    pipeline_queue_command(controller, &cmd_joycon_write_magic_imu_user, NULL);
                     break;
                 case CNT_WIIMOTE:
                     accel_data[0] = ((gamepad->cal.accel_rx_offset + 0x8000) & 0xFF00) >> 8;
@@ -498,8 +441,8 @@ static void gamepad_gyro_handle(gamepad_t * gamepad, hid_controller_t * controll
                     gyro_data[3] = (gamepad->cal.gyro_rx_offset + 0x8000) & 0xFF; 
                     gyro_data[4] = ((gamepad->cal.gyro_ry_offset + 0x8000) & 0xFF00) >> 8;
                     gyro_data[5] = (gamepad->cal.gyro_ry_offset + 0x8000) & 0xFF; 
-                    //hid_queue_command(controller, &cmd_wiimote_write_cal_accel, accel_data, NULL, 1); // Doesn't work?
-                    hid_queue_command(controller, &cmd_wiimote_write_cal_wmp, gyro_data, NULL, 1);  // Only seems to work for newer Wii Remotes
+                    //pipeline_queue_command(controller, &cmd_wiimote_write_cal_accel, accel_data); // Doesn't work?
+                    pipeline_queue_command(controller, &cmd_wiimote_write_cal_wmp, gyro_data);  // Only seems to work for newer Wii Remotes
                     break;
                 default:
                     break;
@@ -510,22 +453,22 @@ static void gamepad_gyro_handle(gamepad_t * gamepad, hid_controller_t * controll
         if (gamepad->type == GAMEPAD_WIIMOTE) { // Wiimote uses long-press to center and long-press to calibrate
             if (gamepad->gyro_center.triggered) {
                 gamepad_reset_angles(gamepad);
-                if (controller) controller_rumble_pattern(controller, 70, 0, 1);
+                if (controller) pipeline_controller_rumble_pattern(controller, 70, 0, 1);
                 gamepad->gyro_center.triggered = 0;
             }
             if (gamepad->gyro_calibrate.triggered) {
                 gamepad_gyro_calibrate(gamepad);
-                if (controller) controller_rumble_pattern(controller, 100, 500, 5);
+                if (controller) pipeline_controller_rumble_pattern(controller, 100, 500, 5);
                 gamepad->gyro_calibrate.triggered = 0;
             }
             // Add option to toggel gyro/IR camera with gyro_enable
         } else {  // Other controllers use short-press to center and long-press to calibrate
             if (gamepad->buttons.r) gamepad_reset_angles(gamepad);
-            else gamepad->calibration_timer = app_timer;
+            else gamepad->calibration_timer = pipeline_timer;
 
-            if (app_timer - gamepad->calibration_timer >= LONG_PRESS_THRESH) {
+            if (pipeline_timer - gamepad->calibration_timer >= LONG_PRESS_THRESH) {
                 gamepad_gyro_calibrate(gamepad);
-                if (controller) controller_rumble_pattern(controller, 100, 500, 5);
+                if (controller) pipeline_controller_rumble_pattern(controller, 100, 500, 5);
             }
         }
     }
@@ -535,9 +478,12 @@ void gamepad_reset(gamepad_t * gamepad) {
 	memset(gamepad, 0, sizeof(gamepad_t));
     gamepad->type = GAMEPAD_NONE;
     gamepad_input_defaults(gamepad);
-    gamepad_cal_defaults(gamepad);
+    gamepad_cal_defaults(&gamepad->cal);
+    gamepad_build_joy_maps_r(gamepad);
+    gamepad_build_joy_maps_l(gamepad);
+    orientation_reset(&gamepad->orientation);
+    imu_time_reset(&gamepad->imu_time);
     gamepad_reset_angles(gamepad);
-    gamepad->imu_timer = 0;
 }
 
 void init_gamepads() {
@@ -545,6 +491,7 @@ void init_gamepads() {
     gamepad_reset(&gamepads[1]);
     gamepad_reset(&gamepads[2]);
     gamepad_reset(&gamepads[3]);
+    joystick_build_map(&wiiu_pro_joy_map, 800, 2047, 3295);
 }
 
 void gamepad_set_type(uint8_t gamepad_num) {
@@ -552,11 +499,11 @@ void gamepad_set_type(uint8_t gamepad_num) {
         gamepad_t * gamepad = &gamepads[gamepad_num - 1];
         hid_controller_t * controller_main;
         hid_controller_t * controller_secondary;
-        get_controllers_from_gamepad(gamepad_num, &controller_main, &controller_secondary, 0);
+        pipeline_get_controllers(gamepad_num, &controller_main, &controller_secondary, 0);
         if (!controller_main && !controller_secondary) return;
 
         if (controller_main) {
-            switch (controller_main->type) {
+            switch (pipeline_controller_state(controller_main)->type) {
                 case CNT_JOYCON_R:
                     if (controller_secondary) gamepad->type = GAMEPAD_JOYCON_DUAL;
                     else gamepad->type = GAMEPAD_JOYCON_R_VERT;
@@ -600,69 +547,151 @@ void gamepad_set_extension(uint8_t gamepad_num) {
     }
 }
 
-// Use gamepad IMU values to integrate yaw, pitch, roll (called from HID packet handler)
-void gamepad_get_angles_from_controller(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
-    
-    if (!gamepad->calibrating) {
-        uint64_t cur_time;
-        double delta_t;
-        double pitch_speed;
-        double yaw_speed;
-        int16_t gyro_y1, gyro_y2, gyro_y3, gyro_z1, gyro_z2, gyro_z3;
-        timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &cur_time);
-        delta_t = (double)(cur_time - gamepad->imu_timer) / 1000000 - 0.01;  // Time between last calculation and first new reading (ideally 5ms, assuming Joy-Con pushes packets every 15ms)
-        if (delta_t < 0) delta_t = 0;
-        //printf("Period: %llu\n", cur_time - gamepad->imu_timer);
-
-        switch (controller->type) {
-            case CNT_JOYCON_R:
-            case CNT_PROCON:
-                if ((controller->status_response[1] == 0x30) && (cur_time - gamepad->imu_timer >= 15000)) {
-                    // Pro controller axes are inverted
-                    gyro_y1 = (int16_t)(((controller->status_response[23] << 8) | controller->status_response[22]) - gamepad->cal.gyro_ry_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-                    gyro_y2 = (int16_t)(((controller->status_response[35] << 8) | controller->status_response[34]) - gamepad->cal.gyro_ry_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-                    gyro_y3 = (int16_t)(((controller->status_response[47] << 8) | controller->status_response[46]) - gamepad->cal.gyro_ry_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-                    gyro_z1 = (int16_t)(((controller->status_response[25] << 8) | controller->status_response[24]) - gamepad->cal.gyro_rz_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-                    gyro_z2 = (int16_t)(((controller->status_response[37] << 8) | controller->status_response[36]) - gamepad->cal.gyro_rz_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-                    gyro_z3 = (int16_t)(((controller->status_response[49] << 8) | controller->status_response[48]) - gamepad->cal.gyro_rz_offset) * ((controller->type == CNT_PROCON) ? -1 : 1);
-
-                    pitch_speed = gyro_y3 * 4588 / 0xFFFF;
-                    yaw_speed = gyro_z3 * 4588 / 0xFFFF;
-                    gamepad->pitch += pitch_speed * delta_t;
-                    gamepad->yaw += yaw_speed * delta_t;
-
-                    pitch_speed = gyro_y2 * 4588 / 0xFFFF;
-                    yaw_speed = gyro_z2 * 4588 / 0xFFFF;
-                    gamepad->pitch += pitch_speed * 0.005;  // Fixed time of 5ms between consecutive readings 
-                    gamepad->yaw += yaw_speed * 0.005;
-
-                    pitch_speed = gyro_y1 * 4588 / 0xFFFF;
-                    yaw_speed = gyro_z1 * 4588 / 0xFFFF;
-                    gamepad->pitch += pitch_speed * 0.005;
-                    gamepad->yaw += yaw_speed * 0.005;
-
-                    gamepad->imu_timer = cur_time;
-                    //printf("Pitch: %f    Yaw: %f\n", gamepad->pitch, gamepad->yaw);
-                }
-                break;
-            case CNT_WIIMOTE:
-                if ((controller->status_response[1] == 0x37) && controller->wmp_active && ((controller->status_response[22] & 0x03) == 0x02)) {
-                    gyro_y1 = ((((controller->status_response[22] & 0xFC) << 6) | controller->status_response[19]) << 2) - 0x8000 - gamepad->cal.gyro_ry_offset;
-                    gyro_z1 = ((((controller->status_response[20] & 0xFC) << 6) | controller->status_response[17]) << 2) - 0x8000 - gamepad->cal.gyro_rz_offset;
-                
-                    double pitch_speed = gyro_y1 * 1440 / 0xFFFF;   // These constants only seem to work correctly for TR Wiimotes
-                    double yaw_speed = gyro_z1 * 1440 / 0xFFFF;
-                    gamepad->pitch += pitch_speed * delta_t;
-                    gamepad->yaw += yaw_speed * delta_t;
-
-                    gamepad->imu_timer = cur_time;
-                    //printf("Pitch: %f    Yaw: %f\n", gamepad->pitch, gamepad->yaw);
+static void gamepad_push_imu_sample(gamepad_t * gamepad, imu_sample_t * sample) {
+    gamepad->imu_samples[gamepad->imu_sample_pos] = *sample;
+    gamepad->imu_sample_pos = (gamepad->imu_sample_pos + 1) % IMU_RING_LEN;
+    if (gamepad->imu_sample_count < IMU_RING_LEN) gamepad->imu_sample_count++;
+}
+
+// Whether this report carries live IMU data, Switch controllers send zeros until IMU streaming takes effect
+static uint8_t gamepad_imu_streaming(hid_controller_t * controller) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    uint8_t i;
+
+    switch (state->type) {
+        case CNT_JOYCON_R:
+        case CNT_PROCON:
+            if (!state->imu_enabled || (controller->status_response[1] != 0x30)) return 0;
+            for (i = 14; i < 14 + (12 * IMU_SAMPLES_PER_REPORT); i++) {
+                if (controller->status_response[i]) return 1;
+            }
+            return 0;
+        case CNT_WIIMOTE:
+            return (controller->status_response[1] == 0x37) && state->wmp_active;
+        default:
+            return 0;
+    }
+}
+
+// Store every IMU sample in a report so the PIC32 gets 200Hz motion data instead of one sample per SPI transfer
+static void gamepad_store_imu_samples(gamepad_t * gamepad, hid_controller_t * controller, uint64_t sample_time[IMU_SAMPLES_PER_REPORT]) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    imu_sample_t sample;
+    uint8_t * data;
+    int8_t i;
+
+    switch (state->type) {
+        case CNT_JOYCON_R:
+        case CNT_PROCON:
+            if (controller->status_response[1] != 0x30) return;
+            for (i = 2; i >= 0; i--) {  // Samples are sent newest first, 5ms apart
+                data = controller->status_response + 14 + (12 * i);
+                sample.timestamp = sample_time[i] / 1000;
+                if (state->type == CNT_PROCON) {
+                    sample.accel_y = -(((data[1] << 8) | data[0]) - gamepad->cal.accel_rx_offset);
+                    sample.accel_x = -(((data[3] << 8) | data[2]) - gamepad->cal.accel_ry_offset);
+                    sample.accel_z = ((data[5] << 8) | data[4]) - gamepad->cal.accel_rz_offset;
+                } else {
+                    sample.accel_x = ((data[1] << 8) | data[0]) - gamepad->cal.accel_rx_offset;
+                    sample.accel_y = ((data[3] << 8) | data[2]) - gamepad->cal.accel_ry_offset;
+                    sample.accel_z = -(((data[5] << 8) | data[4]) - gamepad->cal.accel_rz_offset);
                 }
-                break;
-            default:
-                break;
-        }
+                sample.gyro_x = ((data[7] << 8) | data[6]) - gamepad->cal.gyro_rx_offset;
+                sample.gyro_y = ((data[9] << 8) | data[8]) - gamepad->cal.gyro_ry_offset;
+                sample.gyro_z = ((data[11] << 8) | data[10]) - gamepad->cal.gyro_rz_offset;
+                gamepad_push_imu_sample(gamepad, &sample);
+            }
+            break;
+        case CNT_WIIMOTE:
+            if ((controller->status_response[1] != 0x37) || !state->wmp_active || ((controller->status_response[22] & 0x03) != 0x02)) return;
+            data = controller->status_response;
+            sample.timestamp = sample_time[0] / 1000;
+            sample.accel_x = (int16_t)(((data[4] << 2) | ((data[2] & 0x60) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
+            sample.accel_y = (int16_t)(((data[5] << 2) | ((data[3] & 0x20) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
+            sample.accel_z = (int16_t)(((data[6] << 2) | ((data[3] & 0x40) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
+            sample.gyro_x = ((((data[21] & 0xFC) << 6) | data[18]) << 2) - 0x8000 - gamepad->cal.gyro_rx_offset;
+            sample.gyro_y = ((((data[22] & 0xFC) << 6) | data[19]) << 2) - 0x8000 - gamepad->cal.gyro_ry_offset;
+            sample.gyro_z = ((((data[20] & 0xFC) << 6) | data[17]) << 2) - 0x8000 - gamepad->cal.gyro_rz_offset;
+            gamepad_push_imu_sample(gamepad, &sample);
+            break;
+        default:
+            break;
+    }
+}
+
+// Run the orientation filter on every IMU sample in a report (cur_time is the report arrival time in us)
+void gamepad_get_angles_from_controller(hid_controller_t * controller, uint64_t cur_time) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    gamepad_t * gamepad = &gamepads[state->gamepad_num - 1];
+    uint64_t sample_time[IMU_SAMPLES_PER_REPORT];
+    imu_sample_t * sample;
+    int16_t gyro[3];
+    int16_t accel[3];
+    uint8_t * data;
+    uint8_t streaming;
+    int8_t invert;
+    int8_t i;
+
+    // Switch controllers report when their samples were taken, Wiimotes only have the arrival time
+    if ((state->type == CNT_JOYCON_R || state->type == CNT_PROCON) && (controller->status_response[1] == 0x30)) {
+        if (!imu_time_update(&gamepad->imu_time, controller->status_response[2], cur_time, sample_time)) return;
+    } else {
+        for (i = 0; i < IMU_SAMPLES_PER_REPORT; i++) sample_time[i] = cur_time;
+    }
+
+    // Without IMU data the filter would integrate the calibration offsets, so it waits and starts again from gravity
+    streaming = gamepad_imu_streaming(controller);
+    if (streaming && !gamepad->imu_streaming) orientation_restart(&gamepad->orientation);
+    gamepad->imu_streaming = streaming;
+
+    // Once streaming stops the ring is emptied, otherwise the PIC32 would keep playing back the last samples
+    if (streaming) gamepad_store_imu_samples(gamepad, controller, sample_time);
+    else gamepad->imu_sample_count = 0;
+    if (gamepad->calibrating || !streaming) return;
+
+    switch (state->type) {
+        case CNT_JOYCON_R:
+        case CNT_PROCON:
+            if (controller->status_response[1] != 0x30) return;
+            invert = (state->type == CNT_PROCON) ? -1 : 1;   // Pro Controller IMU is mounted upside down
+            for (i = 2; i >= 0; i--) {  // Samples are sent newest first, 5ms apart
+                data = controller->status_response + 14 + (12 * i);
+                accel[0] = ((data[1] << 8) | data[0]) - gamepad->cal.accel_rx_offset;
+                accel[1] = (((data[3] << 8) | data[2]) - gamepad->cal.accel_ry_offset) * invert;
+                accel[2] = (((data[5] << 8) | data[4]) - gamepad->cal.accel_rz_offset) * invert;
+                gyro[0] = ((data[7] << 8) | data[6]) - gamepad->cal.gyro_rx_offset;
+                gyro[1] = (((data[9] << 8) | data[8]) - gamepad->cal.gyro_ry_offset) * invert;
+                gyro[2] = (((data[11] << 8) | data[10]) - gamepad->cal.gyro_rz_offset) * invert;
+                orientation_update(&gamepad->orientation, gyro, accel, GYRO_SCALE_SWITCH, sample_time[i]);
+            }
+            break;
+        case CNT_WIIMOTE:
+            if ((controller->status_response[1] != 0x37) || !state->wmp_active || ((controller->status_response[22] & 0x03) != 0x02)) return;
+            sample = &gamepad->imu_samples[(gamepad->imu_sample_pos + IMU_RING_LEN - 1) % IMU_RING_LEN];
+            gyro[0] = sample->gyro_x;   // Motion Plus roll, pitch, yaw
+            gyro[1] = sample->gyro_y;
+            gyro[2] = sample->gyro_z;
+            accel[0] = sample->accel_y; // Wiimote accelerometer points y forward
+            accel[1] = -sample->accel_x;
+            accel[2] = sample->accel_z;
+            orientation_update(&gamepad->orientation, gyro, accel, GYRO_SCALE_WMP, cur_time);
+            break;
+        default:
+            return;
+    }
+    gamepad_update_pointer(gamepad);
+}
+
+// Switch controllers get a strength from the rumble duty cycle, Wiimotes just follow the rumble bit
+static uint8_t gamepad_rumble_level(hid_controller_t * controller, uint8_t gamepad_num) {
+    controller_state_t * state = pipeline_controller_state(controller);
+    switch (state->type) {
+        case CNT_JOYCON_R:
+        case CNT_JOYCON_L:
+        case CNT_PROCON:
+            return hd_rumble_level(&wiimotes[gamepad_num - 1]);
+        default:
+            return wiimotes[gamepad_num - 1].rumble;
     }
 }
 
@@ -671,7 +700,9 @@ void gamepad_handle(uint8_t gamepad_num) {
         gamepad_t * gamepad = &gamepads[gamepad_num - 1];
         hid_controller_t * controller_main;
         hid_controller_t * controller_secondary;
-        get_controllers_from_gamepad(gamepad_num, &controller_main, &controller_secondary, 1);    // Only return connected controllers
+        uint8_t rumble;
+        pipeline_get_controllers(gamepad_num, &controller_main, &controller_secondary, 1);    // Only return connected controllers
+        gamepad->handle_time = pipeline_timer;
 
         uint8_t using_wired_joycon = (gamepad_num == UART_GAMEPAD_NUM) && (joycon_right.data_ready || joycon_left.data_ready);
         if (!controller_main && !controller_secondary && !using_wired_joycon) {
@@ -685,6 +716,7 @@ void gamepad_handle(uint8_t gamepad_num) {
         if (using_wired_joycon) {
             gamepad->type = GAMEPAD_JOYCON_WIRED;
             gamepad_parse_uart_input(gamepad);
+            gamepad_get_angles_from_uart(gamepad);
         } else {
             gamepad_set_type(gamepad_num);  // This has to be set every loop to account for wired Joy-Con disconnecting
             switch (gamepad->type) {
@@ -704,7 +736,7 @@ void gamepad_handle(uint8_t gamepad_num) {
                     break;
                 case GAMEPAD_WIIMOTE:
                     gamepad_parse_wiimote_input(gamepad, controller_main);
-                    if (controller_main->wmp_active) gamepad_gyro_handle(gamepad, controller_main);
+                    if (pipeline_controller_state(controller_main)->wmp_active) gamepad_gyro_handle(gamepad, controller_main);
                     // Enable gyro pointer by long pressing minus
                     break;
                 case GAMEPAD_WIIU_PRO:
@@ -714,14 +746,15 @@ void gamepad_handle(uint8_t gamepad_num) {
                     break;
             }
         }
+        latency_probe(gamepad_num, LAT_PARSED);
 
         if (gamepad->type == GAMEPAD_WIIMOTE) {
-            if (controller_main) wiimote_set_extension(gamepad_num, controller_main->extension_type);
+            if (controller_main) wiimote_set_extension(gamepad_num, pipeline_controller_state(controller_main)->extension_type);
         } else {
             if (gamepad->mode_switch.triggered) {
                 wiimote_change_extension(gamepad_num);  // Cycle through virtual extensions
-                if (controller_main) controller_rumble_pattern(controller_main, 100, 70, 2);
-                if (controller_secondary) controller_rumble_pattern(controller_secondary, 100, 70, 2);
+                if (controller_main) pipeline_controller_rumble_pattern(controller_main, 100, 70, 2);
+                if (controller_secondary) pipeline_controller_rumble_pattern(controller_secondary, 100, 70, 2);
                 gamepad->mode_switch.triggered = 0;
             }
         }
@@ -731,16 +764,18 @@ void gamepad_handle(uint8_t gamepad_num) {
         
         // Set controller LEDs and rumble based on response from PIC
         if (controller_main) {
-            if ((controller_main->rumble != wiimotes[gamepad_num - 1].rumble) && !controller_main->rumble_pattern_repetitions)
-                controller_rumble(controller_main, wiimotes[gamepad_num - 1].rumble);
+            rumble = gamepad_rumble_level(controller_main, gamepad_num);
+            if ((pipeline_controller_state(controller_main)->rumble != rumble) && !pipeline_controller_state(controller_main)->rumble_pattern_repetitions)
+                pipeline_controller_rumble(controller_main, rumble);
             if (wiimotes[gamepad_num - 1].player_num) 
-                controller_set_leds(controller_main, wiimotes[gamepad_num - 1].player_num);
+                pipeline_controller_set_leds(controller_main, wiimotes[gamepad_num - 1].player_num);
         }
         if (controller_secondary) {
-            if ((controller_secondary->rumble != wiimotes[gamepad_num - 1].rumble) && !controller_secondary->rumble_pattern_repetitions) 
-                controller_rumble(controller_secondary, wiimotes[gamepad_num - 1].rumble);
+            rumble = gamepad_rumble_level(controller_secondary, gamepad_num);
+            if ((pipeline_controller_state(controller_secondary)->rumble != rumble) && !pipeline_controller_state(controller_secondary)->rumble_pattern_repetitions) 
+                pipeline_controller_rumble(controller_secondary, rumble);
             if (wiimotes[gamepad_num - 1].player_num) 
-                controller_set_leds(controller_secondary, wiimotes[gamepad_num - 1].player_num);
+                pipeline_controller_set_leds(controller_secondary, wiimotes[gamepad_num - 1].player_num);
         }
 
         // TO DO
@@ -749,6 +784,58 @@ void gamepad_handle(uint8_t gamepad_num) {
     }
 }
 
+// Gamepads are normally handled as controller input arrives, this covers disconnects and quiet controllers
+void gamepad_timeout_handle(uint8_t gamepad_num) {
+    if (gamepad_num > 0 && gamepad_num <= 4) {
+        if (pipeline_timer - gamepads[gamepad_num - 1].handle_time >= GAMEPAD_IDLE_TIME) gamepad_handle(gamepad_num);
+    }
+}
+
+// Calibration goes to the trace as the group followed by its calibration_t fields
+static void gamepad_trace_cal(hid_controller_t * controller, enum CAL_GROUP group, const void * values, uint8_t values_len) {
+    uint8_t data[1 + (6 * sizeof(uint16_t))];
+    data[0] = group;
+    memcpy(&data[1], values, values_len);
+    trace_event_data((controller - get_controller(1)) + 1, EVT_CAL, data, 1 + values_len);
+}
+
+// Use calibration cached from a previous connection, only the halves this controller provides
+void gamepad_set_cal_cached(hid_controller_t * controller, const calibration_t * cached) {
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
+    uint8_t groups = 0;
+    if (controller->type != CNT_JOYCON_L) {
+        cal->joy_rx_max = cached->joy_rx_max;
+        cal->joy_rx_center = cached->joy_rx_center;
+        cal->joy_rx_min = cached->joy_rx_min;
+        cal->joy_ry_max = cached->joy_ry_max;
+        cal->joy_ry_center = cached->joy_ry_center;
+        cal->joy_ry_min = cached->joy_ry_min;
+        cal->accel_rx_offset = cached->accel_rx_offset;
+        cal->accel_ry_offset = cached->accel_ry_offset;
+        cal->accel_rz_offset = cached->accel_rz_offset;
+        cal->gyro_rx_offset = cached->gyro_rx_offset;
+        cal->gyro_ry_offset = cached->gyro_ry_offset;
+        cal->gyro_rz_offset = cached->gyro_rz_offset;
+        groups |= CAL_GROUPS_R;
+    }
+    if (controller->type != CNT_JOYCON_R) {
+        cal->joy_lx_max = cached->joy_lx_max;
+        cal->joy_lx_center = cached->joy_lx_center;
+        cal->joy_lx_min = cached->joy_lx_min;
+        cal->joy_ly_max = cached->joy_ly_max;
+        cal->joy_ly_center = cached->joy_ly_center;
+        cal->joy_ly_min = cached->joy_ly_min;
+        cal->accel_lx_offset = cached->accel_lx_offset;
+        cal->accel_ly_offset = cached->accel_ly_offset;
+        cal->accel_lz_offset = cached->accel_lz_offset;
+        cal->gyro_lx_offset = cached->gyro_lx_offset;
+        cal->gyro_ly_offset = cached->gyro_ly_offset;
+        cal->gyro_lz_offset = cached->gyro_lz_offset;
+        groups |= CAL_GROUPS_L;
+    }
+    pipeline_publish_calibration(controller->gamepad_num, groups);
+}
+
 // Set calibration values specific to Nunchuk
 void gamepad_set_cal_nunchuk(hid_controller_t * controller) {
     gamepad_set_cal_accel_l(controller);
@@ -770,275 +857,257 @@ void gamepad_set_cal_imu(hid_controller_t * controller) {
 }
 
 void gamepad_set_cal_accel_r(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
+    if (controller->command_failed) return;     // Keep the current calibration
     switch (controller->type) {
         case CNT_JOYCON_R:
         case CNT_PROCON:
             switch (controller->cal_accel_r_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.accel_rx_offset = (controller->command_response[24] << 8) | controller->command_response[23];
-                        gamepad->cal.accel_ry_offset = (controller->command_response[26] << 8) | controller->command_response[25];
-                        gamepad->cal.accel_rz_offset = (controller->command_response[28] << 8) | controller->command_response[27];
+                        cal->accel_rx_offset = (controller->command_response[24] << 8) | controller->command_response[23];
+                        cal->accel_ry_offset = (controller->command_response[26] << 8) | controller->command_response[25];
+                        cal->accel_rz_offset = (controller->command_response[28] << 8) | controller->command_response[27];
                     } else {
                         controller->cal_accel_r_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_imu_factory, NULL, &gamepad_set_cal_imu, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.accel_rx_offset = (controller->command_response[22] << 8) | controller->command_response[21];
-                    gamepad->cal.accel_ry_offset = (controller->command_response[24] << 8) | controller->command_response[23];
-                    gamepad->cal.accel_rz_offset = (controller->command_response[26] << 8) | controller->command_response[25];
+                    cal->accel_rx_offset = (controller->command_response[22] << 8) | controller->command_response[21];
+                    cal->accel_ry_offset = (controller->command_response[24] << 8) | controller->command_response[23];
+                    cal->accel_rz_offset = (controller->command_response[26] << 8) | controller->command_response[25];
                     break;
                 default:
                     break;
             }
-            printf("Right accel X offset: %d\n", gamepad->cal.accel_rx_offset);
-            printf("Right accel Y offset: %d\n", gamepad->cal.accel_ry_offset);
-            printf("Right accel Z offset: %d\n", gamepad->cal.accel_rz_offset);
+            gamepad_trace_cal(controller, CAL_ACCEL_R, &cal->accel_rx_offset, 3 * sizeof(int16_t));
             break;
         case CNT_WIIMOTE:
-            gamepad->cal.accel_rx_offset = (((controller->command_response[7] << 2) | ((controller->command_response[10] & 0x30) >> 2)) << 6) - 0x8000;
-            gamepad->cal.accel_ry_offset = (((controller->command_response[8] << 2) | ((controller->command_response[10] & 0x0C) >> 2)) << 6) - 0x8000;
-            gamepad->cal.accel_rz_offset = (((controller->command_response[9] << 2) | (controller->command_response[10] & 0x03)) << 6) - 0x8000;
-            printf("Right accel X offset: %d\n", gamepad->cal.accel_rx_offset);
-            printf("Right accel Y offset: %d\n", gamepad->cal.accel_ry_offset);
-            printf("Right accel Z offset: %d\n", gamepad->cal.accel_rz_offset);
+            cal->accel_rx_offset = (((controller->command_response[7] << 2) | ((controller->command_response[10] & 0x30) >> 2)) << 6) - 0x8000;
+            cal->accel_ry_offset = (((controller->command_response[8] << 2) | ((controller->command_response[10] & 0x0C) >> 2)) << 6) - 0x8000;
+            cal->accel_rz_offset = (((controller->command_response[9] << 2) | (controller->command_response[10] & 0x03)) << 6) - 0x8000;
+            gamepad_trace_cal(controller, CAL_ACCEL_R, &cal->accel_rx_offset, 3 * sizeof(int16_t));
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_ACCEL_R));
 }
 
 void gamepad_set_cal_accel_l(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
     uint8_t i, checksum = 0;
+    if (controller->command_failed) return;
     switch (controller->type) {
         case CNT_JOYCON_L:
             switch (controller->cal_accel_l_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.accel_lx_offset = (controller->command_response[24] << 8) | controller->command_response[23];
-                        gamepad->cal.accel_ly_offset = (controller->command_response[26] << 8) | controller->command_response[25];
-                        gamepad->cal.accel_lz_offset = (controller->command_response[28] << 8) | controller->command_response[27];
+                        cal->accel_lx_offset = (controller->command_response[24] << 8) | controller->command_response[23];
+                        cal->accel_ly_offset = (controller->command_response[26] << 8) | controller->command_response[25];
+                        cal->accel_lz_offset = (controller->command_response[28] << 8) | controller->command_response[27];
                     } else {
                         controller->cal_accel_l_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_imu_factory, NULL, &gamepad_set_cal_imu, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.accel_lx_offset = (controller->command_response[22] << 8) | controller->command_response[21];
-                    gamepad->cal.accel_ly_offset = (controller->command_response[24] << 8) | controller->command_response[23];
-                    gamepad->cal.accel_lz_offset = (controller->command_response[26] << 8) | controller->command_response[25];
+                    cal->accel_lx_offset = (controller->command_response[22] << 8) | controller->command_response[21];
+                    cal->accel_ly_offset = (controller->command_response[24] << 8) | controller->command_response[23];
+                    cal->accel_lz_offset = (controller->command_response[26] << 8) | controller->command_response[25];
                     break;
                 default:
                     break;
             }
-            printf("Left accel X offset: %d\n", gamepad->cal.accel_lx_offset);
-            printf("Left accel Y offset: %d\n", gamepad->cal.accel_ly_offset);
-            printf("Left accel Z offset: %d\n", gamepad->cal.accel_lz_offset);
+            gamepad_trace_cal(controller, CAL_ACCEL_L, &cal->accel_lx_offset, 3 * sizeof(int16_t));
             break;
         case CNT_WIIMOTE:
             for(i = 0; i < 14; i++) checksum += controller->command_response[7 + i];
             checksum += 0x55;
             if (checksum == controller->command_response[21]) {
-                gamepad->cal.accel_lx_offset = (((controller->command_response[7] << 2) | ((controller->command_response[10] & 0x30) >> 2)) << 6) - 0x8000;
-                gamepad->cal.accel_ly_offset = (((controller->command_response[8] << 2) | ((controller->command_response[10] & 0x0C) >> 2)) << 6) - 0x8000;
-                gamepad->cal.accel_lz_offset = (((controller->command_response[9] << 2) | (controller->command_response[10] & 0x03)) << 6) - 0x8000;
+                cal->accel_lx_offset = (((controller->command_response[7] << 2) | ((controller->command_response[10] & 0x30) >> 2)) << 6) - 0x8000;
+                cal->accel_ly_offset = (((controller->command_response[8] << 2) | ((controller->command_response[10] & 0x0C) >> 2)) << 6) - 0x8000;
+                cal->accel_lz_offset = (((controller->command_response[9] << 2) | (controller->command_response[10] & 0x03)) << 6) - 0x8000;
             } else {
-                gamepad->cal.accel_lx_offset = 0;
-                gamepad->cal.accel_ly_offset = 0;
-                gamepad->cal.accel_lz_offset = 0;
+                cal->accel_lx_offset = 0;
+                cal->accel_ly_offset = 0;
+                cal->accel_lz_offset = 0;
             }
-            printf("Left accel X offset: %d\n", gamepad->cal.accel_lx_offset);
-            printf("Left accel Y offset: %d\n", gamepad->cal.accel_ly_offset);
-            printf("Left accel Z offset: %d\n", gamepad->cal.accel_lz_offset);
+            gamepad_trace_cal(controller, CAL_ACCEL_L, &cal->accel_lx_offset, 3 * sizeof(int16_t));
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_ACCEL_L));
 }
 
 void gamepad_set_cal_gyro_r(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
+    if (controller->command_failed) return;
     switch (controller->type) {
         case CNT_JOYCON_R:
         case CNT_PROCON:
             switch (controller->cal_gyro_r_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.gyro_rx_offset = (controller->command_response[36] << 8) | controller->command_response[35];
-                        gamepad->cal.gyro_ry_offset = (controller->command_response[38] << 8) | controller->command_response[37];
-                        gamepad->cal.gyro_rz_offset = (controller->command_response[40] << 8) | controller->command_response[39];
+                        cal->gyro_rx_offset = (controller->command_response[36] << 8) | controller->command_response[35];
+                        cal->gyro_ry_offset = (controller->command_response[38] << 8) | controller->command_response[37];
+                        cal->gyro_rz_offset = (controller->command_response[40] << 8) | controller->command_response[39];
                     } else {
                         controller->cal_gyro_r_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_imu_factory, NULL, &gamepad_set_cal_imu, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.gyro_rx_offset = (controller->command_response[34] << 8) | controller->command_response[33];
-                    gamepad->cal.gyro_ry_offset = (controller->command_response[36] << 8) | controller->command_response[35];
-                    gamepad->cal.gyro_rz_offset = (controller->command_response[38] << 8) | controller->command_response[37];
+                    cal->gyro_rx_offset = (controller->command_response[34] << 8) | controller->command_response[33];
+                    cal->gyro_ry_offset = (controller->command_response[36] << 8) | controller->command_response[35];
+                    cal->gyro_rz_offset = (controller->command_response[38] << 8) | controller->command_response[37];
                     break;
                 default:
                     break;
             }
-            printf("Right gyro X offset: %d\n", gamepad->cal.gyro_rx_offset);
-            printf("Right gyro Y offset: %d\n", gamepad->cal.gyro_ry_offset);
-            printf("Right gyro Z offset: %d\n", gamepad->cal.gyro_rz_offset);
+            gamepad_trace_cal(controller, CAL_GYRO_R, &cal->gyro_rx_offset, 3 * sizeof(int16_t));
             break;
         case CNT_WIIMOTE:
-            gamepad->cal.gyro_rx_offset = ((controller->command_response[9] << 8) | controller->command_response[10]) - 0x8000;
-            gamepad->cal.gyro_ry_offset = ((controller->command_response[11] << 8) | controller->command_response[12]) - 0x8000;
-            gamepad->cal.gyro_rz_offset = ((controller->command_response[7] << 8) | controller->command_response[8]) - 0x8000;
-            printf("Right gyro X offset: %d\n", gamepad->cal.gyro_rx_offset);
-            printf("Right gyro Y offset: %d\n", gamepad->cal.gyro_ry_offset);
-            printf("Right gyro Z offset: %d\n", gamepad->cal.gyro_rz_offset);
+            cal->gyro_rx_offset = ((controller->command_response[9] << 8) | controller->command_response[10]) - 0x8000;
+            cal->gyro_ry_offset = ((controller->command_response[11] << 8) | controller->command_response[12]) - 0x8000;
+            cal->gyro_rz_offset = ((controller->command_response[7] << 8) | controller->command_response[8]) - 0x8000;
+            gamepad_trace_cal(controller, CAL_GYRO_R, &cal->gyro_rx_offset, 3 * sizeof(int16_t));
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_GYRO_R));
 }
 
 void gamepad_set_cal_gyro_l(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
+    if (controller->command_failed) return;
     switch (controller->type) {
         case CNT_JOYCON_L:
             switch (controller->cal_gyro_l_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.gyro_lx_offset = (controller->command_response[36] << 8) | controller->command_response[35];
-                        gamepad->cal.gyro_ly_offset = (controller->command_response[38] << 8) | controller->command_response[37];
-                        gamepad->cal.gyro_lz_offset = (controller->command_response[40] << 8) | controller->command_response[39];
+                        cal->gyro_lx_offset = (controller->command_response[36] << 8) | controller->command_response[35];
+                        cal->gyro_ly_offset = (controller->command_response[38] << 8) | controller->command_response[37];
+                        cal->gyro_lz_offset = (controller->command_response[40] << 8) | controller->command_response[39];
                     } else {
                         controller->cal_gyro_l_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_imu_factory, NULL, &gamepad_set_cal_imu, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.gyro_lx_offset = (controller->command_response[34] << 8) | controller->command_response[33];
-                    gamepad->cal.gyro_ly_offset = (controller->command_response[36] << 8) | controller->command_response[35];
-                    gamepad->cal.gyro_lz_offset = (controller->command_response[38] << 8) | controller->command_response[37];
+                    cal->gyro_lx_offset = (controller->command_response[34] << 8) | controller->command_response[33];
+                    cal->gyro_ly_offset = (controller->command_response[36] << 8) | controller->command_response[35];
+                    cal->gyro_lz_offset = (controller->command_response[38] << 8) | controller->command_response[37];
                     break;
                 default:
                     break;
             }
-            printf("Left gyro X offset: %d\n", gamepad->cal.gyro_lx_offset);
-            printf("Left gyro Y offset: %d\n", gamepad->cal.gyro_ly_offset);
-            printf("Left gyro Z offset: %d\n", gamepad->cal.gyro_lz_offset);
+            gamepad_trace_cal(controller, CAL_GYRO_L, &cal->gyro_lx_offset, 3 * sizeof(int16_t));
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_GYRO_L));
 }
 
 void gamepad_set_cal_joy_r(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
     uint8_t i, checksum = 0;
+    if (controller->command_failed) return;
     switch (controller->type) {
         case CNT_JOYCON_R:
         case CNT_PROCON:
             switch (controller->cal_joy_r_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.joy_rx_center = ((controller->command_response[24] << 8) & 0xF00) | controller->command_response[23];
-                        gamepad->cal.joy_ry_center = (controller->command_response[25] << 4) | (controller->command_response[23] >> 4);
-                        gamepad->cal.joy_rx_min = gamepad->cal.joy_rx_center - (((controller->command_response[27] << 8) & 0xF00) | controller->command_response[26]);
-                        gamepad->cal.joy_rx_max = gamepad->cal.joy_rx_center + (((controller->command_response[30] << 8) & 0xF00) | controller->command_response[29]);
-                        gamepad->cal.joy_ry_min = gamepad->cal.joy_ry_center - ((controller->command_response[28] << 4) | (controller->command_response[27] >> 4));
-                        gamepad->cal.joy_ry_max = gamepad->cal.joy_ry_center + ((controller->command_response[31] << 4) | (controller->command_response[30] >> 4));
+                        cal->joy_rx_center = ((controller->command_response[24] << 8) & 0xF00) | controller->command_response[23];
+                        cal->joy_ry_center = (controller->command_response[25] << 4) | (controller->command_response[23] >> 4);
+                        cal->joy_rx_min = cal->joy_rx_center - (((controller->command_response[27] << 8) & 0xF00) | controller->command_response[26]);
+                        cal->joy_rx_max = cal->joy_rx_center + (((controller->command_response[30] << 8) & 0xF00) | controller->command_response[29]);
+                        cal->joy_ry_min = cal->joy_ry_center - ((controller->command_response[28] << 4) | (controller->command_response[27] >> 4));
+                        cal->joy_ry_max = cal->joy_ry_center + ((controller->command_response[31] << 4) | (controller->command_response[30] >> 4));
                     } else {
                         controller->cal_joy_r_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_joy_r_factory, NULL, &gamepad_set_cal_joy_r, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.joy_rx_center = ((controller->command_response[22] << 8) & 0xF00) | controller->command_response[21];
-                    gamepad->cal.joy_ry_center = (controller->command_response[23] << 4) | (controller->command_response[22] >> 4);
-                    gamepad->cal.joy_rx_min = gamepad->cal.joy_rx_center - (((controller->command_response[25] << 8) & 0xF00) | controller->command_response[24]);
-                    gamepad->cal.joy_rx_max = gamepad->cal.joy_rx_center + (((controller->command_response[28] << 8) & 0xF00) | controller->command_response[27]);
-                    gamepad->cal.joy_ry_min = gamepad->cal.joy_ry_center - ((controller->command_response[26] << 4) | (controller->command_response[25] >> 4));
-                    gamepad->cal.joy_ry_max = gamepad->cal.joy_ry_center + ((controller->command_response[29] << 4) | (controller->command_response[28] >> 4));
+                    cal->joy_rx_center = ((controller->command_response[22] << 8) & 0xF00) | controller->command_response[21];
+                    cal->joy_ry_center = (controller->command_response[23] << 4) | (controller->command_response[22] >> 4);
+                    cal->joy_rx_min = cal->joy_rx_center - (((controller->command_response[25] << 8) & 0xF00) | controller->command_response[24]);
+                    cal->joy_rx_max = cal->joy_rx_center + (((controller->command_response[28] << 8) & 0xF00) | controller->command_response[27]);
+                    cal->joy_ry_min = cal->joy_ry_center - ((controller->command_response[26] << 4) | (controller->command_response[25] >> 4));
+                    cal->joy_ry_max = cal->joy_ry_center + ((controller->command_response[29] << 4) | (controller->command_response[28] >> 4));
                     break;
                 default:
                     break;
             }
-            printf("Right stick X center: %d\n", gamepad->cal.joy_rx_center);
-            printf("Right stick Y center: %d\n", gamepad->cal.joy_ry_center);
-            printf("Right stick X min: %d\n", gamepad->cal.joy_rx_min);
-            printf("Right stick X max: %d\n", gamepad->cal.joy_rx_max);
-            printf("Right stick Y min: %d\n", gamepad->cal.joy_ry_min);
-            printf("Right stick Y max: %d\n", gamepad->cal.joy_ry_max);
+            gamepad_trace_cal(controller, CAL_JOY_R, &cal->joy_rx_max, 6 * sizeof(uint16_t));
             break;
         case CNT_WIIMOTE:
             for(i = 0; i < 14; i++) checksum += controller->command_response[7 + i];
             checksum += 0x55;
             if (checksum == controller->command_response[21]) {
-                gamepad->cal.joy_rx_max = controller->command_response[13];
-                gamepad->cal.joy_rx_min = controller->command_response[14];
-                gamepad->cal.joy_rx_center = controller->command_response[15];
-                gamepad->cal.joy_ry_max = controller->command_response[16];
-                gamepad->cal.joy_ry_min = controller->command_response[17];
-                gamepad->cal.joy_ry_center = controller->command_response[18];
+                cal->joy_rx_max = controller->command_response[13];
+                cal->joy_rx_min = controller->command_response[14];
+                cal->joy_rx_center = controller->command_response[15];
+                cal->joy_ry_max = controller->command_response[16];
+                cal->joy_ry_min = controller->command_response[17];
+                cal->joy_ry_center = controller->command_response[18];
             } else {
-                gamepad->cal.joy_rx_max = 0xE0;
-                gamepad->cal.joy_rx_min = 0x20;
-                gamepad->cal.joy_rx_center = 0x80;
-                gamepad->cal.joy_ry_max = 0xE0;
-                gamepad->cal.joy_ry_min = 0x20;
-                gamepad->cal.joy_ry_center = 0x80;
+                cal->joy_rx_max = 0xE0;
+                cal->joy_rx_min = 0x20;
+                cal->joy_rx_center = 0x80;
+                cal->joy_ry_max = 0xE0;
+                cal->joy_ry_min = 0x20;
+                cal->joy_ry_center = 0x80;
             }
-            printf("Right stick X center: %d\n", gamepad->cal.joy_rx_center);
-            printf("Right stick Y center: %d\n", gamepad->cal.joy_ry_center);
-            printf("Right stick X min: %d\n", gamepad->cal.joy_rx_min);
-            printf("Right stick X max: %d\n", gamepad->cal.joy_rx_max);
-            printf("Right stick Y min: %d\n", gamepad->cal.joy_ry_min);
-            printf("Right stick Y max: %d\n", gamepad->cal.joy_ry_max);
+            gamepad_trace_cal(controller, CAL_JOY_R, &cal->joy_rx_max, 6 * sizeof(uint16_t));
             break;
         case CNT_WIIU_PRO:
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_JOY_R));
 }
     
 void gamepad_set_cal_joy_l(hid_controller_t * controller) {
-    gamepad_t * gamepad = &gamepads[controller->gamepad_num - 1];
+    calibration_t * cal = pipeline_staged_calibration(controller->gamepad_num);
     uint8_t i, checksum = 0;
+    if (controller->command_failed) return;
     switch (controller->type) {
         case CNT_JOYCON_L:
         case CNT_PROCON:
             switch (controller->cal_joy_l_type) {
                 case 0:
                     if ((controller->command_response[21] == 0xB2) && (controller->command_response[22] == 0xA1)) { // Magic identifier for user calibration
-                        gamepad->cal.joy_lx_center = ((controller->command_response[27] << 8) & 0xF00) | controller->command_response[26];
-                        gamepad->cal.joy_ly_center = (controller->command_response[28] << 4) | (controller->command_response[27] >> 4);
-                        gamepad->cal.joy_lx_min = gamepad->cal.joy_lx_center - (((controller->command_response[30] << 8) & 0xF00) | controller->command_response[29]);
-                        gamepad->cal.joy_lx_max = gamepad->cal.joy_lx_center + (((controller->command_response[24] << 8) & 0xF00) | controller->command_response[23]);
-                        gamepad->cal.joy_ly_min = gamepad->cal.joy_ly_center - ((controller->command_response[31] << 4) | (controller->command_response[30] >> 4));
-                        gamepad->cal.joy_ly_max = gamepad->cal.joy_ly_center + ((controller->command_response[25] << 4) | (controller->command_response[24] >> 4));
+                        cal->joy_lx_center = ((controller->command_response[27] << 8) & 0xF00) | controller->command_response[26];
+                        cal->joy_ly_center = (controller->command_response[28] << 4) | (controller->command_response[27] >> 4);
+                        cal->joy_lx_min = cal->joy_lx_center - (((controller->command_response[30] << 8) & 0xF00) | controller->command_response[29]);
+                        cal->joy_lx_max = cal->joy_lx_center + (((controller->command_response[24] << 8) & 0xF00) | controller->command_response[23]);
+                        cal->joy_ly_min = cal->joy_ly_center - ((controller->command_response[31] << 4) | (controller->command_response[30] >> 4));
+                        cal->joy_ly_max = cal->joy_ly_center + ((controller->command_response[25] << 4) | (controller->command_response[24] >> 4));
                     } else {
                         controller->cal_joy_l_type = 1;
                         hid_queue_command(controller, &cmd_joycon_read_cal_joy_l_factory, NULL, &gamepad_set_cal_joy_l, 1);
                     }
                     break;
                 case 1:
-                    gamepad->cal.joy_lx_center = ((controller->command_response[25] << 8) & 0xF00) | controller->command_response[24];
-                    gamepad->cal.joy_ly_center = (controller->command_response[26] << 4) | (controller->command_response[25] >> 4);
-                    gamepad->cal.joy_lx_min = gamepad->cal.joy_lx_center - (((controller->command_response[28] << 8) & 0xF00) | controller->command_response[27]);
-                    gamepad->cal.joy_lx_max = gamepad->cal.joy_lx_center + (((controller->command_response[22] << 8) & 0xF00) | controller->command_response[21]);
-                    gamepad->cal.joy_ly_min = gamepad->cal.joy_ly_center - ((controller->command_response[29] << 4) | (controller->command_response[28] >> 4));
-                    gamepad->cal.joy_ly_max = gamepad->cal.joy_ly_center + ((controller->command_response[23] << 4) | (controller->command_response[22] >> 4));
+                    cal->joy_lx_center = ((controller->command_response[25] << 8) & 0xF00) | controller->command_response[24];
+                    cal->joy_ly_center = (controller->command_response[26] << 4) | (controller->command_response[25] >> 4);
+                    cal->joy_lx_min = cal->joy_lx_center - (((controller->command_response[28] << 8) & 0xF00) | controller->command_response[27]);
+                    cal->joy_lx_max = cal->joy_lx_center + (((controller->command_response[22] << 8) & 0xF00) | controller->command_response[21]);
+                    cal->joy_ly_min = cal->joy_ly_center - ((controller->command_response[29] << 4) | (controller->command_response[28] >> 4));
+                    cal->joy_ly_max = cal->joy_ly_center + ((controller->command_response[23] << 4) | (controller->command_response[22] >> 4));
                     break;
                 default:
                     break;
             }
-            printf("Left stick X center: %d\n", gamepad->cal.joy_lx_center);
-            printf("Left stick Y center: %d\n", gamepad->cal.joy_ly_center);
-            printf("Left stick X min: %d\n", gamepad->cal.joy_lx_min);
-            printf("Left stick X max: %d\n", gamepad->cal.joy_lx_max);
-            printf("Left stick Y min: %d\n", gamepad->cal.joy_ly_min);
-            printf("Left stick Y max: %d\n", gamepad->cal.joy_ly_max);
+            gamepad_trace_cal(controller, CAL_JOY_L, &cal->joy_lx_max, 6 * sizeof(uint16_t));
             break;
         case CNT_WIIMOTE:
             for(i = 0; i < 14; i++) checksum += controller->command_response[7 + i];
@@ -1046,43 +1115,39 @@ void gamepad_set_cal_joy_l(hid_controller_t * controller) {
             if (checksum == controller->command_response[21]) {
                 switch (controller->extension_type) {
                     case EXT_NUNCHUK:
-                        gamepad->cal.joy_lx_max = controller->command_response[15];
-                        gamepad->cal.joy_lx_min = controller->command_response[16];
-                        gamepad->cal.joy_lx_center = controller->command_response[17];
-                        gamepad->cal.joy_ly_max = controller->command_response[18];
-                        gamepad->cal.joy_ly_min = controller->command_response[19];
-                        gamepad->cal.joy_ly_center = controller->command_response[20];
+                        cal->joy_lx_max = controller->command_response[15];
+                        cal->joy_lx_min = controller->command_response[16];
+                        cal->joy_lx_center = controller->command_response[17];
+                        cal->joy_ly_max = controller->command_response[18];
+                        cal->joy_ly_min = controller->command_response[19];
+                        cal->joy_ly_center = controller->command_response[20];
                         break;
                     case EXT_CLASSIC:
-                        gamepad->cal.joy_lx_max = controller->command_response[7];
-                        gamepad->cal.joy_lx_min = controller->command_response[8];
-                        gamepad->cal.joy_lx_center = controller->command_response[9];
-                        gamepad->cal.joy_ly_max = controller->command_response[10];
-                        gamepad->cal.joy_ly_min = controller->command_response[11];
-                        gamepad->cal.joy_ly_center = controller->command_response[12];
+                        cal->joy_lx_max = controller->command_response[7];
+                        cal->joy_lx_min = controller->command_response[8];
+                        cal->joy_lx_center = controller->command_response[9];
+                        cal->joy_ly_max = controller->command_response[10];
+                        cal->joy_ly_min = controller->command_response[11];
+                        cal->joy_ly_center = controller->command_response[12];
                         
                         break;
                     default:
                         break;
                 }
             } else {
-                gamepad->cal.joy_lx_max = 0xE0;
-                gamepad->cal.joy_lx_min = 0x20;
-                gamepad->cal.joy_lx_center = 0x80;
-                gamepad->cal.joy_ly_max = 0xE0;
-                gamepad->cal.joy_ly_min = 0x20;
-                gamepad->cal.joy_ly_center = 0x80;
+                cal->joy_lx_max = 0xE0;
+                cal->joy_lx_min = 0x20;
+                cal->joy_lx_center = 0x80;
+                cal->joy_ly_max = 0xE0;
+                cal->joy_ly_min = 0x20;
+                cal->joy_ly_center = 0x80;
             }
-            printf("Left stick X center: %d\n", gamepad->cal.joy_lx_center);
-            printf("Left stick Y center: %d\n", gamepad->cal.joy_ly_center);
-            printf("Left stick X min: %d\n", gamepad->cal.joy_lx_min);
-            printf("Left stick X max: %d\n", gamepad->cal.joy_lx_max);
-            printf("Left stick Y min: %d\n", gamepad->cal.joy_ly_min);
-            printf("Left stick Y max: %d\n", gamepad->cal.joy_ly_max);
+            gamepad_trace_cal(controller, CAL_JOY_L, &cal->joy_lx_max, 6 * sizeof(uint16_t));
             break;
         case CNT_WIIU_PRO:
             break;
         default:
             break;
     }
+    pipeline_publish_calibration(controller->gamepad_num, CAL_GROUP_BIT(CAL_JOY_L));
 }
\ No newline at end of file
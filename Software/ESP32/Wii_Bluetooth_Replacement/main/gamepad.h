@@ -2,8 +2,14 @@
 #define	_GAMEPAD_H_
 
 #define LONG_PRESS_THRESH 700   // 700ms threshold for button events
+#define IMU_RING_LEN 8          // Number of recent IMU samples kept for the SPI link
+#define GAMEPAD_IDLE_TIME 15    // Time (ms) without controller input before a gamepad is handled by the loop timer
 
+#include "fixed.h"
 #include "hid_controller.h"
+#include "imu_time.h"
+#include "joystick.h"
+#include "orientation.h"
 #include "wiimote.h"
 
 typedef struct {
@@ -56,6 +62,16 @@ typedef struct {
 	int16_t gyro_lz;
 } axes_t;
 
+typedef struct {
+    uint32_t timestamp;     // Time (ms) the sample was taken
+    int16_t gyro_x;
+    int16_t gyro_y;
+    int16_t gyro_z;
+    int16_t accel_x;
+    int16_t accel_y;
+    int16_t accel_z;
+} imu_sample_t;
+
 typedef struct {
     uint16_t joy_rx_max;
     uint16_t joy_rx_center;
@@ -83,6 +99,13 @@ typedef struct {
     int16_t gyro_lz_offset;
 } calibration_t;
 
+// Calibration is set on the BTstack core and handed to the pipeline one group at a time
+enum CAL_GROUP { CAL_ACCEL_R, CAL_GYRO_R, CAL_JOY_R, CAL_ACCEL_L, CAL_GYRO_L, CAL_JOY_L, CAL_GROUP_COUNT };
+#define CAL_GROUP_BIT(group)    (1 << (group))
+#define CAL_GROUPS_R            (CAL_GROUP_BIT(CAL_ACCEL_R) | CAL_GROUP_BIT(CAL_GYRO_R) | CAL_GROUP_BIT(CAL_JOY_R))
+#define CAL_GROUPS_L            (CAL_GROUP_BIT(CAL_ACCEL_L) | CAL_GROUP_BIT(CAL_GYRO_L) | CAL_GROUP_BIT(CAL_JOY_L))
+#define CAL_GROUPS_ALL          (CAL_GROUPS_R | CAL_GROUPS_L)
+
 typedef struct {
     int32_t press_timer;
     int32_t release_timer;
@@ -105,12 +128,18 @@ typedef struct {
 	buttons_t buttons;
 	axes_t axes;
 	calibration_t cal;
+    joy_axis_map_t joy_rx_map;  // Built from cal whenever stick calibration changes
+    joy_axis_map_t joy_ry_map;
+    joy_axis_map_t joy_lx_map;
+    joy_axis_map_t joy_ly_map;
 
     button_event_t mode_switch;
     button_event_t gyro_calibrate;
     button_event_t gyro_center;
     button_event_t gyro_enable;
 
+    uint64_t handle_time;   // Last time gamepad was handled
+
     uint8_t calibrating;
     uint32_t calibration_timer;
     int32_t calibrate_gyro_x_sum; 
@@ -118,10 +147,17 @@ typedef struct {
     int32_t calibrate_gyro_z_sum;
     uint8_t calibrate_num_samples;
 
-    double yaw;
-    double pitch;
-    double roll;
-    uint64_t imu_timer;
+    orientation_t orientation;
+    uint8_t imu_streaming;  // Last report carried live IMU data
+    imu_time_t imu_time;
+    fixed_t yaw;    // Pointer angles (degrees) from the center orientation
+    fixed_t pitch;
+    fixed_t roll;
+
+    // Recent right IMU samples (calibrated, same orientation as axes_t)
+    imu_sample_t imu_samples[IMU_RING_LEN];
+    uint8_t imu_sample_pos;     // Next sample to be written
+    uint8_t imu_sample_count;
 
     wiimote_ir_object_t ir1;
     wiimote_ir_object_t ir2;
@@ -135,8 +171,12 @@ void gamepad_reset(gamepad_t * gamepad);
 void init_gamepads();
 void gamepad_set_type(uint8_t gamepad_num);
 void gamepad_set_extension(uint8_t gamepad_num);
-void gamepad_get_angles_from_controller(hid_controller_t * controller);
+void gamepad_get_angles_from_controller(hid_controller_t * controller, uint64_t cur_time);
 void gamepad_handle(uint8_t gamepad_num);
+void gamepad_timeout_handle(uint8_t gamepad_num);
+void gamepad_cal_defaults(calibration_t * cal);
+void gamepad_apply_cal(gamepad_t * gamepad, const calibration_t * cal, uint8_t groups);
+void gamepad_set_cal_cached(hid_controller_t * controller, const calibration_t * cal);
 void gamepad_set_cal_nunchuk(hid_controller_t * controller);
 void gamepad_set_cal_classic(hid_controller_t * controller);
 void gamepad_set_cal_imu(hid_controller_t * controller);
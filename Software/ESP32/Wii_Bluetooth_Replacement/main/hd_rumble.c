@@ -0,0 +1,23 @@
+#include "hd_rumble.h"
+
+// One side of an HD rumble frame per level: high band off, low band at about 200 Hz (encoded 0x4B).
+// Amplitude a = level / 15 is encoded offline as round(log2(a * 8.7) * 32) (round(log2(a * 17) * 16) below 0.23),
+// split into byte 3 = (enc >> 1) + 0x40 and bit 7 of byte 2 = enc & 1. Level 0 is the neutral frame.
+const uint8_t hd_rumble_frames[HD_RUMBLE_LEVELS][4] = {
+    { 0x00, 0x01, 0x40, 0x40 },
+    { 0x00, 0x00, 0x4B, 0x45 },
+    { 0x00, 0x00, 0xCB, 0x49 },
+    { 0x00, 0x00, 0x4B, 0x4E },
+    { 0x00, 0x00, 0xCB, 0x53 },
+    { 0x00, 0x00, 0xCB, 0x58 },
+    { 0x00, 0x00, 0x4B, 0x5D },
+    { 0x00, 0x00, 0xCB, 0x60 },
+    { 0x00, 0x00, 0xCB, 0x63 },
+    { 0x00, 0x00, 0x4B, 0x66 },
+    { 0x00, 0x00, 0xCB, 0x68 },
+    { 0x00, 0x00, 0x4B, 0x6B },
+    { 0x00, 0x00, 0x4B, 0x6D },
+    { 0x00, 0x00, 0xCB, 0x6E },
+    { 0x00, 0x00, 0xCB, 0x70 },
+    { 0x00, 0x00, 0x4B, 0x72 }
+};
\ No newline at end of file
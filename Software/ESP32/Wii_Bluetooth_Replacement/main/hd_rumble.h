@@ -0,0 +1,24 @@
+#ifndef _HD_RUMBLE_H_
+#define	_HD_RUMBLE_H_
+
+#include <stdint.h>
+#include "wiimote.h"
+
+// Joy-Con/Pro Controller HD rumble strength follows the duty cycle of the Wii's rumble bit
+#define HD_RUMBLE_LEVELS        16
+#define HD_RUMBLE_LEVEL_DEFAULT 7       // Used while the duty cycle is unknown (about the old fixed rumble)
+#define HD_RUMBLE_LEVEL_MAX     15      // Level for rumble held constantly on
+#define RUMBLE_MIN_INTERVAL     15      // Time (ms) between rumble-only packets, about the rate controllers take them
+
+extern const uint8_t hd_rumble_frames[HD_RUMBLE_LEVELS][4];
+
+// Rumble level for a Switch controller on this Wiimote slot, 0 = off
+static inline uint8_t hd_rumble_level(const wiimote_t * wiimote) {
+    uint8_t intensity;
+    if (!wiimote->wii_state_valid) return wiimote->rumble ? HD_RUMBLE_LEVEL_DEFAULT : 0;
+    intensity = wiimote->wii_state.rumble_intensity;
+    if (!intensity && !wiimote->rumble) return 0;
+    return 1 + (intensity * (HD_RUMBLE_LEVEL_MAX - 1) + 127) / 255;
+}
+
+#endif
\ No newline at end of file
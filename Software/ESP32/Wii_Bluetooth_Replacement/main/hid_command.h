@@ -6,6 +6,7 @@
 extern const hid_command_t cmd_joycon_report_mode_full; 
 extern const hid_command_t cmd_joycon_report_mode_standard;
 extern const hid_command_t cmd_joycon_enable_imu;
+extern const hid_command_t cmd_joycon_disable_imu;
 extern const hid_command_t cmd_joycon_get_device_info;
 extern const hid_command_t cmd_joycon_read_cal_imu_factory;
 extern const hid_command_t cmd_joycon_read_cal_joy_l_factory;
@@ -13,6 +14,7 @@ extern const hid_command_t cmd_joycon_read_cal_joy_r_factory;
 extern const hid_command_t cmd_joycon_read_cal_imu_user;
 extern const hid_command_t cmd_joycon_read_cal_joy_l_user;
 extern const hid_command_t cmd_joycon_read_cal_joy_r_user;
+extern const hid_command_t cmd_joycon_read_flash;
 extern const hid_command_t cmd_joycon_write_cal_accel_user;
 extern const hid_command_t cmd_joycon_write_cal_gyro_user;
 extern const hid_command_t cmd_joycon_write_magic_imu_user;
@@ -1,18 +1,25 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "btstack.h"
+#include "cal_cache.h"
 #include "gamepad.h"
 #include "hid_command.h"
+#include "hd_rumble.h"
 #include "hid_controller.h"
+#include "latency.h"
+#include "link_policy.h"
+#include "pipeline.h"
 #include "pair.h"
+#include "reconnect.h"
+#include "registry.h"
 #include "uart_controller.h"
+#include "wiimote.h"
 #include "timer.h"
+#include "trace.h"
 #include "driver/timer.h"
 
 hid_controller_t controllers[8];
 
-const uint8_t rumble_off_data[8] = { 0x00, 0x01, 0x40, 0x40, 0x00, 0x01, 0x40, 0x40 };
-const uint8_t rumble_on_data[8] = { 0x00, 0x00, 0x4B, 0x60, 0x00, 0x00, 0x4B, 0x60 };	// Medium-force rumble using low-band only (about 200 Hz)
 
 const uint8_t ext_id_nunchuk[6] = { 0x00, 0x00, 0xA4, 0x20, 0x00, 0x00 };
 const uint8_t ext_id_classic[6] = { 0x00, 0x00, 0xA4, 0x20, 0x01, 0x01 };
@@ -24,75 +31,288 @@ const uint8_t ext_id_wmp_active[6] = { 0x00, 0x00, 0xA4, 0x20, 0x04, 0x05 };
 const uint8_t ext_id_wmp_nunchuk[6] = { 0x00, 0x00, 0xA4, 0x20, 0x05, 0x05 };
 const uint8_t ext_id_wmp_classic[6] = { 0x00, 0x00, 0xA4, 0x20, 0x07, 0x05 };
 
+// Commands that set the same output state (LEDs, report mode), so only the newest one needs to be sent
+static uint8_t hid_command_is_report_mode(enum CMD_NAME name) {
+	return (name == REPORT_MODE_FULL) || (name == REPORT_MODE_STANDARD) || ((name >= REPORT_MODE_BUTTONS) && (name <= REPORT_MODE_EXT21));
+}
+
+static uint8_t hid_commands_supersede(const hid_command_t * a, const hid_command_t * b) {
+	if ((a->name == SET_PLAYER_LEDS) && (b->name == SET_PLAYER_LEDS)) return 1;
+	return hid_command_is_report_mode(a->name) && hid_command_is_report_mode(b->name);
+}
+
 void hid_queue_command(hid_controller_t * controller, const hid_command_t * command, uint8_t * arg, command_response_cb response_cb, uint8_t response_required) {
-	hid_command_t * cur_command = &controller->command_buffer[(controller->command_buffer_pos + controller->command_queue_num) % 32];
-	memcpy(cur_command, command, sizeof(hid_command_t));
+	hid_queued_command_t * cur_command;
+	uint8_t i;
+
+	if (controller->command_queue_num >= HID_COMMAND_QUEUE_LEN) {
+		printf("Command queue full, command dropped\n");
+		return;
+	}
+	if (arg && (controller->command_arg_used + command->arg_len > HID_COMMAND_ARG_POOL)) {
+		printf("Command argument pool full, command dropped\n");
+		return;
+	}
+
+	// Older queued commands for the same output state are dropped, unless something waits on their response
+	for (i = 0; i < controller->command_queue_num; i++) {
+		cur_command = &controller->command_buffer[(controller->command_buffer_pos + i) % HID_COMMAND_QUEUE_LEN];
+		if (!cur_command->superseded && !cur_command->response_cb && hid_commands_supersede(cur_command->command, command)) cur_command->superseded = 1;
+	}
+
+	cur_command = &controller->command_buffer[(controller->command_buffer_pos + controller->command_queue_num) % HID_COMMAND_QUEUE_LEN];
+	cur_command->command = command;
 	cur_command->response_required = response_required;
 	cur_command->response_cb = response_cb;	// Register callback for response
+	cur_command->has_arg = (arg != NULL);
+	cur_command->superseded = 0;
 
-	// Add command arguments if provided
+	// Hold command arguments until the packet is assembled
 	if (arg) {
-		memcpy(cur_command->cmd + cur_command->arg_offset, arg, cur_command->arg_len);
-		if ((cur_command->arg_offset + cur_command->arg_len) > cur_command->len) cur_command->len += (cur_command->arg_offset + cur_command->arg_len - cur_command->len);
+		cur_command->arg_pos = controller->command_arg_head;
+		for (i = 0; i < command->arg_len; i++) controller->command_args[(controller->command_arg_head + i) & (HID_COMMAND_ARG_POOL - 1)] = arg[i];
+		controller->command_arg_head = (controller->command_arg_head + command->arg_len) & (HID_COMMAND_ARG_POOL - 1);
+		controller->command_arg_used += command->arg_len;
 	}
 
 	controller->command_queue_num++;
 	//printf("%d reports queued\n", controller->command_queue_num);
 }
 
-uint8_t hid_send_next_command(hid_controller_t * controller) {
-	if (controller->command_queue_num) {
-		hid_command_t * command = &controller->command_buffer[controller->command_buffer_pos];
-		switch (controller->type) {
-			case CNT_JOYCON_R:
-			case CNT_JOYCON_L:
-			case CNT_PROCON:
-				if (command->cmd[1] == 0x01 || command->cmd[1] == 0x10) {	// Check if subcommand or rumble command
-					command->cmd[2] = controller->command_packet_count;
-					controller->command_packet_count = (controller->command_packet_count + 1) % 0x10;
-					if (controller->rumble) memcpy(command->cmd + 3, rumble_on_data, 8);
-					else memcpy(command->cmd + 3, rumble_off_data, 8);
-				}
-				break;
-			case CNT_WIIMOTE:
-			case CNT_WIIU_PRO:
-				if (controller->rumble) command->cmd[2] |= 0x01;	// Turn rumble on
-				else command->cmd[2] &= 0xFE;	// Turn rumble off
-				break;
-			default:
-				break;
-		}
+// Standalone rumble jumps ahead of commands still waiting for a response slot
+static void hid_queue_rumble(hid_controller_t * controller, const hid_command_t * command) {
+	hid_queued_command_t * cur_command;
+
+	if (controller->command_queue_num >= HID_COMMAND_QUEUE_LEN) return;
+	controller->command_buffer_pos = (controller->command_buffer_pos + HID_COMMAND_QUEUE_LEN - 1) % HID_COMMAND_QUEUE_LEN;
+	cur_command = &controller->command_buffer[controller->command_buffer_pos];
+	cur_command->command = command;
+	cur_command->response_required = 0;
+	cur_command->response_cb = NULL;
+	cur_command->has_arg = 0;
+	cur_command->superseded = 0;
+	controller->command_queue_num++;
+	controller->output.rumble_queued = 1;
+}
 
-		printf("%llu - ", app_timer);
-		printf_hexdump(command->cmd, command->len);
-		
-		controller->command_send_event_queued = 1;
+// Assemble a queued command from its template and arguments, returns the packet length (arguments stay queued)
+static uint16_t hid_build_command(hid_controller_t * controller, hid_queued_command_t * queued, uint8_t * packet) {
+	const hid_command_t * command = queued->command;
+	uint16_t len = command->len;
+	uint8_t i;
+
+	if (queued->has_arg) {
+		if ((command->arg_offset + command->arg_len) > len) len = command->arg_offset + command->arg_len;
+		memcpy(packet, command->cmd, len);
+		for (i = 0; i < command->arg_len; i++) packet[command->arg_offset + i] = controller->command_args[(queued->arg_pos + i) & (HID_COMMAND_ARG_POOL - 1)];
+	} else memcpy(packet, command->cmd, len);
+	return len;
+}
+
+// Commands whose responses can't be told apart, or whose order matters, are never in flight together
+static uint8_t hid_commands_share_response(hid_controller_t * controller, const uint8_t * a, const uint8_t * b) {
+	switch (controller->type) {
+		case CNT_JOYCON_R:
+		case CNT_JOYCON_L:
+		case CNT_PROCON:
+			if (a[11] != b[11]) return 0;
+			if (a[11] == 0x10) return !memcmp(a + 12, b + 12, 5);	// SPI reads are answered with their address and size
+			return 1;
+		case CNT_WIIMOTE:
+		case CNT_WIIU_PRO:
+			if (((a[1] == 0x16) || (a[1] == 0x17)) && ((b[1] == 0x16) || (b[1] == 0x17))) {	// Register writes and reads stay in order
+				if ((a[1] == 0x17) && (b[1] == 0x17)) return !memcmp(a + 4, b + 4, 2);	// Memory reads are answered with their address
+				return 1;
+			}
+			return a[1] == b[1];
+		default:
+			return 1;
+	}
+}
+
+static hid_pending_command_t * hid_find_resend(hid_controller_t * controller) {
+	uint8_t i;
+	for (i = 0; i < HID_COMMAND_IN_FLIGHT; i++) {
+		if (controller->command_pending[i].command && controller->command_pending[i].resend) return &controller->command_pending[i];
+	}
+	return NULL;
+}
+
+// Superseded commands are removed from the front of the queue without being sent
+static void hid_drop_superseded(hid_controller_t * controller) {
+	hid_queued_command_t * next;
+	while (controller->command_queue_num) {
+		next = &controller->command_buffer[controller->command_buffer_pos];
+		if (!next->superseded) return;
+		if (next->has_arg) controller->command_arg_used -= next->command->arg_len;
+		controller->command_buffer_pos = (controller->command_buffer_pos + 1) % HID_COMMAND_QUEUE_LEN;
 		controller->command_queue_num--;
-		l2cap_request_can_send_now_event(controller->l2cap_interrupt_cid);
-		return 1;
 	}
-	return 0;
+}
+
+// Next queued command may be sent if it doesn't need a response slot or one is free and unambiguous
+static uint8_t hid_next_command_ready(hid_controller_t * controller) {
+	hid_queued_command_t * next;
+	uint8_t packet[30];
+	uint8_t i;
+
+	hid_drop_superseded(controller);
+	if (!controller->command_queue_num) return 0;
+	next = &controller->command_buffer[controller->command_buffer_pos];
+	if (!next->response_required) return 1;
+	if (controller->command_pending_num >= HID_COMMAND_IN_FLIGHT) return 0;
+	hid_build_command(controller, next, packet);	// Arguments may carry the response signature (e.g. flash addresses)
+	for (i = 0; i < HID_COMMAND_IN_FLIGHT; i++) {
+		if (controller->command_pending[i].command && hid_commands_share_response(controller, controller->command_pending[i].packet, packet)) return 0;
+	}
+	return 1;
+}
+
+static void hid_free_pending(hid_controller_t * controller, hid_pending_command_t * pending) {
+	pending->command = NULL;
+	pending->resend = 0;
+	controller->command_pending_num--;
+}
+
+// Packet counter and rumble state are filled in every time a packet goes out (including resends)
+static void hid_stamp_command(hid_controller_t * controller, uint8_t * packet) {
+	switch (controller->type) {
+		case CNT_JOYCON_R:
+		case CNT_JOYCON_L:
+		case CNT_PROCON:
+			if (packet[1] == 0x01 || packet[1] == 0x10) {	// Check if subcommand or rumble command
+				packet[2] = controller->command_packet_count;
+				controller->command_packet_count = (controller->command_packet_count + 1) % 0x10;
+				memcpy(packet + 3, hd_rumble_frames[controller->rumble], 4);	// Left
+				memcpy(packet + 7, hd_rumble_frames[controller->rumble], 4);	// Right
+				controller->output.rumble = controller->rumble;
+				controller->output.rumble_time = app_timer;
+			}
+			break;
+		case CNT_WIIMOTE:
+		case CNT_WIIU_PRO:
+			if (controller->rumble) packet[2] |= 0x01;	// Turn rumble on
+			else packet[2] &= 0xFE;	// Turn rumble off
+			controller->output.rumble = controller->rumble;
+			controller->output.rumble_time = app_timer;
+			break;
+		default:
+			break;
+	}
+}
+
+// Packet is assembled straight into the L2CAP buffer once the channel can send. Resends go first.
+static void hid_send_queued_command(hid_controller_t * controller, uint16_t l2cap_cid) {
+	hid_pending_command_t * pending = hid_find_resend(controller);
+	hid_queued_command_t * queued;
+	uint8_t * packet;
+	uint16_t len;
+	uint8_t i;
+
+	if (!pending && !hid_next_command_ready(controller)) {
+		controller->command_send_event_queued = 0;
+		return;
+	}
+	if (!l2cap_reserve_packet_buffer()) {
+		l2cap_request_can_send_now_event(l2cap_cid);
+		return;
+	}
+	packet = l2cap_get_outgoing_buffer();
+
+	if (pending) {
+		len = pending->len;
+		memcpy(packet, pending->packet, len);
+		pending->resend = 0;
+	} else {
+		queued = &controller->command_buffer[controller->command_buffer_pos];
+		len = hid_build_command(controller, queued, packet);
+		if (queued->command->name == RUMBLE) controller->output.rumble_queued = 0;
+		if (queued->has_arg) controller->command_arg_used -= queued->command->arg_len;
+		controller->command_buffer_pos = (controller->command_buffer_pos + 1) % HID_COMMAND_QUEUE_LEN;
+		controller->command_queue_num--;
+
+		if (queued->response_required) {
+			for (i = 0; controller->command_pending[i].command; i++);	// A free slot is guaranteed by hid_next_command_ready()
+			pending = &controller->command_pending[i];
+			pending->command = queued->command;
+			pending->response_cb = queued->response_cb;
+			pending->retries = 0;
+			pending->resend = 0;
+			pending->len = len;
+			memcpy(pending->packet, packet, len);
+			controller->command_pending_num++;
+		}
+	}
+	if (pending) pending->deadline = app_timer + HID_COMMAND_TIMEOUT;
+
+	hid_stamp_command(controller, packet);
+	trace_packet((controller - controllers) + 1, TRACE_CMD, packet, len);
+	link_policy_output(controller, len);
+	l2cap_send_prepared(l2cap_cid, len);
+	controller->command_send_event_queued = 0;
+}
+
+uint8_t hid_send_next_command(hid_controller_t * controller) {
+	if (controller->command_send_event_queued) return 0;
+	if (!hid_find_resend(controller) && !hid_next_command_ready(controller)) return 0;
+	controller->command_send_event_queued = 1;
+	l2cap_request_can_send_now_event(controller->l2cap_interrupt_cid);
+	return 1;
+}
+
+// Resend commands whose response is overdue, and give up on them after HID_COMMAND_RETRIES
+static void hid_check_command_timeouts(hid_controller_t * controller) {
+	hid_pending_command_t * pending;
+	command_response_cb response_cb;
+	uint8_t i;
+
+	for (i = 0; i < HID_COMMAND_IN_FLIGHT; i++) {
+		pending = &controller->command_pending[i];
+		if (!pending->command || pending->resend || (app_timer < pending->deadline)) continue;
+		if (pending->retries < HID_COMMAND_RETRIES) {
+			pending->retries++;
+			pending->resend = 1;
+			trace_event((controller - controllers) + 1, EVT_CMD_RETRY, pending->command->name);
+		} else {
+			trace_event((controller - controllers) + 1, EVT_CMD_TIMEOUT, pending->command->name);
+			response_cb = pending->response_cb;
+			hid_free_pending(controller, pending);
+
+			// Whatever waits on the response is still told, so setup can go on without it
+			if (response_cb) {
+				memset(controller->command_response, 0, 64);
+				controller->command_response_len = 0;
+				controller->command_failed = 1;
+				response_cb(controller);
+				controller->command_failed = 0;
+			}
+		}
+	}
 }
 
 void hid_get_response(hid_controller_t * controller, uint8_t * response, uint8_t response_size) {
+	command_response_cb response_cb = NULL;
+	uint8_t i;
+
 	if ((response[1] & 0x30) == 0x30) {
-		memset(controller->status_response, 0, 64);
-		memcpy(controller->status_response, response, response_size);
-		controller->status_response_len = response_size;
-		controller->status_response_received = 1;
-		gamepad_get_angles_from_controller(controller);	// Angle calculations performed here to avoid latency
+		latency_l2cap((controller - controllers) + 1, controller->time_report);
+		pipeline_push_report(controller, response, response_size);	// Processed by the pipeline on the other core
+		if (controller->time_connect_request) reconnect_first_report(controller);
+		link_policy_input(controller, response, response_size);
 	} else {
 		memset(controller->command_response, 0, 64);
 		memcpy(controller->command_response, response, response_size);
 		controller->command_response_len = response_size;
-		controller->command_response_received = 1;
-		//printf("Command response received\n");
-		printf("%llu - ", app_timer);
-		printf_hexdump(controller->command_response, controller->command_response_len);
+		trace_packet((controller - controllers) + 1, TRACE_RESPONSE, controller->command_response, controller->command_response_len);
 
-		// Check if new response belongs to previous command
-		if (hid_response_matches_command(controller, &controller->command_buffer[(controller->command_buffer_pos - 1) % 32]))
-			controller->command_response_verified = 1;
+		// Find the command in flight this response belongs to
+		for (i = 0; i < HID_COMMAND_IN_FLIGHT; i++) {
+			if (controller->command_pending[i].command && hid_response_matches_command(controller, &controller->command_pending[i])) {
+				response_cb = controller->command_pending[i].response_cb;
+				hid_free_pending(controller, &controller->command_pending[i]);
+				break;
+			}
+		}
 	}
 
 	switch (controller->type) {
@@ -110,40 +330,45 @@ void hid_get_response(hid_controller_t * controller, uint8_t * response, uint8_t
 			}
 			// Check general extension status (report mode must always be updated here)
 			else if (response[1] == 0x20) {
+				controller->output.report_mode = NULL;	// Wiimote stops reporting after a status report, the mode must be set again
 				if (controller->wmp_type == WMP_NOT_SUPPORTED) controller_detect_extension(controller);
-				else if (controller->wmp_type == WMP_SUPPORTED) hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL, NULL, 1);
-				else hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir12, NULL, NULL, 1);
+				else if (controller->wmp_type == WMP_SUPPORTED) controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL);
+				else controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir12, NULL);
 			}
 			break;
 		default:
 			break;
 	}
+
+	// Use callback once the response is matched
+	if (response_cb) response_cb(controller);
 }
 
-uint8_t hid_response_matches_command(hid_controller_t * controller, hid_command_t * command) {
+uint8_t hid_response_matches_command(hid_controller_t * controller, hid_pending_command_t * pending) {
 	switch (controller->type) {
 		case CNT_JOYCON_R:
 		case CNT_JOYCON_L:
 		case CNT_PROCON:
-			switch (command->name) {
+			switch (pending->command->name) {
 				// SPI flash read commands
+				case READ_FLASH:
 				case READ_CAL_IMU_FACTORY:
 				case READ_CAL_JOY_L_FACTORY:
 				case READ_CAL_JOY_R_FACTORY:
 				case READ_CAL_IMU_USER:
 				case READ_CAL_JOY_L_USER:
 				case READ_CAL_JOY_R_USER:
-					if (!memcmp(controller->command_response + 15, command->cmd + 11, 6)) return 1;
+					if (!memcmp(controller->command_response + 15, pending->packet + 11, 6)) return 1;
 					break;
 				// Standard subcommands
 				default:
-					if (!memcmp(controller->command_response + 15, command->cmd + 11, 1)) return 1;
+					if (!memcmp(controller->command_response + 15, pending->packet + 11, 1)) return 1;
 					break;
 			}
 			break;
 		case CNT_WIIMOTE:
 		case CNT_WIIU_PRO:
-			switch (command->name) {
+			switch (pending->command->name) {
 				// Status command
 				case GET_STATUS:
 					if (controller->command_response[1] == 0x20) return 1;
@@ -154,11 +379,11 @@ uint8_t hid_response_matches_command(hid_controller_t * controller, hid_command_
 				case READ_CAL_EXTENSION:
 				case READ_CAL_WMP:
 				case READ_CAL_ACCEL:
-					if ((controller->command_response[1] == 0x21) && !memcmp(controller->command_response + 5, command->cmd + 4, 2)) return 1;
+					if ((controller->command_response[1] == 0x21) && !memcmp(controller->command_response + 5, pending->packet + 4, 2)) return 1;
 					break;
 				// Standard command response
 				default:
-					if ((controller->command_response[1] == 0x22) && (controller->command_response[4] == command->cmd[1])) return 1;
+					if ((controller->command_response[1] == 0x22) && (controller->command_response[4] == pending->packet[1])) return 1;
 					break;
 			}
 			break;
@@ -173,6 +398,8 @@ void hid_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet,
     uint16_t l2cap_cid;
 	hid_controller_t * controller = NULL;
 
+	app_timer_update();
+
     switch (packet_type) {
 		case HCI_EVENT_PACKET:
 			event = hci_event_packet_get_type(packet);
@@ -181,17 +408,20 @@ void hid_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet,
 				controller = get_controller_from_cid(l2cap_cid);
 				if (controller) {
 					if (controller->command_send_event_queued) {
-						l2cap_send(l2cap_cid, controller->command_buffer[controller->command_buffer_pos].cmd, controller->command_buffer[controller->command_buffer_pos].len);
-						controller->command_buffer_pos = (controller->command_buffer_pos + 1) % 32;
-						controller->command_send_event_queued = 0;
+						hid_send_queued_command(controller, l2cap_cid);
 						//printf("Output report sent\n");
+						if (!controller->command_send_event_queued) controller_process(controller);	// Send next command (possibly before this one's response) without waiting for the loop timer
 					}
 				}
 			}
 			break;
 		case L2CAP_DATA_PACKET:
 			controller = get_controller_from_cid(channel);
-			if (controller) hid_get_response(controller, packet, size);
+			if (controller) {
+				controller->time_report = latency_now();	// Reports are timed from here through to the SPI transfer
+				hid_get_response(controller, packet, size);
+				controller_process(controller);
+			}
 			break;
         default:
             break;
@@ -268,8 +498,8 @@ void get_controllers_from_gamepad(uint8_t gamepad_num, hid_controller_t ** contr
 hid_controller_t * register_controller(enum HID_DEVICE controller_type, uint8_t * addr) {
 	if (get_controller_from_addr(addr)) return NULL;	// Controller with this address already registered
 	
-	if (controller_type == CNT_NONE) controller_type = get_controller_type(addr);
-	else store_controller_type(controller_type, addr);
+	if (controller_type == CNT_NONE) controller_type = registry_get_type(addr);
+	else registry_set_type(controller_type, addr);
 	if (controller_type == CNT_NONE) return NULL;	// No controller type found for this address
 
 	uint8_t i, gamepad_num, is_second_joycon = 0;
@@ -297,17 +527,15 @@ hid_controller_t * register_controller(enum HID_DEVICE controller_type, uint8_t
 		}
 	}
 
-	printf("Registering new controller with gamepad %d\n", gamepad_num);
 	for (i = 0; i < 8; i++) {
 		if (!controllers[i].registered && gamepad_num <= 4) {
+			trace_event(i + 1, EVT_REGISTERED, gamepad_num);
 			controller_reset(&controllers[i]);
 			memcpy(controllers[i].address, addr, 6);
 			controllers[i].type = controller_type;
 			controllers[i].gamepad_num = gamepad_num;
 			controllers[i].registered = 1;
-			if (!is_second_joycon) gamepad_reset(&gamepads[gamepad_num - 1]);	// Do not erase gamepad settings if another Joy-Con is actively using it
-			gamepad_set_type(gamepad_num);
-			gamepad_set_extension(gamepad_num);
+			pipeline_reset_gamepad(gamepad_num, !is_second_joycon);	// Do not erase gamepad settings if another Joy-Con is actively using it
 			return &controllers[i];
 		}
 	}
@@ -316,8 +544,9 @@ hid_controller_t * register_controller(enum HID_DEVICE controller_type, uint8_t
 
 // Called when WMP is activated
 static void controller_activate_motion_plus_cb(hid_controller_t * controller) {
+	if (controller->command_failed) return;
 	controller->wmp_active = 1;
-	printf("WMP activated\n");
+	trace_event((controller - controllers) + 1, EVT_WMP_ACTIVATED, 0);
 }
 
 // Called when Wiimote or WMP reports extension change/general status
@@ -328,17 +557,17 @@ void controller_detect_extension(hid_controller_t * controller) {
 				hid_queue_command(controller, &cmd_wiimote_setup_extension_1, NULL, NULL, 1);
 				hid_queue_command(controller, &cmd_wiimote_setup_extension_2, NULL, NULL, 1);
 				hid_queue_command(controller, &cmd_wiimote_read_extension_id, NULL, &controller_setup_extension, 1);
-				hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL, NULL, 1);
-				printf("Extension plugged in\n");
+				controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL);
+				trace_event((controller - controllers) + 1, EVT_EXT_PLUGGED, 0);
 			} 
-			else hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir12, NULL, NULL, 1);
+			else controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir12, NULL);
 		} else {
 			if (!(controller->command_response[4] & 0x02)) {
 				controller->extension_type = EXT_NONE;
-				hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir12, NULL, NULL, 1);
-				printf("Extension unplugged\n");
+				controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir12, NULL);
+				trace_event((controller - controllers) + 1, EVT_EXT_UNPLUGGED, 0);
 			} 
-			else hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL, NULL, 1);
+			else controller_set_report_mode(controller, &cmd_wiimote_report_mode_acc_ir10_ext6, NULL);
 		}
 	} else if (controller->wmp_type == WMP_SUPPORTED) {
 		if (controller->extension_type == EXT_NONE) {
@@ -346,19 +575,20 @@ void controller_detect_extension(hid_controller_t * controller) {
 			hid_queue_command(controller, &cmd_wiimote_setup_extension_1, NULL, NULL, 1);	// Disable WMP to read extension information
 			hid_queue_command(controller, &cmd_wiimote_setup_extension_2, NULL, NULL, 1);
 			hid_queue_command(controller, &cmd_wiimote_read_extension_id, NULL, &controller_setup_extension, 1);	// Reactivate WMP in callback 
-			printf("Extension plugged in (WMP)\n");
+			trace_event((controller - controllers) + 1, EVT_EXT_PLUGGED, 1);
 		} else {
 			controller->extension_type = EXT_NONE;
 			controller->wmp_active = 0;
 			hid_queue_command(controller, &cmd_wiimote_setup_extension_1, NULL, NULL, 1);	// Disable WMP to read extension information
 			hid_queue_command(controller, &cmd_wiimote_activate_wmp, NULL, &controller_activate_motion_plus_cb, 1);	// Rectivate WMP with no passthrough
-			printf("Extension unplugged (WMP)\n");
+			trace_event((controller - controllers) + 1, EVT_EXT_UNPLUGGED, 1);
 		}
 	}
 }
 
 // Called when Wiimote responds with extension ID
 void controller_setup_extension(hid_controller_t * controller) {
+	if (!controller->command_failed) controller->cal_cache_dirty = 1;	// An unread ID is treated as an unsupported extension
 	if (!memcmp(controller->command_response + 7, ext_id_nunchuk, 6)) {
 		controller->extension_type = EXT_NUNCHUK;
 		hid_queue_command(controller, &cmd_wiimote_read_cal_extension, NULL, &gamepad_set_cal_nunchuk, 1);
@@ -374,79 +604,111 @@ void controller_setup_extension(hid_controller_t * controller) {
 	}
 }
 
-// Called when Wiimote responds with WMP ID
-void controller_setup_motion_plus(hid_controller_t * controller) {
-	if (!memcmp(controller->command_response + 11, ext_id_wmp_inactive + 4, 2)) {
-		controller->wmp_type = WMP_SUPPORTED;
+// Sets up WMP once its presence is known, from the ID read or the calibration cache
+static void controller_start_motion_plus(hid_controller_t * controller, enum WMP_TYPE wmp_type, uint8_t read_cal) {
+	controller->wmp_type = wmp_type;
+	if (wmp_type == WMP_SUPPORTED) {
 		hid_queue_command(controller, &cmd_wiimote_setup_wmp, NULL, NULL, 1);
-		hid_queue_command(controller, &cmd_wiimote_read_cal_wmp, NULL, &gamepad_set_cal_gyro_r, 1);
+		if (read_cal) hid_queue_command(controller, &cmd_wiimote_read_cal_wmp, NULL, &gamepad_set_cal_gyro_r, 1);
 		hid_queue_command(controller, &cmd_wiimote_activate_wmp, NULL, &controller_activate_motion_plus_cb, 1);
-		printf("Wii Motion Plus found\n");
+		trace_event((controller - controllers) + 1, EVT_WMP_FOUND, !read_cal);
 	} else {
-		controller->wmp_type = WMP_NOT_SUPPORTED;
 		hid_queue_command(controller, &cmd_wiimote_get_status, NULL, NULL, 1);	// Check for extension missed during setup
-		printf("Wii Motion Plus not found\n");
+		trace_event((controller - controllers) + 1, EVT_WMP_NOT_FOUND, !read_cal);
 	}
 }
 
+// Called when Wiimote responds with WMP ID
+void controller_setup_motion_plus(hid_controller_t * controller) {
+	if (controller->command_failed) {
+		controller->cal_cache_dirty = 0;	// Leave WMP undetermined and uncached, the next connection reads the ID again
+		return;
+	}
+	if (!memcmp(controller->command_response + 11, ext_id_wmp_inactive + 4, 2)) controller_start_motion_plus(controller, WMP_SUPPORTED, 1);
+	else controller_start_motion_plus(controller, WMP_NOT_SUPPORTED, 1);
+}
+
+// Report mode is only queued when it changes, or when a callback waits on it
+void controller_set_report_mode(hid_controller_t * controller, const hid_command_t * report_mode, command_response_cb response_cb) {
+	if ((controller->output.report_mode == report_mode) && !response_cb) return;
+	controller->output.report_mode = report_mode;
+	hid_queue_command(controller, report_mode, NULL, response_cb, 1);
+}
+
 void controller_set_leds(hid_controller_t * controller, uint8_t player_num) {
-	if (controller->player_num != player_num) {
+	if (controller->output.player_num != player_num) {
 		switch (controller->type) {
 			case CNT_JOYCON_R:
 			case CNT_JOYCON_L:
 			case CNT_PROCON:
 				switch (player_num) {
-					case 1: controller->led_state = 0x01;
+					case 1: controller->output.led_state = 0x01;
 						break;
-					case 2: controller->led_state = 0x03;
+					case 2: controller->output.led_state = 0x03;
 						break;
-					case 3: controller->led_state = 0x07;
+					case 3: controller->output.led_state = 0x07;
 						break;
-					case 4: controller->led_state = 0x0F;
+					case 4: controller->output.led_state = 0x0F;
 						break;
-					default: controller->led_state = 0x00;
+					default: controller->output.led_state = 0x00;
 						break;
 				}
-				hid_queue_command(controller, &cmd_joycon_set_player_leds, &controller->led_state, NULL, 1);
+				hid_queue_command(controller, &cmd_joycon_set_player_leds, &controller->output.led_state, NULL, 1);
 				break;
 			case CNT_WIIMOTE:
 			case CNT_WIIU_PRO:
 				switch (player_num) {
-					case 1: controller->led_state = 0x12;
+					case 1: controller->output.led_state = 0x12;
 						break;
-					case 2: controller->led_state = 0x22;
+					case 2: controller->output.led_state = 0x22;
 						break;
-					case 3: controller->led_state = 0x42;
+					case 3: controller->output.led_state = 0x42;
 						break;
-					case 4: controller->led_state = 0x82;
+					case 4: controller->output.led_state = 0x82;
 						break;
-					default: controller->led_state = 0x02;
+					default: controller->output.led_state = 0x02;
 						break;
 				}
-				hid_queue_command(controller, &cmd_wiimote_set_player_leds, &controller->led_state, NULL, 1);
+				hid_queue_command(controller, &cmd_wiimote_set_player_leds, &controller->output.led_state, NULL, 1);
 				break;
 			default:
 				break;
 		}
-		controller->player_num = player_num;
+		controller->output.player_num = player_num;
 	}
 }
 
-void controller_rumble(hid_controller_t * controller, uint8_t enable) {
-	controller->rumble = enable & 0x01;
-	switch(controller->type) {
+// Rumble rides on the next outgoing packet, a standalone rumble packet is only sent when nothing else is ready to go
+static void controller_rumble_update(hid_controller_t * controller) {
+	uint8_t keep_alive = 0;
+
+	switch (controller->type) {
 		case CNT_JOYCON_R:
 		case CNT_JOYCON_L:
 		case CNT_PROCON:
-			if (!controller->command_queue_num) hid_queue_command(controller, &cmd_joycon_rumble, NULL, NULL, 0);
+			keep_alive = controller->rumble && (app_timer - controller->output.rumble_time >= RUMBLE_KEEPALIVE);
 			break;
 		case CNT_WIIMOTE:
 		case CNT_WIIU_PRO:
-			if (!controller->command_queue_num) hid_queue_command(controller, &cmd_wiimote_rumble, NULL, NULL, 0);
 			break;
 		default:
-			break;
+			return;
+	}
+	if ((controller->rumble == controller->output.rumble) && !keep_alive) return;
+	if (controller->output.rumble_queued) return;
+
+	if (!hid_find_resend(controller) && !hid_next_command_ready(controller)) {
+		if (app_timer - controller->output.rumble_time < RUMBLE_MIN_INTERVAL) return;	// Fast pulses are merged, the latest level goes out next
+		if ((controller->type == CNT_WIIMOTE) || (controller->type == CNT_WIIU_PRO)) hid_queue_rumble(controller, &cmd_wiimote_rumble);
+		else hid_queue_rumble(controller, &cmd_joycon_rumble);
 	}
+	hid_send_next_command(controller);
+}
+
+// Level 0 is off, Wiimotes only rumble on or off
+void controller_rumble(hid_controller_t * controller, uint8_t level) {
+	controller->rumble = (level < HD_RUMBLE_LEVELS) ? level : HD_RUMBLE_LEVEL_MAX;
+	if (controller->connected) controller_rumble_update(controller);
 }
 
 // Patterns started when other commands are queued may have altered timing
@@ -458,7 +720,7 @@ void controller_rumble_pattern(hid_controller_t * controller, uint16_t on_period
 		controller->rumble_pattern_timer = app_timer;
 
 		// Begin pattern
-		controller_rumble(controller, 1);
+		controller_rumble(controller, HD_RUMBLE_LEVEL_DEFAULT);
 		controller->rumble_pattern_repetitions--;
 	}
 }
@@ -483,17 +745,6 @@ void controller_connect_rumble(hid_controller_t * controller) {
 }
 
 void controller_rumble_handle(hid_controller_t * controller) {
-	switch (controller->type) {
-		case CNT_JOYCON_R:
-		case CNT_JOYCON_L:
-		case CNT_PROCON:
-			if (controller->rumble && !controller->command_queue_num && (app_timer % 250 <= 5)) 
-				hid_queue_command(controller, &cmd_joycon_rumble, NULL, NULL, 0);	// Keep rumble on
-			break;
-		default:
-			break;
-	}
-
 	if (controller->rumble_pattern_repetitions) {
 		if ((controller->rumble_pattern_repetitions % 2 == 1) && (app_timer - controller->rumble_pattern_timer >= controller->rumble_pattern_on_period)) {
 			controller_rumble(controller, 0);	// Turn rumble off
@@ -501,43 +752,84 @@ void controller_rumble_handle(hid_controller_t * controller) {
 			controller->rumble_pattern_timer = app_timer;
 		}
 		else if ((controller->rumble_pattern_repetitions % 2 == 0) && (app_timer - controller->rumble_pattern_timer >= controller->rumble_pattern_off_period)) {
-			controller_rumble(controller, 1);	// Turn rumble on
+			controller_rumble(controller, HD_RUMBLE_LEVEL_DEFAULT);	// Turn rumble on
 			controller->rumble_pattern_repetitions--;
 			controller->rumble_pattern_timer = app_timer;
 		}
 	}
+
+	controller_rumble_update(controller);	// Changes not sent yet and keep-alive
+}
+
+// Stop IMU streaming while the Wii has no use for motion data, and restart it once needed
+void controller_imu_handle(hid_controller_t * controller) {
+	uint8_t required;
+
+	switch (controller->type) {
+		case CNT_JOYCON_R:
+		case CNT_JOYCON_L:
+		case CNT_PROCON:
+			if (controller->command_queue_num || controller->command_pending_num) return;	// Wait for setup and other commands to finish
+			required = wiimote_motion_required(controller->gamepad_num) || gamepads[controller->gamepad_num - 1].calibrating;
+			if (required) controller->imu_timer = app_timer;
+
+			if (required && !controller->imu_enabled) {
+				hid_queue_command(controller, &cmd_joycon_enable_imu, NULL, NULL, 1);
+				controller->imu_enabled = 1;
+				trace_event((controller - controllers) + 1, EVT_IMU_ENABLED, controller->gamepad_num);
+			}
+			else if (!required && controller->imu_enabled && (app_timer - controller->imu_timer >= IMU_IDLE_TIME)) {
+				hid_queue_command(controller, &cmd_joycon_disable_imu, NULL, NULL, 1);
+				controller->imu_enabled = 0;
+				trace_event((controller - controllers) + 1, EVT_IMU_DISABLED, controller->gamepad_num);
+			}
+			break;
+		default:
+			break;
+	}
 }
 
-// Called on loop to handle outgoing/incoming commands
+// Handles outgoing/incoming commands
 void controller_handle(uint8_t controller_num) {
 	hid_controller_t * controller = &controllers[controller_num - 1];
 	if (controller->connected) {
-		controller_rumble_handle(controller);
-		
 		// Log time of connection for new connection
 		if (controller->time_connected == 0) controller->time_connected = app_timer;
 		
-		// Check for command responses and send commands
-		// TODO: Set timeout for when proper response isn't received
-		if (!controller->command_send_event_queued) {
-			hid_command_t * prev_command = &controller->command_buffer[(controller->command_buffer_pos - 1) % 32];
-			if (prev_command->response_required) {
-				if (controller->command_response_verified) {
-					// Use callback when verified response is received
-					if (prev_command->response_cb) {
-						prev_command->response_cb(controller);
-						prev_command->response_cb = NULL;
-					}
-					// Response is no longer valid when next command is sent
-					if (hid_send_next_command(controller)) controller->command_response_verified = 0;
-				}	
-			} else hid_send_next_command(controller);
+		// Responses are matched as they arrive, only timeouts and sending are handled here
+		hid_check_command_timeouts(controller);
+		hid_send_next_command(controller);
+	}
+}
+
+// Called on loop for time-based controller work and commands queued outside of controller events
+void controller_timer_handle(uint8_t controller_num) {
+	hid_controller_t * controller = &controllers[controller_num - 1];
+	if (controller->connected) {
+		controller_rumble_handle(controller);
+		controller_imu_handle(controller);
+		controller_handle(controller_num);
+		link_policy_handle(controller);
+
+		if (controller->cal_cache_dirty && !controller->command_queue_num && !controller->command_pending_num) {
+			controller->cal_cache_dirty = 0;
+			cal_cache_store(controller);
 		}
 	}
 }
 
+// Called when a controller has new data or can send again, so nothing waits for the loop timer
+void controller_process(hid_controller_t * controller) {
+	controller_handle((controller - controllers) + 1);
+}
+
 // Called once upon connection
 void controller_setup(hid_controller_t * controller) {
+	cal_cache_record_t record;
+	uint8_t cached = cal_cache_load(controller, &record);
+
+	if (cached) trace_event_data((controller - controllers) + 1, EVT_CAL_FROM_CACHE, controller->address, 6);
+	controller->cal_cache_dirty = 1;	// Stored once setup commands are done (only written if changed)
 	switch (controller->type) {
 		case CNT_JOYCON_R:
 		case CNT_JOYCON_L:
@@ -547,25 +839,30 @@ void controller_setup(hid_controller_t * controller) {
 				hid_queue_command(controller, &cmd_joycon_pair_get_key, NULL, &store_link_key, 1);
 				hid_queue_command(controller, &cmd_joycon_pair_save_key, NULL, &end_pair, 1);
 			}
-			hid_queue_command(controller, &cmd_joycon_read_cal_imu_user, NULL, &gamepad_set_cal_imu, 1);
-			hid_queue_command(controller, &cmd_joycon_read_cal_joy_r_user, NULL, &gamepad_set_cal_joy_r, 1);
-			hid_queue_command(controller, &cmd_joycon_read_cal_joy_l_user, NULL, &gamepad_set_cal_joy_l, 1);
+			if (cached) gamepad_set_cal_cached(controller, &record.cal);
+			else flash_cal_load(controller);	// User and factory calibration in as few flash reads as possible
 			hid_queue_command(controller, &cmd_joycon_enable_imu, NULL, NULL, 1);
+			controller->imu_enabled = 1;
+			controller->imu_timer = app_timer;
 			hid_queue_command(controller, &cmd_joycon_enable_rumble, NULL, NULL, 1);
 			//controller_set_leds(controller, controller->gamepad_num);
-			hid_queue_command(controller, &cmd_joycon_report_mode_full, NULL, &controller_connect_rumble, 1);
+			controller_set_report_mode(controller, &cmd_joycon_report_mode_full, &controller_connect_rumble);
+			if (cached) flash_cal_load(controller);	// Refresh the cached calibration once input is already flowing
 			break;
 		case CNT_WIIMOTE:
 			if (controller->pairing) end_pair(controller);	// Pin code pairing occurs in HCI event handler
 			//hid_queue_command(controller, &cmd_wiimote_report_mode_acc_ir12, NULL, NULL, 1);
-			hid_queue_command(controller, &cmd_wiimote_read_wmp_id, NULL, &controller_setup_motion_plus, 1);	// Check for WMP
-			hid_queue_command(controller, &cmd_wiimote_read_cal_accel, NULL, &gamepad_set_cal_accel_r, 1);
+			if (cached) gamepad_set_cal_cached(controller, &record.cal);
+			if (cached && (record.wmp_type == WMP_SUPPORTED)) controller_start_motion_plus(controller, WMP_SUPPORTED, 0);	// WMP calibration comes from the cache
+			else hid_queue_command(controller, &cmd_wiimote_read_wmp_id, NULL, &controller_setup_motion_plus, 1);	// Check for WMP, a cached absence is checked again
+			if (!cached) hid_queue_command(controller, &cmd_wiimote_read_cal_accel, NULL, &gamepad_set_cal_accel_r, 1);
 			//controller_set_leds(controller, controller->gamepad_num);
 			hid_queue_command(controller, &cmd_wiimote_get_status, NULL, &controller_connect_rumble, 1);
+			if (cached) hid_queue_command(controller, &cmd_wiimote_read_cal_accel, NULL, &gamepad_set_cal_accel_r, 1);	// Refresh in the background
 			break;
 		case CNT_WIIU_PRO:
 			if (controller->pairing) end_pair(controller);	// Pin code pairing occurs in HCI event handler
-			hid_queue_command(controller, &cmd_wiimote_report_mode_ext21, NULL, NULL, 1);
+			controller_set_report_mode(controller, &cmd_wiimote_report_mode_ext21, NULL);
 			//controller_set_leds(controller, controller->gamepad_num);
 			hid_queue_command(controller, &cmd_wiimote_get_status, NULL, &controller_connect_rumble, 1);
 		default:
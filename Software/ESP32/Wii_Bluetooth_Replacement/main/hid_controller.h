@@ -1,9 +1,22 @@
 #ifndef _HID_CONTROLLER_H_
 #define	_HID_CONTROLLER_H_
 
+#include "flash_cal.h"
+#include "link_policy.h"
+
 #define HID_CONTROL_PSM 0x0011
 #define HID_INTERRUPT_PSM 0x0013
 
+#define IMU_IDLE_TIME 2000	// Time (ms) motion data must go unused by the Wii before IMU streaming is stopped
+
+#define HID_COMMAND_QUEUE_LEN 64	// Queued commands per controller
+#define HID_COMMAND_ARG_POOL 64		// Argument bytes held for queued commands (power of two)
+#define HID_COMMAND_IN_FLIGHT 4		// Commands awaiting a response at the same time (their responses must be distinguishable)
+#define HID_COMMAND_TIMEOUT 100		// Time (ms) to wait for a response before resending
+#define HID_COMMAND_RETRIES 3		// Resends before a command is given up on
+
+#define RUMBLE_KEEPALIVE 200	// Time (ms) after which Joy-Con/Pro Controller rumble is resent to keep it on
+
 // Forward declarations
 typedef struct hid_controller_t hid_controller_t;
 typedef struct hid_command_t hid_command_t;
@@ -11,9 +24,9 @@ typedef struct hid_command_t hid_command_t;
 typedef void (*command_response_cb)(hid_controller_t*);
 
 enum CMD_NAME { // Joy-Con command names
-				REPORT_MODE_FULL, REPORT_MODE_STANDARD, ENABLE_IMU, GET_DEVICE_INFO, 
+				REPORT_MODE_FULL, REPORT_MODE_STANDARD, ENABLE_IMU, DISABLE_IMU, GET_DEVICE_INFO, 
 				READ_CAL_IMU_FACTORY, READ_CAL_JOY_L_FACTORY, READ_CAL_JOY_R_FACTORY, 
-				READ_CAL_IMU_USER, READ_CAL_JOY_L_USER, READ_CAL_JOY_R_USER, 
+				READ_CAL_IMU_USER, READ_CAL_JOY_L_USER, READ_CAL_JOY_R_USER, READ_FLASH, 
 				WRITE_CAL_IMU_USER, WRITE_CAL_JOY_L_USER, WRITE_CAL_JOY_R_USER, 
 				RESET_PAIR_INFO, PAIR_BEGIN, PAIR_GET_KEY, PAIR_SAVE_KEY, ENABLE_RUMBLE,
 
@@ -28,14 +41,43 @@ enum CMD_NAME { // Joy-Con command names
 				SET_PLAYER_LEDS, RUMBLE };
 struct hid_command_t {
     enum CMD_NAME name;
-    uint8_t response_required;
-    command_response_cb response_cb;
     uint8_t len;
 	uint8_t arg_len;
 	uint8_t arg_offset;
     uint8_t cmd[30];
 };
 
+// Queue entry referring to a const command template, the packet is only assembled when it can be sent
+typedef struct {
+	const hid_command_t * command;
+	command_response_cb response_cb;
+	uint8_t response_required;
+	uint8_t has_arg;
+	uint8_t arg_pos;	// Start of the arguments in command_args
+	uint8_t superseded;	// A later command sets the same output state, dropped instead of sent
+} hid_queued_command_t;
+
+// Sent command awaiting its response, the packet is kept for resending
+typedef struct {
+	const hid_command_t * command;	// NULL if the slot is free
+	command_response_cb response_cb;
+	uint64_t deadline;
+	uint8_t retries;
+	uint8_t resend;
+	uint8_t len;
+	uint8_t packet[30];
+} hid_pending_command_t;
+
+// Output state last handed to the command queue, so only real changes turn into commands
+typedef struct {
+	uint8_t player_num;
+	uint8_t led_state;	// Different controllers use different bits for LEDs
+	const hid_command_t * report_mode;	// NULL if unknown
+	uint8_t rumble;	// Rumble level of the last packet sent
+	uint64_t rumble_time;
+	uint8_t rumble_queued;	// Standalone rumble packet waiting to be sent
+} hid_output_state_t;
+
 enum EXTENSION_TYPE { EXT_NONE = 0, EXT_NUNCHUK = 1, EXT_CLASSIC = 2, EXT_UNSUPPORTED = 3 };
 enum WMP_TYPE { WMP_UNDETERMINED, WMP_NOT_SUPPORTED, WMP_SUPPORTED };
 enum HID_DEVICE { CNT_NONE = 0, CNT_JOYCON_R = 1, CNT_JOYCON_L = 2, CNT_PROCON = 3, CNT_WIIMOTE = 4, CNT_WIIU_PRO = 5 };
@@ -49,11 +91,15 @@ struct hid_controller_t {
 	uint16_t l2cap_interrupt_cid;
 	uint8_t connected;
 	uint32_t time_connected;
+	uint64_t time_connect_request;	// Reconnect timing, 0 once the first input report arrived
+	uint64_t time_connect_acl;
+	uint64_t time_connect_hid;
+	uint64_t time_report;	// Arrival time (us) of the latest L2CAP packet
+	link_policy_t link;
 	uint8_t pairing;
 
 	uint8_t gamepad_num;
-	uint8_t player_num;
-	uint8_t led_state;	// Different controllers use different bits for LEDs
+	hid_output_state_t output;
 
 	// For Wiimotes only
 	enum EXTENSION_TYPE extension_type;
@@ -67,24 +113,32 @@ struct hid_controller_t {
 	uint8_t cal_gyro_l_type;
 	uint8_t cal_joy_r_type;
 	uint8_t cal_joy_l_type;
+	flash_cal_t flash_cal;
+	uint8_t cal_cache_dirty;	// Calibration may have changed, stored once commands are idle
 
-	uint8_t rumble;
+	uint8_t rumble;	// Desired rumble level (0 = off)
 	uint16_t rumble_pattern_on_period;
 	uint16_t rumble_pattern_off_period;
 	uint8_t rumble_pattern_repetitions;
 	uint64_t rumble_pattern_timer;
+
+	uint8_t imu_enabled;
+	uint64_t imu_timer;	// Last time motion data was used by the Wii
 	
-	uint8_t status_response[64];	// Holds status responses (button/axis data)
+	uint8_t status_response[64];	// Holds status responses (button/axis data), only accessed by the pipeline
 	uint8_t status_response_len;
 	uint8_t command_response[64];	// Holds general command responses
 	uint8_t command_response_len;
-	uint8_t status_response_received;	// Set when status is received, cleared when status is processed
-	uint8_t command_response_received;	// Set when command response is received, cleared when data is processed
-	uint8_t command_response_verified;	// Set when response is confirmed to match the previous command
+	uint8_t command_failed;	// Set while a response callback runs for a command that was given up on (command_response is empty)
 
-	hid_command_t command_buffer[32];	// Holds queued commands
-	uint8_t command_buffer_pos;
+	hid_queued_command_t command_buffer[HID_COMMAND_QUEUE_LEN];	// Holds queued commands
+	uint8_t command_buffer_pos;	// Next command to be sent
 	uint8_t command_queue_num;
+	hid_pending_command_t command_pending[HID_COMMAND_IN_FLIGHT];
+	uint8_t command_pending_num;
+	uint8_t command_args[HID_COMMAND_ARG_POOL];	// Arguments of queued commands, consumed in queue order
+	uint8_t command_arg_head;
+	uint8_t command_arg_used;
 	uint8_t command_send_event_queued;
 	uint8_t command_packet_count;
 };
@@ -93,7 +147,7 @@ struct hid_controller_t {
 void hid_queue_command(hid_controller_t * controller, const hid_command_t * command, uint8_t * arg, command_response_cb response_cb, uint8_t response_required);
 uint8_t hid_send_next_command(hid_controller_t * controller);
 void hid_get_response(hid_controller_t * controller, uint8_t * response, uint8_t response_size);
-uint8_t hid_response_matches_command(hid_controller_t * controller, hid_command_t * command);
+uint8_t hid_response_matches_command(hid_controller_t * controller, hid_pending_command_t * pending);
 void hid_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
 // Controller handling
@@ -107,12 +161,16 @@ hid_controller_t * register_controller(enum HID_DEVICE controller_type, uint8_t
 void controller_detect_extension(hid_controller_t * controller);
 void controller_setup_extension(hid_controller_t * controller);
 void controller_setup_motion_plus(hid_controller_t * controller);
+void controller_set_report_mode(hid_controller_t * controller, const hid_command_t * report_mode, command_response_cb response_cb);
 void controller_set_leds(hid_controller_t * controller, uint8_t player_num);
-void controller_rumble(hid_controller_t * controller, uint8_t enable);
+void controller_rumble(hid_controller_t * controller, uint8_t level);
 void controller_rumble_pattern(hid_controller_t * controller, uint16_t on_period, uint16_t off_period, uint8_t repetitions);
 void controller_rumble_handle(hid_controller_t * controller);
+void controller_imu_handle(hid_controller_t * controller);
 void controller_setup(hid_controller_t * controller);
 void controller_handle(uint8_t controller_num);
+void controller_timer_handle(uint8_t controller_num);
+void controller_process(hid_controller_t * controller);
 void controller_disconnect(hid_controller_t * controller);
 
 #endif
\ No newline at end of file
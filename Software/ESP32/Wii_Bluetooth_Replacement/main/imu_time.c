@@ -0,0 +1,34 @@
+#include <inttypes.h>
+#include <string.h>
+#include "imu_time.h"
+
+void imu_time_reset(imu_time_t * imu_time) {
+    memset(imu_time, 0, sizeof(imu_time_t));
+}
+
+// Fills sample_time (local us, newest first like the report) and returns 0 if the report is a repeat
+uint8_t imu_time_update(imu_time_t * imu_time, uint8_t timer, uint64_t arrival_time, uint64_t sample_time[IMU_SAMPLES_PER_REPORT]) {
+    uint8_t ticks = timer - imu_time->last_timer;   // Wraps with the timer byte
+    int64_t offset;
+    uint8_t i;
+
+    if (!imu_time->initialized || ticks > IMU_TIMER_MAX_GAP) {
+        imu_time->initialized = 1;
+        imu_time->device_time = arrival_time;
+        imu_time->offset = 0;
+    } else {
+        if (ticks == 0) return 0;
+        if (ticks > IMU_SAMPLES_PER_REPORT) imu_time->lost_reports += (ticks - 1) / IMU_SAMPLES_PER_REPORT;
+        imu_time->device_time += ticks * IMU_TIMER_TICK_US;
+
+        // Arrival = device time + latency, so the smallest difference is the best estimate of the clock offset
+        offset = (int64_t)(arrival_time - imu_time->device_time);
+        if (offset < imu_time->offset) imu_time->offset = offset;
+        else imu_time->offset += (offset - imu_time->offset) / IMU_OFFSET_LEAK;
+    }
+    imu_time->last_timer = timer;
+
+    for (i = 0; i < IMU_SAMPLES_PER_REPORT; i++)
+        sample_time[i] = imu_time->device_time + imu_time->offset - (i * IMU_TIMER_TICK_US);
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _IMU_TIME_H_
+#define	_IMU_TIME_H_
+
+#include <stdint.h>
+
+// Rebuilds the time each Joy-Con IMU sample was taken from the report timer byte, so radio jitter doesn't reach the integration
+#define IMU_TIMER_TICK_US       5000    // Joy-Con timer byte advances once per IMU sample
+#define IMU_SAMPLES_PER_REPORT  3
+#define IMU_TIMER_MAX_GAP       100     // Ticks skipped before the time base is rebuilt from arrival times
+#define IMU_OFFSET_LEAK         64      // Rising latency is followed at 1/64 of the difference per report (tracks clock drift)
+
+typedef struct {
+    uint8_t initialized;
+    uint8_t last_timer;
+    uint64_t device_time;   // Unwrapped Joy-Con time (us) of the newest sample
+    int64_t offset;         // Local time minus device time, lowest latency seen
+    uint32_t lost_reports;
+} imu_time_t;
+
+void imu_time_reset(imu_time_t * imu_time);
+uint8_t imu_time_update(imu_time_t * imu_time, uint8_t timer, uint64_t arrival_time, uint64_t sample_time[IMU_SAMPLES_PER_REPORT]);
+
+#endif
\ No newline at end of file
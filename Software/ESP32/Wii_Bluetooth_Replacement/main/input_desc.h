@@ -0,0 +1,239 @@
+#ifndef _INPUT_DESC_H_
+#define	_INPUT_DESC_H_
+
+#include <stdint.h>
+
+// Input report layouts for every supported controller. Each table is an X-macro that the gamepad parsers expand
+// into straight-line code, so adding a controller or report type only needs a new table.
+//
+// SET(group, field, byte, bit, width, shift, flags) assigns bits [bit, bit + width) of the report starting at byte,
+// shifted left by shift. OR(...) takes the same arguments and adds more bits to a field already SET.
+// Calibration, button events and axis remapping are applied by the parser afterwards.
+
+#define DESC_INVERT 0x01    // Active low bits
+#define DESC_SIGNED 0x02    // Sign extend from width bits
+
+// All arguments are constants, so this folds into a few shifts and masks per field
+#define DESC_READ(data, byte, bit, width, shift, flags) \
+    ((int32_t)(((((flags) & DESC_SIGNED) ? \
+        (((int32_t)(desc_bits((data), (byte), (bit), (width), (flags)) << (32 - (width)))) >> (32 - (width))) : \
+        (int32_t)desc_bits((data), (byte), (bit), (width), (flags)))) << (shift)))
+
+static inline uint32_t desc_bits(const uint8_t * data, uint8_t byte, uint8_t bit, uint8_t width, uint8_t flags) {
+    uint32_t raw = data[byte];
+    if (bit + width > 8) raw |= data[byte + 1] << 8;
+    if (bit + width > 16) raw |= data[byte + 2] << 16;
+    if (flags & DESC_INVERT) raw = ~raw;
+    return (raw >> bit) & ((1UL << width) - 1);
+}
+
+// Joy-Con (R) and the right half of the Pro Controller, report 0x30
+#define DESC_JOYCON_R_30(SET, OR) \
+    SET(buttons, y,         4, 0, 1, 0, 0) \
+    SET(buttons, x,         4, 1, 1, 0, 0) \
+    SET(buttons, b,         4, 2, 1, 0, 0) \
+    SET(buttons, a,         4, 3, 1, 0, 0) \
+    SET(buttons, srr,       4, 4, 1, 0, 0) \
+    SET(buttons, slr,       4, 5, 1, 0, 0) \
+    SET(buttons, r,         4, 6, 1, 0, 0) \
+    SET(buttons, zr,        4, 7, 1, 0, 0) \
+    SET(buttons, plus,      5, 1, 1, 0, 0) \
+    SET(buttons, rs,        5, 2, 1, 0, 0) \
+    SET(buttons, home,      5, 4, 1, 0, 0) \
+    SET(axes, joy_rx,       10, 0, 12, 0, 0) \
+    SET(axes, joy_ry,       11, 4, 12, 0, 0) \
+    SET(axes, accel_rx,     14, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_ry,     16, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_rz,     18, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_rx,      20, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_ry,      22, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_rz,      24, 0, 16, 0, DESC_SIGNED)
+
+// Joy-Con (L), report 0x30
+#define DESC_JOYCON_L_30(SET, OR) \
+    SET(buttons, minus,     5, 0, 1, 0, 0) \
+    SET(buttons, ls,        5, 3, 1, 0, 0) \
+    SET(buttons, capture,   5, 5, 1, 0, 0) \
+    SET(buttons, dd,        6, 0, 1, 0, 0) \
+    SET(buttons, du,        6, 1, 1, 0, 0) \
+    SET(buttons, dr,        6, 2, 1, 0, 0) \
+    SET(buttons, dl,        6, 3, 1, 0, 0) \
+    SET(buttons, srl,       6, 4, 1, 0, 0) \
+    SET(buttons, sll,       6, 5, 1, 0, 0) \
+    SET(buttons, l,         6, 6, 1, 0, 0) \
+    SET(buttons, zl,        6, 7, 1, 0, 0) \
+    SET(axes, joy_lx,       7, 0, 12, 0, 0) \
+    SET(axes, joy_ly,       8, 4, 12, 0, 0) \
+    SET(axes, accel_lx,     14, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_ly,     16, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_lz,     18, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_lx,      20, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_ly,      22, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_lz,      24, 0, 16, 0, DESC_SIGNED)
+
+// Pro Controller, report 0x30 (IMU is mounted rotated, so accel x and y are swapped)
+#define DESC_PROCON_30(SET, OR) \
+    SET(buttons, y,         4, 0, 1, 0, 0) \
+    SET(buttons, x,         4, 1, 1, 0, 0) \
+    SET(buttons, b,         4, 2, 1, 0, 0) \
+    SET(buttons, a,         4, 3, 1, 0, 0) \
+    SET(buttons, r,         4, 6, 1, 0, 0) \
+    SET(buttons, zr,        4, 7, 1, 0, 0) \
+    SET(buttons, minus,     5, 0, 1, 0, 0) \
+    SET(buttons, plus,      5, 1, 1, 0, 0) \
+    SET(buttons, rs,        5, 2, 1, 0, 0) \
+    SET(buttons, ls,        5, 3, 1, 0, 0) \
+    SET(buttons, home,      5, 4, 1, 0, 0) \
+    SET(buttons, capture,   5, 5, 1, 0, 0) \
+    SET(buttons, dd,        6, 0, 1, 0, 0) \
+    SET(buttons, du,        6, 1, 1, 0, 0) \
+    SET(buttons, dr,        6, 2, 1, 0, 0) \
+    SET(buttons, dl,        6, 3, 1, 0, 0) \
+    SET(buttons, l,         6, 6, 1, 0, 0) \
+    SET(buttons, zl,        6, 7, 1, 0, 0) \
+    SET(axes, joy_lx,       7, 0, 12, 0, 0) \
+    SET(axes, joy_ly,       8, 4, 12, 0, 0) \
+    SET(axes, joy_rx,       10, 0, 12, 0, 0) \
+    SET(axes, joy_ry,       11, 4, 12, 0, 0) \
+    SET(axes, accel_ry,     14, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_rx,     16, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_rz,     18, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_rx,      20, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_ry,      22, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_rz,      24, 0, 16, 0, DESC_SIGNED)
+
+// Wiimote core buttons (all button reports)
+#define DESC_WIIMOTE_BUTTONS(SET, OR) \
+    SET(buttons, dl,        2, 0, 1, 0, 0) \
+    SET(buttons, dr,        2, 1, 1, 0, 0) \
+    SET(buttons, dd,        2, 2, 1, 0, 0) \
+    SET(buttons, du,        2, 3, 1, 0, 0) \
+    SET(buttons, two,       3, 0, 1, 0, 0) \
+    SET(buttons, one,       3, 1, 1, 0, 0) \
+    SET(buttons, b,         3, 2, 1, 0, 0) \
+    SET(buttons, a,         3, 3, 1, 0, 0) \
+    SET(buttons, home,      3, 7, 1, 0, 0)
+
+// Wiimote accelerometer as 10-bit values (reports 0x33 and 0x37), low bits share the button bytes
+#define DESC_WIIMOTE_ACCEL(SET, OR) \
+    SET(axes, accel_rx,     4, 0, 8, 2, 0) \
+    OR(axes, accel_rx,      2, 5, 2, 0, 0) \
+    SET(axes, accel_ry,     5, 0, 8, 2, 0) \
+    OR(axes, accel_ry,      3, 5, 1, 1, 0) \
+    SET(axes, accel_rz,     6, 0, 8, 2, 0) \
+    OR(axes, accel_rz,      3, 6, 1, 1, 0)
+
+// Motion Plus gyro in the 0x37 extension bytes, shifted up to 16 bits
+#define DESC_WMP_GYRO(SET, OR) \
+    SET(axes, gyro_rz,      17, 0, 8, 2, 0) \
+    OR(axes, gyro_rz,       20, 2, 6, 10, 0) \
+    SET(axes, gyro_rx,      18, 0, 8, 2, 0) \
+    OR(axes, gyro_rx,       21, 2, 6, 10, 0) \
+    SET(axes, gyro_ry,      19, 0, 8, 2, 0) \
+    OR(axes, gyro_ry,       22, 2, 6, 10, 0)
+
+// Nunchuk in the 0x37 extension bytes
+#define DESC_NUNCHUK(SET, OR) \
+    SET(axes, joy_lx,       17, 0, 8, 0, 0) \
+    SET(axes, joy_ly,       18, 0, 8, 0, 0) \
+    SET(axes, accel_lx,     19, 0, 8, 2, 0) \
+    OR(axes, accel_lx,      22, 2, 2, 0, 0) \
+    SET(axes, accel_ly,     20, 0, 8, 2, 0) \
+    OR(axes, accel_ly,      22, 4, 2, 0, 0) \
+    SET(axes, accel_lz,     21, 0, 8, 2, 0) \
+    OR(axes, accel_lz,      22, 6, 2, 0, 0) \
+    SET(buttons, z,         22, 0, 1, 0, DESC_INVERT) \
+    SET(buttons, c,         22, 1, 1, 0, DESC_INVERT)
+
+// Classic Controller in the 0x37 extension bytes
+#define DESC_CLASSIC(SET, OR) \
+    SET(axes, joy_lx,       17, 0, 6, 2, 0) \
+    SET(axes, joy_ly,       18, 0, 6, 2, 0) \
+    SET(axes, joy_rx,       19, 7, 1, 3, 0) \
+    OR(axes, joy_rx,        18, 6, 2, 4, 0) \
+    OR(axes, joy_rx,        17, 6, 2, 6, 0) \
+    SET(axes, joy_ry,       19, 0, 5, 3, 0) \
+    SET(buttons, r,         21, 1, 1, 0, DESC_INVERT) \
+    SET(buttons, plus,      21, 2, 1, 0, DESC_INVERT) \
+    SET(buttons, home,      21, 3, 1, 0, DESC_INVERT) \
+    SET(buttons, minus,     21, 4, 1, 0, DESC_INVERT) \
+    SET(buttons, l,         21, 5, 1, 0, DESC_INVERT) \
+    SET(buttons, dd,        21, 6, 1, 0, DESC_INVERT) \
+    SET(buttons, dr,        21, 7, 1, 0, DESC_INVERT) \
+    SET(buttons, du,        22, 0, 1, 0, DESC_INVERT) \
+    SET(buttons, dl,        22, 1, 1, 0, DESC_INVERT) \
+    SET(buttons, zr,        22, 2, 1, 0, DESC_INVERT) \
+    SET(buttons, x,         22, 3, 1, 0, DESC_INVERT) \
+    SET(buttons, a,         22, 4, 1, 0, DESC_INVERT) \
+    SET(buttons, y,         22, 5, 1, 0, DESC_INVERT) \
+    SET(buttons, b,         22, 6, 1, 0, DESC_INVERT) \
+    SET(buttons, zl,        22, 7, 1, 0, DESC_INVERT)
+
+// Wii U Pro Controller, report 0x3D
+#define DESC_WIIU_PRO(SET, OR) \
+    SET(axes, joy_lx,       2, 0, 12, 0, 0) \
+    SET(axes, joy_rx,       4, 0, 12, 0, 0) \
+    SET(axes, joy_ly,       6, 0, 12, 0, 0) \
+    SET(axes, joy_ry,       8, 0, 12, 0, 0) \
+    SET(buttons, r,         10, 1, 1, 0, DESC_INVERT) \
+    SET(buttons, plus,      10, 2, 1, 0, DESC_INVERT) \
+    SET(buttons, home,      10, 3, 1, 0, DESC_INVERT) \
+    SET(buttons, minus,     10, 4, 1, 0, DESC_INVERT) \
+    SET(buttons, l,         10, 5, 1, 0, DESC_INVERT) \
+    SET(buttons, dd,        10, 6, 1, 0, DESC_INVERT) \
+    SET(buttons, dr,        10, 7, 1, 0, DESC_INVERT) \
+    SET(buttons, du,        11, 0, 1, 0, DESC_INVERT) \
+    SET(buttons, dl,        11, 1, 1, 0, DESC_INVERT) \
+    SET(buttons, zr,        11, 2, 1, 0, DESC_INVERT) \
+    SET(buttons, x,         11, 3, 1, 0, DESC_INVERT) \
+    SET(buttons, a,         11, 4, 1, 0, DESC_INVERT) \
+    SET(buttons, y,         11, 5, 1, 0, DESC_INVERT) \
+    SET(buttons, b,         11, 6, 1, 0, DESC_INVERT) \
+    SET(buttons, zl,        11, 7, 1, 0, DESC_INVERT) \
+    SET(buttons, rs,        12, 0, 1, 0, DESC_INVERT) \
+    SET(buttons, ls,        12, 1, 1, 0, DESC_INVERT)
+
+// Wired Joy-Con over UART (the stick byte layout matches the original parser)
+#define DESC_UART_JOYCON_R(SET, OR) \
+    SET(buttons, y,         15, 0, 1, 0, 0) \
+    SET(buttons, x,         15, 1, 1, 0, 0) \
+    SET(buttons, b,         15, 2, 1, 0, 0) \
+    SET(buttons, a,         15, 3, 1, 0, 0) \
+    SET(buttons, srr,       15, 4, 1, 0, 0) \
+    SET(buttons, slr,       15, 5, 1, 0, 0) \
+    SET(buttons, r,         15, 6, 1, 0, 0) \
+    SET(buttons, zr,        15, 7, 1, 0, 0) \
+    SET(buttons, plus,      16, 1, 1, 0, 0) \
+    SET(buttons, rs,        16, 2, 1, 0, 0) \
+    SET(buttons, home,      16, 4, 1, 0, 0) \
+    SET(axes, joy_rx,       22, 0, 8, 4, 0) \
+    SET(axes, joy_ry,       21, 0, 8, 4, 0) \
+    SET(axes, gyro_rx,      31, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_ry,      33, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_rz,      35, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_rx,     37, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_ry,     39, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_rz,     41, 0, 16, 0, DESC_SIGNED)
+
+#define DESC_UART_JOYCON_L(SET, OR) \
+    SET(buttons, minus,     16, 0, 1, 0, 0) \
+    SET(buttons, ls,        16, 3, 1, 0, 0) \
+    SET(buttons, capture,   16, 5, 1, 0, 0) \
+    SET(buttons, dd,        17, 0, 1, 0, 0) \
+    SET(buttons, du,        17, 1, 1, 0, 0) \
+    SET(buttons, dr,        17, 2, 1, 0, 0) \
+    SET(buttons, dl,        17, 3, 1, 0, 0) \
+    SET(buttons, srl,       17, 4, 1, 0, 0) \
+    SET(buttons, sll,       17, 5, 1, 0, 0) \
+    SET(buttons, l,         17, 6, 1, 0, 0) \
+    SET(buttons, zl,        17, 7, 1, 0, 0) \
+    SET(axes, joy_lx,       19, 0, 8, 4, 0) \
+    SET(axes, joy_ly,       20, 0, 8, 4, 0) \
+    SET(axes, gyro_lx,      31, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_ly,      33, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, gyro_lz,      35, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_lx,     37, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_ly,     39, 0, 16, 0, DESC_SIGNED) \
+    SET(axes, accel_lz,     41, 0, 16, 0, DESC_SIGNED)
+
+#endif
\ No newline at end of file
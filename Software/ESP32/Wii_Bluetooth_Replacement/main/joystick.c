@@ -0,0 +1,25 @@
+#include <inttypes.h>
+#include "joystick.h"
+
+// Output steps per raw unit over a half of travel, after trimming both deadzones
+static void joystick_build_half(int32_t travel, int32_t out_span, int32_t * dead, int32_t * range, fixed_t * slope) {
+    int32_t outer = travel * JOY_OUTER_DEADZONE / 100;
+
+    *dead = travel * JOY_DEADZONE / 100;
+    *range = travel - *dead - outer;
+    if (*range <= 0) {  // Bad calibration, only the center is reported
+        *range = 0x7FFFFFFF;
+        *slope = 0;
+        return;
+    }
+    *slope = fixed_from_ratio(1, out_span, *range);
+}
+
+void joystick_build_map(joy_axis_map_t * axis_map, uint16_t min, uint16_t center, uint16_t max) {
+    int32_t dead;
+
+    joystick_build_half((int32_t)center - min, JOY_OUT_CENTER, &dead, &axis_map->low_range, &axis_map->low_slope);
+    axis_map->low_start = center - dead;
+    joystick_build_half((int32_t)max - center - 1, JOY_OUT_MAX - JOY_OUT_CENTER - 1, &dead, &axis_map->high_range, &axis_map->high_slope);
+    axis_map->high_start = center + 1 + dead;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef _JOYSTICK_H_
+#define	_JOYSTICK_H_
+
+#include <stdint.h>
+#include "fixed.h"
+
+// Stick axes are scaled to 0 - 4095 with the center at 2047. The slopes are built once per calibration so parsing never divides.
+#define JOY_OUT_CENTER      2047
+#define JOY_OUT_MAX         4095
+#define JOY_DEADZONE        3   // Inner deadzone (% of each half of travel) reported as center
+#define JOY_OUTER_DEADZONE  3   // Outer deadzone (% of each half of travel) reported as full deflection
+
+typedef struct {
+    int32_t low_start;      // Raw value where the low half leaves the inner deadzone
+    int32_t high_start;     // Raw value where the high half leaves the inner deadzone
+    int32_t low_range;      // Raw travel from low_start to the outer deadzone
+    int32_t high_range;
+    fixed_t low_slope;      // Output per raw unit
+    fixed_t high_slope;
+} joy_axis_map_t;
+
+void joystick_build_map(joy_axis_map_t * axis_map, uint16_t min, uint16_t center, uint16_t max);
+
+static inline uint16_t joystick_map(const joy_axis_map_t * axis_map, uint16_t value) {
+    int32_t dist;
+    if (value < axis_map->low_start) {
+        dist = axis_map->low_start - value;
+        if (dist >= axis_map->low_range) return 0;
+        return JOY_OUT_CENTER - FIXED_TO_INT(dist * axis_map->low_slope);
+    }
+    if (value >= axis_map->high_start) {
+        dist = value - axis_map->high_start;
+        if (dist >= axis_map->high_range) return JOY_OUT_MAX;
+        return JOY_OUT_CENTER + 1 + FIXED_TO_INT(dist * axis_map->high_slope);
+    }
+    return JOY_OUT_CENTER;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "driver/timer.h"
+#include "latency.h"
+
+// Each stage is only written by one core (L2CAP by BTstack, the rest by the pipeline) so no locking is needed
+enum LATENCY_REPORT_STATE { LAT_REPORT_IDLE, LAT_REPORT_ACTIVE, LAT_REPORT_MAPPED };
+
+// Report currently being handled for a gamepad
+typedef struct {
+    uint8_t state;
+    uint8_t controller_num;
+    uint64_t arrival_time;
+} latency_report_t;
+
+// Reports carried by a published SPI frame
+typedef struct {
+    uint32_t seq;   // 0 if unused
+    uint8_t controller_num[4];
+    uint64_t arrival_time[4];
+} latency_frame_t;
+
+latency_stat_t latency_stats[8][LAT_NUM_STAGES];
+uint64_t latency_last_l2cap[8];
+latency_report_t latency_reports[4];
+latency_frame_t latency_frames[LATENCY_FRAMES];
+
+static const char * latency_stage_names[LAT_NUM_STAGES] = { "l2cap", "parsed", "mapped", "spi_queued", "spi_done" };
+
+uint64_t latency_now() {
+    uint64_t time;
+    timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &time);
+    return time;
+}
+
+// Buckets 0 - 3 hold exact values, after that each doubling is split into 4 buckets
+static uint8_t latency_bucket(uint32_t value) {
+    uint8_t octave;
+    if (value < 4) return value;
+    octave = 31 - __builtin_clz(value);
+    if (octave > 16) return LATENCY_BUCKETS - 1;
+    return ((octave - 1) * 4) + ((value >> (octave - 2)) & 3);
+}
+
+static uint32_t latency_bucket_upper(uint8_t bucket) {
+    uint8_t octave = (bucket / 4) + 1;
+    if (bucket < 4) return bucket;
+    return ((5 + (bucket % 4)) << (octave - 2)) - 1;
+}
+
+static void latency_record(uint8_t controller_num, enum LATENCY_STAGE stage, uint64_t elapsed) {
+    latency_stat_t * stat;
+    uint32_t value = (elapsed > UINT32_MAX) ? UINT32_MAX : elapsed;
+
+    if (!controller_num || controller_num > 8) return;
+    stat = &latency_stats[controller_num - 1][stage];
+
+    if (!stat->count || value < stat->min) stat->min = value;
+    if (value > stat->max) stat->max = value;
+    stat->sum += value;
+    stat->count++;
+    stat->buckets[latency_bucket(value)]++;
+}
+
+void latency_l2cap(uint8_t controller_num, uint64_t time) {
+    if (!LATENCY_ENABLE || !controller_num || controller_num > 8) return;
+    if (latency_last_l2cap[controller_num - 1]) latency_record(controller_num, LAT_L2CAP, time - latency_last_l2cap[controller_num - 1]);
+    latency_last_l2cap[controller_num - 1] = time;
+}
+
+// Start timing a report that is about to be handled by a gamepad
+void latency_report_begin(uint8_t gamepad_num, uint8_t controller_num, uint64_t arrival_time) {
+    latency_report_t * report;
+    if (!LATENCY_ENABLE || !gamepad_num || gamepad_num > 4) return;
+
+    report = &latency_reports[gamepad_num - 1];
+    report->state = LAT_REPORT_ACTIVE;
+    report->controller_num = controller_num;
+    report->arrival_time = arrival_time;
+}
+
+// Gamepads handled without a new report (wired Joy-Con, timeouts) are not measured
+void latency_probe(uint8_t gamepad_num, enum LATENCY_STAGE stage) {
+    latency_report_t * report;
+    if (!LATENCY_ENABLE || !gamepad_num || gamepad_num > 4) return;
+
+    report = &latency_reports[gamepad_num - 1];
+    if (report->state != LAT_REPORT_ACTIVE) return;
+
+    latency_record(report->controller_num, stage, latency_now() - report->arrival_time);
+    if (stage == LAT_MAPPED) report->state = LAT_REPORT_MAPPED;
+}
+
+// Reports that didn't change the SPI frame never reach the Wii, so they are dropped once the frame has been built
+void latency_frame_end() {
+    uint8_t i;
+    for (i = 0; i < 4; i++) latency_reports[i].state = LAT_REPORT_IDLE;
+}
+
+// A frame holding every mapped report has been published
+void latency_spi_queued(uint32_t seq) {
+    latency_frame_t * frame = &latency_frames[seq % LATENCY_FRAMES];
+    uint64_t now;
+    uint8_t i;
+    if (!LATENCY_ENABLE) return;
+
+    now = latency_now();
+    memset(frame, 0, sizeof(latency_frame_t));
+    frame->seq = seq;
+    for (i = 0; i < 4; i++) {
+        latency_report_t * report = &latency_reports[i];
+        if (report->state != LAT_REPORT_MAPPED) continue;
+
+        latency_record(report->controller_num, LAT_SPI_QUEUED, now - report->arrival_time);
+        frame->controller_num[i] = report->controller_num;
+        frame->arrival_time[i] = report->arrival_time;
+        report->state = LAT_REPORT_IDLE;
+    }
+}
+
+// Frames are resent until a newer one is published, only the first transfer counts
+void latency_spi_done(uint32_t seq, uint64_t done_time) {
+    latency_frame_t * frame = &latency_frames[seq % LATENCY_FRAMES];
+    uint8_t i;
+    if (!LATENCY_ENABLE || !seq || frame->seq != seq) return;
+
+    for (i = 0; i < 4; i++) {
+        if (frame->controller_num[i]) latency_record(frame->controller_num[i], LAT_SPI_DONE, done_time - frame->arrival_time[i]);
+    }
+    frame->seq = 0;
+}
+
+static uint32_t latency_p99(latency_stat_t * stat) {
+    uint32_t target = stat->count - (stat->count / 100);
+    uint32_t total = 0;
+    uint32_t upper;
+    uint8_t i;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        total += stat->buckets[i];
+        if (total >= target) break;
+    }
+    if (i >= LATENCY_BUCKETS) i = LATENCY_BUCKETS - 1;
+    upper = latency_bucket_upper(i);
+    return (upper < stat->max) ? upper : stat->max;    // Upper edge of the bucket holding the 99th percentile
+}
+
+// Times are in us, stats are read while probes may still be writing them so a line can be one sample off
+void latency_print() {
+    uint8_t i, j;
+
+    printf("Latency (us)      count      min      avg      p99      max\n");
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < LAT_NUM_STAGES; j++) {
+            latency_stat_t stat = latency_stats[i][j];
+            if (!stat.count) continue;
+            printf("C%u %-11s %9" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n", i + 1, latency_stage_names[j],
+                    stat.count, stat.min, (uint32_t)(stat.sum / stat.count), latency_p99(&stat), stat.max);
+        }
+    }
+}
+
+void latency_reset() {
+    memset(latency_stats, 0, sizeof(latency_stats));
+    memset(latency_last_l2cap, 0, sizeof(latency_last_l2cap));
+    printf("Latency stats reset\n");
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef _LATENCY_H_
+#define	_LATENCY_H_
+
+// Per controller timing of each pipeline stage, measured from the arrival of the L2CAP input report (except
+// LAT_L2CAP, which is the time between consecutive reports so radio delays can be told apart from processing)
+#define LATENCY_ENABLE      1
+#define LATENCY_BUCKETS     64  // 4 per doubling, covering 0 us to ~131 ms
+#define LATENCY_FRAMES      4   // SPI frames tracked until their transfer completes (power of 2)
+
+enum LATENCY_STAGE { LAT_L2CAP, LAT_PARSED, LAT_MAPPED, LAT_SPI_QUEUED, LAT_SPI_DONE, LAT_NUM_STAGES };
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_stat_t;
+
+uint64_t latency_now();
+
+// Called from the BTstack core
+void latency_l2cap(uint8_t controller_num, uint64_t time);
+
+// Called from the pipeline task
+void latency_report_begin(uint8_t gamepad_num, uint8_t controller_num, uint64_t arrival_time);
+void latency_probe(uint8_t gamepad_num, enum LATENCY_STAGE stage);
+void latency_frame_end();
+void latency_spi_queued(uint32_t seq);
+void latency_spi_done(uint32_t seq, uint64_t done_time);
+
+// Console
+void latency_print();
+void latency_reset();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "gamepad.h"
+#include "hid_controller.h"
+#include "link_policy.h"
+#include "timer.h"
+#include "wiimote.h"
+
+#define LINK_HCI_MODE_ACTIVE 0
+#define LINK_HCI_MODE_SNIFF 2
+
+static uint32_t link_signature_add(uint32_t signature, uint8_t value) {
+    return (signature ^ value) * 16777619;  // FNV-1a
+}
+
+// Buttons and sticks only, accelerometer/gyro noise doesn't count as activity
+static uint32_t link_input_signature(hid_controller_t * controller, uint8_t * report, uint8_t report_len) {
+    uint32_t signature = 2166136261;
+    uint8_t i, ext;
+
+    switch (controller->type) {
+        case CNT_JOYCON_R:
+        case CNT_JOYCON_L:
+        case CNT_PROCON:
+            if (report[1] != 0x30 || report_len < 13) return controller->link.input_signature;
+            for (i = 4; i < 7; i++) signature = link_signature_add(signature, report[i]);
+            for (i = 7; i < 13; i += 3) {
+                signature = link_signature_add(signature, ((report[i] | (report[i + 1] << 8)) & 0xFFF) >> 6);   // Stick X, 64 steps
+                signature = link_signature_add(signature, ((report[i + 1] >> 4) | (report[i + 2] << 4)) >> 6);  // Stick Y
+            }
+            break;
+        case CNT_WIIMOTE:
+            if (report[1] == 0x3D) ext = 2;
+            else {
+                signature = link_signature_add(signature, report[2]);
+                signature = link_signature_add(signature, report[3]);
+                switch (report[1]) {
+                    case 0x32:
+                    case 0x34: ext = 4; break;
+                    case 0x35: ext = 7; break;
+                    case 0x36: ext = 14; break;
+                    case 0x37: ext = 17; break;
+                    default: ext = 0; break;
+                }
+            }
+            if (!ext || report_len < ext + 6) break;
+            if (controller->extension_type == EXT_NUNCHUK) {
+                signature = link_signature_add(signature, report[ext] >> 3);        // Stick
+                signature = link_signature_add(signature, report[ext + 1] >> 3);
+                signature = link_signature_add(signature, report[ext + 5] & 0x03); // C and Z
+            } else if (controller->extension_type == EXT_CLASSIC) {
+                for (i = 0; i < 6; i++) signature = link_signature_add(signature, report[ext + i]);
+            }
+            break;
+        case CNT_WIIU_PRO:
+            if (report[1] != 0x3D || report_len < 13) return controller->link.input_signature;
+            for (i = 2; i < 10; i += 2) signature = link_signature_add(signature, (report[i] | (report[i + 1] << 8)) >> 6);
+            for (i = 10; i < 13; i++) signature = link_signature_add(signature, report[i]);
+            break;
+        default:
+            break;
+    }
+    return signature;
+}
+
+// Rough slot count of an ACL packet, assuming 2-DH1/2-DH3/2-DH5 plus the slot of the other side's reply
+static uint8_t link_packet_slots(uint8_t len) {
+    if (len + 4 <= 54) return 2;
+    if (len + 4 <= 367) return 4;
+    return 6;
+}
+
+static void link_set_mode(hid_controller_t * controller, enum LINK_MODE mode) {
+    link_policy_t * link = &controller->link;
+    if (link->mode == LINK_SNIFF) link->stats_sniff_ms += app_timer - link->mode_time;
+    link->mode = mode;
+    link->mode_time = app_timer;
+}
+
+static void link_exit_sniff(hid_controller_t * controller) {
+    if (controller->link.mode != LINK_SNIFF) return;
+    if (gap_sniff_mode_exit(controller->handle) == ERROR_CODE_SUCCESS) link_set_mode(controller, LINK_ACTIVE_PENDING);
+}
+
+// Whether the Wii is using this gamepad in a way that needs every report (motion data or rumble)
+static uint8_t link_slot_required(hid_controller_t * controller) {
+    wiimote_t * wiimote;
+    if (!controller->gamepad_num) return 0;
+    wiimote = &wiimotes[controller->gamepad_num - 1];
+    if (controller->command_queue_num || controller->command_pending_num) return 1;
+    if (gamepads[controller->gamepad_num - 1].calibrating) return 1;
+    if (wiimote->rumble) return 1;
+    if (!wiimote->wii_state_valid || !(wiimote->wii_state.flags & WII_STATE_CONNECTED)) return 0;     // Nothing on the Wii is reading this gamepad
+    return wiimote_motion_required(controller->gamepad_num);
+}
+
+static void link_print_stats(hid_controller_t * controller) {
+    link_policy_t * link = &controller->link;
+    uint32_t period = app_timer - link->stats_time;
+    uint32_t sniff_ms = link->stats_sniff_ms;
+
+    if (link->mode == LINK_SNIFF) sniff_ms += app_timer - link->mode_time;     // Count sniff time up to now
+    if (!period) return;
+    printf("Link %d: %s, %" PRIu32 " rx / %" PRIu32 " tx, ~%" PRIu32 " slots/s (%" PRIu32 "%% of airtime), %" PRIu32 "%% in sniff\n",
+        (int)(controller - get_controller(1)) + 1,
+        (link->mode == LINK_SNIFF) ? "sniff" : "active",
+        link->stats_rx, link->stats_tx,
+        link->stats_slots * 1000 / period,
+        link->stats_slots * 1000 / period * 100 / LINK_SLOTS_PER_SECOND,
+        sniff_ms * 100 / period);
+}
+
+static void link_reset_stats(hid_controller_t * controller) {
+    link_policy_t * link = &controller->link;
+    if (link->mode == LINK_SNIFF) link->mode_time = app_timer;     // Sniff time before now is dropped with the rest
+    link->stats_time = app_timer;
+    link->stats_sniff_ms = 0;
+    link->stats_rx = 0;
+    link->stats_tx = 0;
+    link->stats_slots = 0;
+}
+
+void init_link_policy() {
+    gap_set_default_link_policy_settings(LM_LINK_POLICY_ENABLE_ROLE_SWITCH | LM_LINK_POLICY_ENABLE_SNIFF_MODE);
+}
+
+void link_policy_reset(hid_controller_t * controller) {
+    memset(&controller->link, 0, sizeof(link_policy_t));
+    controller->link.mode = LINK_ACTIVE;
+    controller->link.activity_time = app_timer;
+    controller->link.mode_time = app_timer;
+    controller->link.stats_time = app_timer;
+}
+
+// Called for every input report, wakes the link as soon as buttons or sticks change
+void link_policy_input(hid_controller_t * controller, uint8_t * report, uint8_t report_len) {
+    link_policy_t * link = &controller->link;
+    uint32_t signature = link_input_signature(controller, report, report_len);
+
+    link->stats_rx++;
+    link->stats_slots += link_packet_slots(report_len);
+    if (signature != link->input_signature) {
+        link->input_signature = signature;
+        link->activity_time = app_timer;
+        link_exit_sniff(controller);
+    }
+}
+
+void link_policy_output(hid_controller_t * controller, uint8_t len) {
+    controller->link.stats_tx++;
+    controller->link.stats_slots += link_packet_slots(len);
+}
+
+// Called from the HCI mode change event
+void link_policy_mode_change(uint16_t handle, uint8_t status, uint8_t mode, uint16_t interval) {
+    uint8_t i;
+    hid_controller_t * controller = NULL;
+
+    for (i = 1; i <= 8; i++) {
+        if (get_controller(i)->connected && get_controller(i)->handle == handle) controller = get_controller(i);
+    }
+    if (!controller) return;
+    if (status != ERROR_CODE_SUCCESS) {
+        if (controller->link.mode == LINK_SNIFF_PENDING) link_set_mode(controller, LINK_ACTIVE);
+        else if (controller->link.mode == LINK_ACTIVE_PENDING) link_set_mode(controller, LINK_SNIFF);
+        controller->link.activity_time = app_timer;     // Don't retry straight away
+        return;
+    }
+    if (mode == LINK_HCI_MODE_SNIFF) {
+        link_set_mode(controller, LINK_SNIFF);
+        controller->link.sniff_interval = interval;
+        if (app_timer - controller->link.activity_time < LINK_IDLE_TIME) link_exit_sniff(controller);  // Input changed while entering sniff
+    } else link_set_mode(controller, LINK_ACTIVE);
+}
+
+// Called from the app loop
+void link_policy_handle(hid_controller_t * controller) {
+    link_policy_t * link = &controller->link;
+
+    if (!controller->connected || controller->pairing) return;
+    if (link_slot_required(controller)) link->activity_time = app_timer;
+
+    switch (link->mode) {
+        case LINK_ACTIVE:
+            if (app_timer - link->activity_time >= LINK_IDLE_TIME) {
+                if (gap_sniff_mode_enter(controller->handle, LINK_SNIFF_MIN_INTERVAL, LINK_SNIFF_MAX_INTERVAL, LINK_SNIFF_ATTEMPT, LINK_SNIFF_TIMEOUT) == ERROR_CODE_SUCCESS)
+                    link_set_mode(controller, LINK_SNIFF_PENDING);
+                else link->activity_time = app_timer;
+            }
+            break;
+        case LINK_SNIFF:
+            if (app_timer - link->activity_time < LINK_IDLE_TIME) link_exit_sniff(controller);
+            break;
+        case LINK_SNIFF_PENDING:
+        case LINK_ACTIVE_PENDING:
+            if (app_timer - link->mode_time >= LINK_MODE_CHANGE_TIMEOUT) {
+                link_set_mode(controller, LINK_ACTIVE);     // No mode change event, assume the link stayed active
+                link->activity_time = app_timer;
+            }
+            break;
+    }
+
+    if (LINK_STATS_PERIOD && (app_timer - link->stats_time >= LINK_STATS_PERIOD)) {
+        link_print_stats(controller);
+        link_reset_stats(controller);
+    }
+}
+
+// Console "link", slot usage of each connected controller since it connected or since "link reset"
+void link_policy_print() {
+    uint8_t i;
+    for (i = 1; i <= 8; i++) {
+        if (get_controller(i)->connected) link_print_stats(get_controller(i));
+    }
+}
+
+void link_policy_reset_stats() {
+    uint8_t i;
+    for (i = 1; i <= 8; i++) link_reset_stats(get_controller(i));
+    printf("Link stats reset\n");
+}
\ No newline at end of file
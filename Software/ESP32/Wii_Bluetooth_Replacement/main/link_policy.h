@@ -0,0 +1,44 @@
+#ifndef _LINK_POLICY_H_
+#define	_LINK_POLICY_H_
+
+#include <stdint.h>
+
+// Idle controllers are put into sniff mode so active links get more radio slots
+#define LINK_IDLE_TIME          3000    // Time (ms) without input changes before a link is put into sniff
+#define LINK_SNIFF_MIN_INTERVAL 0x0010  // 10 ms (slots)
+#define LINK_SNIFF_MAX_INTERVAL 0x0020  // 20 ms
+#define LINK_SNIFF_ATTEMPT      0x0002  // Slots the controller listens for each sniff anchor
+#define LINK_SNIFF_TIMEOUT      0x0001
+#define LINK_MODE_CHANGE_TIMEOUT 1000   // Time (ms) to wait for a mode change before assuming it failed
+#define LINK_STATS_PERIOD       0       // Time (ms) between slot usage logs, 0 to only print them with the "link" command
+#define LINK_SLOTS_PER_SECOND   1600
+
+enum LINK_MODE { LINK_ACTIVE, LINK_SNIFF_PENDING, LINK_SNIFF, LINK_ACTIVE_PENDING };
+
+typedef struct {
+    enum LINK_MODE mode;
+    uint16_t sniff_interval;    // Slots, as granted by the controller
+    uint32_t input_signature;   // Buttons and coarse stick positions of the last report
+    uint64_t activity_time;     // Last input change or slot needed by the Wii
+    uint64_t mode_time;         // Last mode change or mode change request
+
+    // Slot usage since the last log or "link reset"
+    uint64_t stats_time;
+    uint32_t stats_sniff_ms;
+    uint32_t stats_rx;
+    uint32_t stats_tx;
+    uint32_t stats_slots;
+} link_policy_t;
+
+struct hid_controller_t;
+
+void init_link_policy();
+void link_policy_reset(struct hid_controller_t * controller);
+void link_policy_input(struct hid_controller_t * controller, uint8_t * report, uint8_t report_len);
+void link_policy_output(struct hid_controller_t * controller, uint8_t len);
+void link_policy_mode_change(uint16_t handle, uint8_t status, uint8_t mode, uint16_t interval);
+void link_policy_handle(struct hid_controller_t * controller);
+void link_policy_print();
+void link_policy_reset_stats();
+
+#endif
\ No newline at end of file
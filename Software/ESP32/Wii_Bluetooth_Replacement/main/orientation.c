@@ -0,0 +1,133 @@
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include "orientation.h"
+
+#define DEG_TO_RAD  0.017453293f
+#define RAD_TO_DEG  57.29577951f
+
+static float inv_sqrt(float x) {
+    return 1.0f / sqrtf(x);
+}
+
+// Start level with the measured gravity, facing yaw 0
+static void orientation_init_from_accel(orientation_t * orientation, const float a[3]) {
+    float roll = atan2f(a[1], a[2]);
+    float pitch = atan2f(-a[0], sqrtf(a[1] * a[1] + a[2] * a[2]));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+
+    orientation->q[0] = cr * cp;
+    orientation->q[1] = sr * cp;
+    orientation->q[2] = cr * sp;
+    orientation->q[3] = -sr * sp;
+    orientation->initialized = 1;
+}
+
+void orientation_reset(orientation_t * orientation) {
+    memset(orientation, 0, sizeof(orientation_t));
+    orientation->q[0] = 1.0f;
+}
+
+// Start again from the next accelerometer reading, keeping the learned gyro bias
+void orientation_restart(orientation_t * orientation) {
+    memset(orientation->integral, 0, sizeof(orientation->integral));
+    orientation->rest_time = 0;
+    orientation->initialized = 0;
+}
+
+void orientation_update(orientation_t * orientation, const int16_t gyro[3], const int16_t accel[3], float gyro_scale, uint64_t time) {
+    float * q = orientation->q;
+    float g[3], a[3], v[3], e[3];
+    float a_norm, rate, dt, norm;
+    float q0, q1, q2, q3;
+    uint32_t delta_t;
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        g[i] = gyro[i] * gyro_scale - orientation->bias[i];
+        a[i] = accel[i];
+    }
+    a_norm = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+
+    if (!orientation->initialized) {
+        if (a_norm > 0.0f) {
+            orientation_init_from_accel(orientation, a);
+            orientation->gravity = a_norm;
+            orientation_center(orientation);
+        }
+        orientation->last_time = time;
+        return;
+    }
+
+    if (time <= orientation->last_time) return;
+    delta_t = ((time - orientation->last_time) > ORIENTATION_MAX_DT_US) ? ORIENTATION_MAX_DT_US : (time - orientation->last_time);
+    orientation->last_time = time;
+    dt = delta_t * 0.000001f;
+
+    // Learn gyro bias and the size of 1g while the controller is still
+    rate = sqrtf(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+    if (rate < REST_RATE) {
+        orientation->rest_time += delta_t;
+        if (orientation->rest_time >= REST_TIME_US) {
+            for (i = 0; i < 3; i++) orientation->bias[i] += REST_BIAS_RATE * g[i];
+            orientation->gravity += REST_BIAS_RATE * (a_norm - orientation->gravity);
+        }
+    } else orientation->rest_time = 0;
+
+    for (i = 0; i < 3; i++) g[i] *= DEG_TO_RAD;
+
+    // Gravity correction is skipped while the controller is being shaken
+    if ((a_norm > orientation->gravity * (1.0f - ACCEL_TOLERANCE)) && (a_norm < orientation->gravity * (1.0f + ACCEL_TOLERANCE))) {
+        for (i = 0; i < 3; i++) a[i] /= a_norm;
+
+        // Gravity direction predicted by the current orientation
+        v[0] = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        v[1] = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        v[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+        e[0] = a[1] * v[2] - a[2] * v[1];
+        e[1] = a[2] * v[0] - a[0] * v[2];
+        e[2] = a[0] * v[1] - a[1] * v[0];
+
+        for (i = 0; i < 3; i++) {
+            orientation->integral[i] += MAHONY_KI * e[i] * dt;
+            g[i] += MAHONY_KP * e[i] + orientation->integral[i];
+        }
+    }
+
+    q0 = q[0]; q1 = q[1]; q2 = q[2]; q3 = q[3];
+    q[0] += 0.5f * dt * (-q1 * g[0] - q2 * g[1] - q3 * g[2]);
+    q[1] += 0.5f * dt * (q0 * g[0] + q2 * g[2] - q3 * g[1]);
+    q[2] += 0.5f * dt * (q0 * g[1] - q1 * g[2] + q3 * g[0]);
+    q[3] += 0.5f * dt * (q0 * g[2] + q1 * g[1] - q2 * g[0]);
+
+    norm = inv_sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (i = 0; i < 4; i++) q[i] *= norm;
+}
+
+// Heading and elevation of the forward axis (positive yaw turns left, positive pitch points down)
+static void orientation_get_angles(orientation_t * orientation, float * yaw, float * pitch) {
+    float * q = orientation->q;
+    float fx = q[0] * q[0] + q[1] * q[1] - q[2] * q[2] - q[3] * q[3];
+    float fy = 2.0f * (q[1] * q[2] + q[0] * q[3]);
+    float fz = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+
+    if (fz > 1.0f) fz = 1.0f;
+    if (fz < -1.0f) fz = -1.0f;
+    *yaw = atan2f(fy, fx) * RAD_TO_DEG;
+    *pitch = -asinf(fz) * RAD_TO_DEG;
+}
+
+void orientation_center(orientation_t * orientation) {
+    orientation_get_angles(orientation, &orientation->yaw_center, &orientation->pitch_center);
+}
+
+// Angles relative to the center of the screen
+void orientation_get_pointer(orientation_t * orientation, float * yaw, float * pitch) {
+    orientation_get_angles(orientation, yaw, pitch);
+    *yaw -= orientation->yaw_center;
+    *pitch -= orientation->pitch_center;
+    if (*yaw > 180.0f) *yaw -= 360.0f;
+    if (*yaw < -180.0f) *yaw += 360.0f;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef _ORIENTATION_H_
+#define	_ORIENTATION_H_
+
+#include <stdint.h>
+
+// Mahony filter fusing gyro and accelerometer into a quaternion. Single precision runs on the ESP32 FPU.
+// Inputs are in the body frame: x = forward (towards the screen), y = left, z = up
+#define MAHONY_KP               1.0f    // Pull towards the measured gravity direction
+#define MAHONY_KI               0.02f   // Integral feedback, estimates pitch/roll gyro bias
+#define ACCEL_TOLERANCE         0.25f   // Accel is only trusted within +/- 25% of 1g
+#define REST_RATE               3.0f    // Gyro rate (deg/s) below which the controller may be at rest
+#define REST_TIME_US            500000  // Time below REST_RATE before bias is learned
+#define REST_BIAS_RATE          0.01f   // Fraction of the at-rest rate moved into the bias estimate per sample
+#define ORIENTATION_MAX_DT_US   100000  // Longest gap between samples that is integrated
+
+// Gyro scales (deg/s per LSB)
+#define GYRO_SCALE_SWITCH   (4588.0f / 65535.0f)
+#define GYRO_SCALE_WMP      (1440.0f / 65535.0f)  // Motion Plus values shifted up to 16 bits
+
+typedef struct {
+    float q[4];             // w, x, y, z (body to world)
+    float integral[3];      // Mahony integral feedback (rad/s)
+    float bias[3];          // Gyro bias learned at rest (deg/s)
+    float gravity;          // Magnitude of 1g in accel units, learned at rest
+    uint32_t rest_time;     // Time (us) spent below REST_RATE
+    float yaw_center;       // Angles (degrees) treated as the center of the screen
+    float pitch_center;
+    uint64_t last_time;     // Time (us) of the previous sample
+    uint8_t initialized;
+} orientation_t;
+
+void orientation_reset(orientation_t * orientation);
+void orientation_restart(orientation_t * orientation);
+void orientation_update(orientation_t * orientation, const int16_t gyro[3], const int16_t accel[3], float gyro_scale, uint64_t time);
+void orientation_center(orientation_t * orientation);
+void orientation_get_pointer(orientation_t * orientation, float * yaw, float * pitch);
+
+#endif
\ No newline at end of file
@@ -2,59 +2,112 @@
 #include <stdio.h>
 #include "btstack.h"
 #include "esp_system.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include "connect.h"
 #include "hid_controller.h"
 #include "pair.h"
 #include "timer.h"
+#include "trace.h"
 
 uint8_t host_mac_addr[6];
 uint8_t host_mac_addr_rev[6];
 char host_mac_string[7];
 
-device device1, device2, device3, device4, device5, device6, device7, device8;
-device * device_list[8] = { &device1, &device2, &device3, &device4, &device5, &device6, &device7, &device8 };
+static device device_list[PAIR_DEVICE_LIST_LEN];
+static uint8_t device_count = 0;
+static int8_t pairing_index = -1;   // Device currently pairing
+static int8_t name_index = -1;      // Device with a name request in flight
+
+// Names reported by the controllers, compared by length first
+static const device_name_t device_names[] = {
+    { "Joy-Con (L)", 11, CNT_JOYCON_L },
+    { "Joy-Con (R)", 11, CNT_JOYCON_R },
+    { "Pro Controller", 14, CNT_PROCON },
+    { "Nintendo RVL-CNT-01", 19, CNT_WIIMOTE },
+    { "Nintendo RVL-CNT-01-TR", 22, CNT_WIIMOTE },
+    { "Nintendo RVL-CNT-01-UC", 22, CNT_WIIU_PRO }
+};
 
 enum INQUIRY_STATE inquiry_state = IDLE;
-int device_count = 0;
-uint8_t controllers_found = 0;
 hid_controller_t * device_to_pair = NULL;
-uint32_t pair_timeout;
+uint64_t pair_timeout;
 
 void store_link_key(hid_controller_t * controller) {
     uint8_t i;
     uint8_t link_key[16];
+    if (controller->command_failed) {
+        printf("Link key not received\n");
+        return;
+    }
     for (i = 0; i < 16; i++) link_key[i] = controller->command_response[32 - i] ^ 0xAA;	// Read link key little-endian, XOR each byte with 0xAA
     printf("Link key: ");
     printf_hexdump(link_key, 16);
     gap_store_link_key_for_bd_addr(controller->address, link_key, COMBINATION_KEY);
 }
 
-uint8_t ready_to_pair() {
-    if (inquiry_state == READY_TO_PAIR) return 1;
-    return 0;
+// Returns the unresolved or unpaired device with the strongest signal, so the closest controllers go first
+static int8_t get_best_device(enum DEVICE_STATE state) {
+    uint8_t i;
+    int8_t best = -1;
+    for (i = 0; i < device_count; i++) {
+        if (device_list[i].state == state && (best < 0 || device_list[i].rssi > device_list[best].rssi)) best = i;
+    }
+    return best;
 }
 
-uint8_t get_num_controllers_found() {
-    return controllers_found;
+static int8_t get_device_index_for_address(uint8_t * addr) {
+    uint8_t i;
+    for (i = 0; i < device_count; i++){
+        if (bd_addr_cmp(addr, device_list[i].address) == 0) return i;
+    }
+    return -1;
 }
 
-uint8_t * get_next_discovered_controller_addr(enum HID_DEVICE * controller_type) {
+// Only peripherals (major device class 0x05) can be controllers, anything else isn't worth paging for its name
+static uint8_t is_possible_controller(uint32_t class_of_device) {
+    return ((class_of_device >> 8) & 0x1F) == 0x05;
+}
+
+static void request_next_name() {
+    if (inquiry_state != RESOLVING || name_index >= 0) return;
+    name_index = get_best_device(DEVICE_NAME_NEEDED);
+    if (name_index < 0) return;
+    printf("Get remote name of %s...\n", bd_addr_to_str(device_list[name_index].address));
+    device_list[name_index].state = DEVICE_NAME_PENDING;
+    pair_timeout = app_timer;
+    if (gap_remote_name_request(device_list[name_index].address, device_list[name_index].page_scan_repetition_mode, device_list[name_index].clock_offset | 0x8000)) {
+        device_list[name_index].state = DEVICE_DONE;
+        name_index = -1;
+    }
+}
+
+// Ends the session once every device has been resolved and paired
+static void check_scan_complete() {
     uint8_t i;
-    for (i = 0; i < 8; i++) {
-        if (device_list[i]->controller_type != CNT_NONE) {
-            *controller_type = device_list[i]->controller_type;
-            device_list[i]->controller_type = CNT_NONE;
-            return device_list[i]->address;
-        }
+    if (inquiry_state != RESOLVING || pairing_index >= 0 || name_index >= 0) return;
+    for (i = 0; i < device_count; i++) {
+        if (device_list[i].state != DEVICE_DONE) return;
     }
-    return NULL;
+    printf("Pairing session complete\n");
+    inquiry_state = IDLE;
+    gap_connectable_control(1);
+}
+
+uint8_t ready_to_pair() {
+    if (inquiry_state != RESOLVING || pairing_index >= 0) return 0;
+    return get_best_device(DEVICE_READY) >= 0;
+}
+
+uint8_t * get_next_discovered_controller_addr(enum HID_DEVICE * controller_type) {
+    pairing_index = get_best_device(DEVICE_READY);
+    if (pairing_index < 0) return NULL;
+    device_list[pairing_index].state = DEVICE_PAIRING;
+    *controller_type = device_list[pairing_index].controller_type;
+    return device_list[pairing_index].address;
 }
 
 void begin_pair(hid_controller_t * controller) {
-    inquiry_state = PAIRING;
     device_to_pair = controller;    // Keep track of which controller is pairing in case of timeout event
+    pair_timeout = app_timer;
 	controller->pairing = 1;
 	if (l2cap_create_channel(l2cap_event_handler, controller->address, HID_CONTROL_PSM, 64, &controller->l2cap_control_cid)) end_pair(controller);
     else printf("Pairing - L2CAP control channel created\n");
@@ -63,53 +116,23 @@ void begin_pair(hid_controller_t * controller) {
 void end_pair(hid_controller_t * controller) {
     if (controller) {
         controller->pairing = 0;
-        printf("Pairing complete\n");
+        printf(controller->command_failed ? "Pairing failed\n" : "Pairing complete\n");
+        if (controller != device_to_pair) return;   // Not the pairing in progress
     }
     device_to_pair = NULL;
-    if (controllers_found > 0) controllers_found--;
-    if (controllers_found > 0) {
-        inquiry_state = READY_TO_PAIR;  // Allow next discovered controller to pair
-    } else {
-        inquiry_state = IDLE;
-        gap_connectable_control(1);
-    }
-}
-
-int get_device_index_for_address(uint8_t * addr) {
-    uint8_t i;
-    for (i = 0; i < device_count; i++){
-        if (bd_addr_cmp(addr, device_list[i]->address) == 0) return i;
-    }
-    return -1;
-}
-
-uint8_t has_more_remote_name_requests() {
-    uint8_t i;
-    for (i = 0; i < device_count; i++) {
-        if (device_list[i]->state == REMOTE_NAME_REQUEST) return 1;
-    }
-    return 0;
-}
-
-void do_next_remote_name_request() {
-    uint8_t i;
-    for (i = 0; i < device_count; i++) {
-        if (device_list[i]->state == REMOTE_NAME_REQUEST) {
-            printf("Get remote name of %s...\n", bd_addr_to_str(device_list[i]->address));
-            gap_remote_name_request(device_list[i]->address, device_list[i]->page_scan_repetition_mode, device_list[i]->clock_offset | 0x8000);
-            return;
-        }
-    }
+    if (pairing_index >= 0) device_list[pairing_index].state = DEVICE_DONE;
+    pairing_index = -1;     // Next discovered controller can pair
+    check_scan_complete();
 }
 
 void start_scan(void) {
     if (inquiry_state == IDLE) {
         printf("Starting inquiry scan...\n");
-        controllers_found = 0;
         device_count = 0;
+        pairing_index = -1;
+        name_index = -1;
         inquiry_state = SEARCHING;
         gap_connectable_control(0);
-        init_devices();
         gap_inquiry_start(INQUIRY_INTERVAL);
     }
 }
@@ -119,31 +142,29 @@ void stop_scan() {
     gap_inquiry_stop();
 }
 
-void init_devices() {
-    uint8_t i;
-    for (i = 0; i < 8; i++) {
-        memset(device_list[i]->address, 0, 6);
-        device_list[i]->controller_type = CNT_NONE;
-    }
-}
-
+// A pairing or name request that takes too long is dropped, the rest of the session continues
 void pair_timeout_check() {
-    if (inquiry_state == IDLE) pair_timeout = app_timer;
-    else if (app_timer - pair_timeout >= 15000) {
+    if (inquiry_state != RESOLVING) pair_timeout = app_timer;
+    else if (app_timer - pair_timeout >= PAIR_STAGE_TIMEOUT) {
         printf("Controller pair timeout\n");
-        controllers_found = 0;
-        end_pair(device_to_pair);
+        pair_timeout = app_timer;
+        if (name_index >= 0) {
+            hci_send_cmd(&hci_remote_name_request_cancel, device_list[name_index].address);
+            device_list[name_index].state = DEVICE_DONE;
+            name_index = -1;
+            request_next_name();
+        }
+        if (pairing_index >= 0) end_pair(device_to_pair);
+        else check_scan_complete();
     }
 }
 
-enum HID_DEVICE get_discovered_device_type(char * name) {
-    if (strcmp(name, "Joy-Con (L)") == 0) return CNT_JOYCON_L;
-    else if (strcmp(name, "Joy-Con (R)") == 0) return CNT_JOYCON_R;
-    else if (strcmp(name, "Pro Controller") == 0) return CNT_PROCON;
-    else if (strcmp(name, "Nintendo RVL-CNT-01") == 0) return CNT_WIIMOTE;
-    else if (strcmp(name, "Nintendo RVL-CNT-01-TR") == 0) return CNT_WIIMOTE;
-    else if (strcmp(name, "Nintendo RVL-CNT-01-UC") == 0) return CNT_WIIU_PRO;
-    else return CNT_NONE;
+enum HID_DEVICE get_discovered_device_type(const char * name, uint8_t name_len) {
+    uint8_t i;
+    for (i = 0; i < sizeof(device_names) / sizeof(device_name_t); i++) {
+        if (device_names[i].name_len == name_len && !memcmp(device_names[i].name, name, name_len)) return device_names[i].type;
+    }
+    return CNT_NONE;
 }
 
 void get_mac_address_string(uint8_t * addr, char * string) {
@@ -155,109 +176,71 @@ void get_mac_address_string(uint8_t * addr, char * string) {
     string[12] = '\0';
 }
 
-void store_controller_type(enum HID_DEVICE type, uint8_t * addr) {
-    nvs_flash_init();
-    nvs_handle_t handle;
-    nvs_open("storage", NVS_READWRITE, &handle);
-    char mac_string[13];
-    get_mac_address_string(addr, mac_string);
-    printf("Storing controller %d type for address %s\n", (uint8_t)type, bd_addr_to_str(addr));
-    nvs_set_i8(handle, mac_string, (uint8_t)type);
-    nvs_commit(handle);
-    nvs_close(handle);
-}
-
-enum HID_DEVICE get_controller_type(uint8_t * addr) {
-    esp_err_t err;
-    nvs_flash_init();
-    nvs_handle_t handle;
-    nvs_open("storage", NVS_READWRITE, &handle);
-    uint8_t val;
-    char mac_string[13];
-    get_mac_address_string(addr, mac_string);
-    err = nvs_get_i8(handle, mac_string, (int8_t *)&val);
-    nvs_close(handle);
-    printf("Found controller type %d for address %s\n", val, bd_addr_to_str(addr));
-    if (err == ESP_OK && val <= 5) return (enum HID_DEVICE)val;
-    else return CNT_NONE;
-}
-
 void gap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
     uint8_t event;
     bd_addr_t event_addr;
-    int index;
+    int8_t index;
+    device * dev;
+    uint32_t cod;
+    uint8_t found[TRACE_PAYLOAD_LEN];   // Address, COD, page scan mode, clock offset, RSSI, name length and start of the name
 
     if (packet_type == HCI_EVENT_PACKET) {
 		event = hci_event_packet_get_type(packet);
 		switch (event) {            
             case GAP_EVENT_INQUIRY_RESULT:
-                if (device_count >= 8) break;  // already full
                 gap_event_inquiry_result_get_bd_addr(packet, event_addr);
-                index = get_device_index_for_address(event_addr);
-                if (index >= 0) break;   // already in our list
+                if (get_device_index_for_address(event_addr) >= 0) break;   // already in our list
+                if (device_count >= PAIR_DEVICE_LIST_LEN) break;  // already full
                 
-                memcpy(device_list[device_count]->address, event_addr, 6);
-                device_list[device_count]->page_scan_repetition_mode = gap_event_inquiry_result_get_page_scan_repetition_mode(packet);
-                device_list[device_count]->clock_offset = gap_event_inquiry_result_get_clock_offset(packet);
-                device_list[device_count]->controller_type = CNT_NONE;
-                printf("Device found: %s ", bd_addr_to_str(event_addr));
-                printf("with COD: 0x%06x, ", (unsigned int) gap_event_inquiry_result_get_class_of_device(packet));
-                printf("pageScan %d, ", device_list[device_count]->page_scan_repetition_mode);
-                printf("clock offset 0x%04x", device_list[device_count]->clock_offset);
-                if (gap_event_inquiry_result_get_rssi_available(packet)) {
-                    printf(", rssi %d dBm", (int8_t)gap_event_inquiry_result_get_rssi(packet));
-                }
-                if (gap_event_inquiry_result_get_name_available(packet)) {
-                    char name_buffer[50];
+                dev = &device_list[device_count++];
+                memcpy(dev->address, event_addr, 6);
+                dev->page_scan_repetition_mode = gap_event_inquiry_result_get_page_scan_repetition_mode(packet);
+                dev->clock_offset = gap_event_inquiry_result_get_clock_offset(packet);
+                dev->rssi = PAIR_RSSI_UNKNOWN;
+                dev->controller_type = CNT_NONE;
+                dev->state = DEVICE_NAME_NEEDED;
+                cod = gap_event_inquiry_result_get_class_of_device(packet);
+                memset(found, 0, sizeof(found));
+                memcpy(found, event_addr, 6);
+                found[6] = cod & 0xFF;
+                found[7] = (cod >> 8) & 0xFF;
+                found[8] = (cod >> 16) & 0xFF;
+                found[9] = dev->page_scan_repetition_mode;
+                found[10] = dev->clock_offset & 0xFF;
+                found[11] = dev->clock_offset >> 8;
+                if (gap_event_inquiry_result_get_rssi_available(packet)) dev->rssi = (int8_t)gap_event_inquiry_result_get_rssi(packet);
+                found[12] = (uint8_t)dev->rssi;
+                if (gap_event_inquiry_result_get_name_available(packet)) {  // Name from EIR, no request needed
                     int name_len = gap_event_inquiry_result_get_name_len(packet);
-                    memcpy(name_buffer, gap_event_inquiry_result_get_name(packet), name_len);
-                    name_buffer[name_len] = '\0';
-                    printf(", name '%s'", name_buffer);
-                    device_list[device_count]->controller_type = get_discovered_device_type(name_buffer);
-                    if (device_list[device_count]->controller_type != CNT_NONE) controllers_found++;
-                    device_list[device_count]->state = REMOTE_NAME_FOUND;
-                } else device_list[device_count]->state = REMOTE_NAME_REQUEST;
-                printf("\n");
-                device_count++;
+                    found[13] = name_len;
+                    memcpy(&found[14], gap_event_inquiry_result_get_name(packet), (name_len < TRACE_PAYLOAD_LEN - 14) ? name_len : TRACE_PAYLOAD_LEN - 14);
+                    dev->controller_type = get_discovered_device_type((const char *)gap_event_inquiry_result_get_name(packet), name_len);
+                    dev->state = (dev->controller_type != CNT_NONE) ? DEVICE_READY : DEVICE_DONE;
+                } else if (!is_possible_controller(cod)) dev->state = DEVICE_DONE;
+                trace_event_data(0, EVT_DEVICE_FOUND, found, sizeof(found));
                 break;
 
             case GAP_EVENT_INQUIRY_COMPLETE:
-                if (has_more_remote_name_requests()) {
-                    printf("Requesting device names\n");
-                    inquiry_state = REQUESTING_NAMES;
-                    do_next_remote_name_request();
-                }
-                else if (controllers_found > 0) {
-                    printf("%d controllers found\n", controllers_found);
-                    inquiry_state = READY_TO_PAIR;
-                } else {
-                    printf("No controllers found\n");
-                    inquiry_state = IDLE;
-                    gap_connectable_control(1);
-                }
+                printf("%d devices found\n", device_count);
+                inquiry_state = RESOLVING;
+                request_next_name();
+                check_scan_complete();
                 break;
             case HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE:
                 reverse_bd_addr(&packet[3], event_addr);
                 index = get_device_index_for_address(event_addr);
-                if (index >= 0) {
+                if (index >= 0 && index == name_index) {
                     if (packet[2] == 0) {
                         printf("Name: '%s'\n", &packet[9]);
-                        device_list[index]->controller_type = get_discovered_device_type((char *)&packet[9]);
-                        if (device_list[index]->controller_type != CNT_NONE) controllers_found++;
+                        device_list[index].controller_type = get_discovered_device_type((char *)&packet[9], strnlen((char *)&packet[9], 248));
                     } else {
                         printf("Failed to get name: page timeout\n");
                     }
-                    device_list[index]->state = REMOTE_NAME_FOUND;
-                }
-                if (has_more_remote_name_requests()) do_next_remote_name_request();
-                else if (controllers_found > 0) {
-                    printf("%d controllers found\n", controllers_found);
-                    inquiry_state = READY_TO_PAIR;
-                } else {
-                    printf("No controllers found\n");
-                    inquiry_state = IDLE;
-                    gap_connectable_control(1);
+                    device_list[index].state = (device_list[index].controller_type != CNT_NONE) ? DEVICE_READY : DEVICE_DONE;
+                    name_index = -1;
                 }
+                request_next_name();    // Overlaps with any pairing in progress
+                check_scan_complete();
                 break;
             default:
                 break;
@@ -0,0 +1,429 @@
+#include <string.h>
+#include "btstack.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/timer.h"
+#include "gamepad.h"
+#include "hid_controller.h"
+#include "latency.h"
+#include "pipeline.h"
+#include "spi.h"
+#include "timer.h"
+#include "trace.h"
+#include "uart_controller.h"
+#include "wiimote.h"
+
+// Each controller has two snapshot buffers. The BTstack core always writes the one that isn't the latest, and seq
+// is odd while it does (seqlock), so the pipeline retries any copy that overlapped a write.
+typedef struct {
+    controller_snapshot_t buf[2];
+    volatile uint8_t latest;
+    volatile uint32_t seq;
+} snapshot_slot_t;
+
+snapshot_slot_t snapshots[8];
+controller_state_t published_states[8];     // BTstack core only
+controller_state_t controller_states[8];    // Pipeline only, from the latest snapshot
+uint64_t pipeline_timer = 0;
+
+// Calibration is worked on by the BTstack core in cal_staging and published through the same kind of seqlock. Each
+// group has a generation, so the pipeline only copies groups that changed and keeps its own gyro calibration otherwise.
+typedef struct {
+    calibration_t cal;
+    uint8_t generation[CAL_GROUP_COUNT];
+} staged_cal_t;
+
+typedef struct {
+    staged_cal_t buf[2];
+    volatile uint8_t latest;
+    volatile uint32_t seq;
+} cal_slot_t;
+
+staged_cal_t cal_staging[4];    // BTstack core only
+cal_slot_t cal_slots[4];
+uint8_t cal_applied[4][CAL_GROUP_COUNT];    // Pipeline only
+TaskHandle_t pipeline_task_handle = NULL;
+
+// Single producer (pipeline task) and single consumer (BTstack core), so no locking is needed
+pipeline_request_t requests[PIPELINE_REQUEST_LEN];
+volatile uint32_t request_head = 0;
+volatile uint32_t request_tail = 0;
+volatile uint8_t requests_scheduled = 0;
+uint32_t requests_dropped = 0;
+
+// Rumble requests are coalesced per controller so the latest level is always carried out, even if the ring fills up
+volatile uint8_t rumble_levels[8];
+volatile uint8_t rumble_pending[8];
+
+static uint8_t pipeline_get_controller_num(hid_controller_t * controller) {
+    return (controller - get_controller(1)) + 1;
+}
+
+static void pipeline_copy_state(hid_controller_t * controller, controller_state_t * state) {
+    memset(state, 0, sizeof(controller_state_t));  // Compared with memcmp
+    state->registered = controller->registered;
+    state->connected = controller->connected;
+    state->gamepad_num = controller->gamepad_num;
+    state->type = controller->type;
+    state->imu_enabled = controller->imu_enabled;
+    state->wmp_type = controller->wmp_type;
+    state->wmp_active = controller->wmp_active;
+    state->extension_type = controller->extension_type;
+    state->player_num = controller->output.player_num;
+    state->rumble = controller->rumble;
+    state->rumble_pattern_repetitions = controller->rumble_pattern_repetitions;
+}
+
+// Store the latest status report of a controller and wake the pipeline
+void pipeline_push_report(hid_controller_t * controller, uint8_t * report, uint8_t report_len) {
+    uint8_t controller_num = pipeline_get_controller_num(controller);
+    snapshot_slot_t * slot = &snapshots[controller_num - 1];
+    controller_snapshot_t * snapshot = &slot->buf[slot->latest ^ 1];
+
+    if (report_len > sizeof(snapshot->data)) report_len = sizeof(snapshot->data);
+
+    slot->seq++;
+    __sync_synchronize();
+    memset(snapshot->data, 0, sizeof(snapshot->data));
+    memcpy(snapshot->data, report, report_len);
+    snapshot->len = report_len;
+    snapshot->time = controller->time_report;
+    pipeline_copy_state(controller, &snapshot->state);
+    published_states[controller_num - 1] = snapshot->state;
+    slot->latest ^= 1;
+    __sync_synchronize();
+    slot->seq++;
+
+    if (pipeline_task_handle) xTaskNotify(pipeline_task_handle, PIPELINE_NOTIFY_REPORT(controller_num), eSetBits);
+}
+
+// Controller state also changes without a report (connections, setup callbacks), so it is published again from the
+// app loop whenever it differs from the last snapshot. The report in it stays the same.
+void pipeline_sync_states() {
+    controller_state_t state;
+    snapshot_slot_t * slot;
+    uint8_t i;
+
+    for (i = 0; i < 8; i++) {
+        pipeline_copy_state(get_controller(i + 1), &state);
+        if (!memcmp(&state, &published_states[i], sizeof(controller_state_t))) continue;
+
+        slot = &snapshots[i];
+        slot->seq++;
+        __sync_synchronize();
+        memcpy(&slot->buf[slot->latest ^ 1], &slot->buf[slot->latest], sizeof(controller_snapshot_t));
+        slot->buf[slot->latest ^ 1].state = state;
+        slot->latest ^= 1;
+        __sync_synchronize();
+        slot->seq++;
+        published_states[i] = state;
+
+        if (pipeline_task_handle) xTaskNotify(pipeline_task_handle, PIPELINE_NOTIFY_STATE(i + 1), eSetBits);
+    }
+}
+
+static void pipeline_read_snapshot(uint8_t controller_num, controller_snapshot_t * snapshot) {
+    snapshot_slot_t * slot = &snapshots[controller_num - 1];
+    uint32_t seq;
+
+    do {
+        seq = slot->seq;
+        __sync_synchronize();
+        memcpy(snapshot, &slot->buf[slot->latest], sizeof(controller_snapshot_t));
+        __sync_synchronize();
+    } while ((seq & 1) || (slot->seq != seq));
+}
+
+// Calibration setters on the BTstack core write here, then publish the groups they changed
+calibration_t * pipeline_staged_calibration(uint8_t gamepad_num) {
+    return &cal_staging[gamepad_num - 1].cal;
+}
+
+void pipeline_publish_calibration(uint8_t gamepad_num, uint8_t groups) {
+    staged_cal_t * staged = &cal_staging[gamepad_num - 1];
+    cal_slot_t * slot = &cal_slots[gamepad_num - 1];
+    uint8_t i;
+
+    for (i = 0; i < CAL_GROUP_COUNT; i++) {
+        if (groups & CAL_GROUP_BIT(i)) staged->generation[i]++;
+    }
+
+    slot->seq++;
+    __sync_synchronize();
+    memcpy(&slot->buf[slot->latest ^ 1], staged, sizeof(staged_cal_t));
+    slot->latest ^= 1;
+    __sync_synchronize();
+    slot->seq++;
+
+    if (pipeline_task_handle) xTaskNotify(pipeline_task_handle, PIPELINE_NOTIFY_CAL(gamepad_num), eSetBits);
+}
+
+static void pipeline_apply_calibration(uint8_t gamepad_num) {
+    cal_slot_t * slot = &cal_slots[gamepad_num - 1];
+    staged_cal_t staged;
+    uint32_t seq;
+    uint8_t groups = 0;
+    uint8_t i;
+
+    do {
+        seq = slot->seq;
+        __sync_synchronize();
+        memcpy(&staged, &slot->buf[slot->latest], sizeof(staged_cal_t));
+        __sync_synchronize();
+    } while ((seq & 1) || (slot->seq != seq));
+
+    for (i = 0; i < CAL_GROUP_COUNT; i++) {
+        if (staged.generation[i] == cal_applied[gamepad_num - 1][i]) continue;
+        cal_applied[gamepad_num - 1][i] = staged.generation[i];
+        groups |= CAL_GROUP_BIT(i);
+    }
+    gamepad_apply_cal(&gamepads[gamepad_num - 1], &staged.cal, groups);
+}
+
+// Gamepads are only modified by the pipeline, so the BTstack core asks for resets here
+void pipeline_reset_gamepad(uint8_t gamepad_num, uint8_t reset) {
+    if (gamepad_num == 0 || gamepad_num > 4) return;
+    if (reset) {
+        gamepad_cal_defaults(&cal_staging[gamepad_num - 1].cal);
+        pipeline_publish_calibration(gamepad_num, CAL_GROUPS_ALL);
+    }
+    if (!pipeline_task_handle) return;
+    pipeline_sync_states();     // Registration changes reach the pipeline before the reset
+    xTaskNotify(pipeline_task_handle, reset ? PIPELINE_NOTIFY_RESET(gamepad_num) : PIPELINE_NOTIFY_SET_TYPE(gamepad_num), eSetBits);
+}
+
+controller_state_t * pipeline_controller_state(hid_controller_t * controller) {
+    return &controller_states[pipeline_get_controller_num(controller) - 1];
+}
+
+// Same as get_controllers_from_gamepad(), from the pipeline's copy of the controller state
+void pipeline_get_controllers(uint8_t gamepad_num, hid_controller_t ** controller_main, hid_controller_t ** controller_secondary, uint8_t connection_required) {
+    controller_state_t * state;
+    uint8_t i;
+
+    *controller_main = NULL;
+    *controller_secondary = NULL;
+    for (i = 0; i < 8; i++) {
+        state = &controller_states[i];
+        if ((state->gamepad_num != gamepad_num) || !state->registered || (connection_required && !state->connected)) continue;
+        switch (state->type) {
+            case CNT_JOYCON_R:
+            case CNT_PROCON:
+            case CNT_WIIMOTE:
+            case CNT_WIIU_PRO:
+                *controller_main = get_controller(i + 1);
+                break;
+            case CNT_JOYCON_L:
+                *controller_secondary = get_controller(i + 1);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void pipeline_notify_uart() {
+    if (pipeline_task_handle) xTaskNotify(pipeline_task_handle, PIPELINE_NOTIFY_UART, eSetBits);
+}
+
+static void pipeline_run_requests(void * arg) {
+    UNUSED(arg);
+    pipeline_handle_requests();
+}
+
+// Returns 0 if the request had to be dropped
+static uint8_t pipeline_push_request(pipeline_request_t * request) {
+    uint32_t i;
+
+    // Skip requests that are already waiting to be carried out
+    for (i = request_tail; i != request_head; i++) {
+        if (!memcmp(&requests[i % PIPELINE_REQUEST_LEN], request, sizeof(pipeline_request_t))) return 1;
+    }
+    if (request_head - request_tail >= PIPELINE_REQUEST_LEN) {
+        requests_dropped++;
+        trace_event(pipeline_get_controller_num(request->controller), EVT_REQ_DROPPED, request->type);
+        return 0;
+    }
+
+    memcpy(&requests[request_head % PIPELINE_REQUEST_LEN], request, sizeof(pipeline_request_t));
+    __sync_synchronize();
+    request_head++;
+    __sync_synchronize();
+
+    if (!requests_scheduled) {
+        requests_scheduled = 1;
+        btstack_run_loop_freertos_execute_code_on_main_thread(&pipeline_run_requests, NULL);
+    }
+    return 1;
+}
+
+// Carry out controller requests from the pipeline (BTstack core only)
+void pipeline_handle_requests() {
+    requests_scheduled = 0;
+    __sync_synchronize();
+
+    while (request_tail != request_head) {
+        pipeline_request_t * request = &requests[request_tail % PIPELINE_REQUEST_LEN];
+        hid_controller_t * controller = request->controller;
+        uint8_t controller_num = pipeline_get_controller_num(controller);
+
+        // Cleared before the level is read, so a newer level set meanwhile either lands here or queues a new request
+        if (request->type == REQ_RUMBLE) {
+            rumble_pending[controller_num - 1] = 0;
+            __sync_synchronize();
+        }
+
+        if (controller->connected) {
+            switch (request->type) {
+                case REQ_RUMBLE:
+                    controller_rumble(controller, rumble_levels[controller_num - 1]);
+                    break;
+                case REQ_RUMBLE_PATTERN:
+                    controller_rumble_pattern(controller, request->params[0], request->params[1], request->params[2]);
+                    break;
+                case REQ_SET_LEDS:
+                    controller_set_leds(controller, request->params[0]);
+                    break;
+                case REQ_QUEUE_COMMAND:
+                    hid_queue_command(controller, request->command, request->arg, NULL, 1);
+                    break;
+                case REQ_DISCONNECT:
+                    controller_disconnect(controller);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        __sync_synchronize();
+        request_tail++;
+    }
+}
+
+void pipeline_controller_rumble(hid_controller_t * controller, uint8_t level) {
+    uint8_t controller_num = pipeline_get_controller_num(controller);
+    pipeline_request_t request;
+
+    rumble_levels[controller_num - 1] = level;
+    __sync_synchronize();
+    if (rumble_pending[controller_num - 1]) return;    // The queued request picks up the new level
+
+    rumble_pending[controller_num - 1] = 1;
+    memset(&request, 0, sizeof(request));
+    request.type = REQ_RUMBLE;
+    request.controller = controller;
+    if (!pipeline_push_request(&request)) rumble_pending[controller_num - 1] = 0;
+}
+
+void pipeline_controller_rumble_pattern(hid_controller_t * controller, uint16_t on_period, uint16_t off_period, uint8_t repetitions) {
+    pipeline_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.type = REQ_RUMBLE_PATTERN;
+    request.controller = controller;
+    request.params[0] = on_period;
+    request.params[1] = off_period;
+    request.params[2] = repetitions;
+    pipeline_push_request(&request);
+}
+
+void pipeline_controller_set_leds(hid_controller_t * controller, uint8_t player_num) {
+    pipeline_request_t request;
+    if (pipeline_controller_state(controller)->player_num == player_num) return;
+    memset(&request, 0, sizeof(request));
+    request.type = REQ_SET_LEDS;
+    request.controller = controller;
+    request.params[0] = player_num;
+    pipeline_push_request(&request);
+}
+
+void pipeline_queue_command(hid_controller_t * controller, const hid_command_t * command, uint8_t * arg) {
+    pipeline_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.type = REQ_QUEUE_COMMAND;
+    request.controller = controller;
+    request.command = command;
+    if (arg) memcpy(request.arg, arg, (command->arg_len < PIPELINE_REQUEST_ARG_LEN) ? command->arg_len : PIPELINE_REQUEST_ARG_LEN);
+    pipeline_push_request(&request);
+}
+
+void pipeline_controller_disconnect(hid_controller_t * controller) {
+    pipeline_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.type = REQ_DISCONNECT;
+    request.controller = controller;
+    pipeline_push_request(&request);
+}
+
+static void pipeline_task(void * arg) {
+    controller_snapshot_t snapshot[8];
+    uint32_t notify_bits;
+    uint64_t counter;
+    uint8_t spi_enabled = 0;
+    uint8_t i;
+
+    while (1) {
+        notify_bits = 0;
+        xTaskNotifyWait(0, 0xFFFFFFFF, &notify_bits, pdMS_TO_TICKS(APP_LOOP_PERIOD_MS));
+        timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &counter);  // Register read, app_timer is written by the other core
+        pipeline_timer = counter / 1000;
+
+        // Controller state comes first, resets and reports are handled with it
+        for (i = 1; i <= 8; i++) {
+            if (!(notify_bits & (PIPELINE_NOTIFY_REPORT(i) | PIPELINE_NOTIFY_STATE(i)))) continue;
+            pipeline_read_snapshot(i, &snapshot[i - 1]);
+            controller_states[i - 1] = snapshot[i - 1].state;
+        }
+
+        // Resets and calibration from the BTstack core come before any new reports
+        for (i = 1; i <= 4; i++) {
+            if (notify_bits & PIPELINE_NOTIFY_RESET(i)) {
+                gamepad_reset(&gamepads[i - 1]);
+                wiimote_reset(&wiimotes[i - 1]);
+            }
+            if (notify_bits & (PIPELINE_NOTIFY_RESET(i) | PIPELINE_NOTIFY_SET_TYPE(i))) {
+                gamepad_set_type(i);
+                gamepad_set_extension(i);
+            }
+            if (notify_bits & PIPELINE_NOTIFY_CAL(i)) pipeline_apply_calibration(i);
+        }
+
+        for (i = 1; i <= 8; i++) {
+            if (notify_bits & PIPELINE_NOTIFY_REPORT(i)) {
+                hid_controller_t * controller = get_controller(i);
+                controller_state_t * state = &controller_states[i - 1];
+                if (!state->connected || !state->gamepad_num) continue;
+
+                memcpy(controller->status_response, snapshot[i - 1].data, sizeof(snapshot[i - 1].data));
+                controller->status_response_len = snapshot[i - 1].len;
+                gamepad_get_angles_from_controller(controller, snapshot[i - 1].time);
+                latency_report_begin(state->gamepad_num, i, snapshot[i - 1].time);
+                gamepad_handle(state->gamepad_num);
+            }
+        }
+        if (notify_bits & PIPELINE_NOTIFY_UART) gamepad_handle(UART_GAMEPAD_NUM);
+
+        gamepad_timeout_handle(1);
+        gamepad_timeout_handle(2);
+        gamepad_timeout_handle(3);
+        gamepad_timeout_handle(4);
+
+        if ((pipeline_timer >= 1500) && !spi_enabled) {
+            spi_enabled = 1;
+            spi_slave_enable();  // Accept SPI transfers
+        }
+
+        wiimote_spi_receive();
+        wiimote_spi_update();
+        latency_frame_end();
+    }
+}
+
+void pipeline_init() {
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        gamepad_cal_defaults(&cal_staging[i].cal);
+        memcpy(&cal_slots[i].buf[0], &cal_staging[i], sizeof(staged_cal_t));
+    }
+    xTaskCreatePinnedToCore(&pipeline_task, "pipeline", PIPELINE_STACK_SIZE, NULL, PIPELINE_PRIORITY, &pipeline_task_handle, PIPELINE_CORE);
+}
\ No newline at end of file
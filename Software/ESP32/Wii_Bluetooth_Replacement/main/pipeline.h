@@ -0,0 +1,76 @@
+#ifndef _PIPELINE_H_
+#define	_PIPELINE_H_
+
+#include "gamepad.h"
+#include "hid_controller.h"
+
+// Gamepad/Wiimote/SPI processing runs in its own task on the second core, leaving the BTstack core to move packets
+#define PIPELINE_CORE           1
+#define PIPELINE_PRIORITY       5
+#define PIPELINE_STACK_SIZE     8192
+#define PIPELINE_REQUEST_LEN    32      // Requests from the pipeline to the BTstack core (power of 2)
+#define PIPELINE_REQUEST_ARG_LEN 16
+
+// Task notification bits
+#define PIPELINE_NOTIFY_REPORT(controller_num)  (1 << ((controller_num) - 1))       // Bits 0 - 7
+#define PIPELINE_NOTIFY_RESET(gamepad_num)      (1 << ((gamepad_num) + 7))          // Bits 8 - 11
+#define PIPELINE_NOTIFY_SET_TYPE(gamepad_num)   (1 << ((gamepad_num) + 11))         // Bits 12 - 15
+#define PIPELINE_NOTIFY_UART                    (1 << 16)
+#define PIPELINE_NOTIFY_CAL(gamepad_num)        (1 << ((gamepad_num) + 16))         // Bits 17 - 20
+#define PIPELINE_NOTIFY_STATE(controller_num)   (1 << ((controller_num) + 20))      // Bits 21 - 28
+
+// Controller fields owned by the BTstack core that the pipeline works from
+typedef struct {
+    uint8_t registered;
+    uint8_t connected;
+    uint8_t gamepad_num;
+    enum HID_DEVICE type;
+    uint8_t imu_enabled;
+    enum WMP_TYPE wmp_type;
+    uint8_t wmp_active;
+    enum EXTENSION_TYPE extension_type;
+    uint8_t player_num;     // LEDs last set
+    uint8_t rumble;
+    uint8_t rumble_pattern_repetitions;
+} controller_state_t;
+
+// Latest status report of a controller, along with its state when the report arrived (or changed)
+typedef struct {
+    uint8_t data[64];
+    uint8_t len;
+    uint64_t time;  // Arrival time (us)
+    controller_state_t state;
+} controller_snapshot_t;
+
+enum PIPELINE_REQUEST_TYPE { REQ_RUMBLE, REQ_RUMBLE_PATTERN, REQ_SET_LEDS, REQ_QUEUE_COMMAND, REQ_DISCONNECT };
+typedef struct {
+    enum PIPELINE_REQUEST_TYPE type;
+    hid_controller_t * controller;
+    const hid_command_t * command;
+    uint8_t arg[PIPELINE_REQUEST_ARG_LEN];
+    uint16_t params[3];
+} pipeline_request_t;
+
+void pipeline_init();
+
+// Called from the BTstack core
+void pipeline_push_report(hid_controller_t * controller, uint8_t * report, uint8_t report_len);
+void pipeline_sync_states();
+void pipeline_reset_gamepad(uint8_t gamepad_num, uint8_t reset);
+void pipeline_notify_uart();
+calibration_t * pipeline_staged_calibration(uint8_t gamepad_num);
+void pipeline_publish_calibration(uint8_t gamepad_num, uint8_t groups);
+void pipeline_handle_requests();
+
+// Called from the pipeline task
+controller_state_t * pipeline_controller_state(hid_controller_t * controller);
+void pipeline_get_controllers(uint8_t gamepad_num, hid_controller_t ** controller_main, hid_controller_t ** controller_secondary, uint8_t connection_required);
+
+// Called from the pipeline task, carried out on the BTstack core
+void pipeline_controller_rumble(hid_controller_t * controller, uint8_t level);
+void pipeline_controller_rumble_pattern(hid_controller_t * controller, uint16_t on_period, uint16_t off_period, uint8_t repetitions);
+void pipeline_controller_set_leds(hid_controller_t * controller, uint8_t player_num);
+void pipeline_queue_command(hid_controller_t * controller, const hid_command_t * command, uint8_t * arg);
+void pipeline_controller_disconnect(hid_controller_t * controller);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "hid_controller.h"
+#include "reconnect.h"
+#include "registry.h"
+#include "timer.h"
+#include "trace.h"
+#include "uart_controller.h"
+
+static uint8_t reconnect_active = 0;
+static uint64_t reconnect_timer;
+
+// Link keys live in flash (TLV), so they are mirrored in RAM to keep flash reads off the connection path
+static const btstack_link_key_db_t * link_key_db_flash;
+static link_key_cache_entry_t link_key_cache[LINK_KEY_CACHE_SIZE];
+
+static link_key_cache_entry_t * link_key_cache_find(uint8_t * addr) {
+    uint8_t i;
+    for (i = 0; i < LINK_KEY_CACHE_SIZE; i++) {
+        if (link_key_cache[i].used && !memcmp(link_key_cache[i].address, addr, 6)) return &link_key_cache[i];
+    }
+    return NULL;
+}
+
+static void link_key_cache_put(uint8_t * addr, uint8_t * key, link_key_type_t type) {
+    uint8_t i;
+    link_key_cache_entry_t * entry = link_key_cache_find(addr);
+    for (i = 0; !entry && i < LINK_KEY_CACHE_SIZE; i++) {
+        if (!link_key_cache[i].used) entry = &link_key_cache[i];
+    }
+    if (!entry) return;     // Full, lookups for this address fall through to flash
+    memcpy(entry->address, addr, 6);
+    memcpy(entry->key, key, 16);
+    entry->type = type;
+    entry->used = 1;
+}
+
+static void link_key_cache_load() {
+    btstack_link_key_iterator_t it;
+    bd_addr_t addr;
+    link_key_t key;
+    link_key_type_t type;
+    uint8_t num = 0;
+
+    memset(link_key_cache, 0, sizeof(link_key_cache));
+    if (!link_key_db_flash->iterator_init(&it)) return;
+    while (num < LINK_KEY_CACHE_SIZE && link_key_db_flash->iterator_get_next(&it, addr, key, &type)) {
+        link_key_cache_put(addr, key, type);
+        num++;
+    }
+    link_key_db_flash->iterator_done(&it);
+    printf("Loaded %d link keys\n", num);
+}
+
+static void link_key_cache_open() {
+    link_key_db_flash->open();
+}
+
+static void link_key_cache_set_local_bd_addr(bd_addr_t addr) {
+    link_key_db_flash->set_local_bd_addr(addr);
+    link_key_cache_load();  // Keys are stored per local address
+}
+
+static void link_key_cache_close() {
+    link_key_db_flash->close();
+}
+
+static int link_key_cache_get(bd_addr_t addr, link_key_t key, link_key_type_t * type) {
+    link_key_cache_entry_t * entry = link_key_cache_find(addr);
+    if (!entry) return link_key_db_flash->get_link_key(addr, key, type);
+    memcpy(key, entry->key, 16);
+    *type = entry->type;
+    return 1;
+}
+
+static void link_key_cache_store(bd_addr_t addr, link_key_t key, link_key_type_t type) {
+    link_key_cache_put(addr, key, type);
+    link_key_db_flash->put_link_key(addr, key, type);
+}
+
+static void link_key_cache_delete(bd_addr_t addr) {
+    link_key_cache_entry_t * entry = link_key_cache_find(addr);
+    if (entry) entry->used = 0;
+    link_key_db_flash->delete_link_key(addr);
+}
+
+static int link_key_cache_iterator_init(btstack_link_key_iterator_t * it) {
+    return link_key_db_flash->iterator_init(it);
+}
+
+static int link_key_cache_iterator_get_next(btstack_link_key_iterator_t * it, bd_addr_t addr, link_key_t key, link_key_type_t * type) {
+    return link_key_db_flash->iterator_get_next(it, addr, key, type);
+}
+
+static void link_key_cache_iterator_done(btstack_link_key_iterator_t * it) {
+    link_key_db_flash->iterator_done(it);
+}
+
+static const btstack_link_key_db_t link_key_cache_db = {
+    &link_key_cache_open,
+    &link_key_cache_set_local_bd_addr,
+    &link_key_cache_close,
+    &link_key_cache_get,
+    &link_key_cache_store,
+    &link_key_cache_delete,
+    &link_key_cache_iterator_init,
+    &link_key_cache_iterator_get_next,
+    &link_key_cache_iterator_done,
+};
+
+// Called before the HCI is powered on
+void init_reconnect() {
+    const btstack_tlv_t * tlv_impl;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    link_key_db_flash = btstack_link_key_db_tlv_get_instance(tlv_impl, tlv_context);
+    hci_set_link_key_db(&link_key_cache_db);
+}
+
+// Called once the HCI is working and whenever a controller disconnects
+void reconnect_start() {
+    if (!reconnect_active) {
+        gap_set_page_scan_type(RECONNECT_SCAN_TYPE);
+        gap_set_page_scan_activity(RECONNECT_SCAN_INTERVAL, RECONNECT_SCAN_WINDOW);
+        reconnect_active = 1;
+    }
+    reconnect_timer = app_timer;
+}
+
+// Called from the app loop, returns to the slower page scan once the window has passed
+void reconnect_handle() {
+    if (reconnect_active && (app_timer - reconnect_timer >= RECONNECT_WINDOW)) {
+        gap_set_page_scan_type(IDLE_SCAN_TYPE);
+        gap_set_page_scan_activity(IDLE_SCAN_INTERVAL, IDLE_SCAN_WINDOW);
+        reconnect_active = 0;
+    }
+}
+
+// Known controllers are registered as soon as they page, so their L2CAP channels are accepted without a lookup
+void reconnect_connection_request(uint8_t * addr) {
+    hid_controller_t * controller = get_controller_from_addr(addr);
+    enum HID_DEVICE type;
+
+    if (!controller) {
+        if (joycon_right.connected && !memcmp(addr, joycon_right.address, 6)) return;  // Wired controllers are rejected later
+        if (joycon_left.connected && !memcmp(addr, joycon_left.address, 6)) return;
+        type = registry_get_type(addr);
+        if (type == CNT_NONE) return;
+        controller = register_controller(type, addr);
+        if (!controller) return;
+    }
+    if (!controller->connected) {
+        controller->time_connect_request = app_timer;
+        controller->time_connect_acl = 0;
+        controller->time_connect_hid = 0;
+    }
+}
+
+void reconnect_connection_complete(uint8_t * addr, uint8_t status) {
+    hid_controller_t * controller = get_controller_from_addr(addr);
+    if (!controller || controller->connected) return;
+    if (status != ERROR_CODE_SUCCESS) {
+        if (!controller->l2cap_control_cid && !controller->l2cap_interrupt_cid && !controller->pairing) controller_reset(controller);  // Pre-registered but never connected
+    } else controller->time_connect_acl = app_timer;
+}
+
+void reconnect_hid_opened(hid_controller_t * controller) {
+    controller->time_connect_hid = app_timer;
+}
+
+// Logs the time from the controller paging the ESP32 to its first input report
+void reconnect_first_report(hid_controller_t * controller) {
+    uint64_t request = controller->time_connect_request;
+    controller->time_connect_request = 0;
+    printf("Controller live after %" PRIu64 " ms (ACL %" PRIu64 " ms, HID %" PRIu64 " ms, %s page scan)\n",
+        app_timer - request,
+        controller->time_connect_acl ? controller->time_connect_acl - request : 0,
+        controller->time_connect_hid ? controller->time_connect_hid - request : 0,
+        reconnect_active ? "fast" : "idle");
+    trace_event((controller - get_controller(1)) + 1, EVT_LIVE, reconnect_active);
+}
\ No newline at end of file
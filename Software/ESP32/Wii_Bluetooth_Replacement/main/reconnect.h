@@ -0,0 +1,32 @@
+#ifndef _RECONNECT_H_
+#define	_RECONNECT_H_
+
+#include "hid_controller.h"
+
+// After boot or a disconnect the ESP32 scans for pages more often, so known controllers get through on their first attempts
+#define RECONNECT_WINDOW        30000   // Time (ms) fast page scan stays on
+#define RECONNECT_SCAN_INTERVAL 0x0040  // 40 ms (0.625 ms units)
+#define RECONNECT_SCAN_WINDOW   0x0012  // 11.25 ms
+#define RECONNECT_SCAN_TYPE     PAGE_SCAN_MODE_INTERLACED
+#define IDLE_SCAN_INTERVAL      0x0800  // 1.28 s, controller default
+#define IDLE_SCAN_WINDOW        0x0012
+#define IDLE_SCAN_TYPE          PAGE_SCAN_MODE_STANDARD
+
+#define LINK_KEY_CACHE_SIZE     16      // Link keys held in RAM
+
+typedef struct {
+    uint8_t address[6];
+    link_key_t key;
+    link_key_type_t type;
+    uint8_t used;
+} link_key_cache_entry_t;
+
+void init_reconnect();
+void reconnect_start();
+void reconnect_handle();
+void reconnect_connection_request(uint8_t * addr);
+void reconnect_connection_complete(uint8_t * addr, uint8_t status);
+void reconnect_hid_opened(hid_controller_t * controller);
+void reconnect_first_report(hid_controller_t * controller);
+
+#endif
\ No newline at end of file
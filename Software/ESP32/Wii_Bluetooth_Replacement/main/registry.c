@@ -0,0 +1,157 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "btstack.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "pair.h"
+#include "registry.h"
+#include "timer.h"
+#include "trace.h"
+
+static registry_entry_t registry[REGISTRY_SIZE];
+static uint8_t registry_index[REGISTRY_INDEX_SIZE];   // Entry number + 1, 0 if the slot is empty
+static uint8_t registry_num = 0;
+static uint8_t registry_evict_pos = 0;
+static uint8_t registry_dirty = 0;
+static uint64_t registry_change_time;
+
+// Low address bytes are the most random part of a MAC
+static uint8_t registry_hash(uint8_t * addr) {
+    return (addr[5] ^ (addr[4] << 1) ^ (addr[3] << 2)) & (REGISTRY_INDEX_SIZE - 1);
+}
+
+// Returns the index slot holding this address, or the empty slot it would go in
+static uint8_t registry_find_slot(uint8_t * addr) {
+    uint8_t slot = registry_hash(addr);
+    while (registry_index[slot] && memcmp(registry[registry_index[slot] - 1].address, addr, 6)) slot = (slot + 1) & (REGISTRY_INDEX_SIZE - 1);
+    return slot;
+}
+
+static void registry_rebuild_index() {
+    uint8_t i;
+    memset(registry_index, 0, sizeof(registry_index));
+    for (i = 0; i < registry_num; i++) registry_index[registry_find_slot(registry[i].address)] = i + 1;
+}
+
+static uint8_t registry_parse_key(const char * key, uint8_t * addr) {
+    uint8_t i, j, nibble;
+    if (strlen(key) != 12) return 0;
+    for (i = 0; i < 6; i++) {
+        addr[i] = 0;
+        for (j = 0; j < 2; j++) {
+            char c = key[2 * i + j];
+            if (c >= '0' && c <= '9') nibble = c - '0';
+            else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+            else return 0;
+            addr[i] = (addr[i] << 4) | nibble;
+        }
+    }
+    return 1;
+}
+
+static registry_entry_t * registry_add(uint8_t * addr) {
+    registry_entry_t * entry;
+    uint8_t i;
+
+    for (i = 0; i < registry_num; i++) {
+        if (registry[i].evicted && !memcmp(registry[i].evicted_address, addr, 6)) registry[i].evicted = 0;  // Came back before the erase was written
+    }
+    if (registry_num < REGISTRY_SIZE) {
+        entry = &registry[registry_num++];
+        memset(entry, 0, sizeof(registry_entry_t));
+    } else {
+        entry = &registry[registry_evict_pos];  // Full, reuse entries in turn
+        registry_evict_pos = (registry_evict_pos + 1) % REGISTRY_SIZE;
+        if (!entry->evicted) {
+            memcpy(entry->evicted_address, entry->address, 6);
+            entry->evicted = 1;
+        }
+    }
+    memcpy(entry->address, addr, 6);
+    registry_rebuild_index();
+    return entry;
+}
+
+// Called once at boot
+void init_registry() {
+    esp_err_t err;
+    nvs_handle_t handle;
+    nvs_iterator_t it;
+    nvs_entry_info_t info;
+    uint8_t addr[6];
+    int8_t val;
+
+    err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        nvs_flash_init();
+    }
+    if (nvs_open(REGISTRY_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;  // Nothing stored yet
+
+    it = nvs_entry_find(NVS_DEFAULT_PART_NAME, REGISTRY_NAMESPACE, NVS_TYPE_I8);
+    while (it && registry_num < REGISTRY_SIZE) {
+        nvs_entry_info(it, &info);
+        if (registry_parse_key(info.key, addr) && (nvs_get_i8(handle, info.key, &val) == ESP_OK) && (val > CNT_NONE) && (val <= CNT_WIIU_PRO)) {
+            memcpy(registry[registry_num].address, addr, 6);
+            registry[registry_num].type = (enum HID_DEVICE)val;
+            registry_num++;
+        }
+        it = nvs_entry_next(it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(handle);
+    registry_rebuild_index();
+    printf("Loaded %d known controllers\n", registry_num);
+}
+
+enum HID_DEVICE registry_get_type(uint8_t * addr) {
+    uint8_t slot = registry_find_slot(addr);
+    if (!registry_index[slot]) return CNT_NONE;
+    return registry[registry_index[slot] - 1].type;
+}
+
+// Only updates RAM, registry_write_handle() writes it out later
+void registry_set_type(enum HID_DEVICE type, uint8_t * addr) {
+    registry_entry_t * entry;
+    uint8_t slot = registry_find_slot(addr);
+    uint8_t data[7];    // Type and address for the trace
+
+    if (registry_index[slot]) {
+        entry = &registry[registry_index[slot] - 1];
+        if (entry->type == type) return;
+    } else entry = registry_add(addr);
+
+    data[0] = type;
+    memcpy(&data[1], addr, 6);
+    trace_event_data(0, EVT_TYPE_STORED, data, sizeof(data));
+    entry->type = type;
+    entry->dirty = 1;
+    registry_dirty = 1;
+    registry_change_time = app_timer;
+}
+
+// Called from the app loop, writes all pending changes with a single commit once they have settled
+void registry_write_handle() {
+    nvs_handle_t handle;
+    char mac_string[13];
+    uint8_t i;
+
+    if (!registry_dirty || (app_timer - registry_change_time < REGISTRY_WRITE_DELAY)) return;
+    registry_dirty = 0;
+    if (nvs_open(REGISTRY_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    for (i = 0; i < registry_num; i++) {
+        if (registry[i].evicted) {
+            get_mac_address_string(registry[i].evicted_address, mac_string);
+            nvs_erase_key(handle, mac_string);
+            registry[i].evicted = 0;
+        }
+        if (registry[i].dirty) {
+            get_mac_address_string(registry[i].address, mac_string);
+            nvs_set_i8(handle, mac_string, (int8_t)registry[i].type);
+            registry[i].dirty = 0;
+        }
+    }
+    nvs_commit(handle);
+    nvs_close(handle);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _REGISTRY_H_
+#define	_REGISTRY_H_
+
+#include "hid_controller.h"
+
+// Known controller types are loaded from NVS once at boot, so accepting a connection never touches flash
+#define REGISTRY_NAMESPACE  "storage"   // One i8 entry per controller, keyed by MAC hex string
+#define REGISTRY_SIZE       32          // Controllers remembered
+#define REGISTRY_INDEX_SIZE 64          // Hash index slots (power of 2, larger than REGISTRY_SIZE)
+#define REGISTRY_WRITE_DELAY    2000    // Time (ms) changes are held in RAM before being written together
+
+typedef struct {
+    uint8_t address[6];
+    enum HID_DEVICE type;
+    uint8_t dirty;              // Type not yet written to NVS
+    uint8_t evicted;            // Entry reused, the previous address must be erased from NVS
+    uint8_t evicted_address[6];
+} registry_entry_t;
+
+void init_registry();
+enum HID_DEVICE registry_get_type(uint8_t * addr);
+void registry_set_type(enum HID_DEVICE type, uint8_t * addr);
+void registry_write_handle();
+
+#endif
\ No newline at end of file
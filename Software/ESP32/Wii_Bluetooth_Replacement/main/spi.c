@@ -2,21 +2,40 @@
 #include "btstack.h"
 #include "driver/spi_slave.h"
 #include "driver/gpio.h"
+#include "driver/timer.h"
+#include "latency.h"
 #include "spi.h"
 
+// Frames are written into a free buffer, published once complete, then queued with the slave driver.
+// Buffer states only change in task context so the transaction callback doesn't need locking.
+typedef struct {
+    uint8_t * tx_buf;
+    uint8_t * rx_buf;
+    enum SPI_BUF_STATE state;
+    uint32_t seq;   // Order buffers were published in
+} spi_buf_t;
+
 spi_slave_transaction_t transaction;
-uint8_t * recv_buf;
-uint8_t * send_buf;
-uint8_t send_buf_pos = 0;
-uint8_t recv_data_ready = 0;
+spi_buf_t spi_bufs[SPI_NUM_BUFS];
+spi_buf_t * writing_buf = NULL;
+spi_buf_t * in_flight_buf = NULL;
+uint16_t send_buf_pos = 0;
+uint32_t publish_seq = 0;
+uint8_t recv_buf[SPI_FRAME_LEN];
+volatile uint8_t recv_data_ready = 0;
+volatile uint64_t recv_done_time = 0;   // Transfer completion (us), read with the result in task context
+uint8_t spi_enabled = 0;
 
 // Called when master has completed a transaction
 void spi_slave_post_trans_cb() {
+    recv_done_time = timer_group_get_counter_value_in_isr(TIMER_GROUP_1, TIMER_1);
     recv_data_ready = 1;
     gpio_set_level(SPI_EN, 0);
 }
 
 void spi_slave_init(uint64_t mosi_pin, uint64_t miso_pin, uint64_t sclk_pin, uint64_t cs_pin) {
+    uint8_t i;
+
     spi_bus_config_t bus_cfg = {
         .mosi_io_num = mosi_pin,
         .miso_io_num = miso_pin,
@@ -26,7 +45,7 @@ void spi_slave_init(uint64_t mosi_pin, uint64_t miso_pin, uint64_t sclk_pin, uin
     spi_slave_interface_config_t slv_cfg = {
         .mode = 1,
         .spics_io_num = cs_pin,
-        .queue_size = 8,
+        .queue_size = 1,    // Only the latest frame is ever queued
         .flags = 0,
         //.post_setup_cb = spi_slave_post_setup_cb,
         .post_trans_cb = spi_slave_post_trans_cb
@@ -34,38 +53,105 @@ void spi_slave_init(uint64_t mosi_pin, uint64_t miso_pin, uint64_t sclk_pin, uin
 
     spi_slave_initialize(VSPI_HOST, &bus_cfg, &slv_cfg, 1);
     memset(&transaction, 0, sizeof(transaction));
+    memset(recv_buf, 0, SPI_FRAME_LEN);
+
+    for (i = 0; i < SPI_NUM_BUFS; i++) {
+        spi_bufs[i].tx_buf = heap_caps_malloc(SPI_FRAME_LEN, MALLOC_CAP_DMA);
+        spi_bufs[i].rx_buf = heap_caps_malloc(SPI_FRAME_LEN, MALLOC_CAP_DMA);
+        spi_bufs[i].state = SPI_BUF_FREE;
+    }
+}
+
+// Queue the most recently published frame if the driver is idle
+static void spi_slave_queue_latest() {
+    spi_buf_t * latest = NULL;
+    uint8_t i;
+
+    if (in_flight_buf || !spi_enabled) return;
+
+    for (i = 0; i < SPI_NUM_BUFS; i++) {
+        if ((spi_bufs[i].state == SPI_BUF_PUBLISHED) && (!latest || (int32_t)(spi_bufs[i].seq - latest->seq) > 0)) latest = &spi_bufs[i];
+    }
+    if (!latest) return;
+
+    transaction.length = SPI_FRAME_LEN * 8;
+    transaction.tx_buffer = latest->tx_buf;
+    transaction.rx_buffer = latest->rx_buf;
+    if (spi_slave_queue_trans(VSPI_HOST, &transaction, 0) == ESP_OK) {
+        latest->state = SPI_BUF_IN_FLIGHT;
+        in_flight_buf = latest;
+        gpio_set_level(SPI_EN, 1);  // Let master know a frame is ready
+    }
+}
 
-    recv_buf = heap_caps_malloc(128, MALLOC_CAP_DMA);
-    send_buf = heap_caps_malloc(128, MALLOC_CAP_DMA);
+// Allow transfers once the rest of the system is running
+void spi_slave_enable() {
+    spi_enabled = 1;
+    spi_slave_queue_latest();
 }
 
 uint8_t spi_slave_queue_data(uint8_t * data_buf, uint8_t data_len) {
-    if (data_len + send_buf_pos > 128) data_len = 128 - send_buf_pos;
-    memcpy(send_buf + send_buf_pos, data_buf, data_len);
+    uint8_t i;
+
+    // Start a new frame in a free buffer
+    if (!writing_buf) {
+        for (i = 0; i < SPI_NUM_BUFS; i++) {
+            if (spi_bufs[i].state == SPI_BUF_FREE) {
+                writing_buf = &spi_bufs[i];
+                break;
+            }
+        }
+        if (!writing_buf) return 0;
+        writing_buf->state = SPI_BUF_WRITING;
+        send_buf_pos = 0;
+    }
+
+    if (data_len + send_buf_pos > SPI_FRAME_LEN) data_len = SPI_FRAME_LEN - send_buf_pos;
+    memcpy(writing_buf->tx_buf + send_buf_pos, data_buf, data_len);
     send_buf_pos += data_len;
 
-    // Queue transaction after 128 bytes have been written
-    if (send_buf_pos == 128) {
+    // Publish after a full frame has been written, dropping any older frame that was never sent
+    if (send_buf_pos == SPI_FRAME_LEN) {
+        for (i = 0; i < SPI_NUM_BUFS; i++) {
+            if (spi_bufs[i].state == SPI_BUF_PUBLISHED) spi_bufs[i].state = SPI_BUF_FREE;
+        }
+        writing_buf->seq = ++publish_seq;
+        writing_buf->state = SPI_BUF_PUBLISHED;
+        latency_spi_queued(writing_buf->seq);
+        writing_buf = NULL;
         send_buf_pos = 0;
-        transaction.length = 1024;
-        transaction.tx_buffer = send_buf;
-        transaction.rx_buffer = recv_buf;
-        if (spi_slave_queue_trans(VSPI_HOST, &transaction, 0) == ESP_OK) return 1;
+
+        spi_slave_queue_latest();
+        return 1;
     }
     return 0;
 }
 
-uint8_t * spi_slave_get_data(uint8_t * data_len) {
+uint8_t * spi_slave_get_data(uint16_t * data_len) {
     if (recv_data_ready) {
         spi_slave_transaction_t * trans_desc;
+        uint8_t * data = NULL;
+
+        recv_data_ready = 0;
         if (spi_slave_get_trans_result(VSPI_HOST, &trans_desc, 0) == ESP_OK) {
             *data_len = trans_desc->trans_len / 8;
-            recv_data_ready = 0;
-            gpio_set_level(SPI_EN, 1);
-            return recv_buf;
+            if (*data_len > SPI_FRAME_LEN) *data_len = SPI_FRAME_LEN;
+            memcpy(recv_buf, trans_desc->rx_buffer, *data_len);
+            data = recv_buf;
         }
-        recv_data_ready = 0;
-        gpio_set_level(SPI_EN, 1);
+        // Frames are only published when something changes, so keep resending the last one until there is a newer frame
+        if (in_flight_buf) {
+            uint8_t i, newer_published = 0;
+            latency_spi_done(in_flight_buf->seq, recv_done_time);
+            for (i = 0; i < SPI_NUM_BUFS; i++) {
+                if (spi_bufs[i].state == SPI_BUF_PUBLISHED) newer_published = 1;
+            }
+            in_flight_buf->state = newer_published ? SPI_BUF_FREE : SPI_BUF_PUBLISHED;
+            in_flight_buf = NULL;
+        }
+
+        spi_slave_queue_latest();
+        return data;
     }
     return NULL;
 }
\ No newline at end of file
@@ -3,9 +3,22 @@
 
 #define SPI_EN GPIO_NUM_5
 
+// Each transfer holds 4 Wiimote slots followed by 4 IMU sample slots
+#define SPI_SLOT_LEN    32
+#define SPI_FRAME_LEN   (SPI_SLOT_LEN * 8)
+
+// Wii state received from the PIC32, one message per Wiimote after the 4 status bytes
+#define SPI_DOWNSTREAM_OFFSET   32
+#define SPI_DOWNSTREAM_LEN      8
+
+#define SPI_NUM_BUFS    3   // One being written, one published and one in flight
+
+enum SPI_BUF_STATE { SPI_BUF_FREE, SPI_BUF_WRITING, SPI_BUF_PUBLISHED, SPI_BUF_IN_FLIGHT };
+
 void spi_slave_post_trans_cb();
 void spi_slave_init(uint64_t mosi_pin, uint64_t miso_pin, uint64_t sclk_pin, uint64_t cs_pin);
+void spi_slave_enable();
 uint8_t spi_slave_queue_data(uint8_t * data_buf, uint8_t data_len);
-uint8_t * spi_slave_get_data(uint8_t * data_len);
+uint8_t * spi_slave_get_data(uint16_t * data_len);
 
 #endif
\ No newline at end of file
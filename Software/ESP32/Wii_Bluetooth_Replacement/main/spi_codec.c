@@ -0,0 +1,157 @@
+#include <inttypes.h>
+#include <string.h>
+#include "spi.h"
+#include "spi_codec.h"
+#include "wiimote.h"
+
+// Wiimote slot: buttons, sticks, accelerometers, Motion Plus and IR dots
+void spi_codec_encode_wiimote(const wiimote_t * wiimote, uint8_t wiimote_num, uint8_t * buf) {
+    uint8_t i;
+
+    if (!wiimote->active) {
+        memset(buf, 0xFF, SPI_SLOT_LEN);
+        return;
+    }
+
+    memset(buf, 0, SPI_SLOT_LEN);
+    buf[0] = (wiimote->extension << 4) | wiimote_num;
+
+    buf[1] = wiimote->a | 
+            (wiimote->b << 1) |
+            (wiimote->one << 2) | 
+            (wiimote->two << 3) |
+            (wiimote->du << 4) | 
+            (wiimote->dd << 5) | 
+            (wiimote->dr << 6) | 
+            (wiimote->dl << 7);
+    
+    buf[2] = wiimote->plus | 
+            (wiimote->minus << 1) |
+            (wiimote->home << 2) | 
+            (wiimote->classic.plus << 3) | 
+            (wiimote->classic.minus << 4) | 
+            (wiimote->classic.home << 5) |
+            (wiimote->nunchuk.c << 6) | 
+            (wiimote->nunchuk.z << 7);
+    buf[3] = wiimote->classic.a | 
+            (wiimote->classic.b << 1) |
+            (wiimote->classic.x << 2) | 
+            (wiimote->classic.y << 3) | 
+            (wiimote->classic.du << 4) | 
+            (wiimote->classic.dd << 5) |
+            (wiimote->classic.dr << 6) | 
+            (wiimote->classic.dl << 7);
+    buf[4] = wiimote->classic.r | 
+            (wiimote->classic.zr << 1) |
+            (wiimote->classic.l << 2) | 
+            (wiimote->classic.zl << 3);
+
+    if (wiimote->extension == EXT_CLASSIC) {
+        buf[5] = wiimote->classic.lx;
+        buf[6] = wiimote->classic.ly;
+    } else {
+        buf[5] = wiimote->nunchuk.x;
+        buf[6] = wiimote->nunchuk.y;
+    }
+
+    buf[7] = wiimote->classic.rx;
+    buf[8] = wiimote->classic.ry;
+
+    buf[9] = wiimote->accel_x & 0xFF;
+    buf[10] = wiimote->accel_y & 0xFF;
+    buf[11] = wiimote->accel_z & 0xFF;
+    buf[12] = ((wiimote->accel_x & 0x300) >> 8) | 
+            ((wiimote->accel_y & 0x300) >> 6) | 
+            ((wiimote->accel_z & 0x300) >> 4);
+
+    buf[13] = wiimote->nunchuk.accel_x & 0xFF;
+    buf[14] = wiimote->nunchuk.accel_y & 0xFF;
+    buf[15] = wiimote->nunchuk.accel_z & 0xFF;
+    buf[16] = ((wiimote->nunchuk.accel_x & 0x300) >> 8) | 
+            ((wiimote->nunchuk.accel_y & 0x300) >> 6) | 
+            ((wiimote->nunchuk.accel_z & 0x300) >> 4);
+    
+    buf[17] = wiimote->motion_plus.yaw_speed & 0xFF;
+    buf[18] = wiimote->motion_plus.pitch_speed & 0xFF;
+    buf[19] = wiimote->motion_plus.roll_speed & 0xFF;
+    buf[20] = ((wiimote->motion_plus.yaw_speed & 0xF00) >> 8) |
+            ((wiimote->motion_plus.pitch_speed & 0xF00) >> 4);
+    buf[21] = (wiimote->motion_plus.roll_speed & 0xF00) >> 8;
+
+    if (wiimote->ir_idle) memset(buf + 22, 0xFF, 8);
+    else {
+        buf[22] = (uint16_t)FIXED_TO_INT(wiimote->ir_object[0].x) & 0xFF;
+        buf[23] = ((uint16_t)FIXED_TO_INT(wiimote->ir_object[0].x) & 0xFF00) >> 8;
+        buf[24] = (uint16_t)FIXED_TO_INT(wiimote->ir_object[0].y) & 0xFF;
+        buf[25] = ((uint16_t)FIXED_TO_INT(wiimote->ir_object[0].y) & 0xFF00) >> 8;
+        buf[26] = (uint16_t)FIXED_TO_INT(wiimote->ir_object[1].x) & 0xFF;
+        buf[27] = ((uint16_t)FIXED_TO_INT(wiimote->ir_object[1].x) & 0xFF00) >> 8;
+        buf[28] = (uint16_t)FIXED_TO_INT(wiimote->ir_object[1].y) & 0xFF;
+        buf[29] = ((uint16_t)FIXED_TO_INT(wiimote->ir_object[1].y) & 0xFF00) >> 8;
+    }
+
+    uint8_t checksum_buttons = 0, checksum_axes = 0;
+    for (i = 0; i < 4; i++) checksum_buttons += buf[i + 1];
+    checksum_buttons += 0x55;
+    for (i = 0; i < 25; i++) checksum_axes += buf[i + 5];
+    checksum_axes += 0x55;
+
+    buf[30] = checksum_buttons;
+    buf[31] = checksum_axes;
+}
+
+// IMU slot: up to IMU_SLOT_SAMPLES samples, oldest first
+void spi_codec_encode_imu(const spi_imu_sample_t * samples, uint8_t num_samples, uint8_t wiimote_num, uint8_t * buf) {
+    uint8_t i, j;
+
+    memset(buf, 0xFF, SPI_SLOT_LEN);
+    if (num_samples > IMU_SLOT_SAMPLES) num_samples = IMU_SLOT_SAMPLES;
+    buf[0] = (num_samples << 4) | wiimote_num;
+
+    for (i = 0; i < num_samples; i++) {
+        uint8_t * sample_buf = buf + 1 + (10 * i);
+
+        // Time (ms) followed by 14-bit gyro and 10-bit accel packed into 3 bytes per axis
+        sample_buf[0] = samples[i].time;
+        for (j = 0; j < 3; j++) {
+            uint32_t axis = (samples[i].gyro[j] & 0x3FFF) | ((uint32_t)(samples[i].accel[j] & 0x3FF) << 14);
+            sample_buf[1 + (3 * j)] = axis & 0xFF;
+            sample_buf[2 + (3 * j)] = (axis >> 8) & 0xFF;
+            sample_buf[3 + (3 * j)] = (axis >> 16) & 0xFF;
+        }
+    }
+
+    uint8_t checksum = 0;
+    for (i = 0; i < 31; i++) checksum += buf[i];
+    buf[31] = checksum + 0x55;
+}
+
+// Returns the Wiimote number of a status byte, or 0 if it isn't valid
+uint8_t spi_codec_decode_status(uint8_t status, uint8_t * player_num, uint8_t * rumble, uint8_t * connection_allowed) {
+    uint8_t wiimote_num = status & 0x07;
+
+    if (wiimote_num == 0 || wiimote_num > 4) return 0;
+    *connection_allowed = (status & 0x08) >> 3;
+    *player_num = (status & 0x70) >> 4;
+    *rumble = (status & 0x80) >> 7;
+    return wiimote_num;
+}
+
+// Returns the Wiimote number of a Wii state message, or 0 if it isn't valid
+uint8_t spi_codec_decode_state(const uint8_t * buf, wii_state_t * state) {
+    uint8_t wiimote_num = buf[0] & 0x07;
+    uint8_t checksum = 0x55;
+    uint8_t i;
+
+    if (wiimote_num == 0 || wiimote_num > 4) return 0;
+    for (i = 0; i < SPI_DOWNSTREAM_LEN - 1; i++) checksum += buf[i];
+    if (checksum != buf[SPI_DOWNSTREAM_LEN - 1]) return 0;
+
+    state->rumble_intensity = buf[1];
+    state->led_state = buf[2] & 0x0F;
+    state->flags = buf[3];
+    state->reporting_mode = buf[4];
+    state->speaker_format = buf[5];
+    state->speaker_volume = buf[6];
+    return wiimote_num;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef _SPI_CODEC_H_
+#define	_SPI_CODEC_H_
+
+#include "wiimote.h"
+
+// Encoding and decoding of PIC32 link frames, kept free of hardware access and global state
+
+typedef struct {
+    uint8_t time;       // Low byte of sample time (ms)
+    uint16_t gyro[3];   // 14-bit Motion Plus values (roll, pitch, yaw)
+    uint16_t accel[3];  // 10-bit accelerometer values (x, y, z)
+} spi_imu_sample_t;
+
+void spi_codec_encode_wiimote(const wiimote_t * wiimote, uint8_t wiimote_num, uint8_t * buf);
+void spi_codec_encode_imu(const spi_imu_sample_t * samples, uint8_t num_samples, uint8_t wiimote_num, uint8_t * buf);
+uint8_t spi_codec_decode_status(uint8_t status, uint8_t * player_num, uint8_t * rumble, uint8_t * connection_allowed);
+uint8_t spi_codec_decode_state(const uint8_t * buf, wii_state_t * state);
+
+#endif
\ No newline at end of file
@@ -4,5 +4,8 @@
 #define APP_LOOP_PERIOD_MS 5
 
 extern uint64_t app_timer;  // App runtime in ms
+extern uint64_t pipeline_timer; // Same clock as app_timer, read by the pipeline task for itself
+
+void app_timer_update();
 
 #endif
\ No newline at end of file
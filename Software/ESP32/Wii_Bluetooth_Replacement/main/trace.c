@@ -0,0 +1,104 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/timer.h"
+#include "trace.h"
+
+_Static_assert(sizeof(trace_record_t) == TRACE_RECORD_LEN, "Trace record layout changed");
+
+trace_record_t trace_ring[TRACE_RING_LEN];
+uint32_t trace_head = 0;    // Next record to write
+uint32_t trace_tail = 0;    // Next record to print
+uint32_t trace_dropped = 0; // Records lost since the last drain because the ring was full
+portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Fill a record outside the lock, then only hold it for the copy into the ring
+static void trace_push(trace_record_t * record) {
+    uint64_t time;
+    timer_get_counter_value(TIMER_GROUP_1, TIMER_1, &time);
+    record->time = (uint32_t)time;
+
+    portENTER_CRITICAL(&trace_mux);
+    if (trace_head - trace_tail >= TRACE_RING_LEN) trace_dropped++;
+    else {
+        memcpy(&trace_ring[trace_head % TRACE_RING_LEN], record, sizeof(trace_record_t));
+        trace_head++;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+void trace_packet(uint8_t controller_num, enum TRACE_DIR dir, uint8_t * data, uint8_t len) {
+    trace_record_t record;
+    if (!TRACE_ENABLE) return;
+
+    memset(&record, 0, sizeof(record));
+    record.controller = controller_num;
+    record.dir = dir;
+    record.len = len;
+    memcpy(record.payload, data, (len < TRACE_PAYLOAD_LEN) ? len : TRACE_PAYLOAD_LEN);
+    trace_push(&record);
+}
+
+void trace_event(uint8_t controller_num, enum TRACE_EVENT_TYPE event, uint8_t arg) {
+    trace_event_data(controller_num, event, &arg, 1);
+}
+
+// Events that carry more than one byte, the layout of the data is known to the decoder per event type
+void trace_event_data(uint8_t controller_num, enum TRACE_EVENT_TYPE event, const void * data, uint8_t len) {
+    trace_record_t record;
+    if (!TRACE_ENABLE) return;
+
+    memset(&record, 0, sizeof(record));
+    record.controller = controller_num;
+    record.dir = TRACE_EVENT;
+    record.len = len;
+    record.event = event;
+    memcpy(record.payload, data, (len < TRACE_PAYLOAD_LEN) ? len : TRACE_PAYLOAD_LEN);
+    trace_push(&record);
+}
+
+static void trace_task(void * arg) {
+    static const char hex[] = "0123456789ABCDEF";
+    trace_record_t records[8];
+    char line[3 + (TRACE_RECORD_LEN * 2) + 1];
+    uint32_t dropped;
+    uint8_t num_records;
+    uint8_t * data;
+    uint8_t i, j;
+
+    while (1) {
+        do {
+            num_records = 0;
+            portENTER_CRITICAL(&trace_mux);
+            while ((trace_tail != trace_head) && (num_records < 8)) {
+                memcpy(&records[num_records++], &trace_ring[trace_tail % TRACE_RING_LEN], sizeof(trace_record_t));
+                trace_tail++;
+            }
+            dropped = trace_dropped;
+            trace_dropped = 0;
+            portEXIT_CRITICAL(&trace_mux);
+
+            if (dropped) printf("#D %" PRIu32 "\n", dropped);
+            // Each line goes out in one write so output from other tasks can't land in the middle of a record
+            for (i = 0; i < num_records; i++) {
+                data = (uint8_t *)&records[i];
+                memcpy(line, "#T ", 3);
+                for (j = 0; j < TRACE_RECORD_LEN; j++) {
+                    line[3 + (2 * j)] = hex[data[j] >> 4];
+                    line[4 + (2 * j)] = hex[data[j] & 0x0F];
+                }
+                line[3 + (2 * TRACE_RECORD_LEN)] = '\n';
+                fwrite(line, 1, 4 + (2 * TRACE_RECORD_LEN), stdout);
+            }
+        } while (num_records == 8);
+
+        vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+    }
+}
+
+void trace_init() {
+    if (!TRACE_ENABLE) return;
+    xTaskCreatePinnedToCore(&trace_task, "trace", TRACE_TASK_STACK_SIZE, NULL, TRACE_TASK_PRIORITY, NULL, tskNO_AFFINITY);
+}
\ No newline at end of file
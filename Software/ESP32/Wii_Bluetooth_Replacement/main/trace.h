@@ -0,0 +1,35 @@
+#ifndef _TRACE_H_
+#define	_TRACE_H_
+
+// Binary trace of HID traffic and controller events. Records are copied into a RAM ring from any core and
+// printed by a low priority task as "#T <hex record>" lines (decoded on the host by trace_decode.py)
+#define TRACE_ENABLE        1
+#define TRACE_RECORD_LEN    32
+#define TRACE_PAYLOAD_LEN   24
+#define TRACE_RING_LEN      128     // Records (power of 2)
+#define TRACE_DRAIN_PERIOD_MS   20
+#define TRACE_TASK_PRIORITY 1
+#define TRACE_TASK_STACK_SIZE   3072
+
+enum TRACE_DIR { TRACE_CMD = 0, TRACE_RESPONSE = 1, TRACE_EVENT = 2 };
+enum TRACE_EVENT_TYPE { EVT_NONE = 0, EVT_REGISTERED, EVT_CONNECTED, EVT_DISCONNECTED, EVT_EXT_PLUGGED, EVT_EXT_UNPLUGGED,
+                        EVT_WMP_FOUND, EVT_WMP_NOT_FOUND, EVT_WMP_ACTIVATED, EVT_IMU_ENABLED, EVT_IMU_DISABLED,
+                        EVT_CMD_RETRY, EVT_CMD_TIMEOUT, EVT_LIVE, EVT_REQ_DROPPED, EVT_CAL, EVT_CAL_FROM_CACHE, EVT_CAL_CACHED,
+                        EVT_GYRO_CALIBRATING, EVT_GYRO_CALIBRATED, EVT_TYPE_STORED, EVT_DEVICE_FOUND };
+
+// Layout is fixed so the host decoder can unpack it directly (little endian)
+typedef struct {
+    uint32_t time;          // us, wraps every ~71 minutes
+    uint8_t controller;     // Controller number (0 if none)
+    uint8_t dir;            // enum TRACE_DIR
+    uint8_t len;            // Full length of the packet, payload holds at most TRACE_PAYLOAD_LEN bytes of it
+    uint8_t event;          // enum TRACE_EVENT_TYPE for event records
+    uint8_t payload[TRACE_PAYLOAD_LEN];
+} trace_record_t;
+
+void trace_init();
+void trace_packet(uint8_t controller_num, enum TRACE_DIR dir, uint8_t * data, uint8_t len);
+void trace_event(uint8_t controller_num, enum TRACE_EVENT_TYPE event, uint8_t arg);
+void trace_event_data(uint8_t controller_num, enum TRACE_EVENT_TYPE event, const void * data, uint8_t len);
+
+#endif
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "gamepad.h"
 #include "timer.h"
 #include "uart_controller.h"
+#include "pipeline.h"
 #include "pair.h"
 
 // Subcommand format:
@@ -85,8 +86,8 @@ uart_joycon_t joycon_right;
 uart_joycon_t joycon_left;
 gpio_config_t pin_config; 
 
+// Only called from the RX task, which owns the port for sending as well as receiving
 static void uart_joycon_write_next_command(uart_joycon_t * joycon) {
-	uint8_t i;
 	if (joycon->handshake_pos == 10) {
 		uart_handshake_commands[joycon->handshake_pos][25] = host_mac_addr[5];
 		uart_handshake_commands[joycon->handshake_pos][26] = host_mac_addr[4];
@@ -95,56 +96,115 @@ static void uart_joycon_write_next_command(uart_joycon_t * joycon) {
 		uart_handshake_commands[joycon->handshake_pos][29] = host_mac_addr[1];
 		uart_handshake_commands[joycon->handshake_pos][30] = host_mac_addr[0];
 	}
-	for (i = 1; i <= uart_handshake_commands[joycon->handshake_pos][0]; i++) joycon->uart_port->fifo.rw_byte = uart_handshake_commands[joycon->handshake_pos][i];
+	uart_write_bytes(joycon->uart_num, (const char *)&uart_handshake_commands[joycon->handshake_pos][1], uart_handshake_commands[joycon->handshake_pos][0]);
 	if (joycon->handshake_pos < 14) joycon->handshake_pos++;
 }
 
-static void uart_joycon_intr_handle(uart_joycon_t * joycon) {
-	if (!joycon->chars_remaining) gpio_set_level(joycon->rx_en_pin, 0);
-	uart_disable_rx_intr(joycon->uart_num);
-	uart_clear_intr_status(joycon->uart_num, UART_RXFIFO_FULL_INT_CLR | UART_RXFIFO_TOUT_INT_CLR);
-	
-	uint16_t rx_fifo_len;
-	rx_fifo_len = joycon->uart_port->status.rxfifo_cnt;
-
-	if (!joycon->chars_remaining) {
-		joycon->message_started = 1;
-		joycon->message_len = 0;
-	} else if (rx_fifo_len >= joycon->chars_remaining) {
-		joycon->message_started = 0;	// Message ends when remaining chars are received
-		joycon->chars_remaining = 0;
-	}
-	
-	// Read data
-	while(rx_fifo_len){
-		joycon->rx_buf[joycon->message_len] = joycon->uart_port->fifo.rw_byte;
-		joycon->message_len++;
-		rx_fifo_len--;
-	}
+// Input is double buffered so the pipeline never reads a frame while the RX task writes it
+static void uart_joycon_publish_input(uart_joycon_t * joycon) {
+	joycon->input_seq++;
+	__sync_synchronize();
+	memcpy(joycon->input_buf[joycon->input_latest ^ 1], joycon->frame_buf, UART_JOYCON_FRAME_LEN);
+	joycon->input_latest ^= 1;
+	__sync_synchronize();
+	joycon->input_seq++;
+}
 
-	if (joycon->message_started) {
-		joycon->chars_remaining = joycon->rx_buf[3] + 5 - joycon->message_len;
-		if (joycon->chars_remaining > 0) joycon->uart_intr.rxfifo_full_thresh = joycon->chars_remaining;
-		else joycon->chars_remaining = 8;	// Assuming 8 chars remaining
-	} else {
-		joycon->message_received = 1;
-		joycon->uart_intr.rxfifo_full_thresh = 4;	// Wait for next command header
-		if (!gpio_get_level(joycon->tx_en_pin)) uart_joycon_write_next_command(joycon);
-		else joycon->command_queued = 1;
-		if (!memcmp(joycon->rx_buf, uart_response_baud_switched, 12)) joycon->baud_switch_queued = 1;
-	}
-	uart_intr_config(joycon->uart_num, &joycon->uart_intr);
-	uart_enable_rx_intr(joycon->uart_num);
+// Called from the pipeline, retries if the RX task published a newer frame during the copy
+void uart_joycon_read_input(uart_joycon_t * joycon, uint8_t * data) {
+	uint32_t seq;
 
-	gpio_set_level(joycon->rx_en_pin, 1);
+	do {
+		seq = joycon->input_seq;
+		__sync_synchronize();
+		memcpy(data, joycon->input_buf[joycon->input_latest], UART_JOYCON_FRAME_LEN);
+		__sync_synchronize();
+	} while ((seq & 1) || (joycon->input_seq != seq));
 }
 
-static void joycon_right_intr_handle(void *arg) {
-	uart_joycon_intr_handle(&joycon_right);
+static void uart_joycon_frame_received(uart_joycon_t * joycon) {
+	uart_joycon_frame_t frame;
+
+	if (!memcmp(joycon->frame_buf, uart_response_baud_switched, 12)) joycon->baud_switch_queued = 1;
+
+	// Input goes straight to the pipeline
+	if (!memcmp(joycon->frame_buf, uart_status_response_header, 8)) {
+		uart_joycon_publish_input(joycon);
+		joycon->data_ready = 1;
+		pipeline_notify_uart();
+	} else joycon->data_ready = 0;
+
+	// Every message is also queued for uart_joycon_handle, subcommand replies share the input header
+	frame.len = (joycon->frame_len < UART_JOYCON_FRAME_LEN) ? joycon->frame_len : UART_JOYCON_FRAME_LEN;
+	memcpy(frame.data, joycon->frame_buf, frame.len);
+	xQueueSend(joycon->frame_queue, &frame, 0);	// Dropped if the loop falls behind
+
+	if (!gpio_get_level(joycon->tx_en_pin)) uart_joycon_write_next_command(joycon);
+	else joycon->command_queued = 1;
 }
 
-static void joycon_left_intr_handle(void *arg) {
-	uart_joycon_intr_handle(&joycon_left);
+// Messages start with 0x19 0x81, byte 3 holds the number of bytes after the 5 byte header
+static void uart_joycon_parse(uart_joycon_t * joycon, uint8_t * data, uint16_t len) {
+	uint16_t i;
+
+	for (i = 0; i < len; i++) {
+		if ((joycon->frame_len == 0) && (data[i] != 0x19)) continue;
+		if ((joycon->frame_len == 1) && (data[i] != 0x81)) {
+			joycon->frame_len = (data[i] == 0x19) ? 1 : 0;	// Resync on the next header
+			continue;
+		}
+
+		joycon->frame_buf[joycon->frame_len++] = data[i];
+		if (joycon->frame_len == 4) {
+			joycon->frame_expected = data[i] + 5;
+			if (joycon->frame_expected > sizeof(joycon->frame_buf)) joycon->frame_len = 0;
+		} else if ((joycon->frame_len > 4) && (joycon->frame_len == joycon->frame_expected)) {
+			uart_joycon_frame_received(joycon);
+			joycon->frame_len = 0;
+		}
+	}
+}
+
+static void uart_joycon_rx_task(void * arg) {
+	uart_joycon_t * joycon = (uart_joycon_t *)arg;
+	uart_event_t event;
+	uint8_t data[128];
+	int len;
+
+	while (1) {
+		if (xQueueReceive(joycon->event_queue, &event, portMAX_DELAY) != pdTRUE) continue;
+		if (joycon->rx_reset) {
+			joycon->rx_reset = 0;
+			joycon->frame_len = 0;
+			joycon->handshake_pos = 0;
+		}
+
+		switch (event.type) {
+			case UART_DATA:
+				do {
+					len = uart_read_bytes(joycon->uart_num, data, sizeof(data), 0);
+					if (len > 0) uart_joycon_parse(joycon, data, len);
+				} while (len == sizeof(data));
+				break;
+			case UART_FIFO_OVF:
+			case UART_BUFFER_FULL:
+				// Bytes were lost, so drop everything up to the next header
+				uart_flush_input(joycon->uart_num);
+				xQueueReset(joycon->event_queue);
+				joycon->send_requested = 0;	// A send event may have been dropped as well
+				joycon->frame_len = 0;
+				break;
+			case UART_JOYCON_EVENT_SEND:
+				joycon->send_requested = 0;
+				if (joycon->command_queued && !gpio_get_level(joycon->tx_en_pin)) {
+					joycon->command_queued = 0;
+					uart_joycon_write_next_command(joycon);
+				}
+				break;
+			default:
+				break;
+		}
+	}
 }
 
 static void uart_joycon_setup(uart_joycon_t * joycon) {
@@ -162,10 +222,8 @@ static void uart_joycon_setup(uart_joycon_t * joycon) {
 	uart_set_pin(joycon->uart_num, joycon->tx_pin, joycon->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
     uart_set_line_inverse(joycon->uart_num, UART_INVERSE_TXD);
 
-	uart_driver_install(joycon->uart_num, 2048, 0, 0, NULL, 0);
-	uart_isr_free(joycon->uart_num);
-	if (joycon->type == UART_JOYCON_R) uart_isr_register(joycon->uart_num, joycon_right_intr_handle, NULL, ESP_INTR_FLAG_LOWMED, NULL);
-	else if (joycon->type == UART_JOYCON_L) uart_isr_register(joycon->uart_num, joycon_left_intr_handle, NULL, ESP_INTR_FLAG_LOWMED, NULL);
+	uart_driver_install(joycon->uart_num, UART_JOYCON_RX_BUF_LEN, 0, UART_JOYCON_EVENT_QUEUE_LEN, &joycon->event_queue, 0);
+	joycon->frame_queue = xQueueCreate(UART_JOYCON_FRAME_QUEUE_LEN, sizeof(uart_joycon_frame_t));
 
 	joycon->uart_intr.intr_enable_mask = UART_RXFIFO_FULL_INT_ENA_M
 									   | UART_RXFIFO_TOUT_INT_ENA_M
@@ -173,11 +231,12 @@ static void uart_joycon_setup(uart_joycon_t * joycon) {
 									   | UART_RXFIFO_OVF_INT_ENA_M
 									   | UART_BRK_DET_INT_ENA_M
 									   | UART_PARITY_ERR_INT_ENA_M;
-    joycon->uart_intr.rxfifo_full_thresh = 4;
-    joycon->uart_intr.rx_timeout_thresh = 10;
+    joycon->uart_intr.rxfifo_full_thresh = UART_JOYCON_RX_FULL_THRESH;
+    joycon->uart_intr.rx_timeout_thresh = UART_JOYCON_RX_TIMEOUT;
     joycon->uart_intr.txfifo_empty_intr_thresh = 10;
-	uart_intr_config(joycon->uart_num, &joycon->uart_intr);
+	uart_intr_config(joycon->uart_num, &joycon->uart_intr);	// Set once, message boundaries are found by the RX task
 	uart_enable_rx_intr(joycon->uart_num);
+	xTaskCreatePinnedToCore(&uart_joycon_rx_task, (joycon->type == UART_JOYCON_R) ? "joycon_r_rx" : "joycon_l_rx", UART_JOYCON_TASK_STACK_SIZE, joycon, UART_JOYCON_TASK_PRIORITY, NULL, tskNO_AFFINITY);
 
 	joycon->command_queued = 1;
 	joycon->connected = 0;
@@ -224,6 +283,11 @@ void uart_set_cal_imu(uart_joycon_t * joycon) {
 	printf("Gyro Z offset: %d\n", joycon->gyro_z_offset);
 }
 
+static void uart_build_joy_maps(uart_joycon_t * joycon) {
+	joystick_build_map(&joycon->joy_x_map, joycon->joy_x_min, joycon->joy_x_center, joycon->joy_x_max);
+	joystick_build_map(&joycon->joy_y_map, joycon->joy_y_min, joycon->joy_y_center, joycon->joy_y_max);
+}
+
 void uart_set_cal_joy(uart_joycon_t * joycon) {
 	switch (joycon->type) {
 		case UART_JOYCON_L:
@@ -249,6 +313,7 @@ void uart_set_cal_joy(uart_joycon_t * joycon) {
 	printf("Joystick X max: %d\n", joycon->joy_x_max);
 	printf("Joystick Y min: %d\n", joycon->joy_y_min);
 	printf("Joystick Y max: %d\n", joycon->joy_y_max);
+	uart_build_joy_maps(joycon);
 }
 
 void reset_joycon(uart_joycon_t * joycon) {
@@ -257,11 +322,8 @@ void reset_joycon(uart_joycon_t * joycon) {
     joycon->key_stored = 0;
 
 	memset(joycon->rx_buf, 0, 256);
-    joycon->handshake_pos = 0;
-    joycon->chars_remaining = 0;
-    joycon->message_started = 0;
-    joycon->message_received = 0;
-    joycon->message_len = 0;
+    joycon->rx_reset = 1;   // Handshake position is reset by the RX task
+    if (joycon->frame_queue) xQueueReset(joycon->frame_queue);
     joycon->command_queued = 0;
     joycon->baud_switch_queued = 0;
     joycon->connected = 0;
@@ -280,11 +342,26 @@ void reset_joycon(uart_joycon_t * joycon) {
     joycon->gyro_x_offset = 0;
     joycon->gyro_y_offset = 0;
     joycon->gyro_z_offset = 0;
+    uart_build_joy_maps(joycon);
+}
+
+// Sending is left to the RX task so only one task touches the port
+static void uart_joycon_request_send(uart_joycon_t * joycon) {
+	uart_event_t event;
+
+	memset(&event, 0, sizeof(uart_event_t));
+	event.type = UART_JOYCON_EVENT_SEND;
+	joycon->send_requested = 1;
+	if (xQueueSend(joycon->event_queue, &event, 0) != pdTRUE) joycon->send_requested = 0;
 }
 
 void uart_joycon_handle(uart_joycon_t * joycon) {
+	uart_joycon_frame_t frame;
+
 	if (joycon->connected) {
-		if (joycon->message_received) {
+		while (xQueueReceive(joycon->frame_queue, &frame, 0) == pdTRUE) {
+			memcpy(joycon->rx_buf, frame.data, frame.len);
+
 			// Check responses and get data
 			if (!memcmp(joycon->rx_buf + 26, uart_handshake_commands[7] + 23, 6)) uart_set_cal_imu(joycon);
 			if (!memcmp(joycon->rx_buf + 26, uart_handshake_commands[8] + 23, 6) && joycon->type == UART_JOYCON_L) uart_set_cal_joy(joycon);
@@ -292,17 +369,9 @@ void uart_joycon_handle(uart_joycon_t * joycon) {
 			if (!memcmp(joycon->rx_buf + 26, uart_handshake_commands[10] + 23, 2)) uart_set_mac_address(joycon);
 			if (!memcmp(joycon->rx_buf + 26, uart_handshake_commands[11] + 23, 2)) uart_store_link_key(joycon);
 
-			if (!memcmp(joycon->rx_buf, uart_status_response_header, 8)) joycon->data_ready = 1;
-			else joycon->data_ready = 0;
-
-			uart_flush(joycon->uart_num);
-			joycon->message_received = 0;
 			joycon->connect_timer = app_timer;
 		}
-		if (joycon->command_queued && !gpio_get_level(joycon->tx_en_pin)) {
-			uart_joycon_write_next_command(joycon);
-			joycon->command_queued = 0;
-		}
+		if (joycon->command_queued && !joycon->send_requested && !gpio_get_level(joycon->tx_en_pin)) uart_joycon_request_send(joycon);
 
 		if (joycon->baud_switch_queued) {
 			uart_set_baudrate(joycon->uart_num, 3125000);
@@ -318,9 +387,7 @@ void uart_joycon_handle(uart_joycon_t * joycon) {
 			printf("Joy-Con disconnected\n");
 			uart_set_baudrate(joycon->uart_num, 1000000);
 			reset_joycon(joycon);
-			uart_flush(joycon->uart_num);
-			joycon->uart_intr.rxfifo_full_thresh = 4;
-			uart_enable_rx_intr(joycon->uart_num);
+			uart_flush_input(joycon->uart_num);
 		}
 	} else {
 		if (!gpio_get_level(joycon->tx_en_pin)) {	// This line goes low in a Joy-Con connection event
@@ -328,9 +395,8 @@ void uart_joycon_handle(uart_joycon_t * joycon) {
 			joycon->connected = 1;
 			joycon->command_queued = 1;
 			joycon->connect_timer = app_timer;	// Store time of connection
-			uart_flush(joycon->uart_num);
-			joycon->uart_intr.rxfifo_full_thresh = 4;
-			uart_enable_rx_intr(joycon->uart_num);
+			uart_flush_input(joycon->uart_num);
+			joycon->rx_reset = 1;
 		}
 	}
 }
@@ -340,7 +406,6 @@ void uart_init() {
 	reset_joycon(&joycon_left);
 	
 	joycon_right.uart_num = UART_NUM_1;
-	joycon_right.uart_port = &UART1;
 	joycon_right.tx_pin = JOYCON_R_TX;
 	joycon_right.rx_pin = JOYCON_R_RX;
 	joycon_right.rx_en_pin = JOYCON_R_RX_EN;
@@ -348,7 +413,6 @@ void uart_init() {
 	joycon_right.type = UART_JOYCON_R;
 
 	joycon_left.uart_num = UART_NUM_2;
-	joycon_left.uart_port = &UART2;
 	joycon_left.tx_pin = JOYCON_L_TX;
 	joycon_left.rx_pin = JOYCON_L_RX;
 	joycon_left.rx_en_pin = JOYCON_L_RX_EN;
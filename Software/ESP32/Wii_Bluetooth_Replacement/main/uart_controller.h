@@ -2,6 +2,7 @@
 #define	_UART_DRIVER_H_
 
 #include "driver/uart.h"
+#include "joystick.h"
 
 // TX means sending from ESP32, RX means ESP32 receiving
 #define JOYCON_R_TX	    GPIO_NUM_32
@@ -15,7 +16,23 @@
 
 #define UART_GAMEPAD_NUM 1  // Define which gamepad the wired controllers are bound to
 
+// Received bytes are buffered by the UART driver, its ISR only queues an event for the Joy-Con's RX task
+#define UART_JOYCON_RX_BUF_LEN      2048
+#define UART_JOYCON_EVENT_QUEUE_LEN 16
+#define UART_JOYCON_RX_FULL_THRESH  64  // FIFO bytes before the driver moves them to its buffer
+#define UART_JOYCON_RX_TIMEOUT      2   // Idle symbol times before a partly filled FIFO is moved
+#define UART_JOYCON_TASK_PRIORITY   6   // Above the pipeline so commands are answered right away
+#define UART_JOYCON_TASK_STACK_SIZE 3072
+#define UART_JOYCON_FRAME_LEN       64  // Longest message kept (input reports and subcommand replies), rounded up
+#define UART_JOYCON_FRAME_QUEUE_LEN 8   // Messages waiting for uart_joycon_handle
+#define UART_JOYCON_EVENT_SEND      UART_EVENT_MAX  // Posted to the RX task, which does all sending
+
 enum JOYCON_TYPE { UART_JOYCON_R, UART_JOYCON_L };
+typedef struct {
+    uint8_t len;
+    uint8_t data[UART_JOYCON_FRAME_LEN];
+} uart_joycon_frame_t;
+
 typedef struct {
     enum JOYCON_TYPE type;
     uint8_t address[6];
@@ -23,21 +40,27 @@ typedef struct {
     uint8_t key_stored;
 
     uint8_t uart_num;
-    uart_dev_t * uart_port;
     uart_config_t uart_config;
     uart_intr_config_t uart_intr;
+    QueueHandle_t event_queue;
+
+    QueueHandle_t frame_queue;  // Complete messages from the RX task
 
-    uint8_t rx_buf[256];
-    uint8_t handshake_pos;
-    int8_t chars_remaining;
-    uint8_t message_started;
-    uint8_t message_received;
-    uint8_t message_len;
-    uint8_t command_queued;
-    uint8_t baud_switch_queued;
+    uint8_t rx_buf[256];    // Message being checked by uart_joycon_handle
+    uint8_t input_buf[2][UART_JOYCON_FRAME_LEN];   // Latest input report, double buffered for the pipeline
+    volatile uint8_t input_latest;
+    volatile uint32_t input_seq;    // Odd while input_buf is being written
+    uint8_t frame_buf[256]; // Message being assembled by the RX task
+    uint16_t frame_len;
+    uint16_t frame_expected;
+    volatile uint8_t rx_reset;  // Drop any partly received message
+    uint8_t handshake_pos;      // RX task only
+    volatile uint8_t command_queued;
+    volatile uint8_t send_requested;    // Send event posted to the RX task
+    volatile uint8_t baud_switch_queued;
     uint8_t connected;
     uint32_t connect_timer;
-    uint8_t data_ready;
+    volatile uint8_t data_ready;
 
     uint64_t tx_pin;
     uint64_t rx_pin;
@@ -57,12 +80,15 @@ typedef struct {
     int16_t gyro_x_offset;
     int16_t gyro_y_offset;
     int16_t gyro_z_offset;
+    joy_axis_map_t joy_x_map;
+    joy_axis_map_t joy_y_map;
 } uart_joycon_t;
 
 extern uart_joycon_t joycon_right;
 extern uart_joycon_t joycon_left;
 
 void uart_joycon_handle(uart_joycon_t * joycon);
+void uart_joycon_read_input(uart_joycon_t * joycon, uint8_t * data);
 void uart_init();
 
 #endif
\ No newline at end of file
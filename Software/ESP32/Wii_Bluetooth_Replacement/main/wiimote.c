@@ -5,14 +5,13 @@
 #include "gamepad.h"
 #include "timer.h"
 #include "spi.h"
+#include "spi_codec.h"
 #include "hid_controller.h"
+#include "latency.h"
+#include "pipeline.h"
 
 wiimote_t wiimotes[4];
 
-static double map(double x, double in_min, double in_max, double out_min, double out_max) {
-    return ((x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min);
-}
-
 static void wiimote_set_defaults(wiimote_t * wiimote) {
     wiimote->a = 0;
     wiimote->b = 0;
@@ -36,17 +35,20 @@ static void wiimote_set_defaults(wiimote_t * wiimote) {
 }
 
 static void wiimote_angle_to_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
-    wiimote->ir_object[0].x = map(-gamepad->yaw, -IR_YAW_MAX, IR_YAW_MAX, IR_X_MIN, IR_X_MAX) + IR_OFFSET;
-    wiimote->ir_object[0].y = map(-gamepad->pitch, -IR_PITCH_MAX, IR_PITCH_MAX, IR_Y_MIN, IR_Y_MAX);
-    wiimote->ir_object[1].x = map(-gamepad->yaw, -IR_YAW_MAX, IR_YAW_MAX, IR_X_MIN, IR_X_MAX) - IR_OFFSET;
-    wiimote->ir_object[1].y = map(-gamepad->pitch, -IR_PITCH_MAX, IR_PITCH_MAX, IR_Y_MIN, IR_Y_MAX);
+    fixed_t x = fixed_map(-gamepad->yaw, FIXED_CONST(-IR_YAW_MAX), FIXED_CONST(IR_YAW_MAX), FIXED_CONST(IR_X_MIN), FIXED_CONST(IR_X_MAX));
+    fixed_t y = fixed_map(-gamepad->pitch, FIXED_CONST(-IR_PITCH_MAX), FIXED_CONST(IR_PITCH_MAX), FIXED_CONST(IR_Y_MIN), FIXED_CONST(IR_Y_MAX));
 
-    if ((gamepad->yaw < -IR_YAW_MAX - 5) || (gamepad->yaw > IR_YAW_MAX + 5) ||
-        (gamepad->pitch < -IR_PITCH_MAX - 5) || (gamepad->pitch > IR_PITCH_MAX + 5))
+    wiimote->ir_object[0].x = x + FIXED_FROM_INT(IR_OFFSET);
+    wiimote->ir_object[0].y = y;
+    wiimote->ir_object[1].x = x - FIXED_FROM_INT(IR_OFFSET);
+    wiimote->ir_object[1].y = y;
+
+    if ((gamepad->yaw < FIXED_CONST(-IR_YAW_MAX - 5)) || (gamepad->yaw > FIXED_CONST(IR_YAW_MAX + 5)) ||
+        (gamepad->pitch < FIXED_CONST(-IR_PITCH_MAX - 5)) || (gamepad->pitch > FIXED_CONST(IR_PITCH_MAX + 5)))
         wiimote->ir_idle = 1;
     else {
         wiimote->ir_idle = 0;
-        wiimote->ir_idle_timeout = app_timer;
+        wiimote->ir_idle_timeout = pipeline_timer;
     }
 	
 	// TODO: Allow offsets so gyro cursor can keep up with joystick cursor
@@ -54,12 +56,12 @@ static void wiimote_angle_to_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
 
 static uint8_t wiimote_joy_to_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
     if (gamepad->buttons.r) {
-        wiimote->ir_object[0].x = IR_X_CENTER + IR_OFFSET;
-        wiimote->ir_object[0].y = IR_Y_CENTER;
-        wiimote->ir_object[1].x = IR_X_CENTER - IR_OFFSET;
-        wiimote->ir_object[1].y = IR_Y_CENTER;
+        wiimote->ir_object[0].x = FIXED_CONST(IR_X_CENTER + IR_OFFSET);
+        wiimote->ir_object[0].y = FIXED_CONST(IR_Y_CENTER);
+        wiimote->ir_object[1].x = FIXED_CONST(IR_X_CENTER - IR_OFFSET);
+        wiimote->ir_object[1].y = FIXED_CONST(IR_Y_CENTER);
         wiimote->ir_idle = 0;
-        wiimote->ir_idle_timeout = app_timer;
+        wiimote->ir_idle_timeout = pipeline_timer;
     }
     
     uint32_t joy_x_sq = ((int16_t)gamepad->axes.joy_rx - 0x7FF) * ((int16_t)gamepad->axes.joy_rx - 0x7FF);
@@ -67,8 +69,8 @@ static uint8_t wiimote_joy_to_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
     uint32_t deadzone_sq = IR_JOY_DEADZONE * IR_JOY_DEADZONE;
     
     if (joy_x_sq + joy_y_sq > deadzone_sq) {    // Joystick is outside deadzone
-        double x_speed = ((int16_t)gamepad->axes.joy_rx - 0x7FF) * IR_JOY_SENSITIVITY / 0xFFF;
-        double y_speed = ((int16_t)gamepad->axes.joy_ry - 0x7FF) * IR_JOY_SENSITIVITY / 0xFFF;
+        fixed_t x_speed = fixed_from_ratio((int16_t)gamepad->axes.joy_rx - 0x7FF, IR_JOY_SENSITIVITY, 0xFFF);
+        fixed_t y_speed = fixed_from_ratio((int16_t)gamepad->axes.joy_ry - 0x7FF, IR_JOY_SENSITIVITY, 0xFFF);
         
         wiimote->ir_object[0].x -= x_speed;
         wiimote->ir_object[0].y -= y_speed;
@@ -76,21 +78,21 @@ static uint8_t wiimote_joy_to_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
         wiimote->ir_object[1].y -= y_speed;
 
         wiimote->ir_idle = 0;
-        wiimote->ir_idle_timeout = app_timer;
+        wiimote->ir_idle_timeout = pipeline_timer;
 
         // Keep joystick cursor within bounds
-        if (wiimote->ir_object[0].x > 0x3FF) wiimote->ir_object[0].x = 0x3FF;
+        if (wiimote->ir_object[0].x > FIXED_FROM_INT(0x3FF)) wiimote->ir_object[0].x = FIXED_FROM_INT(0x3FF);
         if (wiimote->ir_object[0].x < 0) wiimote->ir_object[0].x = 0;
-        if (wiimote->ir_object[0].y > 0x3FF) wiimote->ir_object[0].y = 0x3FF;
+        if (wiimote->ir_object[0].y > FIXED_FROM_INT(0x3FF)) wiimote->ir_object[0].y = FIXED_FROM_INT(0x3FF);
         if (wiimote->ir_object[0].y < 0) wiimote->ir_object[0].y = 0;
-        if (wiimote->ir_object[1].x > 0x3FF) wiimote->ir_object[1].x = 0x3FF;
+        if (wiimote->ir_object[1].x > FIXED_FROM_INT(0x3FF)) wiimote->ir_object[1].x = FIXED_FROM_INT(0x3FF);
         if (wiimote->ir_object[1].x < 0) wiimote->ir_object[1].x = 0;
-        if (wiimote->ir_object[1].y > 0x3FF) wiimote->ir_object[1].y = 0x3FF;
+        if (wiimote->ir_object[1].y > FIXED_FROM_INT(0x3FF)) wiimote->ir_object[1].y = FIXED_FROM_INT(0x3FF);
         if (wiimote->ir_object[1].y < 0) wiimote->ir_object[1].y = 0;
 
         return 1;
     } else {
-        if (!wiimote->ir_idle && ((app_timer - wiimote->ir_idle_timeout) >= IR_JOY_IDLE_TIME)) wiimote->ir_idle = 1;
+        if (!wiimote->ir_idle && ((pipeline_timer - wiimote->ir_idle_timeout) >= IR_JOY_IDLE_TIME)) wiimote->ir_idle = 1;
         return 0;
     }
 }
@@ -104,6 +106,7 @@ static void wiimote_update_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
             wiimote->ir_idle = 1;
             break;
         case GAMEPAD_JOYCON_DUAL:
+        case GAMEPAD_JOYCON_WIRED:
         case GAMEPAD_PROCON:
             if (wiimote->extension != EXT_CLASSIC) {
                 if (!wiimote_joy_to_ir(wiimote, gamepad)) wiimote_angle_to_ir(wiimote, gamepad);    // Use angles if joystick is inactive
@@ -122,6 +125,22 @@ static void wiimote_update_ir(wiimote_t * wiimote, gamepad_t * gamepad) {
     }
 }
 
+// Convert a gamepad IMU sample to Wiimote accelerometer (x, y, z) and Motion Plus (roll, pitch, yaw) values
+static void wiimote_map_imu(wiimote_t * wiimote, gamepad_t * gamepad, imu_sample_t * sample, uint16_t * accel, uint16_t * gyro) {
+    accel[0] = (sample->accel_x + 0x8000) >> 6;
+    accel[1] = (sample->accel_y + 0x8000) >> 6;
+    accel[2] = (sample->accel_z + 0x8000) >> 6;
+    gyro[0] = (sample->gyro_x + 0x8000) >> 2;
+    gyro[1] = (sample->gyro_y + 0x8000) >> 2;
+    gyro[2] = (sample->gyro_z + 0x8000) >> 2;
+
+    // Switch accel x and y for sideways Wiimote 
+    if (((gamepad->type == GAMEPAD_PROCON) || (gamepad->type == GAMEPAD_WIIU_PRO)) && (wiimote->extension == EXT_NONE)) {
+        accel[0] = (sample->accel_y + 0x8000) >> 6;
+        accel[1] = (sample->accel_x + 0x8000) >> 6;
+    }
+}
+
 void wiimote_reset(wiimote_t * wiimote) {
     memset(wiimote, 0, sizeof(wiimote_t));
     wiimote->extension = EXT_NONE;
@@ -225,12 +244,17 @@ void wiimote_handle(uint8_t wiimote_num) {
     wiimote->classic.rx = gamepad->axes.joy_rx >> 4;
     wiimote->classic.ry = gamepad->axes.joy_ry >> 4;
 
-    wiimote->accel_x = (gamepad->axes.accel_rx + 0x8000) >> 6;
-    wiimote->accel_y = (gamepad->axes.accel_ry + 0x8000) >> 6;
-    wiimote->accel_z = (gamepad->axes.accel_rz + 0x8000) >> 6;
-    wiimote->motion_plus.yaw_speed = (gamepad->axes.gyro_rz + 0x8000) >> 2;
-    wiimote->motion_plus.pitch_speed = (gamepad->axes.gyro_ry + 0x8000) >> 2;
-    wiimote->motion_plus.roll_speed = (gamepad->axes.gyro_rx + 0x8000) >> 2;
+    imu_sample_t imu = { pipeline_timer, 
+                        gamepad->axes.gyro_rx, gamepad->axes.gyro_ry, gamepad->axes.gyro_rz, 
+                        gamepad->axes.accel_rx, gamepad->axes.accel_ry, gamepad->axes.accel_rz };
+    uint16_t accel[3], gyro[3];
+    wiimote_map_imu(wiimote, gamepad, &imu, accel, gyro);
+    wiimote->accel_x = accel[0];
+    wiimote->accel_y = accel[1];
+    wiimote->accel_z = accel[2];
+    wiimote->motion_plus.roll_speed = gyro[0];
+    wiimote->motion_plus.pitch_speed = gyro[1];
+    wiimote->motion_plus.yaw_speed = gyro[2];
     
     // Adjustments based on gamepad type
     switch (gamepad->type) {
@@ -253,10 +277,6 @@ void wiimote_handle(uint8_t wiimote_num) {
             wiimote->nunchuk.accel_z = 0x260;
         case GAMEPAD_PROCON:
             if (wiimote->extension == EXT_NONE) {
-                // Switch accel x and y for sideways Wiimote 
-                wiimote->accel_x = (gamepad->axes.accel_ry + 0x8000) >> 6;
-                wiimote->accel_y = (gamepad->axes.accel_rx + 0x8000) >> 6;
-
                 // Rotate d-pad for sideways wiimote
                 wiimote->du = gamepad->buttons.dl;
                 wiimote->dd = gamepad->buttons.dr;
@@ -277,125 +297,105 @@ void wiimote_handle(uint8_t wiimote_num) {
     }
 
     wiimote_update_ir(wiimote, gamepad);
+    latency_probe(wiimote_num, LAT_MAPPED);
+}
+
+static void wiimote_spi_get_slot(uint8_t wiimote_num, uint8_t * buf) {
+    spi_codec_encode_wiimote(&wiimotes[wiimote_num - 1], wiimote_num, buf);
 }
 
-void wiimote_spi_send(uint8_t wiimote_num) {
+// Most recent IMU samples so the PIC32 can pick the one closest to each report it sends
+static void wiimote_spi_get_imu_slot(uint8_t wiimote_num, uint8_t * buf) {
+    gamepad_t * gamepad = &gamepads[wiimote_num - 1];
     wiimote_t * wiimote = &wiimotes[wiimote_num - 1];
-    uint8_t buf[32] = { 0 };
+    spi_imu_sample_t samples[IMU_SLOT_SAMPLES];
+    uint8_t i;
 
     if (wiimote->active) {
-        buf[0] = (wiimote->extension << 4) | wiimote_num;
-
-        buf[1] = wiimote->a | 
-                (wiimote->b << 1) |
-                (wiimote->one << 2) | 
-                (wiimote->two << 3) |
-                (wiimote->du << 4) | 
-                (wiimote->dd << 5) | 
-                (wiimote->dr << 6) | 
-                (wiimote->dl << 7);
-        
-        buf[2] = wiimote->plus | 
-                (wiimote->minus << 1) |
-                (wiimote->home << 2) | 
-                (wiimote->classic.plus << 3) | 
-                (wiimote->classic.minus << 4) | 
-                (wiimote->classic.home << 5) |
-                (wiimote->nunchuk.c << 6) | 
-                (wiimote->nunchuk.z << 7);
-        buf[3] = wiimote->classic.a | 
-                (wiimote->classic.b << 1) |
-                (wiimote->classic.x << 2) | 
-                (wiimote->classic.y << 3) | 
-                (wiimote->classic.du << 4) | 
-                (wiimote->classic.dd << 5) |
-                (wiimote->classic.dr << 6) | 
-                (wiimote->classic.dl << 7);
-        buf[4] = wiimote->classic.r | 
-                (wiimote->classic.zr << 1) |
-                (wiimote->classic.l << 2) | 
-                (wiimote->classic.zl << 3);
-
-        if (wiimote->extension == EXT_CLASSIC) {
-            buf[5] = wiimote->classic.lx;
-            buf[6] = wiimote->classic.ly;
-        } else {
-            buf[5] = wiimote->nunchuk.x;
-            buf[6] = wiimote->nunchuk.y;
-        }
+        uint8_t num_samples = (gamepad->imu_sample_count < IMU_SLOT_SAMPLES) ? gamepad->imu_sample_count : IMU_SLOT_SAMPLES;
 
-        buf[7] = wiimote->classic.rx;
-        buf[8] = wiimote->classic.ry;
-
-        buf[9] = wiimote->accel_x & 0xFF;
-        buf[10] = wiimote->accel_y & 0xFF;
-        buf[11] = wiimote->accel_z & 0xFF;
-        buf[12] = ((wiimote->accel_x & 0x300) >> 8) | 
-                ((wiimote->accel_y & 0x300) >> 6) | 
-                ((wiimote->accel_z & 0x300) >> 4);
-
-        buf[13] = wiimote->nunchuk.accel_x & 0xFF;
-        buf[14] = wiimote->nunchuk.accel_y & 0xFF;
-        buf[15] = wiimote->nunchuk.accel_z & 0xFF;
-        buf[16] = ((wiimote->nunchuk.accel_x & 0x300) >> 8) | 
-                ((wiimote->nunchuk.accel_y & 0x300) >> 6) | 
-                ((wiimote->nunchuk.accel_z & 0x300) >> 4);
-        
-        buf[17] = wiimote->motion_plus.yaw_speed & 0xFF;
-        buf[18] = wiimote->motion_plus.pitch_speed & 0xFF;
-        buf[19] = wiimote->motion_plus.roll_speed & 0xFF;
-        buf[20] = ((wiimote->motion_plus.yaw_speed & 0xF00) >> 8) |
-                ((wiimote->motion_plus.pitch_speed & 0xF00) >> 4);
-        buf[21] = (wiimote->motion_plus.roll_speed & 0xF00) >> 8;
-
-        if (wiimote->ir_idle) memset(buf + 22, 0xFF, 8);
-        else {
-            buf[22] = (uint16_t)wiimote->ir_object[0].x & 0xFF;
-            buf[23] = ((uint16_t)wiimote->ir_object[0].x & 0xFF00) >> 8;
-            buf[24] = (uint16_t)wiimote->ir_object[0].y & 0xFF;
-            buf[25] = ((uint16_t)wiimote->ir_object[0].y & 0xFF00) >> 8;
-            buf[26] = (uint16_t)wiimote->ir_object[1].x & 0xFF;
-            buf[27] = ((uint16_t)wiimote->ir_object[1].x & 0xFF00) >> 8;
-            buf[28] = (uint16_t)wiimote->ir_object[1].y & 0xFF;
-            buf[29] = ((uint16_t)wiimote->ir_object[1].y & 0xFF00) >> 8;
+        for (i = 0; i < num_samples; i++) {    // Oldest sample first
+            imu_sample_t * sample = &gamepad->imu_samples[(gamepad->imu_sample_pos + IMU_RING_LEN - num_samples + i) % IMU_RING_LEN];
+            samples[i].time = sample->timestamp & 0xFF;
+            wiimote_map_imu(wiimote, gamepad, sample, samples[i].accel, samples[i].gyro);
         }
+        spi_codec_encode_imu(samples, num_samples, wiimote_num, buf);
+    } else memset(buf, 0xFF, SPI_SLOT_LEN);
+}
 
-        uint8_t checksum_buttons = 0, checksum_axes = 0, i;
-        for (i = 0; i < 4; i++) checksum_buttons += buf[i + 1];
-        checksum_buttons += 0x55;
-        for (i = 0; i < 25; i++) checksum_axes += buf[i + 5];
-        checksum_axes += 0x55;
+// Publish a new SPI frame whenever a Wiimote's state has changed since the last one
+void wiimote_spi_update() {
+    static uint8_t prev_frame[SPI_FRAME_LEN];
+    uint8_t frame[SPI_FRAME_LEN];
+    uint8_t i;
 
-        buf[30] = checksum_buttons;
-        buf[31] = checksum_axes;
-    } else {
-        uint8_t i;
-        for (i = 0; i < 32; i++) buf[i] = 0xFF;
+    for (i = 0; i < 4; i++) {
+        wiimote_spi_get_slot(i + 1, frame + (SPI_SLOT_LEN * i));
+        wiimote_spi_get_imu_slot(i + 1, frame + (SPI_SLOT_LEN * (i + 4)));
     }
+    if (!memcmp(frame, prev_frame, SPI_FRAME_LEN)) return;
+    memcpy(prev_frame, frame, SPI_FRAME_LEN);
 
-    spi_slave_queue_data(buf, 32);
+    for (i = 0; i < 8; i++) spi_slave_queue_data(frame + (SPI_SLOT_LEN * i), SPI_SLOT_LEN);
 }
 
 void wiimote_spi_receive() {
-    uint8_t recv_buf_len, i;
+    uint16_t recv_buf_len;
+    uint8_t i;
     uint8_t * recv_buf;
     
     recv_buf = spi_slave_get_data(&recv_buf_len);
     if (!recv_buf) return;
 
+    if (recv_buf_len >= SPI_DOWNSTREAM_OFFSET + (SPI_DOWNSTREAM_LEN * 4)) {
+        for (i = 0; i < 4; i++) {
+            wii_state_t state;
+            uint8_t wiimote_num = spi_codec_decode_state(&recv_buf[SPI_DOWNSTREAM_OFFSET + (SPI_DOWNSTREAM_LEN * i)], &state);
+            if (wiimote_num) {
+                wiimotes[wiimote_num - 1].wii_state = state;
+                wiimotes[wiimote_num - 1].wii_state_valid = 1;
+            }
+        }
+    }
+
     for (i = 0; i < 4; i++) {
-        uint8_t wiimote_num = recv_buf[i] & 0x07;
-        uint8_t connection_allowed = (recv_buf[i] & 0x08) >> 3;
-        if (wiimote_num > 0 && wiimote_num <= 4) {
+        uint8_t player_num, rumble, connection_allowed;
+        uint8_t wiimote_num = spi_codec_decode_status(recv_buf[i], &player_num, &rumble, &connection_allowed);
+        if (wiimote_num) {
             hid_controller_t * controller_main;
             hid_controller_t * controller_secondary;
-            get_controllers_from_gamepad(wiimote_num, &controller_main, &controller_secondary, 1);    // Only return connected controllers
+            pipeline_get_controllers(wiimote_num, &controller_main, &controller_secondary, 1);    // Only return connected controllers
 
-            if (controller_main && !connection_allowed) controller_disconnect(controller_main);
-            if (controller_secondary && !connection_allowed) controller_disconnect(controller_secondary);
+            if (controller_main && !connection_allowed) pipeline_controller_disconnect(controller_main);
+            if (controller_secondary && !connection_allowed) pipeline_controller_disconnect(controller_secondary);
 
-            wiimotes[wiimote_num - 1].player_num = (recv_buf[i] & 0x70) >> 4;
-            wiimotes[wiimote_num - 1].rumble = (recv_buf[i] & 0x80) >> 7;
+            wiimotes[wiimote_num - 1].player_num = player_num;
+            wiimotes[wiimote_num - 1].rumble = rumble;
         }
     }
+}
+
+// Whether the Wii is using any motion data (accelerometer, IR pointer or Motion Plus)
+uint8_t wiimote_motion_required(uint8_t wiimote_num) {
+    wiimote_t * wiimote = &wiimotes[wiimote_num - 1];
+
+    if (!wiimote->wii_state_valid || !(wiimote->wii_state.flags & WII_STATE_CONNECTED)) return 1;  // Keep streaming until the Wii state is known
+    if (wiimote->wii_state.flags & (WII_STATE_IRCAM | WII_STATE_WMP)) return 1;
+
+    switch (wiimote->wii_state.reporting_mode) {
+        case 0x31:  // Reports with Wiimote accelerometer data
+        case 0x33:
+        case 0x35:
+        case 0x37:
+        case 0x3E:
+        case 0x3F:
+            return 1;
+        case 0x32:  // Reports with extension data only need motion for the Nunchuk accelerometer
+        case 0x34:
+        case 0x36:
+        case 0x3D:
+            return wiimote->extension == EXT_NUNCHUK;
+        default:
+            return 0;
+    }
 }
\ No newline at end of file
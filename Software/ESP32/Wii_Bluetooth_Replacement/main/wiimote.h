@@ -1,6 +1,7 @@
 #ifndef _WIIMOTE_H_
 #define _WIIMOTE_H_
 
+#include "fixed.h"
 #include "hid_controller.h"
 
 // Half distance between 2 IR dots
@@ -19,15 +20,34 @@
 #define IR_PITCH_MAX    12.0
 #define IR_YAW_MAX      20.0
 
-#define IR_JOY_SENSITIVITY  10.0
+#define IR_JOY_SENSITIVITY  10
 #define IR_JOY_DEADZONE     400 	// Joystick range is 0 to 4095
 #define IR_JOY_IDLE_TIME    1700 	// Time (ms) of no joystick movement required before cursor becomes idle
 
 #define DPAD_JOY_DEADZONE	800
 
+#define IMU_SLOT_SAMPLES    3   // IMU samples sent to the PIC32 per transfer (one Joy-Con report)
+
+// Flags in the Wii state message received from the PIC32
+#define WII_STATE_CONNECTED     0x01
+#define WII_STATE_IRCAM         0x02
+#define WII_STATE_SPEAKER       0x04
+#define WII_STATE_WMP           0x08
+#define WII_STATE_CONTINUOUS    0x10
+
+// Wii state received from the PIC32
 typedef struct {
-    double x;
-    double y;
+    uint8_t rumble_intensity;   // Fraction of time rumble was on since last transfer (0 - 255)
+    uint8_t led_state;          // Bit 0 = LED 1
+    uint8_t flags;              // WII_STATE_* flags
+    uint8_t reporting_mode;
+    uint8_t speaker_format;
+    uint8_t speaker_volume;
+} wii_state_t;
+
+typedef struct {
+    fixed_t x;
+    fixed_t y;
     uint8_t size;
     uint8_t xmin;
     uint8_t ymin;
@@ -109,6 +129,9 @@ typedef struct {
     uint8_t player_num; // Based on LED pattern
     uint8_t rumble;
 
+    uint8_t wii_state_valid;
+    wii_state_t wii_state;
+
     uint8_t battery_level;
 
     enum EXTENSION_TYPE extension;
@@ -121,7 +144,8 @@ void init_wiimotes();
 void wiimote_set_extension(uint8_t wiimote_num, enum EXTENSION_TYPE extension);
 void wiimote_change_extension(uint8_t wiimote_num);
 void wiimote_handle(uint8_t wiimote_num);
-void wiimote_spi_send(uint8_t wiimote_num);
+void wiimote_spi_update();
 void wiimote_spi_receive();
+uint8_t wiimote_motion_required(uint8_t wiimote_num);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Decodes "#T" trace records from the ESP32 console into readable text. Other lines are passed through.
+# Usage: make monitor | ./trace_decode.py    or    ./trace_decode.py log.txt
+import struct
+import sys
+
+RECORD_LEN = 32
+PAYLOAD_LEN = 24
+
+DIRS = { 0: "CMD ", 1: "RESP", 2: "EVT " }
+
+# Must match enum TRACE_EVENT_TYPE in main/trace.h
+EVENTS = [ "none", "registered with gamepad", "connected to gamepad", "disconnected", "extension plugged in",
+           "extension unplugged", "Wii Motion Plus found", "Wii Motion Plus not found", "Wii Motion Plus activated",
+           "IMU enabled", "IMU disabled", "command resent", "command timed out",
+           "input live (1 = fast page scan)", "pipeline request dropped, queue full (request type)", "calibration",
+           "using cached calibration", "calibration cached", "gyro calibration started (gamepad)", "gyro calibrated",
+           "controller type stored", "device found" ]
+
+# Must match enum CAL_GROUP in main/gamepad.h and enum HID_DEVICE in main/hid_controller.h
+CAL_GROUPS = [ "right accel", "right gyro", "right stick", "left accel", "left gyro", "left stick" ]
+DEVICES = [ "none", "Joy-Con (R)", "Joy-Con (L)", "Pro Controller", "Wiimote", "Wii U Pro Controller" ]
+
+def format_addr(data):
+    return ":".join("%02X" % b for b in data[:6])
+
+def format_cal(payload, length):
+    group = payload[0]
+    name = CAL_GROUPS[group] if group < len(CAL_GROUPS) else "group %d" % group
+    if name.endswith("stick"):
+        x_max, x_center, x_min, y_max, y_center, y_min = struct.unpack_from("<6H", payload, 1)
+        return "%s X %d/%d/%d, Y %d/%d/%d (min/center/max)" % (name, x_min, x_center, x_max, y_min, y_center, y_max)
+    return "%s offset X %d, Y %d, Z %d" % ((name,) + struct.unpack_from("<3h", payload, 1))
+
+def format_gyro_calibrated(payload, length):
+    return "gamepad %d gyro offset X %d, Y %d, Z %d" % ((payload[0],) + struct.unpack_from("<3h", payload, 1))
+
+def format_type_stored(payload, length):
+    device = DEVICES[payload[0]] if payload[0] < len(DEVICES) else "type %d" % payload[0]
+    return "%s for %s" % (device, format_addr(payload[1:]))
+
+def format_device_found(payload, length):
+    cod = payload[6] | (payload[7] << 8) | (payload[8] << 16)
+    clock_offset = payload[10] | (payload[11] << 8)
+    rssi = struct.unpack_from("<b", payload, 12)[0]
+    text = "%s with COD 0x%06X, page scan %d, clock offset 0x%04X" % (format_addr(payload), cod, payload[9], clock_offset)
+    if rssi != -127:
+        text += ", rssi %d dBm" % rssi
+    name_len = payload[13]
+    if name_len:
+        name = payload[14:14 + min(name_len, PAYLOAD_LEN - 14)].decode("ascii", "replace")
+        text += ", name '%s%s'" % (name, "..." if name_len > PAYLOAD_LEN - 14 else "")
+    return text
+
+# Events with more than one byte of data, by index in EVENTS
+EVENT_FORMATS = { 15: format_cal,
+                  16: lambda payload, length: format_addr(payload),
+                  17: lambda payload, length: format_addr(payload),
+                  19: format_gyro_calibrated,
+                  20: format_type_stored,
+                  21: format_device_found }
+
+def describe_packet(data, length):
+    # Joy-Con/Pro Controller subcommands and replies
+    if len(data) > 11 and data[0] == 0xA2 and data[1] == 0x01:
+        return "subcmd 0x%02X" % data[11]
+    if len(data) > 15 and data[0] == 0xA1 and data[1] == 0x21:
+        return "reply to subcmd 0x%02X (%s)" % (data[15], "ack" if data[14] & 0x80 else "nack")
+    # Wiimote output/input reports
+    if len(data) > 1 and data[0] in (0xA1, 0xA2):
+        return "report 0x%02X" % data[1]
+    return ""
+
+def decode_record(hex_str):
+    raw = bytes.fromhex(hex_str)
+    if len(raw) != RECORD_LEN:
+        return None
+    time, controller, direction, length, event = struct.unpack_from("<IBBBB", raw)
+    payload = raw[8:8 + PAYLOAD_LEN]
+
+    text = "%10.3f ms  C%d  %s  " % (time / 1000, controller, DIRS.get(direction, "?   "))
+    if direction == 2:
+        name = EVENTS[event] if event < len(EVENTS) else "event %d" % event
+        if event in EVENT_FORMATS:
+            return text + "%s: %s" % (name, EVENT_FORMATS[event](payload, length))
+        return text + "%s (%d)" % (name, payload[0])
+
+    data = payload[:min(length, PAYLOAD_LEN)]
+    text += "len %2d  %s" % (length, " ".join("%02X" % b for b in data))
+    if length > PAYLOAD_LEN:
+        text += " ..."
+    desc = describe_packet(data, length)
+    return text + ("  [%s]" % desc if desc else "")
+
+def main():
+    src = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    for line in src:
+        line = line.rstrip("\r\n")
+        if line.startswith("#T "):
+            decoded = decode_record(line[3:].strip())
+            print(decoded if decoded else line)
+        elif line.startswith("#D "):
+            print("*** %s trace records dropped ***" % line[3:].strip())
+        else:
+            print(line)
+        sys.stdout.flush()
+
+if __name__ == "__main__":
+    main()
@@ -57,17 +57,17 @@ OBJECTDIR=build/${CND_CONF}/${IMAGE_TYPE}
 DISTDIR=dist/${CND_CONF}/${IMAGE_TYPE}
 
 # Source Files Quoted if spaced
-SOURCEFILES_QUOTED_IF_SPACED=delay.c hci.c l2cap.c main.c sdp.c spi.c uart.c wiimote.c wm_crypto.c wm_eeprom.c wm_reports.c usb/usb.c usb/usb_cdc.c usb/usb_descriptors.c usb/usb_hid.c usb/usb_winusb.c
+SOURCEFILES_QUOTED_IF_SPACED=delay.c hci.c l2cap.c main.c sdp.c spi.c spi_codec.c uart.c wiimote.c wm_crypto.c wm_eeprom.c wm_reports.c usb/usb.c usb/usb_cdc.c usb/usb_descriptors.c usb/usb_hid.c usb/usb_winusb.c
 
 # Object Files Quoted if spaced
-OBJECTFILES_QUOTED_IF_SPACED=${OBJECTDIR}/delay.o ${OBJECTDIR}/hci.o ${OBJECTDIR}/l2cap.o ${OBJECTDIR}/main.o ${OBJECTDIR}/sdp.o ${OBJECTDIR}/spi.o ${OBJECTDIR}/uart.o ${OBJECTDIR}/wiimote.o ${OBJECTDIR}/wm_crypto.o ${OBJECTDIR}/wm_eeprom.o ${OBJECTDIR}/wm_reports.o ${OBJECTDIR}/usb/usb.o ${OBJECTDIR}/usb/usb_cdc.o ${OBJECTDIR}/usb/usb_descriptors.o ${OBJECTDIR}/usb/usb_hid.o ${OBJECTDIR}/usb/usb_winusb.o
-POSSIBLE_DEPFILES=${OBJECTDIR}/delay.o.d ${OBJECTDIR}/hci.o.d ${OBJECTDIR}/l2cap.o.d ${OBJECTDIR}/main.o.d ${OBJECTDIR}/sdp.o.d ${OBJECTDIR}/spi.o.d ${OBJECTDIR}/uart.o.d ${OBJECTDIR}/wiimote.o.d ${OBJECTDIR}/wm_crypto.o.d ${OBJECTDIR}/wm_eeprom.o.d ${OBJECTDIR}/wm_reports.o.d ${OBJECTDIR}/usb/usb.o.d ${OBJECTDIR}/usb/usb_cdc.o.d ${OBJECTDIR}/usb/usb_descriptors.o.d ${OBJECTDIR}/usb/usb_hid.o.d ${OBJECTDIR}/usb/usb_winusb.o.d
+OBJECTFILES_QUOTED_IF_SPACED=${OBJECTDIR}/delay.o ${OBJECTDIR}/hci.o ${OBJECTDIR}/l2cap.o ${OBJECTDIR}/main.o ${OBJECTDIR}/sdp.o ${OBJECTDIR}/spi.o ${OBJECTDIR}/spi_codec.o ${OBJECTDIR}/uart.o ${OBJECTDIR}/wiimote.o ${OBJECTDIR}/wm_crypto.o ${OBJECTDIR}/wm_eeprom.o ${OBJECTDIR}/wm_reports.o ${OBJECTDIR}/usb/usb.o ${OBJECTDIR}/usb/usb_cdc.o ${OBJECTDIR}/usb/usb_descriptors.o ${OBJECTDIR}/usb/usb_hid.o ${OBJECTDIR}/usb/usb_winusb.o
+POSSIBLE_DEPFILES=${OBJECTDIR}/delay.o.d ${OBJECTDIR}/hci.o.d ${OBJECTDIR}/l2cap.o.d ${OBJECTDIR}/main.o.d ${OBJECTDIR}/sdp.o.d ${OBJECTDIR}/spi.o.d ${OBJECTDIR}/spi_codec.o.d ${OBJECTDIR}/uart.o.d ${OBJECTDIR}/wiimote.o.d ${OBJECTDIR}/wm_crypto.o.d ${OBJECTDIR}/wm_eeprom.o.d ${OBJECTDIR}/wm_reports.o.d ${OBJECTDIR}/usb/usb.o.d ${OBJECTDIR}/usb/usb_cdc.o.d ${OBJECTDIR}/usb/usb_descriptors.o.d ${OBJECTDIR}/usb/usb_hid.o.d ${OBJECTDIR}/usb/usb_winusb.o.d
 
 # Object Files
-OBJECTFILES=${OBJECTDIR}/delay.o ${OBJECTDIR}/hci.o ${OBJECTDIR}/l2cap.o ${OBJECTDIR}/main.o ${OBJECTDIR}/sdp.o ${OBJECTDIR}/spi.o ${OBJECTDIR}/uart.o ${OBJECTDIR}/wiimote.o ${OBJECTDIR}/wm_crypto.o ${OBJECTDIR}/wm_eeprom.o ${OBJECTDIR}/wm_reports.o ${OBJECTDIR}/usb/usb.o ${OBJECTDIR}/usb/usb_cdc.o ${OBJECTDIR}/usb/usb_descriptors.o ${OBJECTDIR}/usb/usb_hid.o ${OBJECTDIR}/usb/usb_winusb.o
+OBJECTFILES=${OBJECTDIR}/delay.o ${OBJECTDIR}/hci.o ${OBJECTDIR}/l2cap.o ${OBJECTDIR}/main.o ${OBJECTDIR}/sdp.o ${OBJECTDIR}/spi.o ${OBJECTDIR}/spi_codec.o ${OBJECTDIR}/uart.o ${OBJECTDIR}/wiimote.o ${OBJECTDIR}/wm_crypto.o ${OBJECTDIR}/wm_eeprom.o ${OBJECTDIR}/wm_reports.o ${OBJECTDIR}/usb/usb.o ${OBJECTDIR}/usb/usb_cdc.o ${OBJECTDIR}/usb/usb_descriptors.o ${OBJECTDIR}/usb/usb_hid.o ${OBJECTDIR}/usb/usb_winusb.o
 
 # Source Files
-SOURCEFILES=delay.c hci.c l2cap.c main.c sdp.c spi.c uart.c wiimote.c wm_crypto.c wm_eeprom.c wm_reports.c usb/usb.c usb/usb_cdc.c usb/usb_descriptors.c usb/usb_hid.c usb/usb_winusb.c
+SOURCEFILES=delay.c hci.c l2cap.c main.c sdp.c spi.c spi_codec.c uart.c wiimote.c wm_crypto.c wm_eeprom.c wm_reports.c usb/usb.c usb/usb_cdc.c usb/usb_descriptors.c usb/usb_hid.c usb/usb_winusb.c
 
 
 CFLAGS=
@@ -142,6 +142,12 @@ ${OBJECTDIR}/spi.o: spi.c  nbproject/Makefile-${CND_CONF}.mk
 	@${RM} ${OBJECTDIR}/spi.o 
 	@${FIXDEPS} "${OBJECTDIR}/spi.o.d" $(SILENT) -rsi ${MP_CC_DIR}../  -c ${MP_CC}  $(MP_EXTRA_CC_PRE) -g -D__DEBUG -D__MPLAB_DEBUGGER_PK3=1  -fframe-base-loclist  -x c -c -mprocessor=$(MP_PROCESSOR_OPTION)  -I"usb" -MMD -MF "${OBJECTDIR}/spi.o.d" -o ${OBJECTDIR}/spi.o spi.c    -DXPRJ_default=$(CND_CONF)  -legacy-libc  $(COMPARISON_BUILD) 
 	
+${OBJECTDIR}/spi_codec.o: spi_codec.c  nbproject/Makefile-${CND_CONF}.mk
+	@${MKDIR} "${OBJECTDIR}" 
+	@${RM} ${OBJECTDIR}/spi_codec.o.d 
+	@${RM} ${OBJECTDIR}/spi_codec.o 
+	@${FIXDEPS} "${OBJECTDIR}/spi_codec.o.d" $(SILENT) -rsi ${MP_CC_DIR}../  -c ${MP_CC}  $(MP_EXTRA_CC_PRE) -g -D__DEBUG -D__MPLAB_DEBUGGER_PK3=1  -fframe-base-loclist  -x c -c -mprocessor=$(MP_PROCESSOR_OPTION)  -I"usb" -MMD -MF "${OBJECTDIR}/spi_codec.o.d" -o ${OBJECTDIR}/spi_codec.o spi_codec.c    -DXPRJ_default=$(CND_CONF)  -legacy-libc  $(COMPARISON_BUILD) 
+	
 ${OBJECTDIR}/uart.o: uart.c  nbproject/Makefile-${CND_CONF}.mk
 	@${MKDIR} "${OBJECTDIR}" 
 	@${RM} ${OBJECTDIR}/uart.o.d 
@@ -239,6 +245,12 @@ ${OBJECTDIR}/spi.o: spi.c  nbproject/Makefile-${CND_CONF}.mk
 	@${RM} ${OBJECTDIR}/spi.o 
 	@${FIXDEPS} "${OBJECTDIR}/spi.o.d" $(SILENT) -rsi ${MP_CC_DIR}../  -c ${MP_CC}  $(MP_EXTRA_CC_PRE)  -g -x c -c -mprocessor=$(MP_PROCESSOR_OPTION)  -I"usb" -MMD -MF "${OBJECTDIR}/spi.o.d" -o ${OBJECTDIR}/spi.o spi.c    -DXPRJ_default=$(CND_CONF)  -legacy-libc  $(COMPARISON_BUILD) 
 	
+${OBJECTDIR}/spi_codec.o: spi_codec.c  nbproject/Makefile-${CND_CONF}.mk
+	@${MKDIR} "${OBJECTDIR}" 
+	@${RM} ${OBJECTDIR}/spi_codec.o.d 
+	@${RM} ${OBJECTDIR}/spi_codec.o 
+	@${FIXDEPS} "${OBJECTDIR}/spi_codec.o.d" $(SILENT) -rsi ${MP_CC_DIR}../  -c ${MP_CC}  $(MP_EXTRA_CC_PRE)  -g -x c -c -mprocessor=$(MP_PROCESSOR_OPTION)  -I"usb" -MMD -MF "${OBJECTDIR}/spi_codec.o.d" -o ${OBJECTDIR}/spi_codec.o spi_codec.c    -DXPRJ_default=$(CND_CONF)  -legacy-libc  $(COMPARISON_BUILD) 
+	
 ${OBJECTDIR}/uart.o: uart.c  nbproject/Makefile-${CND_CONF}.mk
 	@${MKDIR} "${OBJECTDIR}" 
 	@${RM} ${OBJECTDIR}/uart.o.d 
@@ -4,6 +4,14 @@
 #define SPI_EN PORTBbits.RB4
 #define SPI_CS LATBbits.LATB3
 
+// Each transfer holds 4 Wiimote slots followed by 4 IMU sample slots
+#define SPI_SLOT_LEN	32
+#define SPI_FRAME_LEN	(SPI_SLOT_LEN * 8)
+
+// Wii state sent to the ESP32, one message per Wiimote after the 4 status bytes
+#define SPI_DOWNSTREAM_OFFSET	32
+#define SPI_DOWNSTREAM_LEN	8
+
 void spi_master_init(const uint32_t clk, uint8_t mode);
 void spi_off();
 uint8_t spi_busy();
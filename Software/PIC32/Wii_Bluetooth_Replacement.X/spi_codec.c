@@ -0,0 +1,123 @@
+#include "spi_codec.h"
+#include "spi.h"
+
+#include <string.h>
+
+uint8_t spi_codec_encode_status(uint8_t wiimote_num, uint8_t player_num, bool connectable, bool rumble) {
+	return (rumble << 7) | (player_num << 4) | (connectable << 3) | wiimote_num;
+}
+
+void spi_codec_encode_state(uint8_t wiimote_num, const struct spi_wii_state * state, uint8_t * buf) {
+	uint8_t i;
+
+	buf[0] = wiimote_num;
+	buf[1] = state->rumble_intensity;
+	buf[2] = state->led_state;
+	buf[3] = state->flags;
+	buf[4] = state->reporting_mode;
+	buf[5] = state->speaker_format;
+	buf[6] = state->speaker_volume;
+
+	buf[7] = 0x55;
+	for (i = 0; i < SPI_DOWNSTREAM_LEN - 1; i++) buf[7] += buf[i];
+}
+
+// Returns false if the button checksum doesn't match, in which case usr is left untouched
+bool spi_codec_decode_wiimote(const uint8_t * buf, struct wiimote_state_usr * usr, enum EXTENSION_TYPE * extension) {
+	uint8_t checksum_buttons = 0;
+	uint8_t j;
+
+	for (j = 0; j < 4; j++) checksum_buttons += buf[j + 1];
+	checksum_buttons += 0x55;
+	if (checksum_buttons != buf[30]) return false;
+
+	*extension = buf[0] >> 4;
+
+	usr->a = buf[1] & 0x01;
+	usr->b = (buf[1] & 0x02) >> 1;
+	usr->one = (buf[1] & 0x04) >> 2;
+	usr->two = (buf[1] & 0x08) >> 3;
+	usr->up = (buf[1] & 0x10) >> 4;
+	usr->down = (buf[1] & 0x20) >> 5;
+	usr->right = (buf[1] & 0x40) >> 6;
+	usr->left = (buf[1] & 0x80) >> 7;
+	usr->plus = buf[2] & 0x01;
+	usr->minus = (buf[2] & 0x02) >> 1;
+	usr->home = (buf[2] & 0x04) >> 2;
+	usr->classic.plus = (buf[2] & 0x08) >> 3;
+	usr->classic.minus = (buf[2] & 0x10) >> 4;
+	usr->classic.home = (buf[2] & 0x20) >> 5;
+	usr->nunchuk.c = (buf[2] & 0x40) >> 6;
+	usr->nunchuk.z = (buf[2] & 0x80) >> 7;
+	usr->classic.a = buf[3] & 0x01;
+	usr->classic.b = (buf[3] & 0x02) >> 1;
+	usr->classic.x = (buf[3] & 0x04) >> 2;
+	usr->classic.y = (buf[3] & 0x08) >> 3;
+	usr->classic.up = (buf[3] & 0x10) >> 4;
+	usr->classic.down = (buf[3] & 0x20) >> 5;
+	usr->classic.right = (buf[3] & 0x40) >> 6;
+	usr->classic.left = (buf[3] & 0x80) >> 7;
+	usr->classic.r = buf[4] & 0x01;
+	usr->classic.zr = (buf[4] & 0x02) >> 1;
+	usr->classic.l = (buf[4] & 0x04) >> 2;
+	usr->classic.zl = (buf[4] & 0x08) >> 3;
+
+	// Extra mappings
+	if (*extension != EXT_CLASSIC) usr->b |= usr->classic.zr;
+
+	usr->classic.lx = buf[5] >> 2;
+	usr->classic.ly = buf[6] >> 2;
+	usr->classic.rx = buf[7] >> 3;
+	usr->classic.ry = buf[8] >> 3;
+	usr->nunchuk.x = buf[5];
+	usr->nunchuk.y = buf[6];
+
+	usr->accel_x = buf[9] | ((buf[12] & 0x03) << 8);
+	usr->accel_y = buf[10] | ((buf[12] & 0x0C) << 6);
+	usr->accel_z = buf[11] | ((buf[12] & 0x30) << 4);
+
+	usr->nunchuk.accel_x = buf[13] | ((buf[16] & 0x03) << 8);
+	usr->nunchuk.accel_y = buf[14] | ((buf[16] & 0x0C) << 6);
+	usr->nunchuk.accel_z = buf[15] | ((buf[16] & 0x30) << 4);
+
+	usr->ir_object[0].x = buf[22] | (buf[23] << 8);
+	usr->ir_object[0].y = buf[24] | (buf[25] << 8);
+	usr->ir_object[0].size = 8;
+	usr->ir_object[1].x = buf[26] | (buf[27] << 8);
+	usr->ir_object[1].y = buf[28] | (buf[29] << 8);
+	usr->ir_object[1].size = 8;
+	usr->ir_object[2].x = 0xFFFF;
+	usr->ir_object[2].y = 0xFFFF;
+	usr->ir_object[2].size = 0;
+	usr->ir_object[3].x = 0xFFFF;
+	usr->ir_object[3].y = 0xFFFF;
+	usr->ir_object[3].size = 0;
+
+	return true;
+}
+
+// Returns the number of samples in an IMU slot (oldest first), or 0 if the slot isn't valid
+uint8_t spi_codec_decode_imu(const uint8_t * buf, struct spi_imu_sample * samples) {
+	uint8_t num_samples = buf[0] >> 4;
+	uint8_t checksum = 0;
+	uint8_t i, j;
+
+	for (i = 0; i < 31; i++) checksum += buf[i];
+	checksum += 0x55;
+	if ((checksum != buf[31]) || !num_samples || (num_samples > IMU_SLOT_SAMPLES)) return 0;
+
+	for (i = 0; i < num_samples; i++) {
+		const uint8_t * sample_buf = buf + 1 + (10 * i);
+		uint32_t axis[3];
+		for (j = 0; j < 3; j++) axis[j] = sample_buf[1 + (3 * j)] | (sample_buf[2 + (3 * j)] << 8) | ((uint32_t)sample_buf[3 + (3 * j)] << 16);
+
+		samples[i].time = sample_buf[0];
+		samples[i].roll = axis[0] & 0x3FFF;
+		samples[i].pitch = axis[1] & 0x3FFF;
+		samples[i].yaw = axis[2] & 0x3FFF;
+		samples[i].accel_x = axis[0] >> 14;
+		samples[i].accel_y = axis[1] >> 14;
+		samples[i].accel_z = axis[2] >> 14;
+	}
+	return num_samples;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef SPI_CODEC_H_
+#define SPI_CODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "wiimote.h"
+
+// Encoding and decoding of ESP32 link frames, kept free of hardware access and global state
+
+struct spi_imu_sample {
+	uint8_t time;	// Low byte of ESP32 time (ms)
+	uint16_t roll;	// 14-bit Motion Plus values
+	uint16_t pitch;
+	uint16_t yaw;
+	uint16_t accel_x;	// 10-bit accelerometer values
+	uint16_t accel_y;
+	uint16_t accel_z;
+};
+
+// Wii state sent to the ESP32
+struct spi_wii_state {
+	uint8_t rumble_intensity;	// Fraction of time rumble was on since last transfer (0 - 255)
+	uint8_t led_state;	// Bit 0 = LED 1
+	uint8_t flags;	// WII_STATE_* flags
+	uint8_t reporting_mode;
+	uint8_t speaker_format;
+	uint8_t speaker_volume;
+};
+
+uint8_t spi_codec_encode_status(uint8_t wiimote_num, uint8_t player_num, bool connectable, bool rumble);
+void spi_codec_encode_state(uint8_t wiimote_num, const struct spi_wii_state * state, uint8_t * buf);
+bool spi_codec_decode_wiimote(const uint8_t * buf, struct wiimote_state_usr * usr, enum EXTENSION_TYPE * extension);
+uint8_t spi_codec_decode_imu(const uint8_t * buf, struct spi_imu_sample * samples);
+
+#endif
\ No newline at end of file
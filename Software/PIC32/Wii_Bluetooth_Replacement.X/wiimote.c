@@ -3,6 +3,7 @@
 #include "wm_crypto.h"
 #include "wm_eeprom.h"
 #include "spi.h"
+#include "spi_codec.h"
 #include "delay.h"
 #include "uart.h"
 #include "hci.h"
@@ -46,11 +47,18 @@ int32_t _wiimote_get_data(uint16_t hci_handle, uint8_t * buf) {
 	return 0;
 }
 
+// Track how long rumble has been on so the ESP32 gets an intensity rather than a single sample
+static void wiimote_set_rumble(wiimote_t * wiimote, bool rumble) {
+	if (wiimote->sys.rumble) wiimote->sys.rumble_on_time += main_timer - wiimote->sys.rumble_time;
+	wiimote->sys.rumble_time = main_timer;
+	wiimote->sys.rumble = rumble;
+}
+
 int wiimote_recv_report(wiimote_t * wiimote, const uint8_t * buf, int len) {
 struct report_data * data = (struct report_data *)buf;
 
 // Every output report contains rumble info
-wiimote->sys.rumble = data->buf[0] & 0x01;
+wiimote_set_rumble(wiimote, data->buf[0] & 0x01);
 
 	switch (data->type) {
 		case 0x11: {    // Player LEDS
@@ -115,6 +123,108 @@ wiimote->sys.rumble = data->buf[0] & 0x01;
 	return 0;
 }
 
+static uint16_t imu_interpolate(uint16_t a, uint16_t b, int32_t part, int32_t span) {
+	return a + (((int32_t)b - (int32_t)a) * part) / span;
+}
+
+// Store IMU samples from an ESP32 IMU slot, converting their timestamps to main_timer time
+static void wiimote_imu_receive(wiimote_t * wiimote, const uint8_t * buf) {
+	struct wiimote_imu * imu = &wiimote->imu;
+	struct spi_imu_sample samples[IMU_SLOT_SAMPLES];
+	uint8_t num_samples = spi_codec_decode_imu(buf, samples);
+	uint8_t i;
+
+	if (!num_samples) return;
+
+	// Only the low byte of the ESP32 time is sent, so unwrap it using the newest sample
+	uint8_t newest_time = samples[num_samples - 1].time;
+	if (imu->count && (newest_time == (uint8_t)imu->esp_time)) return;	// Same samples as the previous transfer, so they don't count as an update
+	uint32_t prev_esp_time = imu->esp_time;
+	uint8_t resync = !imu->count || (main_timer - imu->last_update_time >= 200);
+
+	if (resync) {
+		imu->count = 0;
+		imu->esp_time = newest_time;
+		imu->clock_offset = main_timer - imu->esp_time;
+		imu->drift_count = 0;
+	} else {
+		uint8_t elapsed = newest_time - (uint8_t)imu->esp_time;
+		if (elapsed >= 128) return;	// Older than samples already received
+		imu->esp_time += elapsed;
+
+		// Lowest transfer latency seen gives the best clock offset, but let it creep up in case the clocks drift apart
+		int32_t offset = main_timer - imu->esp_time;
+		if (offset < imu->clock_offset) imu->clock_offset = offset;
+		else if (++imu->drift_count >= 64) {
+			imu->clock_offset++;
+			imu->drift_count = 0;
+		}
+	}
+	imu->last_update_time = main_timer;
+
+	for (i = 0; i < num_samples; i++) {	// Oldest sample first
+		uint32_t esp_time = imu->esp_time - (uint8_t)(newest_time - samples[i].time);
+		if (!resync && ((int32_t)(esp_time - prev_esp_time) <= 0)) continue;	// Already received in a previous transfer
+
+		struct wiimote_imu_sample * sample = &imu->samples[imu->pos];
+		sample->time = esp_time + imu->clock_offset;
+		sample->roll = samples[i].roll;
+		sample->pitch = samples[i].pitch;
+		sample->yaw = samples[i].yaw;
+		sample->accel_x = samples[i].accel_x;
+		sample->accel_y = samples[i].accel_y;
+		sample->accel_z = samples[i].accel_z;
+
+		imu->pos = (imu->pos + 1) % IMU_RING_LEN;
+		if (imu->count < IMU_RING_LEN) imu->count++;
+	}
+}
+
+// Set accelerometer and Motion Plus values from the samples surrounding the time this report represents
+static void wiimote_imu_playback(wiimote_t * wiimote) {
+	struct wiimote_imu * imu = &wiimote->imu;
+	struct wiimote_imu_sample * prev = NULL;
+	struct wiimote_imu_sample * next = NULL;
+	struct wiimote_imu_sample sample;
+	uint32_t time = main_timer - IMU_PLAYOUT_DELAY;
+	uint8_t i;
+
+	if (!imu->count) return;
+
+	// Streaming stopped (IMU disabled or controller changed), so leave the regular accelerometer and Motion Plus values alone
+	if (main_timer - imu->samples[(imu->pos + IMU_RING_LEN - 1) % IMU_RING_LEN].time > IMU_PLAYBACK_TIMEOUT) return;
+
+	for (i = 0; i < imu->count; i++) {	// Oldest sample first
+		struct wiimote_imu_sample * cur = &imu->samples[(imu->pos + IMU_RING_LEN - imu->count + i) % IMU_RING_LEN];
+		if ((int32_t)(cur->time - time) <= 0) prev = cur;
+		else {
+			next = cur;
+			break;
+		}
+	}
+
+	if (prev && next) {
+		int32_t span = next->time - prev->time;
+		int32_t part = time - prev->time;
+		sample.yaw = imu_interpolate(prev->yaw, next->yaw, part, span);
+		sample.roll = imu_interpolate(prev->roll, next->roll, part, span);
+		sample.pitch = imu_interpolate(prev->pitch, next->pitch, part, span);
+		sample.accel_x = imu_interpolate(prev->accel_x, next->accel_x, part, span);
+		sample.accel_y = imu_interpolate(prev->accel_y, next->accel_y, part, span);
+		sample.accel_z = imu_interpolate(prev->accel_z, next->accel_z, part, span);
+	} else sample = prev ? *prev : *next;	// Outside of the received samples, use the closest one
+
+	wiimote->usr.accel_x = sample.accel_x;
+	wiimote->usr.accel_y = sample.accel_y;
+	wiimote->usr.accel_z = sample.accel_z;
+	wiimote->usr.motionplus.yaw_down = sample.yaw;
+	wiimote->usr.motionplus.roll_left = sample.roll;
+	wiimote->usr.motionplus.pitch_left = sample.pitch;
+	wiimote->usr.motionplus.yaw_slow = 0;	// Samples use the full gyro range
+	wiimote->usr.motionplus.roll_slow = 0;
+	wiimote->usr.motionplus.pitch_slow = 0;
+}
+
 int wiimote_get_report(wiimote_t * wiimote, uint8_t * buf) {
 	if (main_timer - wiimote->sys.last_report_time < 11) return 0;	// Wait 11ms or more between reports
 
@@ -133,6 +243,7 @@ int wiimote_get_report(wiimote_t * wiimote, uint8_t * buf) {
 		len = 2;
 		data->io = 0xa1;
 		data->type = wiimote->sys.reporting_mode;
+		wiimote_imu_playback(wiimote);
 	}
 	else
 	{
@@ -732,29 +843,51 @@ uint8_t wiimote_get_player_num(wiimote_t * wiimote) {
 	}
 }
 
+// Wii state used by the ESP32 to decide what to request from real controllers
+static void wiimote_get_state_message(wiimote_t * wiimote, uint8_t wiimote_num, uint8_t * buf) {
+	struct spi_wii_state state;
+	uint32_t window = main_timer - wiimote->sys.rumble_window_start;
+	uint32_t intensity;
+
+	// Rumble duty cycle since the last transfer
+	wiimote_set_rumble(wiimote, wiimote->sys.rumble);
+	if (window) intensity = (wiimote->sys.rumble_on_time * 255) / window;
+	else intensity = wiimote->sys.rumble ? 255 : 0;
+	if (intensity > 255) intensity = 255;
+	wiimote->sys.rumble_on_time = 0;
+	wiimote->sys.rumble_window_start = main_timer;
+
+	state.rumble_intensity = intensity;
+	state.led_state = wiimote->sys.led_1 | (wiimote->sys.led_2 << 1) | (wiimote->sys.led_3 << 2) | (wiimote->sys.led_4 << 3);
+	state.flags = (wiimote->sys.connected ? WII_STATE_CONNECTED : 0) |
+				  (wiimote->sys.ircam_enabled ? WII_STATE_IRCAM : 0) |
+				  (wiimote->sys.speaker_enabled ? WII_STATE_SPEAKER : 0) |
+				  ((wiimote->sys.wmp_state == 1) ? WII_STATE_WMP : 0) |
+				  (wiimote->sys.reporting_continuous ? WII_STATE_CONTINUOUS : 0);
+	state.reporting_mode = wiimote->sys.reporting_mode;
+	state.speaker_format = wiimote->register_a2[0x01];
+	state.speaker_volume = wiimote->register_a2[0x05];
+
+	spi_codec_encode_state(wiimote_num, &state, buf);
+}
+
 void update_wiimotes() {
-	uint8_t input_data[128] = { 0 };
+	uint8_t input_data[SPI_FRAME_LEN] = { 0 };
+	uint8_t output_data[SPI_FRAME_LEN] = { 0 };
 
 	if (((main_timer - prev_update_time) >= 15) && SPI_EN) {   // Allow 15ms for ESP32 to acknowledge last transfer
 		prev_update_time = main_timer;
-		uint8_t i, j;
+		uint8_t i;
+		uint16_t k;
+
+		for (i = 0; i < 4; i++) {
+			output_data[i] = spi_codec_encode_status(i + 1, wiimote_get_player_num(&wiimotes[i]), wiimotes[i].sys.connectable, wiimotes[i].sys.rumble);
+			wiimote_get_state_message(&wiimotes[i], i + 1, &output_data[SPI_DOWNSTREAM_OFFSET + (SPI_DOWNSTREAM_LEN * i)]);
+		}
 
 		SPI_CS = 0;	// Begin SPI transaction
 
-		input_data[0] = spi_transfer((wiimotes[0].sys.rumble << 7) | 
-						(wiimote_get_player_num(&wiimotes[0]) << 4) | 
-						(wiimotes[0].sys.connectable << 3) | 0x01);
-		input_data[1] = spi_transfer((wiimotes[1].sys.rumble << 7) | 
-						(wiimote_get_player_num(&wiimotes[1]) << 4) | 
-						(wiimotes[1].sys.connectable << 3) | 0x02);
-		input_data[2] = spi_transfer((wiimotes[2].sys.rumble << 7) | 
-						(wiimote_get_player_num(&wiimotes[2]) << 4) | 
-						(wiimotes[2].sys.connectable << 3) | 0x03);
-		input_data[3] = spi_transfer((wiimotes[3].sys.rumble << 7) | 
-						(wiimote_get_player_num(&wiimotes[3]) << 4) | 
-						(wiimotes[3].sys.connectable << 3) | 0x04);
-
-		for (i = 4; i < 128; i++) input_data[i] = spi_transfer(0x00);
+		for (k = 0; k < SPI_FRAME_LEN; k++) input_data[k] = spi_transfer(output_data[k]);
 		
 		SPI_CS = 1;	// End SPI transaction
 
@@ -795,80 +928,20 @@ void update_wiimotes() {
 					uart_transmit(" disconnected", 1);
 				}
 
-				uint8_t checksum_buttons = 0;
-				for (j = 0; j < 4; j++) checksum_buttons += input_data[j + 1 + (32 * i)];
-				checksum_buttons += 0x55;
-
-				if (checksum_buttons == input_data[30 + (32 * i)]) {    // Verify checksum
-					if ((input_data[32 * i] >> 4) != wiimotes[i].sys.extension) {
-						wiimotes[i].sys.extension = input_data[32 * i] >> 4;
+				enum EXTENSION_TYPE extension;
+				if (spi_codec_decode_wiimote(input_data + (32 * i), &wiimotes[i].usr, &extension)) {	// Verify checksum
+					if (extension != wiimotes[i].sys.extension) {
+						wiimotes[i].sys.extension = extension;
 						init_extension(&wiimotes[i]);
 						wiimotes[i].sys.extension_connected = 0;
 						report_queue_push_status(&wiimotes[i]);
 						wiimotes[i].sys.extension_connected = 1;
 						report_queue_push_status(&wiimotes[i]);
 					}
+				}
 
-					wiimotes[i].usr.a = input_data[1 + (32 * i)] & 0x01;
-					wiimotes[i].usr.b = (input_data[1 + (32 * i)] & 0x02) >> 1;
-					wiimotes[i].usr.one = (input_data[1 + (32 * i)] & 0x04) >> 2;
-					wiimotes[i].usr.two = (input_data[1 + (32 * i)] & 0x08) >> 3;
-					wiimotes[i].usr.up = (input_data[1 + (32 * i)] & 0x10) >> 4;
-					wiimotes[i].usr.down = (input_data[1 + (32 * i)] & 0x20) >> 5;
-					wiimotes[i].usr.right = (input_data[1 + (32 * i)] & 0x40) >> 6;
-					wiimotes[i].usr.left = (input_data[1 + (32 * i)] & 0x80) >> 7;
-					wiimotes[i].usr.plus = input_data[2 + (32 * i)] & 0x01;
-					wiimotes[i].usr.minus = (input_data[2 + (32 * i)] & 0x02) >> 1;
-					wiimotes[i].usr.home = (input_data[2 + (32 * i)] & 0x04) >> 2;
-					wiimotes[i].usr.classic.plus = (input_data[2 + (32 * i)] & 0x08) >> 3;
-					wiimotes[i].usr.classic.minus = (input_data[2 + (32 * i)] & 0x10) >> 4;
-					wiimotes[i].usr.classic.home = (input_data[2 + (32 * i)] & 0x20) >> 5;
-					wiimotes[i].usr.nunchuk.c = (input_data[2 + (32 * i)] & 0x40) >> 6;
-					wiimotes[i].usr.nunchuk.z = (input_data[2 + (32 * i)] & 0x80) >> 7;
-					wiimotes[i].usr.classic.a = input_data[3 + (32 * i)] & 0x01;
-					wiimotes[i].usr.classic.b = (input_data[3 + (32 * i)] & 0x02) >> 1;
-					wiimotes[i].usr.classic.x = (input_data[3 + (32 * i)] & 0x04) >> 2;
-					wiimotes[i].usr.classic.y = (input_data[3 + (32 * i)] & 0x08) >> 3;
-					wiimotes[i].usr.classic.up = (input_data[3 + (32 * i)] & 0x10) >> 4;
-					wiimotes[i].usr.classic.down = (input_data[3 + (32 * i)] & 0x20) >> 5;
-					wiimotes[i].usr.classic.right = (input_data[3 + (32 * i)] & 0x40) >> 6;
-					wiimotes[i].usr.classic.left = (input_data[3 + (32 * i)] & 0x80) >> 7;
-					wiimotes[i].usr.classic.r = input_data[4 + (32 * i)] & 0x01;
-					wiimotes[i].usr.classic.zr = (input_data[4 + (32 * i)] & 0x02) >> 1;
-					wiimotes[i].usr.classic.l = (input_data[4 + (32 * i)] & 0x04) >> 2;
-					wiimotes[i].usr.classic.zl = (input_data[4 + (32 * i)] & 0x08) >> 3;
-
-					// Extra mappings
-					if (wiimotes[i].sys.extension != EXT_CLASSIC) wiimotes[i].usr.b |= wiimotes[i].usr.classic.zr;
-
-					wiimotes[i].usr.classic.lx = input_data[5 + (32 * i)] >> 2;
-					wiimotes[i].usr.classic.ly = input_data[6 + (32 * i)] >> 2;
-					wiimotes[i].usr.classic.rx = input_data[7 + (32 * i)] >> 3;
-					wiimotes[i].usr.classic.ry = input_data[8 + (32 * i)] >> 3;
-					wiimotes[i].usr.nunchuk.x = input_data[5 + (32 * i)];
-					wiimotes[i].usr.nunchuk.y = input_data[6 + (32 * i)];
-
-					wiimotes[i].usr.accel_x = input_data[9 + (32 * i)] | ((input_data[12 + (32 * i)] & 0x03) << 8);
-					wiimotes[i].usr.accel_y = input_data[10 + (32 * i)] | ((input_data[12 + (32 * i)] & 0x0C) << 6);
-					wiimotes[i].usr.accel_z = input_data[11 + (32 * i)] | ((input_data[12 + (32 * i)] & 0x30) << 4);
-
-					wiimotes[i].usr.nunchuk.accel_x = input_data[13 + (32 * i)] | ((input_data[16 + (32 * i)] & 0x03) << 8);
-					wiimotes[i].usr.nunchuk.accel_y = input_data[14 + (32 * i)] | ((input_data[16 + (32 * i)] & 0x0C) << 6);
-					wiimotes[i].usr.nunchuk.accel_z = input_data[15 + (32 * i)] | ((input_data[16 + (32 * i)] & 0x30) << 4);
-
-					wiimotes[i].usr.ir_object[0].x = input_data[22 + (32 * i)] | (input_data[23 + (32 * i)] << 8);
-					wiimotes[i].usr.ir_object[0].y = input_data[24 + (32 * i)] | (input_data[25 + (32 * i)] << 8);
-					wiimotes[i].usr.ir_object[0].size = 8;
-					wiimotes[i].usr.ir_object[1].x = input_data[26 + (32 * i)] | (input_data[27 + (32 * i)] << 8);
-					wiimotes[i].usr.ir_object[1].y = input_data[28 + (32 * i)] | (input_data[29 + (32 * i)] << 8);
-					wiimotes[i].usr.ir_object[1].size = 8;
-					wiimotes[i].usr.ir_object[2].x = 0xFFFF;
-					wiimotes[i].usr.ir_object[2].y = 0xFFFF;
-					wiimotes[i].usr.ir_object[2].size = 0;
-					wiimotes[i].usr.ir_object[3].x = 0xFFFF;
-					wiimotes[i].usr.ir_object[3].y = 0xFFFF;
-					wiimotes[i].usr.ir_object[3].size = 0;
-				}  
+				// IMU samples for Motion Plus follow the 4 Wiimote slots
+				if ((input_data[32 * (i + 4)] & 0x07) == i + 1) wiimote_imu_receive(&wiimotes[i], input_data + (32 * (i + 4)));
 			} else {    // Controller is not connected
 				if (wiimotes[i].sys.connected) {
 					hci_queue_evt(HCI_DISCONNECTION_COMPLETE, 0, wiimotes[i].sys.hci_handle);   // Terminate connection
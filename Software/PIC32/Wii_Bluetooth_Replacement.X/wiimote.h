@@ -4,6 +4,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define IMU_RING_LEN 8
+#define IMU_SLOT_SAMPLES 3	// IMU samples received from the ESP32 per transfer
+#define IMU_PLAYOUT_DELAY 20	// Reports use motion data from this many ms ago so there is a newer sample to interpolate towards
+#define IMU_PLAYBACK_TIMEOUT (5 * IMU_PLAYOUT_DELAY)	// Samples stop being played back once the newest is this old (ms)
+
+// Flags in the Wii state message sent to the ESP32
+#define WII_STATE_CONNECTED	0x01
+#define WII_STATE_IRCAM		0x02
+#define WII_STATE_SPEAKER	0x04
+#define WII_STATE_WMP		0x08
+#define WII_STATE_CONTINUOUS	0x10
+
 enum EXTENSION_TYPE { 
 	EXT_NONE = 0, 
 	EXT_NUNCHUK = 1, 
@@ -64,6 +76,26 @@ struct wiimote_motionplus {
 	bool pitch_slow;
 };
 
+struct wiimote_imu_sample {
+	uint32_t time;	// main_timer time of sample
+	uint16_t yaw;	// 14-bit Motion Plus values
+	uint16_t roll;
+	uint16_t pitch;
+	uint16_t accel_x;	// 10-bit accelerometer values
+	uint16_t accel_y;
+	uint16_t accel_z;
+};
+
+struct wiimote_imu {
+	struct wiimote_imu_sample samples[IMU_RING_LEN];
+	uint8_t pos;	// Next sample to be written
+	uint8_t count;
+	uint32_t esp_time;	// Unwrapped ESP32 time of newest sample
+	int32_t clock_offset;	// main_timer minus ESP32 time
+	uint8_t drift_count;
+	uint32_t last_update_time;
+};
+
 struct wiimote_state_usr {
 	bool a;
 	bool b;
@@ -109,6 +141,9 @@ struct wiimote_state_sys {
 	bool led_4;
 
 	bool rumble;
+	uint32_t rumble_time;	// Time of last rumble change
+	uint32_t rumble_on_time;	// Time (ms) spent rumbling since the last SPI transfer
+	uint32_t rumble_window_start;
 
 	bool ircam_enabled;
 	bool speaker_enabled;
@@ -141,6 +176,8 @@ typedef struct {
 	struct wiimote_state_sys sys;
 	struct wiimote_state_usr usr;
 
+	struct wiimote_imu imu;
+
 	uint8_t register_a2[0x09 + 1]; // Speaker
 	uint8_t register_a4[0xff + 1]; // Extension
 	uint8_t register_a6[0xff + 1]; // Wii motion plus
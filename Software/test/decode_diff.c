@@ -0,0 +1,448 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "input_desc.h"
+#include "loopback.h"
+
+// Differential test of the input descriptor tables (input_desc.h) against the hand written parsers they replaced,
+// run on random reports, then a benchmark of both.
+// Usage: decode_diff [seed] [iterations]
+//
+// Stick mapping and button events are left out, those are shared code and ran after the decode in both versions.
+
+#define REPORT_LEN      64
+#define BENCH_REPORTS   2000000
+
+// Same fields and types as gamepad.h, which can't be included here without the BTstack headers
+#define BUTTON_FIELDS \
+    X(a) X(b) X(x) X(y) X(du) X(dd) X(dr) X(dl) X(r) X(zr) X(l) X(zl) X(plus) X(minus) X(home) X(capture) \
+    X(rs) X(ls) X(srr) X(slr) X(srl) X(sll) X(one) X(two) X(c) X(z)
+
+#define STICK_FIELDS \
+    X(joy_lx) X(joy_ly) X(joy_rx) X(joy_ry)
+
+#define MOTION_FIELDS \
+    X(accel_rx) X(accel_ry) X(accel_rz) X(accel_lx) X(accel_ly) X(accel_lz) \
+    X(gyro_rx) X(gyro_ry) X(gyro_rz) X(gyro_lx) X(gyro_ly) X(gyro_lz)
+
+#define X(name) uint8_t name;
+typedef struct { BUTTON_FIELDS } buttons_t;
+#undef X
+
+#define X(name) uint16_t name;
+typedef struct { STICK_FIELDS
+#undef X
+#define X(name) int16_t name;
+    MOTION_FIELDS } axes_t;
+#undef X
+
+// Only the calibration offsets, stick ranges are used by the mapping
+#define X(name) int16_t name##_offset;
+typedef struct { MOTION_FIELDS } calibration_t;
+#undef X
+
+typedef struct {
+    buttons_t buttons;
+    axes_t axes;
+    calibration_t cal;
+    uint8_t calibrating;
+} gamepad_t;
+
+typedef void (*parser_t)(gamepad_t * gamepad, const uint8_t * data);
+
+// Descriptor decode and the post-processing that follows it in gamepad.c
+
+#define DESC_SET(group, field, byte, bit, width, shift, flags)  gamepad->group.field = DESC_READ(data, byte, bit, width, shift, flags);
+#define DESC_OR(group, field, byte, bit, width, shift, flags)   gamepad->group.field |= DESC_READ(data, byte, bit, width, shift, flags);
+#define DESC_DECODE(table) table(DESC_SET, DESC_OR)
+
+static void table_apply_gyro_r_cal(gamepad_t * gamepad) {
+    if (gamepad->calibrating) return;
+    gamepad->axes.gyro_rx -= gamepad->cal.gyro_rx_offset;
+    gamepad->axes.gyro_ry -= gamepad->cal.gyro_ry_offset;
+    gamepad->axes.gyro_rz -= gamepad->cal.gyro_rz_offset;
+}
+
+static void table_joycon_r(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_JOYCON_R_30)
+    gamepad->axes.accel_rx -= gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry -= gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz = -(gamepad->axes.accel_rz - gamepad->cal.accel_rz_offset);
+    table_apply_gyro_r_cal(gamepad);
+}
+
+static void table_joycon_l(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_JOYCON_L_30)
+    gamepad->axes.accel_lx -= gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly -= gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz -= gamepad->cal.accel_lz_offset;
+    gamepad->axes.gyro_lx -= gamepad->cal.gyro_lx_offset;
+    gamepad->axes.gyro_ly -= gamepad->cal.gyro_ly_offset;
+    gamepad->axes.gyro_lz -= gamepad->cal.gyro_lz_offset;
+}
+
+static void table_procon(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_PROCON_30)
+    gamepad->axes.accel_ry = -(gamepad->axes.accel_ry - gamepad->cal.accel_rx_offset);
+    gamepad->axes.accel_rx = -(gamepad->axes.accel_rx - gamepad->cal.accel_ry_offset);
+    gamepad->axes.accel_rz -= gamepad->cal.accel_rz_offset;
+    table_apply_gyro_r_cal(gamepad);
+}
+
+static void table_wiimote(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_WIIMOTE_BUTTONS)
+    DESC_DECODE(DESC_WIIMOTE_ACCEL)
+    gamepad->axes.accel_rx = (int16_t)(gamepad->axes.accel_rx * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry = (int16_t)(gamepad->axes.accel_ry * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz = (int16_t)(gamepad->axes.accel_rz * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
+}
+
+static void table_wmp(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_WMP_GYRO)
+    gamepad->axes.gyro_rx -= 0x8000;
+    gamepad->axes.gyro_ry -= 0x8000;
+    gamepad->axes.gyro_rz -= 0x8000;
+    table_apply_gyro_r_cal(gamepad);
+}
+
+static void table_nunchuk(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_NUNCHUK)
+    gamepad->axes.accel_lx = (int16_t)(gamepad->axes.accel_lx * 64) - 0x8000 - gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly = (int16_t)(gamepad->axes.accel_ly * 64) - 0x8000 - gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz = (int16_t)(gamepad->axes.accel_lz * 64) - 0x8000 - gamepad->cal.accel_lz_offset;
+}
+
+static void table_classic(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_CLASSIC)
+}
+
+static void table_wiiu_pro(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_WIIU_PRO)
+}
+
+// The wired Joy-Con offsets live in the UART controller, the calibration struct stands in for them here
+static void table_uart_r(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_UART_JOYCON_R)
+    gamepad->axes.gyro_rx -= gamepad->cal.gyro_rx_offset;
+    gamepad->axes.gyro_ry -= gamepad->cal.gyro_ry_offset;
+    gamepad->axes.gyro_rz -= gamepad->cal.gyro_rz_offset;
+    gamepad->axes.accel_rx -= gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry -= gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz -= gamepad->cal.accel_rz_offset;
+}
+
+static void table_uart_l(gamepad_t * gamepad, const uint8_t * data) {
+    DESC_DECODE(DESC_UART_JOYCON_L)
+    gamepad->axes.gyro_lx -= gamepad->cal.gyro_lx_offset;
+    gamepad->axes.gyro_ly -= gamepad->cal.gyro_ly_offset;
+    gamepad->axes.gyro_lz -= gamepad->cal.gyro_lz_offset;
+    gamepad->axes.accel_lx -= gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly -= gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz -= gamepad->cal.accel_lz_offset;
+}
+
+// Hand written parsers from gamepad.c before the descriptor tables
+
+static void legacy_joycon_r(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (data[4] & 0x08) >> 3;
+    gamepad->buttons.b = (data[4] & 0x04) >> 2;
+    gamepad->buttons.x = (data[4] & 0x02) >> 1;
+    gamepad->buttons.y = data[4] & 0x01;
+    gamepad->buttons.r = (data[4] & 0x40) >> 6;
+    gamepad->buttons.zr = (data[4] & 0x80) >> 7;
+    gamepad->buttons.plus = (data[5] & 0x02) >> 1;
+    gamepad->buttons.home = (data[5] & 0x10) >> 4;
+    gamepad->buttons.rs = (data[5] & 0x04) >> 2;
+    gamepad->buttons.srr = (data[4] & 0x10) >> 4;
+    gamepad->buttons.slr = (data[4] & 0x20) >> 5;
+    gamepad->axes.joy_rx = data[10] | ((data[11] & 0x0F) << 8);
+    gamepad->axes.joy_ry = (data[11] >> 4) | (data[12] << 4);
+    gamepad->axes.accel_rx = ((data[15] << 8) | data[14]) - gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry = ((data[17] << 8) | data[16]) - gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz = -(((data[19] << 8) | data[18]) - gamepad->cal.accel_rz_offset);
+    gamepad->axes.gyro_rx = ((data[21] << 8) | data[20]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);
+    gamepad->axes.gyro_ry = ((data[23] << 8) | data[22]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
+    gamepad->axes.gyro_rz = ((data[25] << 8) | data[24]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
+}
+
+static void legacy_joycon_l(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.du = (data[6] & 0x02) >> 1;
+    gamepad->buttons.dd = data[6] & 0x01;
+    gamepad->buttons.dr = (data[6] & 0x04) >> 2;
+    gamepad->buttons.dl = (data[6] & 0x08) >> 3;
+    gamepad->buttons.l = (data[6] & 0x40) >> 6;
+    gamepad->buttons.zl = (data[6] & 0x80) >> 7;
+    gamepad->buttons.minus = data[5] & 0x01;
+    gamepad->buttons.capture = (data[5] & 0x20) >> 5;
+    gamepad->buttons.ls = (data[5] & 0x08) >> 3;
+    gamepad->buttons.srl = (data[6] & 0x10) >> 4;
+    gamepad->buttons.sll = (data[6] & 0x20) >> 5;
+    gamepad->axes.joy_lx = data[7] | ((data[8] & 0x0F) << 8);
+    gamepad->axes.joy_ly = (data[8] >> 4) | (data[9] << 4);
+    gamepad->axes.accel_lx = ((data[15] << 8) | data[14]) - gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly = ((data[17] << 8) | data[16]) - gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz = ((data[19] << 8) | data[18]) - gamepad->cal.accel_lz_offset;
+    gamepad->axes.gyro_lx = ((data[21] << 8) | data[20]) - gamepad->cal.gyro_lx_offset;
+    gamepad->axes.gyro_ly = ((data[23] << 8) | data[22]) - gamepad->cal.gyro_ly_offset;
+    gamepad->axes.gyro_lz = ((data[25] << 8) | data[24]) - gamepad->cal.gyro_lz_offset;
+}
+
+static void legacy_procon(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (data[4] & 0x08) >> 3;
+    gamepad->buttons.b = (data[4] & 0x04) >> 2;
+    gamepad->buttons.x = (data[4] & 0x02) >> 1;
+    gamepad->buttons.y = data[4] & 0x01;
+    gamepad->buttons.du = (data[6] & 0x02) >> 1;
+    gamepad->buttons.dd = data[6] & 0x01;
+    gamepad->buttons.dr = (data[6] & 0x04) >> 2;
+    gamepad->buttons.dl = (data[6] & 0x08) >> 3;
+    gamepad->buttons.r = (data[4] & 0x40) >> 6;
+    gamepad->buttons.l = (data[6] & 0x40) >> 6;
+    gamepad->buttons.zr = (data[4] & 0x80) >> 7;
+    gamepad->buttons.zl = (data[6] & 0x80) >> 7;
+    gamepad->buttons.plus = (data[5] & 0x02) >> 1;
+    gamepad->buttons.minus = data[5] & 0x01;
+    gamepad->buttons.home = (data[5] & 0x10) >> 4;
+    gamepad->buttons.capture = (data[5] & 0x20) >> 5;
+    gamepad->buttons.rs = (data[5] & 0x04) >> 2;
+    gamepad->buttons.ls = (data[5] & 0x08) >> 3;
+    gamepad->axes.joy_rx = data[10] | ((data[11] & 0x0F) << 8);
+    gamepad->axes.joy_ry = (data[11] >> 4) | (data[12] << 4);
+    gamepad->axes.joy_lx = data[7] | ((data[8] & 0x0F) << 8);
+    gamepad->axes.joy_ly = (data[8] >> 4) | (data[9] << 4);
+    gamepad->axes.accel_ry = -(((data[15] << 8) | data[14]) - gamepad->cal.accel_rx_offset);
+    gamepad->axes.accel_rx = -(((data[17] << 8) | data[16]) - gamepad->cal.accel_ry_offset);
+    gamepad->axes.accel_rz = ((data[19] << 8) | data[18]) - gamepad->cal.accel_rz_offset;
+    gamepad->axes.gyro_rx = ((data[21] << 8) | data[20]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);
+    gamepad->axes.gyro_ry = ((data[23] << 8) | data[22]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
+    gamepad->axes.gyro_rz = ((data[25] << 8) | data[24]) - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
+}
+
+static void legacy_wiimote(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (data[3] & 0x08) >> 3;
+    gamepad->buttons.b = (data[3] & 0x04) >> 2;
+    gamepad->buttons.one = (data[3] & 0x02) >> 1;
+    gamepad->buttons.two = data[3] & 0x01;
+    gamepad->buttons.du = (data[2] & 0x08) >> 3;
+    gamepad->buttons.dd = (data[2] & 0x04) >> 2;
+    gamepad->buttons.dr = (data[2] & 0x02) >> 1;
+    gamepad->buttons.dl = data[2] & 0x01;
+    gamepad->buttons.home = (data[3] & 0x80) >> 7;
+    gamepad->axes.accel_rx = (int16_t)(((data[4] << 2) | ((data[2] & 0x60) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry = (int16_t)(((data[5] << 2) | ((data[3] & 0x20) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz = (int16_t)(((data[6] << 2) | ((data[3] & 0x40) >> 5)) * 64) - 0x8000 - gamepad->cal.accel_rz_offset;
+}
+
+static void legacy_wmp(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->axes.gyro_rx = ((((data[21] & 0xFC) << 6) | data[18]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rx_offset);
+    gamepad->axes.gyro_ry = ((((data[22] & 0xFC) << 6) | data[19]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_ry_offset);
+    gamepad->axes.gyro_rz = ((((data[20] & 0xFC) << 6) | data[17]) << 2) - 0x8000 - (gamepad->calibrating ? 0 : gamepad->cal.gyro_rz_offset);
+}
+
+static void legacy_nunchuk(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.c = (~data[22] & 0x02) >> 1;
+    gamepad->buttons.z = ~data[22] & 0x01;
+    gamepad->axes.joy_lx = data[17];
+    gamepad->axes.joy_ly = data[18];
+    gamepad->axes.accel_lx = (int16_t)(((data[19] << 2) | ((data[22] & 0x0C) >> 2)) * 64) - 0x8000 - gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly = (int16_t)(((data[20] << 2) | ((data[22] & 0x30) >> 4)) * 64) - 0x8000 - gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz = (int16_t)(((data[21] << 2) | ((data[22] & 0xC0) >> 6)) * 64) - 0x8000 - gamepad->cal.accel_lz_offset;
+}
+
+static void legacy_classic(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (~data[22] & 0x10) >> 4;
+    gamepad->buttons.b = (~data[22] & 0x40) >> 6;
+    gamepad->buttons.x = (~data[22] & 0x08) >> 3;
+    gamepad->buttons.y = (~data[22] & 0x20) >> 5;
+    gamepad->buttons.du = ~data[22] & 0x01;
+    gamepad->buttons.dd = (~data[21] & 0x40) >> 6;
+    gamepad->buttons.dr = (~data[21] & 0x80) >> 7;
+    gamepad->buttons.dl = (~data[22] & 0x02) >> 1;
+    gamepad->buttons.r = (~data[21] & 0x02) >> 1;
+    gamepad->buttons.l = (~data[21] & 0x20) >> 5;
+    gamepad->buttons.zr = (~data[22] & 0x04) >> 2;
+    gamepad->buttons.zl = (~data[22] & 0x80) >> 7;
+    gamepad->buttons.plus = (~data[21] & 0x04) >> 2;
+    gamepad->buttons.minus = (~data[21] & 0x10) >> 4;
+    gamepad->buttons.home = (~data[21] & 0x08) >> 3;
+    gamepad->axes.joy_rx = (((data[17] & 0xC0) >> 3) | ((data[18] & 0xC0) >> 5) | ((data[19] & 0x80) >> 7)) << 3;
+    gamepad->axes.joy_ry = (data[19] & 0x1F) << 3;
+    gamepad->axes.joy_lx = (data[17] & 0x3F) << 2;
+    gamepad->axes.joy_ly = (data[18] & 0x3F) << 2;
+}
+
+static void legacy_wiiu_pro(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (~data[11] & 0x10) >> 4;
+    gamepad->buttons.b = (~data[11] & 0x40) >> 6;
+    gamepad->buttons.x = (~data[11] & 0x08) >> 3;
+    gamepad->buttons.y = (~data[11] & 0x20) >> 5;
+    gamepad->buttons.du = ~data[11] & 0x01;
+    gamepad->buttons.dd = (~data[10] & 0x40) >> 6;
+    gamepad->buttons.dr = (~data[10] & 0x80) >> 7;
+    gamepad->buttons.dl = (~data[11] & 0x02) >> 1;
+    gamepad->buttons.r = (~data[10] & 0x02) >> 1;
+    gamepad->buttons.l = (~data[10] & 0x20) >> 5;
+    gamepad->buttons.zr = (~data[11] & 0x04) >> 2;
+    gamepad->buttons.zl = (~data[11] & 0x80) >> 7;
+    gamepad->buttons.plus = (~data[10] & 0x04) >> 2;
+    gamepad->buttons.minus = (~data[10] & 0x10) >> 4;
+    gamepad->buttons.home = (~data[10] & 0x08) >> 3;
+    gamepad->buttons.rs = ~data[12] & 0x01;
+    gamepad->buttons.ls = (~data[12] & 0x02) >> 1;
+    gamepad->axes.joy_rx = data[4] | ((data[5] & 0x0F) << 8);
+    gamepad->axes.joy_ry = data[8] | ((data[9] & 0x0F) << 8);
+    gamepad->axes.joy_lx = data[2] | ((data[3] & 0x0F) << 8);
+    gamepad->axes.joy_ly = data[6] | ((data[7] & 0x0F) << 8);
+}
+
+static void legacy_uart_r(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.a = (data[15] & 0x08) >> 3;
+    gamepad->buttons.b = (data[15] & 0x04) >> 2;
+    gamepad->buttons.x = (data[15] & 0x02) >> 1;
+    gamepad->buttons.y = data[15] & 0x01;
+    gamepad->buttons.r = (data[15] & 0x40) >> 6;
+    gamepad->buttons.zr = (data[15] & 0x80) >> 7;
+    gamepad->buttons.plus = (data[16] & 0x02) >> 1;
+    gamepad->buttons.home = (data[16] & 0x10) >> 4;
+    gamepad->buttons.rs = (data[16] & 0x04) >> 2;
+    gamepad->buttons.srr = (data[15] & 0x10) >> 4;
+    gamepad->buttons.slr = (data[15] & 0x20) >> 5;
+    gamepad->axes.joy_rx = ((data[22] & 0x0F << 4) | (data[22] & 0xF0 >> 4)) << 4;
+    gamepad->axes.joy_ry = data[21] << 4;
+    gamepad->axes.gyro_rx = ((data[32] << 8) | data[31]) - gamepad->cal.gyro_rx_offset;
+    gamepad->axes.gyro_ry = ((data[34] << 8) | data[33]) - gamepad->cal.gyro_ry_offset;
+    gamepad->axes.gyro_rz = ((data[36] << 8) | data[35]) - gamepad->cal.gyro_rz_offset;
+    gamepad->axes.accel_rx = ((data[38] << 8) | data[37]) - gamepad->cal.accel_rx_offset;
+    gamepad->axes.accel_ry = ((data[40] << 8) | data[39]) - gamepad->cal.accel_ry_offset;
+    gamepad->axes.accel_rz = ((data[42] << 8) | data[41]) - gamepad->cal.accel_rz_offset;
+}
+
+static void legacy_uart_l(gamepad_t * gamepad, const uint8_t * data) {
+    gamepad->buttons.du = (data[17] & 0x02) >> 1;
+    gamepad->buttons.dd = data[17] & 0x01;
+    gamepad->buttons.dr = (data[17] & 0x04) >> 2;
+    gamepad->buttons.dl = (data[17] & 0x08) >> 3;
+    gamepad->buttons.l = (data[17] & 0x40) >> 6;
+    gamepad->buttons.zl = (data[17] & 0x80) >> 7;
+    gamepad->buttons.minus = data[16] & 0x01;
+    gamepad->buttons.capture = (data[16] & 0x20) >> 5;
+    gamepad->buttons.ls = (data[16] & 0x08) >> 3;
+    gamepad->buttons.srl = (data[17] & 0x10) >> 4;
+    gamepad->buttons.sll = (data[17] & 0x20) >> 5;
+    gamepad->axes.joy_lx = ((data[19] & 0x0F << 4) | (data[19] & 0xF0 >> 4)) << 4;
+    gamepad->axes.joy_ly = data[20] << 4;
+    gamepad->axes.gyro_lx = ((data[32] << 8) | data[31]) - gamepad->cal.gyro_lx_offset;
+    gamepad->axes.gyro_ly = ((data[34] << 8) | data[33]) - gamepad->cal.gyro_ly_offset;
+    gamepad->axes.gyro_lz = ((data[36] << 8) | data[35]) - gamepad->cal.gyro_lz_offset;
+    gamepad->axes.accel_lx = ((data[38] << 8) | data[37]) - gamepad->cal.accel_lx_offset;
+    gamepad->axes.accel_ly = ((data[40] << 8) | data[39]) - gamepad->cal.accel_ly_offset;
+    gamepad->axes.accel_lz = ((data[42] << 8) | data[41]) - gamepad->cal.accel_lz_offset;
+}
+
+typedef struct {
+    const char * name;
+    uint8_t report_id;      // Written to byte 1, 0 leaves the random value
+    uint8_t ext_id;         // Low bits of byte 22 that select the extension data (0xFF leaves the random value)
+    parser_t table;
+    parser_t legacy;
+} report_type_t;
+
+static const report_type_t report_types[] = {
+    { "joycon r",   0x30, 0xFF, table_joycon_r,     legacy_joycon_r },
+    { "joycon l",   0x30, 0xFF, table_joycon_l,     legacy_joycon_l },
+    { "procon",     0x30, 0xFF, table_procon,       legacy_procon },
+    { "wiimote",    0x37, 0xFF, table_wiimote,      legacy_wiimote },
+    { "wmp",        0x37, 0x02, table_wmp,          legacy_wmp },
+    { "nunchuk",    0x37, 0xFF, table_nunchuk,      legacy_nunchuk },
+    { "classic",    0x37, 0xFF, table_classic,      legacy_classic },
+    { "wiiu pro",   0x3D, 0xFF, table_wiiu_pro,     legacy_wiiu_pro },
+    { "uart r",     0x00, 0xFF, table_uart_r,       legacy_uart_r },
+    { "uart l",     0x00, 0xFF, table_uart_l,       legacy_uart_l },
+};
+
+#define NUM_REPORT_TYPES (sizeof(report_types) / sizeof(report_types[0]))
+
+static uint32_t failures = 0;
+
+static void random_bytes(uint32_t * rng, void * buf, uint32_t len) {
+    uint8_t * bytes = buf;
+    uint32_t i;
+    for (i = 0; i < len; i++) bytes[i] = link_rand(rng);
+}
+
+static void random_report(uint32_t * rng, const report_type_t * type, uint8_t * data) {
+    random_bytes(rng, data, REPORT_LEN);
+    if (type->report_id) data[1] = type->report_id;
+    if (type->ext_id != 0xFF) data[22] = (data[22] & 0xFC) | type->ext_id;
+}
+
+#define X(field) if (expected->group.field != decoded->group.field) { \
+        printf("%s %" PRIu32 ": %s expected %d, got %d\n", type->name, iteration, #field, expected->group.field, decoded->group.field); \
+        failures++; \
+    }
+static void compare(const report_type_t * type, uint32_t iteration, const gamepad_t * expected, const gamepad_t * decoded) {
+#define group buttons
+    BUTTON_FIELDS
+#undef group
+#define group axes
+    STICK_FIELDS
+    MOTION_FIELDS
+#undef group
+}
+#undef X
+
+static void diff(uint32_t * rng, uint32_t iteration) {
+    uint8_t data[REPORT_LEN];
+    gamepad_t legacy, table;
+    uint32_t i;
+
+    for (i = 0; i < NUM_REPORT_TYPES; i++) {
+        random_report(rng, &report_types[i], data);
+
+        // Fields a parser doesn't touch keep their previous value, so both start from the same random state
+        random_bytes(rng, &legacy, sizeof(legacy));
+        legacy.calibrating = link_rand(rng) & 0x01;
+        table = legacy;
+
+        report_types[i].legacy(&legacy, data);
+        report_types[i].table(&table, data);
+        compare(&report_types[i], iteration, &legacy, &table);
+    }
+}
+
+static double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static double bench(parser_t parse, gamepad_t * gamepad, uint8_t (* reports)[REPORT_LEN]) {
+    double start = seconds_now();
+    uint32_t i;
+
+    for (i = 0; i < BENCH_REPORTS; i++) parse(gamepad, reports[i & 0xFF]);
+    return ((seconds_now() - start) * 1e9) / BENCH_REPORTS;
+}
+
+int main(int argc, char ** argv) {
+    uint32_t seed = (argc > 1) ? strtoul(argv[1], NULL, 0) : 0x5EED;
+    uint32_t iterations = (argc > 2) ? strtoul(argv[2], NULL, 0) : 100000;
+    uint32_t rng = seed ? seed : 1;
+    static uint8_t reports[256][REPORT_LEN];
+    static gamepad_t gamepad;
+    uint32_t i, j;
+
+    for (i = 0; i < iterations; i++) diff(&rng, i);
+    printf("%" PRIu32 " reports of each type (seed 0x%" PRIX32 "): %" PRIu32 " failures\n", iterations, seed, failures);
+
+    // The parsers are called through a pointer, as they would be per controller type on the ESP32
+    for (i = 0; i < NUM_REPORT_TYPES; i++) {
+        for (j = 0; j < 256; j++) random_report(&rng, &report_types[i], reports[j]);
+        printf("%-10s table %5.1f ns/report, legacy %5.1f ns/report\n", report_types[i].name,
+               bench(report_types[i].table, &gamepad, reports), bench(report_types[i].legacy, &gamepad, reports));
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fixed.h"
+#include "loopback.h"
+
+// Checks the Q16.16 helpers against the double precision math they replaced, then times both.
+// Usage: fixed_point [seed] [iterations]
+
+// Same values as wiimote.h, which can't be included here without the BTstack headers
+#define IR_X_MIN            112.0
+#define IR_X_MAX            912.0
+#define IR_Y_MIN            84.0
+#define IR_Y_MAX            484.0
+#define IR_PITCH_MAX        12.0
+#define IR_YAW_MAX          20.0
+#define IR_JOY_SENSITIVITY  10
+
+#define IR_TOLERANCE        0.001   // Pixels, the cursor is sent to the Wii as a whole pixel
+#define RATIO_TOLERANCE     (2.0 / 65536.0)
+#define MUL_TOLERANCE       (2.0 / 65536.0)
+#define BENCH_CALLS         2000000
+
+static uint32_t failures = 0;
+static double max_ir_error = 0, max_ratio_error = 0, max_mul_error = 0, max_div_error = 0;
+
+static double map(double x, double in_min, double in_max, double out_min, double out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static double to_double(fixed_t x) {
+    return x / 65536.0;
+}
+
+// Uniform in [min, max]
+static double rand_range(uint32_t * rng, double min, double max) {
+    return min + (max - min) * (link_rand(rng) / 4294967295.0);
+}
+
+static void check(const char * what, uint32_t iteration, double error, double tolerance, double * max_error) {
+    if (error > *max_error) *max_error = error;
+    if (error <= tolerance) return;
+    printf("%s %" PRIu32 ": error %g exceeds %g\n", what, iteration, error, tolerance);
+    failures++;
+}
+
+// Cursor position from the pointer angles, as in wiimote_angle_to_ir()
+static void angle_to_ir_fixed(fixed_t yaw, fixed_t pitch, fixed_t * x, fixed_t * y) {
+    *x = fixed_map(-yaw, FIXED_CONST(-IR_YAW_MAX), FIXED_CONST(IR_YAW_MAX), FIXED_CONST(IR_X_MIN), FIXED_CONST(IR_X_MAX));
+    *y = fixed_map(-pitch, FIXED_CONST(-IR_PITCH_MAX), FIXED_CONST(IR_PITCH_MAX), FIXED_CONST(IR_Y_MIN), FIXED_CONST(IR_Y_MAX));
+}
+
+static void angle_to_ir_double(double yaw, double pitch, double * x, double * y) {
+    *x = map(-yaw, -IR_YAW_MAX, IR_YAW_MAX, IR_X_MIN, IR_X_MAX);
+    *y = map(-pitch, -IR_PITCH_MAX, IR_PITCH_MAX, IR_Y_MIN, IR_Y_MAX);
+}
+
+static void compare(uint32_t * rng, uint32_t iteration) {
+    // Angles go out of range on purpose, the cursor is allowed to leave the screen before going idle
+    float yaw = rand_range(rng, -2 * IR_YAW_MAX, 2 * IR_YAW_MAX);
+    float pitch = rand_range(rng, -2 * IR_PITCH_MAX, 2 * IR_PITCH_MAX);
+    int16_t joy = (int16_t)(link_rand(rng) % 0x1000) - 0x7FF;
+    fixed_t fa = (fixed_t)(rand_range(rng, -1000, 1000) * 65536.0);
+    fixed_t fb = (fixed_t)(rand_range(rng, -1000, 1000) * 65536.0);
+    fixed_t fx, fy;
+    double dx, dy;
+
+    // Converted the same way as gamepad_update_pointer()
+    angle_to_ir_fixed((fixed_t)(yaw * 65536.0f), (fixed_t)(pitch * 65536.0f), &fx, &fy);
+    angle_to_ir_double(yaw, pitch, &dx, &dy);
+    check("ir x", iteration, fabs(to_double(fx) - dx), IR_TOLERANCE, &max_ir_error);
+    check("ir y", iteration, fabs(to_double(fy) - dy), IR_TOLERANCE, &max_ir_error);
+
+    check("joy speed", iteration, fabs(to_double(fixed_from_ratio(joy, IR_JOY_SENSITIVITY, 0xFFF)) - ((double)joy * IR_JOY_SENSITIVITY / 0xFFF)),
+          RATIO_TOLERANCE, &max_ratio_error);
+
+    // Products are kept below 32768 so they fit in Q16.16
+    check("mul", iteration, fabs(to_double(fixed_mul(fa, fb / 32)) - (to_double(fa) * to_double(fb / 32))), MUL_TOLERANCE, &max_mul_error);
+
+    if (abs(fb) >= FIXED_ONE)
+        check("div", iteration, fabs(to_double(fixed_div(fa, fb)) - (to_double(fa) / to_double(fb))), RATIO_TOLERANCE, &max_div_error);
+}
+
+static double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static volatile fixed_t fixed_sink;
+static volatile double double_sink;
+
+static void bench_fixed(const fixed_t * angles) {
+    double start = seconds_now();
+    double elapsed;
+    fixed_t x, y;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_CALLS; i++) {
+        angle_to_ir_fixed(angles[i & 0xFF], angles[(i + 1) & 0xFF], &x, &y);
+        fixed_sink = x + y;
+    }
+    elapsed = seconds_now() - start;
+    printf("%-14s %6.1f ns/call\n", "fixed angle", (elapsed * 1e9) / BENCH_CALLS);
+}
+
+static void bench_double(const fixed_t * angles) {
+    double start = seconds_now();
+    double elapsed;
+    double x, y;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_CALLS; i++) {
+        angle_to_ir_double(angles[i & 0xFF] / 65536.0, angles[(i + 1) & 0xFF] / 65536.0, &x, &y);
+        double_sink = x + y;
+    }
+    elapsed = seconds_now() - start;
+    printf("%-14s %6.1f ns/call\n", "double angle", (elapsed * 1e9) / BENCH_CALLS);
+}
+
+int main(int argc, char ** argv) {
+    uint32_t seed = (argc > 1) ? strtoul(argv[1], NULL, 0) : 0x5EED;
+    uint32_t iterations = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1000000;
+    uint32_t rng = seed ? seed : 1;
+    fixed_t angles[256];
+    uint32_t i;
+
+    for (i = 0; i < iterations; i++) compare(&rng, i);
+    printf("%" PRIu32 " comparisons (seed 0x%" PRIX32 "): %" PRIu32 " failures\n", iterations, seed, failures);
+    printf("max error: ir %.6f px, ratio %.8f, mul %.8f, div %.8f\n", max_ir_error, max_ratio_error, max_mul_error, max_div_error);
+
+    // The host has a double precision FPU, so this understates the gap on the ESP32 where doubles are emulated
+    for (i = 0; i < 256; i++) angles[i] = (fixed_t)(rand_range(&rng, -IR_YAW_MAX, IR_YAW_MAX) * 65536.0);
+    bench_fixed(angles);
+    bench_double(angles);
+
+    return failures ? 1 : 0;
+}
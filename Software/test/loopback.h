@@ -0,0 +1,65 @@
+#ifndef _LOOPBACK_H_
+#define	_LOOPBACK_H_
+
+#include <stdint.h>
+
+// The ESP32 and PIC32 codecs use clashing headers (wiimote.h), so each side is built in its own file and
+// they only share these plain structs holding the values a frame is expected to carry
+
+// Wiimote slot fields as seen by the PIC32
+#define LINK_WIIMOTE_FIELDS \
+    X(extension) X(a) X(b) X(one) X(two) X(up) X(down) X(right) X(left) X(plus) X(minus) X(home) \
+    X(classic_plus) X(classic_minus) X(classic_home) X(nunchuk_c) X(nunchuk_z) \
+    X(classic_a) X(classic_b) X(classic_x) X(classic_y) X(classic_up) X(classic_down) X(classic_right) X(classic_left) \
+    X(classic_r) X(classic_zr) X(classic_l) X(classic_zl) \
+    X(classic_lx) X(classic_ly) X(classic_rx) X(classic_ry) X(nunchuk_x) X(nunchuk_y) \
+    X(accel_x) X(accel_y) X(accel_z) X(nunchuk_accel_x) X(nunchuk_accel_y) X(nunchuk_accel_z) \
+    X(ir0_x) X(ir0_y) X(ir1_x) X(ir1_y)
+
+#define LINK_IMU_FIELDS \
+    X(time) X(roll) X(pitch) X(yaw) X(accel_x) X(accel_y) X(accel_z)
+
+#define LINK_STATE_FIELDS \
+    X(wiimote_num) X(rumble_intensity) X(led_state) X(flags) X(reporting_mode) X(speaker_format) X(speaker_volume)
+
+#define LINK_STATUS_FIELDS \
+    X(wiimote_num) X(player_num) X(rumble) X(connection_allowed)
+
+#define X(name) uint16_t name;
+typedef struct { LINK_WIIMOTE_FIELDS } link_wiimote_t;
+typedef struct { LINK_IMU_FIELDS } link_imu_t;
+typedef struct { LINK_STATE_FIELDS } link_state_t;
+typedef struct { LINK_STATUS_FIELDS } link_status_t;
+#undef X
+
+#define LINK_MAX_IMU_SAMPLES 3
+
+// Shared xorshift generator so runs are repeatable from a seed
+static inline uint32_t link_rand(uint32_t * state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// ESP32 side (spi_codec_esp.c)
+void esp_random_wiimote(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_wiimote_t * expected);
+uint8_t esp_random_imu(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_imu_t * expected);
+uint8_t esp_decode_state(const uint8_t * buf, link_state_t * state);
+uint8_t esp_decode_status(uint8_t status, link_status_t * decoded);
+void esp_bench_prepare(uint32_t * rng);
+void esp_bench_encode(uint8_t * frame);
+void esp_bench_decode(const uint8_t * frame);
+
+// PIC32 side (spi_codec_pic.c)
+uint8_t pic_decode_wiimote(const uint8_t * buf, link_wiimote_t * decoded);
+uint8_t pic_decode_imu(const uint8_t * buf, link_imu_t * decoded);
+void pic_random_state(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_state_t * expected);
+uint8_t pic_random_status(uint32_t * rng, link_status_t * expected);
+void pic_bench_prepare(uint32_t * rng);
+void pic_bench_encode(uint8_t * frame);
+void pic_bench_decode(const uint8_t * frame);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "orientation.h"
+#include "loopback.h"
+
+// Replays an IMU trace through the orientation filter, checks the pointer angles and times each sample.
+// Usage: orientation_replay [trace]
+// A trace has one sample per line: time (us), gyro x y z, accel x y z (raw Switch units, body frame).
+// Without one a synthetic trace is used: rest, a 90 degree turn left, then a 20 degree tilt down.
+
+#define MAX_SAMPLES         100000
+#define SAMPLE_PERIOD_US    5000        // Joy-Con and Pro Controller send 3 samples per 15 ms report
+#define ACCEL_1G            4096.0
+#define GYRO_NOISE          4           // LSB
+#define ACCEL_NOISE         20
+#define ANGLE_TOLERANCE     2.0         // Degrees
+#define SAMPLE_BUDGET_NS    5000        // Generous on a PC, the pipeline has a whole sample period per sample
+#define BENCH_SAMPLES       2000000
+
+typedef struct {
+    uint64_t time;
+    int16_t gyro[3];
+    int16_t accel[3];
+} sample_t;
+
+static sample_t samples[MAX_SAMPLES];
+static uint32_t num_samples = 0;
+
+static int16_t noise(uint32_t * rng, int16_t amplitude) {
+    return (int16_t)(link_rand(rng) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Rates in deg/s, pitch in degrees (positive points down)
+static void synth_segment(uint32_t * rng, uint32_t duration_ms, double yaw_rate, double pitch_rate, double * pitch) {
+    uint32_t i;
+
+    for (i = 0; (i < (duration_ms * 1000) / SAMPLE_PERIOD_US) && (num_samples < MAX_SAMPLES); i++) {
+        sample_t * s = &samples[num_samples];
+        double p = *pitch * M_PI / 180.0;
+
+        s->time = (uint64_t)num_samples * SAMPLE_PERIOD_US;
+        s->gyro[0] = noise(rng, GYRO_NOISE);
+        s->gyro[1] = (int16_t)lround(pitch_rate / GYRO_SCALE_SWITCH) + noise(rng, GYRO_NOISE);
+        s->gyro[2] = (int16_t)lround(yaw_rate / GYRO_SCALE_SWITCH) + noise(rng, GYRO_NOISE);
+        s->accel[0] = (int16_t)lround(-ACCEL_1G * sin(p)) + noise(rng, ACCEL_NOISE);
+        s->accel[1] = noise(rng, ACCEL_NOISE);
+        s->accel[2] = (int16_t)lround(ACCEL_1G * cos(p)) + noise(rng, ACCEL_NOISE);
+        num_samples++;
+
+        *pitch += pitch_rate * SAMPLE_PERIOD_US * 0.000001;
+    }
+}
+
+static uint8_t load_trace(const char * path) {
+    FILE * file = fopen(path, "r");
+    sample_t * s;
+
+    if (!file) {
+        printf("Can't open %s\n", path);
+        return 0;
+    }
+    while (num_samples < MAX_SAMPLES) {
+        s = &samples[num_samples];
+        if (fscanf(file, "%" SCNu64 " %" SCNd16 " %" SCNd16 " %" SCNd16 " %" SCNd16 " %" SCNd16 " %" SCNd16,
+                   &s->time, &s->gyro[0], &s->gyro[1], &s->gyro[2], &s->accel[0], &s->accel[1], &s->accel[2]) != 7) break;
+        num_samples++;
+    }
+    fclose(file);
+    return num_samples != 0;
+}
+
+static void replay(orientation_t * orientation, uint64_t time_offset) {
+    uint32_t i;
+
+    for (i = 0; i < num_samples; i++)
+        orientation_update(orientation, samples[i].gyro, samples[i].accel, GYRO_SCALE_SWITCH, samples[i].time + time_offset);
+}
+
+static uint8_t check(const char * what, float value, double expected) {
+    uint8_t ok = fabs(value - expected) <= ANGLE_TOLERANCE;
+    printf("%-6s %7.2f deg (expected %.2f): %s\n", what, value, expected, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+int main(int argc, char ** argv) {
+    orientation_t orientation;
+    uint64_t trace_length;
+    uint32_t rng = 0x5EED;
+    uint32_t replayed = 0;
+    uint8_t ok = 1;
+    double pitch = 0;
+    double start, ns_per_sample;
+    float yaw_out, pitch_out;
+
+    if (argc > 1) {
+        if (!load_trace(argv[1])) return 1;
+    } else {
+        synth_segment(&rng, 1000, 0, 0, &pitch);
+        synth_segment(&rng, 1000, 90, 0, &pitch);
+        synth_segment(&rng, 500, 0, 0, &pitch);
+        synth_segment(&rng, 500, 0, 40, &pitch);
+        synth_segment(&rng, 500, 0, 0, &pitch);
+    }
+
+    orientation_reset(&orientation);
+    replay(&orientation, 0);
+    orientation_get_pointer(&orientation, &yaw_out, &pitch_out);
+    printf("%" PRIu32 " samples\n", num_samples);
+    if (argc > 1) printf("yaw %.2f deg, pitch %.2f deg\n", yaw_out, pitch_out);
+    else {
+        ok &= check("yaw", yaw_out, 90);
+        ok &= check("pitch", pitch_out, pitch);
+    }
+
+    // Keep time moving forward between passes so every sample is integrated
+    trace_length = samples[num_samples - 1].time + SAMPLE_PERIOD_US;
+    orientation_reset(&orientation);
+    start = seconds_now();
+    while (replayed < BENCH_SAMPLES) {
+        replay(&orientation, trace_length * (replayed / num_samples));
+        replayed += num_samples;
+    }
+    ns_per_sample = ((seconds_now() - start) * 1e9) / replayed;
+    printf("orientation_update %.1f ns/sample (budget %d ns): %s\n", ns_per_sample, SAMPLE_BUDGET_NS, (ns_per_sample <= SAMPLE_BUDGET_NS) ? "ok" : "FAILED");
+    if (ns_per_sample > SAMPLE_BUDGET_NS) ok = 0;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+#include <inttypes.h>
+#include <string.h>
+#include "spi.h"
+#include "spi_codec.h"
+#include "wiimote.h"
+#include "loopback.h"
+
+// Linked from the ESP32 firmware in the real build
+wiimote_t wiimotes[4];
+
+static wiimote_t bench_wiimotes[4];
+static spi_imu_sample_t bench_samples[4][IMU_SLOT_SAMPLES];
+
+static uint8_t rand_bit(uint32_t * rng) {
+    return link_rand(rng) & 0x01;
+}
+
+static void random_wiimote(uint32_t * rng, wiimote_t * wiimote) {
+    memset(wiimote, 0, sizeof(wiimote_t));
+    wiimote->active = 1;
+    wiimote->extension = link_rand(rng) % 3;
+
+    wiimote->a = rand_bit(rng);
+    wiimote->b = rand_bit(rng);
+    wiimote->one = rand_bit(rng);
+    wiimote->two = rand_bit(rng);
+    wiimote->du = rand_bit(rng);
+    wiimote->dd = rand_bit(rng);
+    wiimote->dr = rand_bit(rng);
+    wiimote->dl = rand_bit(rng);
+    wiimote->plus = rand_bit(rng);
+    wiimote->minus = rand_bit(rng);
+    wiimote->home = rand_bit(rng);
+
+    wiimote->classic.a = rand_bit(rng);
+    wiimote->classic.b = rand_bit(rng);
+    wiimote->classic.x = rand_bit(rng);
+    wiimote->classic.y = rand_bit(rng);
+    wiimote->classic.du = rand_bit(rng);
+    wiimote->classic.dd = rand_bit(rng);
+    wiimote->classic.dr = rand_bit(rng);
+    wiimote->classic.dl = rand_bit(rng);
+    wiimote->classic.plus = rand_bit(rng);
+    wiimote->classic.minus = rand_bit(rng);
+    wiimote->classic.home = rand_bit(rng);
+    wiimote->classic.r = rand_bit(rng);
+    wiimote->classic.l = rand_bit(rng);
+    wiimote->classic.zr = rand_bit(rng);
+    wiimote->classic.zl = rand_bit(rng);
+    wiimote->classic.lx = link_rand(rng);
+    wiimote->classic.ly = link_rand(rng);
+    wiimote->classic.rx = link_rand(rng);
+    wiimote->classic.ry = link_rand(rng);
+
+    wiimote->nunchuk.c = rand_bit(rng);
+    wiimote->nunchuk.z = rand_bit(rng);
+    wiimote->nunchuk.x = link_rand(rng);
+    wiimote->nunchuk.y = link_rand(rng);
+    wiimote->nunchuk.accel_x = link_rand(rng) & 0x3FF;
+    wiimote->nunchuk.accel_y = link_rand(rng) & 0x3FF;
+    wiimote->nunchuk.accel_z = link_rand(rng) & 0x3FF;
+
+    wiimote->accel_x = link_rand(rng) & 0x3FF;
+    wiimote->accel_y = link_rand(rng) & 0x3FF;
+    wiimote->accel_z = link_rand(rng) & 0x3FF;
+
+    wiimote->motion_plus.yaw_speed = link_rand(rng) & 0x3FFF;
+    wiimote->motion_plus.pitch_speed = link_rand(rng) & 0x3FFF;
+    wiimote->motion_plus.roll_speed = link_rand(rng) & 0x3FFF;
+
+    wiimote->ir_idle = (link_rand(rng) % 8) == 0;
+    wiimote->ir_object[0].x = FIXED_FROM_INT(link_rand(rng) % 1024) + (link_rand(rng) & 0xFFFF);
+    wiimote->ir_object[0].y = FIXED_FROM_INT(link_rand(rng) % 768) + (link_rand(rng) & 0xFFFF);
+    wiimote->ir_object[1].x = FIXED_FROM_INT(link_rand(rng) % 1024) + (link_rand(rng) & 0xFFFF);
+    wiimote->ir_object[1].y = FIXED_FROM_INT(link_rand(rng) % 768) + (link_rand(rng) & 0xFFFF);
+}
+
+// What the PIC32 should make of a Wiimote (scaling and remapping included)
+static void expected_wiimote(const wiimote_t * wiimote, link_wiimote_t * expected) {
+    uint8_t stick_x = (wiimote->extension == EXT_CLASSIC) ? wiimote->classic.lx : wiimote->nunchuk.x;
+    uint8_t stick_y = (wiimote->extension == EXT_CLASSIC) ? wiimote->classic.ly : wiimote->nunchuk.y;
+
+    memset(expected, 0, sizeof(link_wiimote_t));
+    expected->extension = wiimote->extension;
+    expected->a = wiimote->a;
+    expected->b = wiimote->b | ((wiimote->extension != EXT_CLASSIC) ? wiimote->classic.zr : 0);  // ZR doubles as B
+    expected->one = wiimote->one;
+    expected->two = wiimote->two;
+    expected->up = wiimote->du;
+    expected->down = wiimote->dd;
+    expected->right = wiimote->dr;
+    expected->left = wiimote->dl;
+    expected->plus = wiimote->plus;
+    expected->minus = wiimote->minus;
+    expected->home = wiimote->home;
+    expected->classic_plus = wiimote->classic.plus;
+    expected->classic_minus = wiimote->classic.minus;
+    expected->classic_home = wiimote->classic.home;
+    expected->nunchuk_c = wiimote->nunchuk.c;
+    expected->nunchuk_z = wiimote->nunchuk.z;
+    expected->classic_a = wiimote->classic.a;
+    expected->classic_b = wiimote->classic.b;
+    expected->classic_x = wiimote->classic.x;
+    expected->classic_y = wiimote->classic.y;
+    expected->classic_up = wiimote->classic.du;
+    expected->classic_down = wiimote->classic.dd;
+    expected->classic_right = wiimote->classic.dr;
+    expected->classic_left = wiimote->classic.dl;
+    expected->classic_r = wiimote->classic.r;
+    expected->classic_zr = wiimote->classic.zr;
+    expected->classic_l = wiimote->classic.l;
+    expected->classic_zl = wiimote->classic.zl;
+    expected->classic_lx = stick_x >> 2;    // Classic Controller sticks are 6 and 5 bits
+    expected->classic_ly = stick_y >> 2;
+    expected->classic_rx = wiimote->classic.rx >> 3;
+    expected->classic_ry = wiimote->classic.ry >> 3;
+    expected->nunchuk_x = stick_x;
+    expected->nunchuk_y = stick_y;
+    expected->accel_x = wiimote->accel_x;
+    expected->accel_y = wiimote->accel_y;
+    expected->accel_z = wiimote->accel_z;
+    expected->nunchuk_accel_x = wiimote->nunchuk.accel_x;
+    expected->nunchuk_accel_y = wiimote->nunchuk.accel_y;
+    expected->nunchuk_accel_z = wiimote->nunchuk.accel_z;
+    expected->ir0_x = wiimote->ir_idle ? 0xFFFF : (uint16_t)FIXED_TO_INT(wiimote->ir_object[0].x);
+    expected->ir0_y = wiimote->ir_idle ? 0xFFFF : (uint16_t)FIXED_TO_INT(wiimote->ir_object[0].y);
+    expected->ir1_x = wiimote->ir_idle ? 0xFFFF : (uint16_t)FIXED_TO_INT(wiimote->ir_object[1].x);
+    expected->ir1_y = wiimote->ir_idle ? 0xFFFF : (uint16_t)FIXED_TO_INT(wiimote->ir_object[1].y);
+}
+
+void esp_random_wiimote(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_wiimote_t * expected) {
+    wiimote_t wiimote;
+    random_wiimote(rng, &wiimote);
+    expected_wiimote(&wiimote, expected);
+    spi_codec_encode_wiimote(&wiimote, wiimote_num, buf);
+}
+
+static uint8_t random_samples(uint32_t * rng, spi_imu_sample_t * samples) {
+    uint8_t num_samples = 1 + (link_rand(rng) % IMU_SLOT_SAMPLES);
+    uint8_t i, j;
+
+    for (i = 0; i < num_samples; i++) {
+        samples[i].time = link_rand(rng);
+        for (j = 0; j < 3; j++) {
+            samples[i].gyro[j] = link_rand(rng) & 0x3FFF;
+            samples[i].accel[j] = link_rand(rng) & 0x3FF;
+        }
+    }
+    return num_samples;
+}
+
+// Returns the number of samples encoded
+uint8_t esp_random_imu(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_imu_t * expected) {
+    spi_imu_sample_t samples[IMU_SLOT_SAMPLES];
+    uint8_t num_samples = random_samples(rng, samples);
+    uint8_t i;
+
+    for (i = 0; i < num_samples; i++) {
+        expected[i].time = samples[i].time;
+        expected[i].roll = samples[i].gyro[0];
+        expected[i].pitch = samples[i].gyro[1];
+        expected[i].yaw = samples[i].gyro[2];
+        expected[i].accel_x = samples[i].accel[0];
+        expected[i].accel_y = samples[i].accel[1];
+        expected[i].accel_z = samples[i].accel[2];
+    }
+    spi_codec_encode_imu(samples, num_samples, wiimote_num, buf);
+    return num_samples;
+}
+
+uint8_t esp_decode_state(const uint8_t * buf, link_state_t * decoded) {
+    wii_state_t state;
+    uint8_t wiimote_num = spi_codec_decode_state(buf, &state);
+
+    memset(decoded, 0, sizeof(link_state_t));
+    if (!wiimote_num) return 0;
+    decoded->wiimote_num = wiimote_num;
+    decoded->rumble_intensity = state.rumble_intensity;
+    decoded->led_state = state.led_state;
+    decoded->flags = state.flags;
+    decoded->reporting_mode = state.reporting_mode;
+    decoded->speaker_format = state.speaker_format;
+    decoded->speaker_volume = state.speaker_volume;
+    return wiimote_num;
+}
+
+uint8_t esp_decode_status(uint8_t status, link_status_t * decoded) {
+    uint8_t player_num, rumble, connection_allowed;
+    uint8_t wiimote_num = spi_codec_decode_status(status, &player_num, &rumble, &connection_allowed);
+
+    memset(decoded, 0, sizeof(link_status_t));
+    if (!wiimote_num) return 0;
+    decoded->wiimote_num = wiimote_num;
+    decoded->player_num = player_num;
+    decoded->rumble = rumble;
+    decoded->connection_allowed = connection_allowed;
+    return wiimote_num;
+}
+
+void esp_bench_prepare(uint32_t * rng) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        random_wiimote(rng, &bench_wiimotes[i]);
+        random_samples(rng, bench_samples[i]);
+    }
+}
+
+// Build a full upstream frame the way wiimote_spi_update does
+void esp_bench_encode(uint8_t * frame) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        spi_codec_encode_wiimote(&bench_wiimotes[i], i + 1, frame + (SPI_SLOT_LEN * i));
+        spi_codec_encode_imu(bench_samples[i], IMU_SLOT_SAMPLES, i + 1, frame + (SPI_SLOT_LEN * (i + 4)));
+    }
+}
+
+// Read a full downstream frame the way wiimote_spi_receive does
+void esp_bench_decode(const uint8_t * frame) {
+    uint8_t player_num, rumble, connection_allowed;
+    wii_state_t state;
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        if (spi_codec_decode_state(frame + SPI_DOWNSTREAM_OFFSET + (SPI_DOWNSTREAM_LEN * i), &state)) wiimotes[i].wii_state = state;
+        if (spi_codec_decode_status(frame[i], &player_num, &rumble, &connection_allowed)) wiimotes[i].player_num = player_num;
+    }
+}
\ No newline at end of file
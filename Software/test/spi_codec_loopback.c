@@ -0,0 +1,112 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "loopback.h"
+
+// Round trips randomised states through both link codecs and checks every field, then times each codec.
+// Usage: spi_codec_loopback [seed] [iterations]
+
+#define FRAME_LEN       256
+#define BENCH_FRAMES    200000
+
+static uint32_t failures = 0;
+
+#define X(name) if (expected->name != decoded->name) { \
+        printf("%s %" PRIu32 ": %s expected %u, got %u\n", what, iteration, #name, expected->name, decoded->name); \
+        failures++; \
+    }
+static void compare_wiimote(const char * what, uint32_t iteration, const link_wiimote_t * expected, const link_wiimote_t * decoded) { LINK_WIIMOTE_FIELDS }
+static void compare_imu(const char * what, uint32_t iteration, const link_imu_t * expected, const link_imu_t * decoded) { LINK_IMU_FIELDS }
+static void compare_state(const char * what, uint32_t iteration, const link_state_t * expected, const link_state_t * decoded) { LINK_STATE_FIELDS }
+static void compare_status(const char * what, uint32_t iteration, const link_status_t * expected, const link_status_t * decoded) { LINK_STATUS_FIELDS }
+#undef X
+
+static void check(const char * what, uint32_t iteration, int ok) {
+    if (ok) return;
+    printf("%s %" PRIu32 ": failed\n", what, iteration);
+    failures++;
+}
+
+static void round_trip(uint32_t * rng, uint32_t iteration) {
+    uint8_t buf[32];
+    uint8_t wiimote_num = 1 + (iteration % 4);
+    link_wiimote_t expected_wiimote, decoded_wiimote;
+    link_imu_t expected_imu[LINK_MAX_IMU_SAMPLES], decoded_imu[LINK_MAX_IMU_SAMPLES];
+    link_state_t expected_state, decoded_state;
+    link_status_t expected_status, decoded_status;
+    uint8_t num_samples, i;
+
+    // ESP32 -> PIC32
+    esp_random_wiimote(rng, wiimote_num, buf, &expected_wiimote);
+    check("wiimote checksum", iteration, pic_decode_wiimote(buf, &decoded_wiimote));
+    compare_wiimote("wiimote", iteration, &expected_wiimote, &decoded_wiimote);
+
+    buf[1 + (link_rand(rng) % 4)] ^= 1 << (link_rand(rng) % 8);    // Any flipped button bit must fail the checksum
+    check("wiimote corrupt", iteration, !pic_decode_wiimote(buf, &decoded_wiimote));
+
+    num_samples = esp_random_imu(rng, wiimote_num, buf, expected_imu);
+    check("imu count", iteration, pic_decode_imu(buf, decoded_imu) == num_samples);
+    for (i = 0; i < num_samples; i++) compare_imu("imu", iteration, &expected_imu[i], &decoded_imu[i]);
+
+    buf[link_rand(rng) % 31] ^= 1 << (link_rand(rng) % 8);
+    check("imu corrupt", iteration, !pic_decode_imu(buf, decoded_imu));
+
+    // PIC32 -> ESP32
+    pic_random_state(rng, wiimote_num, buf, &expected_state);
+    check("state checksum", iteration, esp_decode_state(buf, &decoded_state) == wiimote_num);
+    compare_state("state", iteration, &expected_state, &decoded_state);
+
+    buf[1 + (link_rand(rng) % 6)] ^= 1 << (link_rand(rng) % 8);
+    check("state corrupt", iteration, !esp_decode_state(buf, &decoded_state));
+
+    buf[0] = pic_random_status(rng, &expected_status);
+    check("status", iteration, esp_decode_status(buf[0], &decoded_status) == expected_status.wiimote_num);
+    compare_status("status", iteration, &expected_status, &decoded_status);
+}
+
+static double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static void bench(const char * name, void (*run)(uint8_t *), uint8_t * frame) {
+    double start = seconds_now();
+    double elapsed;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++) run(frame);
+    elapsed = seconds_now() - start;
+    printf("%-12s %10.0f frames/s (%.1f ns/frame)\n", name, BENCH_FRAMES / elapsed, (elapsed * 1e9) / BENCH_FRAMES);
+}
+
+static void run_esp_decode(uint8_t * frame) { esp_bench_decode(frame); }
+static void run_pic_decode(uint8_t * frame) { pic_bench_decode(frame); }
+
+int main(int argc, char ** argv) {
+    uint32_t seed = (argc > 1) ? strtoul(argv[1], NULL, 0) : 0x5EED;
+    uint32_t iterations = (argc > 2) ? strtoul(argv[2], NULL, 0) : 100000;
+    uint32_t rng = seed ? seed : 1;
+    uint8_t upstream[FRAME_LEN];
+    uint8_t downstream[FRAME_LEN];
+    uint32_t i;
+
+    for (i = 0; i < iterations; i++) round_trip(&rng, i);
+    printf("%" PRIu32 " round trips (seed 0x%" PRIX32 "): %" PRIu32 " failures\n", iterations, seed, failures);
+
+    memset(upstream, 0, sizeof(upstream));
+    memset(downstream, 0, sizeof(downstream));
+    esp_bench_prepare(&rng);
+    pic_bench_prepare(&rng);
+    esp_bench_encode(upstream);
+    pic_bench_encode(downstream);
+
+    bench("esp encode", esp_bench_encode, upstream);
+    bench("pic decode", run_pic_decode, upstream);
+    bench("pic encode", pic_bench_encode, downstream);
+    bench("esp decode", run_esp_decode, downstream);
+
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include <inttypes.h>
+#include <string.h>
+#include "spi.h"
+#include "spi_codec.h"
+#include "wiimote.h"
+#include "loopback.h"
+
+static struct spi_wii_state bench_states[4];
+static uint8_t bench_status[4];
+static struct wiimote_state_usr bench_usr[4];
+static struct spi_imu_sample bench_samples[4][IMU_SLOT_SAMPLES];
+
+uint8_t pic_decode_wiimote(const uint8_t * buf, link_wiimote_t * decoded) {
+    struct wiimote_state_usr usr;
+    enum EXTENSION_TYPE extension;
+
+    memset(decoded, 0, sizeof(link_wiimote_t));
+    memset(&usr, 0, sizeof(usr));
+    if (!spi_codec_decode_wiimote(buf, &usr, &extension)) return 0;
+
+    decoded->extension = extension;
+    decoded->a = usr.a;
+    decoded->b = usr.b;
+    decoded->one = usr.one;
+    decoded->two = usr.two;
+    decoded->up = usr.up;
+    decoded->down = usr.down;
+    decoded->right = usr.right;
+    decoded->left = usr.left;
+    decoded->plus = usr.plus;
+    decoded->minus = usr.minus;
+    decoded->home = usr.home;
+    decoded->classic_plus = usr.classic.plus;
+    decoded->classic_minus = usr.classic.minus;
+    decoded->classic_home = usr.classic.home;
+    decoded->nunchuk_c = usr.nunchuk.c;
+    decoded->nunchuk_z = usr.nunchuk.z;
+    decoded->classic_a = usr.classic.a;
+    decoded->classic_b = usr.classic.b;
+    decoded->classic_x = usr.classic.x;
+    decoded->classic_y = usr.classic.y;
+    decoded->classic_up = usr.classic.up;
+    decoded->classic_down = usr.classic.down;
+    decoded->classic_right = usr.classic.right;
+    decoded->classic_left = usr.classic.left;
+    decoded->classic_r = usr.classic.r;
+    decoded->classic_zr = usr.classic.zr;
+    decoded->classic_l = usr.classic.l;
+    decoded->classic_zl = usr.classic.zl;
+    decoded->classic_lx = usr.classic.lx;
+    decoded->classic_ly = usr.classic.ly;
+    decoded->classic_rx = usr.classic.rx;
+    decoded->classic_ry = usr.classic.ry;
+    decoded->nunchuk_x = usr.nunchuk.x;
+    decoded->nunchuk_y = usr.nunchuk.y;
+    decoded->accel_x = usr.accel_x;
+    decoded->accel_y = usr.accel_y;
+    decoded->accel_z = usr.accel_z;
+    decoded->nunchuk_accel_x = usr.nunchuk.accel_x;
+    decoded->nunchuk_accel_y = usr.nunchuk.accel_y;
+    decoded->nunchuk_accel_z = usr.nunchuk.accel_z;
+    decoded->ir0_x = usr.ir_object[0].x;
+    decoded->ir0_y = usr.ir_object[0].y;
+    decoded->ir1_x = usr.ir_object[1].x;
+    decoded->ir1_y = usr.ir_object[1].y;
+    return 1;
+}
+
+// Returns the number of samples decoded
+uint8_t pic_decode_imu(const uint8_t * buf, link_imu_t * decoded) {
+    struct spi_imu_sample samples[IMU_SLOT_SAMPLES];
+    uint8_t num_samples = spi_codec_decode_imu(buf, samples);
+    uint8_t i;
+
+    for (i = 0; i < num_samples; i++) {
+        decoded[i].time = samples[i].time;
+        decoded[i].roll = samples[i].roll;
+        decoded[i].pitch = samples[i].pitch;
+        decoded[i].yaw = samples[i].yaw;
+        decoded[i].accel_x = samples[i].accel_x;
+        decoded[i].accel_y = samples[i].accel_y;
+        decoded[i].accel_z = samples[i].accel_z;
+    }
+    return num_samples;
+}
+
+static void random_state(uint32_t * rng, struct spi_wii_state * state) {
+    state->rumble_intensity = link_rand(rng);
+    state->led_state = link_rand(rng) & 0x0F;
+    state->flags = link_rand(rng) & 0x1F;
+    state->reporting_mode = 0x30 + (link_rand(rng) % 0x10);
+    state->speaker_format = link_rand(rng);
+    state->speaker_volume = link_rand(rng);
+}
+
+void pic_random_state(uint32_t * rng, uint8_t wiimote_num, uint8_t * buf, link_state_t * expected) {
+    struct spi_wii_state state;
+
+    random_state(rng, &state);
+    expected->wiimote_num = wiimote_num;
+    expected->rumble_intensity = state.rumble_intensity;
+    expected->led_state = state.led_state;
+    expected->flags = state.flags;
+    expected->reporting_mode = state.reporting_mode;
+    expected->speaker_format = state.speaker_format;
+    expected->speaker_volume = state.speaker_volume;
+    spi_codec_encode_state(wiimote_num, &state, buf);
+}
+
+// Returns the encoded status byte
+uint8_t pic_random_status(uint32_t * rng, link_status_t * expected) {
+    expected->wiimote_num = 1 + (link_rand(rng) % 4);
+    expected->player_num = link_rand(rng) % 8;
+    expected->rumble = link_rand(rng) & 0x01;
+    expected->connection_allowed = link_rand(rng) & 0x01;
+    return spi_codec_encode_status(expected->wiimote_num, expected->player_num, expected->connection_allowed, expected->rumble);
+}
+
+void pic_bench_prepare(uint32_t * rng) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        random_state(rng, &bench_states[i]);
+        bench_status[i] = spi_codec_encode_status(i + 1, link_rand(rng) % 8, link_rand(rng) & 0x01, link_rand(rng) & 0x01);
+    }
+}
+
+// Build a full downstream frame: 4 status bytes, then one Wii state message per Wiimote
+void pic_bench_encode(uint8_t * frame) {
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        frame[i] = bench_status[i];
+        spi_codec_encode_state(i + 1, &bench_states[i], frame + SPI_DOWNSTREAM_OFFSET + (SPI_DOWNSTREAM_LEN * i));
+    }
+}
+
+// Read a full upstream frame: 4 Wiimote slots then 4 IMU slots
+void pic_bench_decode(const uint8_t * frame) {
+    enum EXTENSION_TYPE extension;
+    uint8_t i;
+    for (i = 0; i < 4; i++) {
+        spi_codec_decode_wiimote(frame + (SPI_SLOT_LEN * i), &bench_usr[i], &extension);
+        spi_codec_decode_imu(frame + (SPI_SLOT_LEN * (i + 4)), bench_samples[i]);
+    }
+}
\ No newline at end of file